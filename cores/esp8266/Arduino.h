@@ -203,6 +203,8 @@ void analogReference(uint8_t mode);
 void analogWrite(uint8_t pin, int val);
 void analogWriteFreq(uint32_t freq);
 void analogWriteRange(uint32_t range);
+void analogWriteSync(bool sync);
+void analogWritePhase(uint8_t pin, int phase);
 
 unsigned long millis(void);
 unsigned long micros(void);
@@ -164,11 +164,13 @@ bool FS::begin() {
     if (!_impl) {
         return false;
     }
+    _impl->changed();
     return _impl->begin();
 }
 
 void FS::end() {
     if (_impl) {
+        _impl->changed();
         _impl->end();
     }
 }
@@ -177,6 +179,7 @@ bool FS::format() {
     if (!_impl) {
         return false;
     }
+    _impl->changed();
     return _impl->format();
 }
 
@@ -203,6 +206,10 @@ File FS::open(const char* path, const char* mode) {
         return File();
     }
 
+    // a write to an existing file shows up in contentGeneration() once it is flushed or closed
+    if ((am & AM_WRITE) && !_impl->exists(path)) {
+        _impl->changed();
+    }
     return File(_impl->open(path, om, am));
 }
 
@@ -232,6 +239,7 @@ bool FS::remove(const char* path) {
     if (!_impl) {
         return false;
     }
+    _impl->changed();
     return _impl->remove(path);
 }
 
@@ -243,6 +251,7 @@ bool FS::rename(const char* pathFrom, const char* pathTo) {
     if (!_impl) {
         return false;
     }
+    _impl->changed();
     return _impl->rename(pathFrom, pathTo);
 }
 
@@ -250,6 +259,20 @@ bool FS::rename(const String& pathFrom, const String& pathTo) {
     return rename(pathFrom.c_str(), pathTo.c_str());
 }
 
+uint32_t FS::generation() const {
+    if (!_impl) {
+        return 0;
+    }
+    return _impl->generation();
+}
+
+uint32_t FS::contentGeneration() const {
+    if (!_impl) {
+        return 0;
+    }
+    return _impl->contentGeneration();
+}
+
 
 static bool sflags(const char* mode, OpenMode& om, AccessMode& am) {
     switch (mode[0]) {
@@ -125,6 +125,12 @@ public:
     bool rename(const char* pathFrom, const char* pathTo);
     bool rename(const String& pathFrom, const String& pathTo);
 
+    // Changes every time files may have been created, removed or renamed through
+    // this API, so whatever was learned from a directory listing can be cached
+    uint32_t generation() const;
+    // Changes every time a file written through this API is flushed or closed
+    uint32_t contentGeneration() const;
+
 protected:
     FSImplPtr _impl;
 };
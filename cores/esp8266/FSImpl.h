@@ -72,6 +72,16 @@ public:
     virtual bool rename(const char* pathFrom, const char* pathTo) = 0;
     virtual bool remove(const char* path) = 0;
 
+    // Bumped by FS whenever files may have been created, removed or renamed
+    uint32_t generation() const { return _generation; }
+    void changed() { ++_generation; }
+    // Bumped by the files once data written to them is flushed or closed
+    uint32_t contentGeneration() const { return _contentGeneration; }
+    void contentChanged() { ++_contentGeneration; }
+
+protected:
+    uint32_t _generation = 0;
+    uint32_t _contentGeneration = 0;
 };
 
 } // namespace fs
@@ -32,13 +32,16 @@
 #include "Esp.h"
 
 HardwareSerial::HardwareSerial(int uart_nr)
-    : _uart_nr(uart_nr), _rx_size(256)
+    : _uart_nr(uart_nr), _rx_size(256), _tx_size(0)
 {}
 
 void HardwareSerial::begin(unsigned long baud, SerialConfig config, SerialMode mode, uint8_t tx_pin)
 {
     end();
     _uart = uart_init(_uart_nr, baud, (int) config, (int) mode, tx_pin, _rx_size);
+    if(_tx_size) {
+        uart_resize_tx_buffer(_uart, _tx_size);
+    }
 #if defined(DEBUG_ESP_PORT) && !defined(NDEBUG)
     if (static_cast<void*>(this) == static_cast<void*>(&DEBUG_ESP_PORT))
     {
@@ -68,6 +71,37 @@ size_t HardwareSerial::setRxBufferSize(size_t size){
     return _rx_size;
 }
 
+size_t HardwareSerial::setTxBufferSize(size_t size){
+    if(_uart) {
+        _tx_size = uart_resize_tx_buffer(_uart, size);
+    } else {
+        _tx_size = size;
+    }
+    return _tx_size;
+}
+
+size_t HardwareSerial::readBytes(char* buffer, size_t size)
+{
+    size_t got = 0;
+    unsigned long start = millis();
+    while(got < size) {
+        size_t chunk = uart_read(_uart, buffer + got, size - got);
+        got += chunk;
+        if(got == size) {
+            break;
+        }
+        if(chunk) {
+            // the timeout counts from the last byte received, as in Stream::timedRead()
+            start = millis();
+        } else if(millis() - start >= _timeout) {
+            break;
+        } else {
+            yield();
+        }
+    }
+    return got;
+}
+
 void HardwareSerial::setDebugOutput(bool en)
 {
     if(!_uart) {
@@ -88,6 +88,8 @@ public:
     void end();
 
     size_t setRxBufferSize(size_t size);
+    // 0, the default, writes straight to the 128 byte hardware fifo
+    size_t setTxBufferSize(size_t size);
 
     void swap()
     {
@@ -128,6 +130,21 @@ public:
         // this may return -1, but that's okay
         return uart_read_char(_uart);
     }
+    // read already received data, without waiting
+    size_t read(char* buffer, size_t size)
+    {
+        return uart_read(_uart, buffer, size);
+    }
+    size_t read(uint8_t* buffer, size_t size)
+    {
+        return uart_read(_uart, (char*)buffer, size);
+    }
+    // wait up to the stream timeout for size bytes
+    size_t readBytes(char* buffer, size_t size) override;
+    size_t readBytes(uint8_t* buffer, size_t size) override
+    {
+        return readBytes((char*)buffer, size);
+    }
     int availableForWrite(void)
     {
         return static_cast<int>(uart_tx_free(_uart));
@@ -194,6 +211,7 @@ protected:
     int _uart_nr;
     uart_t* _uart = nullptr;
     size_t _rx_size;
+    size_t _tx_size;
 };
 
 extern HardwareSerial Serial;
@@ -1,3 +1,4 @@
+#include <stddef.h>
 #include "Schedule.h"
 
 struct scheduled_fn_t
@@ -19,10 +19,15 @@ UpdaterClass::UpdaterClass()
 , _error(0)
 , _buffer(0)
 , _bufferLen(0)
+, _pendingBuffer(0)
+, _pendingLen(0)
 , _size(0)
 , _startAddress(0)
 , _currentAddress(0)
+, _erasedAddress(0)
 , _command(U_FLASH)
+, _eraseTime(0)
+, _writeTime(0)
 {
 }
 
@@ -31,8 +36,13 @@ void UpdaterClass::_reset() {
     delete[] _buffer;
   _buffer = 0;
   _bufferLen = 0;
+  if (_pendingBuffer)
+    delete[] _pendingBuffer;
+  _pendingBuffer = 0;
+  _pendingLen = 0;
   _startAddress = 0;
   _currentAddress = 0;
+  _erasedAddress = 0;
   _size = 0;
   _command = U_FLASH;
 }
@@ -114,6 +124,7 @@ bool UpdaterClass::begin(size_t size, int command) {
   //initialize
   _startAddress = updateStartAddress;
   _currentAddress = _startAddress;
+  _erasedAddress = _startAddress;
   _size = size;
   if (ESP.getFreeHeap() > 2 * FLASH_SECTOR_SIZE) {
     _bufferSize = FLASH_SECTOR_SIZE;
@@ -121,7 +132,13 @@ bool UpdaterClass::begin(size_t size, int command) {
     _bufferSize = 256;
   }
   _buffer = new uint8_t[_bufferSize];
+  if (ESP.getFreeHeap() > 3 * FLASH_SECTOR_SIZE) {
+    // a second sector buffer lets the next one fill while the last is waiting to be written
+    _pendingBuffer = new uint8_t[_bufferSize];
+  }
   _command = command;
+  _eraseTime = 0;
+  _writeTime = 0;
 
 #ifdef DEBUG_UPDATER
   DEBUG_UPDATER.printf("[begin] _startAddress:     0x%08X (%d)\n", _startAddress, _startAddress);
@@ -160,7 +177,7 @@ bool UpdaterClass::end(bool evenIfRemaining){
   }
 
   if(evenIfRemaining) {
-    if(_bufferLen > 0) {
+    if(_pendingLen > 0 || _bufferLen > 0) {
       _writeBuffer();
     }
     _size = progress();
@@ -203,14 +220,75 @@ bool UpdaterClass::end(bool evenIfRemaining){
   return true;
 }
 
+bool UpdaterClass::_eraseSector(uint32_t address){
+  uint32_t start = micros();
+  bool eraseResult = ESP.flashEraseSector(address/FLASH_SECTOR_SIZE);
+  _eraseTime += micros() - start;
+  if (eraseResult) {
+    _erasedAddress = address + FLASH_SECTOR_SIZE;
+  }
+  return eraseResult;
+}
+
+bool UpdaterClass::idle(){
+  if(hasError() || !isRunning())
+    return false;
+
+  if(_pendingLen > 0) {
+    _writePending();
+    return true;
+  }
+  if(_erasedAddress < _startAddress + _size && _erasedAddress < _currentAddress + UPDATER_ERASE_AHEAD * FLASH_SECTOR_SIZE) {
+    if(!_eraseSector(_erasedAddress)) {
+      _currentAddress = (_startAddress + _size);
+      _setError(UPDATE_ERROR_ERASE);
+    }
+    return true;
+  }
+  return false;
+}
+
+// Writes everything buffered to flash
 bool UpdaterClass::_writeBuffer(){
+  if(!_writePending())
+    return false;
+  if(!_flashBuffer(_buffer, _bufferLen))
+    return false;
+  _bufferLen = 0;
+  return true;
+}
+
+bool UpdaterClass::_writePending(){
+  if(_pendingLen == 0)
+    return true;
+  if(!_flashBuffer(_pendingBuffer, _pendingLen))
+    return false;
+  _pendingLen = 0;
+  return true;
+}
+
+// A full buffer, written right away or, with a spare buffer, held back until idle()
+bool UpdaterClass::_queueBuffer(){
+  if(!_pendingBuffer)
+    return _writeBuffer();
+  if(!_writePending())
+    return false;
+  uint8_t *full = _buffer;
+  _buffer = _pendingBuffer;
+  _pendingBuffer = full;
+  _pendingLen = _bufferLen;
+  _bufferLen = 0;
+  return true;
+}
+
+bool UpdaterClass::_flashBuffer(uint8_t *buffer, size_t len){
   #define FLASH_MODE_PAGE  0
   #define FLASH_MODE_OFFSET  2
 
   bool eraseResult = true, writeResult = true;
-  if (_currentAddress % FLASH_SECTOR_SIZE == 0) {
+  if (_currentAddress % FLASH_SECTOR_SIZE == 0 && _currentAddress >= _erasedAddress) {
     if(!_async) yield();
-    eraseResult = ESP.flashEraseSector(_currentAddress/FLASH_SECTOR_SIZE);
+    eraseResult = _eraseSector(_currentAddress);
   }
 
   // If the flash settings don't match what we already have, modify them.
@@ -222,22 +300,24 @@ bool UpdaterClass::_writeBuffer(){
   if (_currentAddress == _startAddress + FLASH_MODE_PAGE) {
     flashMode = ESP.getFlashChipMode();
     #ifdef DEBUG_UPDATER
-      DEBUG_UPDATER.printf("Header: 0x%1X %1X %1X %1X\n", _buffer[0], _buffer[1], _buffer[2], _buffer[3]);
+      DEBUG_UPDATER.printf("Header: 0x%1X %1X %1X %1X\n", buffer[0], buffer[1], buffer[2], buffer[3]);
     #endif
-    bufferFlashMode = ESP.magicFlashChipMode(_buffer[FLASH_MODE_OFFSET]);
+    bufferFlashMode = ESP.magicFlashChipMode(buffer[FLASH_MODE_OFFSET]);
     if (bufferFlashMode != flashMode) {
       #ifdef DEBUG_UPDATER
         DEBUG_UPDATER.printf("Set flash mode from 0x%1X to 0x%1X\n", bufferFlashMode, flashMode);
       #endif
 
-      _buffer[FLASH_MODE_OFFSET] = flashMode;
+      buffer[FLASH_MODE_OFFSET] = flashMode;
       modifyFlashMode = true;
     }
   }
   
   if (eraseResult) {
     if(!_async) yield();
-    writeResult = ESP.flashWrite(_currentAddress, (uint32_t*) _buffer, _bufferLen);
+    uint32_t start = micros();
+    writeResult = ESP.flashWrite(_currentAddress, (uint32_t*) buffer, len);
+    _writeTime += micros() - start;
   } else { // if erase was unsuccessful
     _currentAddress = (_startAddress + _size);
     _setError(UPDATE_ERROR_ERASE);
@@ -247,7 +327,7 @@ bool UpdaterClass::_writeBuffer(){
   // Restore the old flash mode, if we modified it.
   // Ensures that the MD5 hash will still match what was sent.
   if (modifyFlashMode) {
-    _buffer[FLASH_MODE_OFFSET] = bufferFlashMode;
+    buffer[FLASH_MODE_OFFSET] = bufferFlashMode;
   }
 
   if (!writeResult) {
@@ -255,9 +335,8 @@ bool UpdaterClass::_writeBuffer(){
     _setError(UPDATE_ERROR_WRITE);
     return false;
   }
-  _md5.add(_buffer, _bufferLen);
-  _currentAddress += _bufferLen;
-  _bufferLen = 0;
+  _md5.add(buffer, len);
+  _currentAddress += len;
   return true;
 }
 
@@ -18,6 +18,9 @@
 #define UPDATE_ERROR_MAGIC_BYTE         (10)
 #define UPDATE_ERROR_BOOTSTRAP          (11)
 
+// Sectors erased ahead of the write position while waiting for data
+#define UPDATER_ERASE_AHEAD 4
+
 #define U_FLASH   0
 #define U_SPIFFS  100
 #define U_AUTH    200
@@ -99,11 +102,25 @@ class UpdaterClass {
     size_t progress(){ return _currentAddress - _startAddress; }
     size_t remaining(){ return _size - (_currentAddress - _startAddress); }
 
+    /*
+      Does one piece of flash work that can be done ahead of time:
+      writes a full buffer still held back, or erases the next sector.
+      Call it while waiting for data instead of delay()
+      Returns false if there was nothing to do
+    */
+    bool idle();
+
+    //Time spent erasing and writing flash since begin(), in microseconds
+    uint32_t eraseTime(){ return _eraseTime; }
+    uint32_t writeTime(){ return _writeTime; }
+
     /*
       Template to write from objects that expose
       available() and read(uint8_t*, size_t) methods
       faster than the writeStream method
       writes only what is available
+      A full buffer is held back while more data is coming in and
+      written to flash when it stops, so receiving and flashing overlap
     */
     template<typename T>
     size_t write(T &data){
@@ -113,30 +130,30 @@ class UpdaterClass {
 
       size_t available = data.available();
       while(available) {
-        if(_bufferLen + available > remaining()){
-          available = remaining() - _bufferLen;
-        }
-        if(_bufferLen + available > _bufferSize) {
-          size_t toBuff = _bufferSize - _bufferLen;
-          data.read(_buffer + _bufferLen, toBuff);
-          _bufferLen += toBuff;
-          if(!_writeBuffer())
-            return written;
-          written += toBuff;
-        } else {
-          data.read(_buffer + _bufferLen, available);
-          _bufferLen += available;
-          written += available;
-          if(_bufferLen == remaining()) {
-            if(!_writeBuffer()) {
-              return written;
-            }
-          }
+        size_t toBuff = available;
+        if(toBuff > _bufferSize - _bufferLen)
+          toBuff = _bufferSize - _bufferLen;
+        if(toBuff > remaining() - _pendingLen - _bufferLen)
+          toBuff = remaining() - _pendingLen - _bufferLen;
+        data.read(_buffer + _bufferLen, toBuff);
+        _bufferLen += toBuff;
+        written += toBuff;
+        if(_pendingLen + _bufferLen == remaining()) {
+          //we are at the end of the update, so should write what's left to flash
+          _writeBuffer();
+          return written;
         }
-        if(remaining() == 0)
+        if(_bufferLen == _bufferSize && !_queueBuffer())
           return written;
-        delay(1);
         available = data.available();
+        if(!available) {
+          //nothing new yet, do the flash work while the peer keeps sending
+          if(!idle())
+            delay(1);
+          if(hasError())
+            return written;
+          available = data.available();
+        }
       }
       return written;
     }
@@ -144,6 +161,10 @@ class UpdaterClass {
   private:
     void _reset();
     bool _writeBuffer();
+    bool _queueBuffer();
+    bool _writePending();
+    bool _flashBuffer(uint8_t *buffer, size_t len);
+    bool _eraseSector(uint32_t address);
 
     bool _verifyHeader(uint8_t data);
     bool _verifyEnd();
@@ -155,10 +176,15 @@ class UpdaterClass {
     uint8_t *_buffer;
     size_t _bufferLen; // amount of data written into _buffer
     size_t _bufferSize; // total size of _buffer
+    uint8_t *_pendingBuffer; // spare buffer, holds a full one until it is written
+    size_t _pendingLen; // amount of data waiting in _pendingBuffer
     size_t _size;
     uint32_t _startAddress;
     uint32_t _currentAddress;
+    uint32_t _erasedAddress; // end of the sectors erased ahead
     uint32_t _command;
+    uint32_t _eraseTime;
+    uint32_t _writeTime;
 
     String _target_md5;
     MD5Builder _md5;
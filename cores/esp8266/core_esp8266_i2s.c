@@ -64,6 +64,8 @@ typedef struct i2s_state {
   // Callback function should be defined as 'void ICACHE_RAM_ATTR function_name()',
   // and be placed in IRAM for faster execution. Avoid long computational tasks in this
   // function, use it to set flags and process later.
+  uint16_t         (*refill) (uint32_t *buf, uint16_t count);
+  // Fills a finished TX buffer right from the ISR, same rules as the callback.
 } i2s_state_t;
 
 // RX = I2S receive (i.e. microphone), TX = I2S transmit (i.e. DAC)
@@ -160,13 +162,25 @@ static void ICACHE_RAM_ATTR i2s_slc_isr(void) {
   SLCIC = 0xFFFFFFFF;
   if (slc_intr_status & SLCIRXEOF) {
     slc_queue_item_t *finished_item = (slc_queue_item_t *)SLCRXEDA;
-    // Zero the buffer so it is mute in case of underflow
-    ets_memset((void *)finished_item->buf_ptr, 0x00, SLC_BUF_LEN * 4);
-    if (tx->slc_queue_len >= SLC_BUF_CNT-1) {
-      // All buffers are empty. This means we have an underflow
-      i2s_slc_queue_next_item(tx); // Free space for finished_item
+    uint16_t filled = 0;
+    if (tx->refill) {
+      // Refilled in place, the DMA plays it again when it comes around
+      filled = tx->refill(finished_item->buf_ptr, SLC_BUF_LEN);
+      if (filled > SLC_BUF_LEN) {
+        filled = SLC_BUF_LEN;
+      }
+    }
+    // Zero the (rest of the) buffer so it is mute in case of underflow
+    if (filled < SLC_BUF_LEN) {
+      ets_memset((void *)(finished_item->buf_ptr + filled), 0x00, (SLC_BUF_LEN - filled) * 4);
+    }
+    if (!filled) {
+      if (tx->slc_queue_len >= SLC_BUF_CNT-1) {
+        // All buffers are empty. This means we have an underflow
+        i2s_slc_queue_next_item(tx); // Free space for finished_item
+      }
+      tx->slc_queue[tx->slc_queue_len++] = finished_item->buf_ptr;
     }
-    tx->slc_queue[tx->slc_queue_len++] = finished_item->buf_ptr;
     if (tx->callback) {
       tx->callback();
     }
@@ -191,6 +205,15 @@ void i2s_rx_set_callback(void (*callback) (void)) {
   rx->callback = callback;
 }
 
+void i2s_set_refill_callback(uint16_t (*refill) (uint32_t *buf, uint16_t count)) {
+  if (!tx) {
+    return;
+  }
+  ETS_SLC_INTR_DISABLE();
+  tx->refill = refill;
+  ETS_SLC_INTR_ENABLE();
+}
+
 static bool _alloc_channel(i2s_state_t *ch) {
   ch->slc_queue_len = 0;
   for (int x=0; x<SLC_BUF_CNT; x++) {
@@ -286,21 +309,17 @@ static void i2s_slc_end(){
   }
 }
 
-// These routines push a single, 32-bit sample to the I2S buffers. Call at (on average)
-// at least the current sample rate.
-static bool _i2s_write_sample(uint32_t sample, bool nb) {
-  if (!tx) {
-    return false;
-  }
-
-  if (tx->curr_slc_buf_pos==SLC_BUF_LEN || tx->curr_slc_buf==NULL) {
-    if (tx->slc_queue_len == 0) {
-      if (nb) {
+// Make sure the current buffer has room left, taking the next one off the queue once
+// it is used up.  Returns false when none is free and we may not wait for one.
+static bool _i2s_next_buffer(i2s_state_t *ch, bool blocking) {
+  if (ch->curr_slc_buf_pos==SLC_BUF_LEN || ch->curr_slc_buf==NULL) {
+    if (ch->slc_queue_len == 0) {
+      if (!blocking) {
         // Don't wait if nonblocking, just notify upper levels
         return false;
       }
       while (1) {
-        if (tx->slc_queue_len > 0) {
+        if (ch->slc_queue_len > 0) {
           break;
         } else {
           optimistic_yield(10000);
@@ -308,9 +327,18 @@ static bool _i2s_write_sample(uint32_t sample, bool nb) {
       }
     }
     ETS_SLC_INTR_DISABLE();
-    tx->curr_slc_buf = (uint32_t *)i2s_slc_queue_next_item(tx);
+    ch->curr_slc_buf = (uint32_t *)i2s_slc_queue_next_item(ch);
     ETS_SLC_INTR_ENABLE();
-    tx->curr_slc_buf_pos=0;
+    ch->curr_slc_buf_pos=0;
+  }
+  return true;
+}
+
+// These routines push a single, 32-bit sample to the I2S buffers. Call at (on average)
+// at least the current sample rate.
+static bool _i2s_write_sample(uint32_t sample, bool nb) {
+  if (!tx || !_i2s_next_buffer(tx, !nb)) {
+    return false;
   }
   tx->curr_slc_buf[tx->curr_slc_buf_pos++]=sample;
   return true;
@@ -324,6 +352,54 @@ bool i2s_write_sample_nb(uint32_t sample) {
   return _i2s_write_sample(sample, true);
 }
 
+// Zero-copy writing: the free part of the DMA buffer being filled, the next free one
+// when that is full.  Samples written there go out once they are committed.
+uint32_t *i2s_acquire_buffer(uint16_t *space, bool blocking) {
+  if (!tx || !_i2s_next_buffer(tx, blocking)) {
+    *space = 0;
+    return NULL;
+  }
+  *space = SLC_BUF_LEN - tx->curr_slc_buf_pos;
+  return &tx->curr_slc_buf[tx->curr_slc_buf_pos];
+}
+
+void i2s_commit_buffer(uint16_t count) {
+  if (!tx || !tx->curr_slc_buf) {
+    return;
+  }
+  if (count > SLC_BUF_LEN - tx->curr_slc_buf_pos) {
+    count = SLC_BUF_LEN - tx->curr_slc_buf_pos;
+  }
+  tx->curr_slc_buf_pos += count;
+}
+
+// Block copies into the DMA buffers, the checks are done once per buffer instead of once per sample
+static uint16_t _i2s_write_buffer(const uint32_t *frames, uint16_t frame_count, bool nb) {
+  uint16_t written = 0;
+  while (written < frame_count) {
+    uint16_t space;
+    uint32_t *buf = i2s_acquire_buffer(&space, !nb);
+    if (!buf) {
+      break;
+    }
+    if (space > frame_count - written) {
+      space = frame_count - written;
+    }
+    memcpy(buf, frames + written, space * sizeof(frames[0]));
+    i2s_commit_buffer(space);
+    written += space;
+  }
+  return written;
+}
+
+uint16_t i2s_write_buffer(const uint32_t *frames, uint16_t frame_count) {
+  return _i2s_write_buffer(frames, frame_count, false);
+}
+
+uint16_t i2s_write_buffer_nb(const uint32_t *frames, uint16_t frame_count) {
+  return _i2s_write_buffer(frames, frame_count, true);
+}
+
 bool i2s_write_lr(int16_t left, int16_t right){
   int sample = right & 0xFFFF;
   sample = sample << 16;
@@ -332,27 +408,9 @@ bool i2s_write_lr(int16_t left, int16_t right){
 }
 
 bool i2s_read_sample(int16_t *left, int16_t *right, bool blocking) {
-  if (!rx) {
+  if (!rx || !_i2s_next_buffer(rx, blocking)) {
     return false;
   }
-  if (rx->curr_slc_buf_pos==SLC_BUF_LEN || rx->curr_slc_buf==NULL) {
-    if (rx->slc_queue_len == 0) {
-      if (!blocking) {
-        return false;
-      }
-      while (1) {
-        if (rx->slc_queue_len > 0){
-          break;
-        } else {
-          optimistic_yield(10000);
-        }
-      }
-    }
-    ETS_SLC_INTR_DISABLE();
-    rx->curr_slc_buf = (uint32_t *)i2s_slc_queue_next_item(rx);
-    ETS_SLC_INTR_ENABLE();
-    rx->curr_slc_buf_pos=0;
-  }
 
   uint32_t sample = rx->curr_slc_buf[rx->curr_slc_buf_pos++];
   if (left) {
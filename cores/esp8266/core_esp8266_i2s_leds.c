@@ -0,0 +1,227 @@
+/*
+  i2s_leds.c - WS2812/SK6812 LED output through the I2S DMA
+
+  Uses the SLC DMA the same way as i2s.c, but with one descriptor chain per
+  frame instead of a ring of sample buffers.
+
+  This file is part of the esp8266 core for Arduino environment.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+#include "Arduino.h"
+#include "osapi.h"
+#include "ets_sys.h"
+
+#include "i2s_reg.h"
+#include "i2s.h"
+#include "i2s_leds.h"
+
+#define I2S_LEDS_SAMPLE_RATE (100000) // 32 bits per sample, 3.2MHz on the data line
+#define I2S_LEDS_RESET_LEN   (30)     // Low time after a frame, in samples of 10us.  Newer WS2812B need 280us.
+#define I2S_LEDS_ITEM_LEN    (1020)   // Samples per DMA descriptor, the length field is 12 bits of bytes
+
+#define I2SO_DATA 3
+
+// Same layout as in i2s.c
+typedef struct slc_queue_item {
+  uint32_t                blocksize : 12;
+  uint32_t                datalen   : 12;
+  uint32_t                unused    :  5;
+  uint32_t                sub_sof   :  1;
+  uint32_t                eof       :  1;
+  volatile uint32_t       owner     :  1; // DMA can change this value
+  uint32_t *              buf_ptr;
+  struct slc_queue_item * next_link_ptr;
+} slc_queue_item_t;
+
+// A frame is its samples followed by the reset time, its first and last descriptors raise an EOF interrupt
+typedef struct i2s_leds_frame {
+  uint32_t *         samples;
+  slc_queue_item_t * items; // The data, then one for the reset time
+  uint16_t           item_count;
+  volatile bool      busy; // Linked in and not sent completely yet
+} i2s_leds_frame_t;
+
+typedef struct i2s_leds_state {
+  uint16_t          len; // Bytes, and samples, per frame
+  uint8_t           back; // The frame to encode into next
+  i2s_leds_frame_t  frames[2];
+  uint32_t          zeros[I2S_LEDS_RESET_LEN];
+  slc_queue_item_t  idle; // Keeps the line low between frames, loops onto itself
+} i2s_leds_state_t;
+
+static i2s_leds_state_t *leds = NULL;
+
+static void ICACHE_RAM_ATTR i2s_leds_slc_isr(void) {
+  ETS_SLC_INTR_DISABLE();
+  uint32_t slc_intr_status = SLCIS;
+  SLCIC = 0xFFFFFFFF;
+  if (slc_intr_status & SLCIRXEOF) {
+    slc_queue_item_t *finished_item = (slc_queue_item_t *)SLCRXEDA;
+    for (int i = 0; i < 2; i++) {
+      i2s_leds_frame_t *frame = &leds->frames[i];
+      if (finished_item == &frame->items[0] || finished_item == &frame->items[frame->item_count - 1]) {
+        // The frame is under way, the DMA mustn't go back to it from idle
+        if (leds->idle.next_link_ptr == &frame->items[0]) {
+          leds->idle.next_link_ptr = &leds->idle;
+        }
+      }
+      if (finished_item == &frame->items[frame->item_count - 1]) {
+        frame->busy = false;
+      }
+    }
+  }
+  ETS_SLC_INTR_ENABLE();
+}
+
+static void i2s_leds_set_item(slc_queue_item_t *item, uint32_t *buf, uint16_t samples, bool eof) {
+  item->unused = 0;
+  item->owner = 1;
+  item->eof = eof ? 1 : 0;
+  item->sub_sof = 0;
+  item->datalen = samples * 4;
+  item->blocksize = samples * 4;
+  item->buf_ptr = buf;
+}
+
+static bool i2s_leds_alloc_frame(i2s_leds_frame_t *frame, uint16_t len) {
+  frame->busy = false;
+  frame->item_count = (len + I2S_LEDS_ITEM_LEN - 1) / I2S_LEDS_ITEM_LEN + 1;
+  frame->samples = (uint32_t *)malloc(len * sizeof(frame->samples[0]));
+  frame->items = (slc_queue_item_t *)calloc(frame->item_count, sizeof(frame->items[0]));
+  if (!frame->samples || !frame->items) {
+    return false;
+  }
+
+  uint16_t x;
+  for (x = 0; x < frame->item_count - 1; x++) {
+    uint16_t pos = x * I2S_LEDS_ITEM_LEN;
+    uint16_t samples = (len - pos < I2S_LEDS_ITEM_LEN) ? len - pos : I2S_LEDS_ITEM_LEN;
+    i2s_leds_set_item(&frame->items[x], &frame->samples[pos], samples, x == 0);
+    frame->items[x].next_link_ptr = &frame->items[x + 1];
+  }
+  i2s_leds_set_item(&frame->items[x], leds->zeros, I2S_LEDS_RESET_LEN, true);
+  frame->items[x].next_link_ptr = &leds->idle;
+  return true;
+}
+
+bool i2s_leds_begin(uint16_t led_count, uint8_t bytes_per_led) {
+  if (leds) {
+    i2s_leds_end();
+  }
+  if (!led_count || !bytes_per_led || ((uint32_t)led_count * bytes_per_led > 0xffff)) {
+    return false;
+  }
+
+  leds = (i2s_leds_state_t *)calloc(1, sizeof(*leds));
+  if (!leds) {
+    return false; // OOM Error!
+  }
+  leds->len = led_count * bytes_per_led;
+  i2s_leds_set_item(&leds->idle, leds->zeros, I2S_LEDS_RESET_LEN, false);
+  leds->idle.next_link_ptr = &leds->idle;
+  if (!i2s_leds_alloc_frame(&leds->frames[0], leds->len) || !i2s_leds_alloc_frame(&leds->frames[1], leds->len)) {
+    i2s_leds_end();
+    return false; // OOM Error!
+  }
+
+  // Only the data pin, BCK and WS stay free for other use
+  pinMode(I2SO_DATA, FUNCTION_1);
+
+  // DMA set up as in i2s.c, the I2S "RX" link feeds the transmitter and the unused TX link
+  // still needs a valid descriptor
+  ETS_SLC_INTR_DISABLE();
+  SLCC0 |= SLCRXLR | SLCTXLR;
+  SLCC0 &= ~(SLCRXLR | SLCTXLR);
+  SLCIC = 0xFFFFFFFF;
+  SLCC0 &= ~(SLCMM << SLCM); // Clear DMA MODE
+  SLCC0 |= (1 << SLCM); // Set DMA MODE to 1
+  SLCRXDC |= SLCBINR | SLCBTNR; // Enable INFOR_NO_REPLACE and TOKEN_NO_REPLACE
+  SLCRXDC &= ~(SLCBRXFE | SLCBRXEM | SLCBRXFM); // Disable RX_FILL, RX_EOF_MODE and RX_FILL_MODE
+  SLCTXL &= ~(SLCTXLAM << SLCTXLA); // clear TX descriptor address
+  SLCRXL &= ~(SLCRXLAM << SLCRXLA); // clear RX descriptor address
+  SLCTXL |= (uint32)&leds->idle << SLCTXLA; // Set fake (unused) RX descriptor address
+  SLCRXL |= (uint32)&leds->idle << SLCRXLA; // Start out idle
+  ETS_SLC_INTR_ATTACH(i2s_leds_slc_isr, NULL);
+  SLCIE = SLCIRXEOF;
+  ETS_SLC_INTR_ENABLE();
+  SLCTXL |= SLCTXLS;
+  SLCRXL |= SLCRXLS;
+
+  I2S_CLK_ENABLE();
+  I2SIC = 0x3F;
+  I2SIE = 0;
+  I2SC &= ~(I2SRST);
+  I2SC |= I2SRST;
+  I2SC &= ~(I2SRST);
+  I2SFC &= ~(I2SDE | (I2STXFMM << I2STXFM) | (I2SRXFMM << I2SRXFM)); // 16-bit dual channel, so samples go out whole
+  I2SFC |= I2SDE; // Enable DMA
+  I2SCC &= ~((I2STXCMM << I2STXCM) | (I2SRXCMM << I2SRXCM)); // Dual channel mode
+  i2s_set_rate(I2S_LEDS_SAMPLE_RATE);
+  I2SC |= I2STXS; // Start transmission
+
+  return true;
+}
+
+void i2s_leds_end() {
+  I2SC &= ~I2STXS;
+  I2SC &= ~(I2SRST);
+  I2SC |= I2SRST;
+  I2SC &= ~(I2SRST);
+
+  ETS_SLC_INTR_DISABLE();
+  SLCIC = 0xFFFFFFFF;
+  SLCIE = 0;
+  SLCTXL &= ~(SLCTXLAM << SLCTXLA); // clear TX descriptor address
+  SLCRXL &= ~(SLCRXLAM << SLCRXLA); // clear RX descriptor address
+
+  if (leds) {
+    pinMode(I2SO_DATA, INPUT);
+    for (int i = 0; i < 2; i++) {
+      free(leds->frames[i].samples);
+      free(leds->frames[i].items);
+    }
+    free(leds);
+    leds = NULL;
+  }
+}
+
+bool i2s_leds_busy() {
+  if (!leds) {
+    return false;
+  }
+  return leds->frames[leds->back ^ 1].busy;
+}
+
+bool i2s_leds_show(const uint8_t *pixels) {
+  if (!leds) {
+    return false;
+  }
+
+  // Encode while the previous frame is still going out, it's in the other buffer
+  i2s_leds_frame_t *frame = &leds->frames[leds->back];
+  i2s_leds_encode(frame->samples, pixels, leds->len);
+  while (i2s_leds_busy()) {
+    optimistic_yield(10000);
+  }
+
+  // The DMA is in the idle loop now, or on its way there, and takes the new frame from it
+  frame->busy = true;
+  ETS_SLC_INTR_DISABLE();
+  leds->idle.next_link_ptr = &frame->items[0];
+  ETS_SLC_INTR_ENABLE();
+  leds->back ^= 1;
+  return true;
+}
@@ -0,0 +1,36 @@
+/*
+  i2s_leds_encode.c - Bitstream encoder for the I2S LED output
+
+  This file is part of the esp8266 core for Arduino environment.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+#include "i2s_leds.h"
+
+// Four LED bits, most significant first, as 16 I2S bits: 1000 for a 0, 1110 for a 1
+static const uint16_t i2s_leds_nibble[16] = {
+  0x8888, 0x888e, 0x88e8, 0x88ee, 0x8e88, 0x8e8e, 0x8ee8, 0x8eee,
+  0xe888, 0xe88e, 0xe8e8, 0xe8ee, 0xee88, 0xee8e, 0xeee8, 0xeeee
+};
+
+// I2S shifts out the upper half of each sample first, MSB first, so the high
+// nibble goes into the upper half
+void i2s_leds_encode(uint32_t *dst, const uint8_t *src, size_t len) {
+  const uint8_t *end = src + len;
+  while (src < end) {
+    uint8_t b = *src++;
+    *dst++ = ((uint32_t)i2s_leds_nibble[b >> 4] << 16) | i2s_leds_nibble[b & 0x0f];
+  }
+}
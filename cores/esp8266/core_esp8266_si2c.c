@@ -21,12 +21,63 @@
 #include "twi.h"
 #include "pins_arduino.h"
 #include "wiring_private.h"
+#include "core_esp8266_waveform.h"
 
 unsigned int preferred_si2c_clock = 100000;
 unsigned char twi_dcount = 18;
 static unsigned char twi_sda, twi_scl;
 static uint32_t twi_clockStretchLimit;
 
+// Transactions queued by twi_transferAsync(), clocked out from the timer1 callback one edge at a time
+typedef struct {
+  unsigned char address;
+  unsigned char sendStop;
+  unsigned char tx[TWI_ASYNC_TX_MAX];
+  unsigned int txLen;
+  unsigned char * rx;
+  unsigned int rxLen;
+  twi_callback_t callback;
+  void * arg;
+} twi_transfer_t;
+
+// Each *_HIGH phase is followed by the one waiting for SCL to go high
+typedef enum {
+  TWI_PH_START,        // lines idle, SDA goes low
+  TWI_PH_CLOCK_HIGH,   // SCL released for the bit on SDA
+  TWI_PH_CLOCK,        // SCL high: read the bit clocked, then SCL low with the next one on SDA
+  TWI_PH_RESTART_HIGH, // SCL released with SDA released
+  TWI_PH_RESTART,      // SCL high: SDA goes low for the address
+  TWI_PH_STOP_HIGH,    // SCL released with SDA low
+  TWI_PH_STOP,         // SCL high: SDA goes high
+  TWI_PH_IDLE_HIGH,    // no stop: SCL released with SDA released
+  TWI_PH_IDLE,         // no stop: done once SCL is high
+} twi_phase_t;
+
+static struct {
+  twi_transfer_t queue[TWI_ASYNC_QUEUE];
+  volatile uint8_t head;
+  volatile uint8_t count;
+  uint8_t phase;
+  bool reading;     // the address sent is for reading
+  bool addressing;  // the byte on the bus is the address
+  bool clocked;     // a bit was clocked in TWI_PH_CLOCK
+  uint8_t bit;      // of the byte, 8 is the acknowledge
+  uint8_t out;
+  uint8_t in;
+  uint8_t status;
+  unsigned int pos;
+  uint32_t next;    // cycle of the next edge
+  uint32_t stretchStart;
+} twi_async;
+
+static uint32_t twi_async_half;    // cycles between edges
+static uint32_t twi_async_stretch; // cycles a slave may hold SCL low
+
+// Every edge is an interrupt of a few microseconds, above 50KHz they would leave little time for anything else
+#define TWI_ASYNC_MIN_HALF_US 10
+#define TWI_ASYNC_FLUFF 100 // cycles early an edge is still done, the next IRQ would come later
+#define TWI_ASYNC_IDLE 0xffffffff
+
 #define SDA_LOW()   (GPES = (1 << twi_sda)) //Enable SDA (becomes output and since GPO is 0 for the pin, it will pull the line low)
 #define SDA_HIGH()  (GPEC = (1 << twi_sda)) //Disable SDA (becomes input and since it has pullup it will go high)
 #define SDA_READ()  ((GPI & (1 << twi_sda)) != 0)
@@ -45,7 +96,11 @@ static uint32_t twi_clockStretchLimit;
 #endif
 
 void twi_setClock(unsigned int freq){
+  twi_asyncWait();
   preferred_si2c_clock = freq;
+  twi_async_half = F_CPU / 2 / (freq ? freq : 1);
+  if(twi_async_half < TWI_ASYNC_MIN_HALF_US * clockCyclesPerMicrosecond())
+    twi_async_half = TWI_ASYNC_MIN_HALF_US * clockCyclesPerMicrosecond();
 #if F_CPU == FCPU80
   if(freq <= 50000) twi_dcount = 38;//about 50KHz
   else if(freq <= 100000) twi_dcount = 19;//about 100KHz
@@ -67,9 +122,11 @@ void twi_setClock(unsigned int freq){
 
 void twi_setClockStretchLimit(uint32_t limit){
   twi_clockStretchLimit = limit * TWI_CLOCK_STRETCH_MULTIPLIER;
+  twi_async_stretch = limit * clockCyclesPerMicrosecond();
 }
 
 void twi_init(unsigned char sda, unsigned char scl){
+  twi_asyncWait();
   twi_sda = sda;
   twi_scl = scl;
   pinMode(twi_sda, INPUT_PULLUP);
@@ -80,6 +137,7 @@ void twi_init(unsigned char sda, unsigned char scl){
 
 
 void twi_stop(void){
+  twi_asyncWait();
   pinMode(twi_sda, INPUT);
   pinMode(twi_scl, INPUT);
 }
@@ -165,6 +223,7 @@ static unsigned char twi_read_byte(bool nack) {
 
 unsigned char twi_writeTo(unsigned char address, unsigned char * buf, unsigned int len, unsigned char sendStop){
   unsigned int i;
+  twi_asyncWait();
   if(!twi_write_start()) 
     return 4;//line busy
   if(!twi_write_byte(((address << 1) | 0) & 0xFF)) {
@@ -193,6 +252,7 @@ unsigned char twi_writeTo(unsigned char address, unsigned char * buf, unsigned i
 
 unsigned char twi_readFrom(unsigned char address, unsigned char* buf, unsigned int len, unsigned char sendStop){
   unsigned int i;
+  twi_asyncWait();
   if(!twi_write_start()) 
     return 4;//line busy
   if(!twi_write_byte(((address << 1) | 1) & 0xFF)) {
@@ -216,6 +276,7 @@ unsigned char twi_readFrom(unsigned char address, unsigned char* buf, unsigned i
 }
 
 uint8_t twi_status() {           
+    twi_asyncWait();
     if (SCL_READ()==0)     
         return I2C_SCL_HELD_LOW;             //SCL held low by another device, no procedure available to recover
     int clockCount = 20;                   
@@ -236,3 +297,215 @@ uint8_t twi_status() {
     return I2C_OK;                       //all ok
 
 }
+
+#ifndef __ets__
+extern uint32_t xthal_get_ccount();
+#endif
+
+static inline ICACHE_RAM_ATTR uint32_t twi_cycles(void) {
+#ifdef __ets__
+  uint32_t ccount;
+  __asm__ __volatile__("esync; rsr %0,ccount":"=a"(ccount));
+  return ccount;
+#else
+  return xthal_get_ccount();
+#endif
+}
+
+static ICACHE_RAM_ATTR void twi_async_finish(uint8_t status) {
+  twi_transfer_t * t = &twi_async.queue[twi_async.head];
+  twi_async.head = (twi_async.head + 1) % TWI_ASYNC_QUEUE;
+  twi_async.count--;
+  twi_async.phase = TWI_PH_START;
+  if(t->callback)
+    t->callback(t->arg, status);
+}
+
+static ICACHE_RAM_ATTR void twi_async_address(const twi_transfer_t * t) {
+  twi_async.out = (t->address << 1) | (twi_async.reading ? 1 : 0);
+  twi_async.bit = 0;
+  twi_async.pos = 0;
+  twi_async.addressing = true;
+  twi_async.clocked = false;
+  twi_async.phase = TWI_PH_CLOCK;
+}
+
+// After the last acknowledge: a stop, or the lines released for a repeated start
+static ICACHE_RAM_ATTR void twi_async_end(const twi_transfer_t * t) {
+  SCL_LOW();
+  if(t->sendStop) {
+    SDA_LOW();
+    twi_async.phase = TWI_PH_STOP_HIGH;
+  } else {
+    SDA_HIGH();
+    twi_async.phase = TWI_PH_IDLE_HIGH;
+  }
+}
+
+static ICACHE_RAM_ATTR void twi_async_step(uint32_t now) {
+  twi_transfer_t * t = &twi_async.queue[twi_async.head];
+  switch(twi_async.phase) {
+  case TWI_PH_START:
+    SCL_HIGH();
+    SDA_HIGH();
+    if(SDA_READ() == 0) {
+      twi_async_finish(4);//line busy
+      return;
+    }
+    SDA_LOW();
+    twi_async.status = 0;
+    twi_async.reading = (t->txLen == 0 && t->rxLen != 0);
+    twi_async_address(t);
+    return;
+  case TWI_PH_CLOCK_HIGH:
+  case TWI_PH_RESTART_HIGH:
+  case TWI_PH_STOP_HIGH:
+  case TWI_PH_IDLE_HIGH:
+    SCL_HIGH();
+    twi_async.stretchStart = now;
+    twi_async.phase++;
+    return;
+  }
+
+  if(SCL_READ() == 0) {
+    // Clock stretching
+    if(now - twi_async.stretchStart > twi_async_stretch) {
+      SDA_HIGH();
+      SCL_HIGH();
+      twi_async_finish(TWI_ASYNC_TIMEOUT);
+    }
+    return;
+  }
+  switch(twi_async.phase) {
+  case TWI_PH_RESTART:
+    SDA_LOW();
+    twi_async.reading = true;
+    twi_async_address(t);
+    return;
+  case TWI_PH_STOP:
+    SDA_HIGH();
+    twi_async_finish(twi_async.status);
+    return;
+  case TWI_PH_IDLE:
+    twi_async_finish(twi_async.status);
+    return;
+  }
+
+  // TWI_PH_CLOCK
+  if(twi_async.clocked && twi_async.bit == 8) {
+    bool sda = SDA_READ();
+    if(twi_async.reading && !twi_async.addressing) {
+      t->rx[twi_async.pos++] = twi_async.in;
+      if(twi_async.pos == t->rxLen) {
+        twi_async_end(t);
+        return;
+      }
+    } else if(sda) {
+      twi_async.status = twi_async.addressing ? 2 : 3;//received NACK
+      twi_async_end(t);
+      return;
+    } else if(twi_async.reading) {
+      // the slave sends from here
+    } else if(twi_async.pos < t->txLen) {
+      twi_async.out = t->tx[twi_async.pos++];
+    } else if(t->rxLen) {
+      // repeated start for the read
+      SCL_LOW();
+      SDA_HIGH();
+      twi_async.phase = TWI_PH_RESTART_HIGH;
+      return;
+    } else {
+      twi_async_end(t);
+      return;
+    }
+    twi_async.addressing = false;
+    twi_async.bit = 0;
+  } else if(twi_async.clocked) {
+    twi_async.in = (twi_async.in << 1) | SDA_READ();
+    twi_async.bit++;
+  }
+
+  SCL_LOW();
+  bool receiving = twi_async.reading && !twi_async.addressing;
+  if(twi_async.bit < 8) {
+    if(receiving || (twi_async.out & (0x80 >> twi_async.bit)))
+      SDA_HIGH();
+    else
+      SDA_LOW();
+  } else if(receiving && twi_async.pos + 1 < t->rxLen) {
+    SDA_LOW();//ACK
+  } else {
+    SDA_HIGH();//NACK, or released for the slave to acknowledge
+  }
+  twi_async.clocked = true;
+  twi_async.phase = TWI_PH_CLOCK_HIGH;
+}
+
+static ICACHE_RAM_ATTR uint32_t twi_async_timer(void) {
+  if(!twi_async.count)
+    return TWI_ASYNC_IDLE;
+  uint32_t now = twi_cycles();
+  int32_t wait = twi_async.next - now;
+  if(wait > TWI_ASYNC_FLUFF)
+    return wait;
+  twi_async_step(now);
+  twi_async.next = now + twi_async_half;
+  return twi_async.count ? twi_async_half : TWI_ASYNC_IDLE;
+}
+
+// Gives timer1 back once the queue is empty, outside of the interrupt. The callback is
+// looked up rather than remembered, others may take it over once it's given back.
+static void twi_async_release(void) {
+  if(!twi_async.count && getTimer1Callback() == twi_async_timer)
+    setTimer1Callback(NULL);
+}
+
+/**
+ * Queues a write of txLen bytes, then a read of rxLen bytes into rx after a repeated start,
+ * each part left out when its length is 0. The timer1 interrupt clocks it out, rx has to stay
+ * valid until the callback. Returns false if the queue is full, the arguments don't fit, or
+ * someone else has set the timer1 callback.
+ */
+bool twi_transferAsync(unsigned char address, const unsigned char * tx, unsigned int txLen, unsigned char * rx, unsigned int rxLen, unsigned char sendStop, twi_callback_t callback, void * arg){
+  if(txLen > TWI_ASYNC_TX_MAX || (rxLen && !rx) || twi_async.count >= TWI_ASYNC_QUEUE)
+    return false;
+  if(getTimer1Callback() && getTimer1Callback() != twi_async_timer)
+    return false;
+
+  ets_intr_lock();
+  twi_transfer_t * t = &twi_async.queue[(twi_async.head + twi_async.count) % TWI_ASYNC_QUEUE];
+  t->address = address;
+  t->sendStop = sendStop;
+  if(txLen)
+    memcpy(t->tx, tx, txLen);
+  t->txLen = txLen;
+  t->rx = rx;
+  t->rxLen = rxLen;
+  t->callback = callback;
+  t->arg = arg;
+  if(!twi_async.count++) {
+    twi_async.phase = TWI_PH_START;
+    twi_async.next = twi_cycles();
+  }
+  ets_intr_unlock();
+
+  if(getTimer1Callback() != twi_async_timer)
+    setTimer1Callback(twi_async_timer);
+  return true;
+}
+
+bool twi_asyncBusy(void){
+  if(twi_async.count)
+    return true;
+  twi_async_release();
+  return false;
+}
+
+/**
+ * Waits until the queued transactions are done
+ */
+void twi_asyncWait(void){
+  while(twi_async.count)
+    optimistic_yield(1000);
+  twi_async_release();
+}
@@ -17,6 +17,11 @@
   contiguous and only take effect on the next waveform transition,
   allowing for smooth transitions.
 
+  The running generators are kept in a small queue sorted by their next
+  event, so the IRQ only looks at the ones that are actually due instead of
+  scanning every pin.  Edges that fall within a few cycles of each other are
+  written to the GPIOs together.
+
   This replaces older tone(), analogWrite(), and the Servo classes.
 
   Everywhere in the code where "cycles" is used, it means ESP.getCycleTime()
@@ -62,6 +67,8 @@
 // Waveform generator can create tones, PWM, and servos
 typedef struct {
   uint32_t nextServiceCycle;        // ESP cycle timer when a transition required
+  uint32_t nextEventCycle;          // Transition or timeout, whichever comes first.  The queue order.
+  uint32_t lastEventCycle;          // Scheduled cycle of the last event, timeLeftCycles counts from here
   uint32_t timeLeftCycles;          // For time-limited waveform, how many ESP cycles left
   const uint16_t gpioMask;          // Mask instead of value to speed IRQ loop
   const uint16_t gpio16Mask;        // Mask instead of value to speed IRQ loop
@@ -69,24 +76,38 @@ typedef struct {
   unsigned nextTimeHighCycles : 31; // Copy over low->high to keep smooth waveform
   unsigned enabled            : 1;  // Is this GPIO generating a waveform?
   unsigned nextTimeLowCycles  : 31; // Copy over high->low to keep smooth waveform
+  uint32_t nextBoundaryCycle;       // Aligned only: start of the next shared period
+  unsigned aligned            : 1;  // Locked to the shared period, see startWaveformAligned()
+  unsigned phaseCycles        : 31; // Aligned only: goes high this long after each period boundary
 } Waveform;
 
 // These can be accessed in interrupts, so ensure to bracket access with SEI/CLI
 static Waveform waveform[] = {
-  {0, 0, 1<<0, 0, 0, 0, 0, 0}, // GPIO0
-  {0, 0, 1<<1, 0, 0, 0, 0, 0}, // GPIO1
-  {0, 0, 1<<2, 0, 0, 0, 0, 0},
-  {0, 0, 1<<3, 0, 0, 0, 0, 0},
-  {0, 0, 1<<4, 0, 0, 0, 0, 0},
-  {0, 0, 1<<5, 0, 0, 0, 0, 0},
+  {0, 0, 0, 0, 1<<0, 0, 0, 0, 0, 0, 0, 0, 0}, // GPIO0
+  {0, 0, 0, 0, 1<<1, 0, 0, 0, 0, 0, 0, 0, 0}, // GPIO1
+  {0, 0, 0, 0, 1<<2, 0, 0, 0, 0, 0, 0, 0, 0},
+  {0, 0, 0, 0, 1<<3, 0, 0, 0, 0, 0, 0, 0, 0},
+  {0, 0, 0, 0, 1<<4, 0, 0, 0, 0, 0, 0, 0, 0},
+  {0, 0, 0, 0, 1<<5, 0, 0, 0, 0, 0, 0, 0, 0},
   // GPIOS 6-11 not allowed, used for flash
-  {0, 0, 1<<12, 0, 0, 0, 0, 0},
-  {0, 0, 1<<13, 0, 0, 0, 0, 0},
-  {0, 0, 1<<14, 0, 0, 0, 0, 0},
-  {0, 0, 1<<15, 0, 0, 0, 0, 0},
-  {0, 0, 0, 1, 0, 0, 0, 0}  // GPIO16
+  {0, 0, 0, 0, 1<<12, 0, 0, 0, 0, 0, 0, 0, 0},
+  {0, 0, 0, 0, 1<<13, 0, 0, 0, 0, 0, 0, 0, 0},
+  {0, 0, 0, 0, 1<<14, 0, 0, 0, 0, 0, 0, 0, 0},
+  {0, 0, 0, 0, 1<<15, 0, 0, 0, 0, 0, 0, 0, 0},
+  {0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0}  // GPIO16
 };
 
+// Indexes of the enabled waveforms, soonest nextEventCycle first.  Same rules as waveform[].
+static uint8_t waveQueue[countof(waveform)];
+static uint8_t waveQueueLen = 0;
+
+// The period shared by the aligned waveforms.  Boundaries from alignedAnchorCycle on are
+// alignedPeriodCycles apart, earlier ones alignedOldPeriodCycles, so a new period takes over
+// at the same boundary for every pin.  The IRQ moves the anchor along to keep it recent.
+static uint32_t alignedAnchorCycle = 0;
+static uint32_t alignedPeriodCycles = 0;
+static uint32_t alignedOldPeriodCycles = 0;
+
 static uint32_t (*timer1CB)() = NULL;;
 
 
@@ -102,6 +123,13 @@ static inline ICACHE_RAM_ATTR uint32_t min_u32(uint32_t a, uint32_t b) {
   return b;
 }
 
+static inline ICACHE_RAM_ATTR uint32_t max_u32(uint32_t a, uint32_t b) {
+  if (a > b) {
+    return a;
+  }
+  return b;
+}
+
 static inline ICACHE_RAM_ATTR void ReloadTimer(uint32_t a) {
   // Below a threshold you actually miss the edge IRQ, so ensure enough time
   if (a > 32) {
@@ -111,22 +139,54 @@ static inline ICACHE_RAM_ATTR void ReloadTimer(uint32_t a) {
   }
 }
 
+#ifndef __ets__
+extern uint32_t xthal_get_ccount();
+#endif
+
 static inline ICACHE_RAM_ATTR uint32_t GetCycleCount() {
+#ifdef __ets__
   uint32_t ccount;
   __asm__ __volatile__("esync; rsr %0,ccount":"=a"(ccount));
   return ccount;
+#else
+  return xthal_get_ccount();
+#endif
+}
+
+// Put a waveform into the queue behind everything due before it.  Times are
+// compared relative to now, all of them lie within 2^31 cycles of it.
+static ICACHE_RAM_ATTR void QueueInsert(uint8_t idx, uint32_t now) {
+  int32_t due = waveform[idx].nextEventCycle - now;
+  uint8_t pos = waveQueueLen++;
+  while (pos && (int32_t)(waveform[waveQueue[pos - 1]].nextEventCycle - now) > due) {
+    waveQueue[pos] = waveQueue[pos - 1];
+    pos--;
+  }
+  waveQueue[pos] = idx;
+}
+
+static ICACHE_RAM_ATTR void QueueRemove(uint8_t idx) {
+  uint8_t pos = 0;
+  while (pos < waveQueueLen && waveQueue[pos] != idx) {
+    pos++;
+  }
+  if (pos == waveQueueLen) {
+    return;
+  }
+  waveQueueLen--;
+  for (; pos < waveQueueLen; pos++) {
+    waveQueue[pos] = waveQueue[pos + 1];
+  }
 }
 
 // Interrupt on/off control
 static ICACHE_RAM_ATTR void timer1Interrupt();
 static uint8_t timerRunning = false;
-static uint32_t lastCycleCount = 0; // Last ESP cycle counter on running the interrupt routine
 
 static void initTimer() {
   timer1_disable();
   timer1_isr_init();
   timer1_attachInterrupt(timer1Interrupt);
-  lastCycleCount = GetCycleCount();
   timer1_enable(TIM_DIV1, TIM_EDGE, TIM_SINGLE);
   timerRunning = true;
 }
@@ -143,50 +203,64 @@ void setTimer1Callback(uint32_t (*fn)()) {
   timer1CB = fn;
   if (!timerRunning && fn) {
     initTimer();
-  } else if (timerRunning && !fn) {
-    int cnt = 0;
-    for (size_t i = 0; i < countof(waveform); i++) {
-      cnt += waveform[i].enabled ? 1 : 0;
-    }
-    if (!cnt) {
-      deinitTimer();
-    }
+  } else if (timerRunning && !fn && !waveQueueLen) {
+    deinitTimer();
   }
   ReloadTimer(MicrosecondsToCycles(1)); // Cause an interrupt post-haste
 }
 
+uint32_t (*getTimer1Callback(void))() {
+  return timer1CB;
+}
+
+// Index of the waveform generator for pin, countof(waveform) if there is none
+static uint8_t WaveformIndex(uint8_t pin) {
+  uint8_t idx;
+  for (idx = 0; idx < countof(waveform); idx++) {
+    if (((pin == 16) && waveform[idx].gpio16Mask==1) || ((pin != 16) && (waveform[idx].gpioMask == 1<<pin))) {
+      break;
+    }
+  }
+  return idx;
+}
+
 // Start up a waveform on a pin, or change the current one.  Will change to the new
 // waveform smoothly on next low->high transition.  For immediate change, stopWaveform()
 // first, then it will immediately begin.
 int startWaveform(uint8_t pin, uint32_t timeHighUS, uint32_t timeLowUS, uint32_t runTimeUS) {
-  Waveform *wave = NULL;
-  for (size_t i = 0; i < countof(waveform); i++) {
-    if (((pin == 16) && waveform[i].gpio16Mask==1) || ((pin != 16) && (waveform[i].gpioMask == 1<<pin))) {
-      wave = (Waveform*) & (waveform[i]);
-      break;
-    }
-  }
-  if (!wave) {
+  uint8_t idx = WaveformIndex(pin);
+  if (idx == countof(waveform)) {
     return false;
   }
+  Waveform *wave = &waveform[idx];
 
-  // To safely update the packed bitfields we need to stop interrupts while setting them as we could
-  // get an IRQ in the middle of a multi-instruction mask-and-set required to change them which would
-  // then cause an IRQ update of these values (.enabled only, for now) to be lost.
+  // To safely update the packed bitfields and the queue we need to stop interrupts while setting them
+  // as we could get an IRQ in the middle of a multi-instruction mask-and-set required to change them.
   ets_intr_lock();
 
-  wave->nextTimeHighCycles = MicrosecondsToCycles(timeHighUS) - 70;  // Take out some time for IRQ codepath
-  wave->nextTimeLowCycles = MicrosecondsToCycles(timeLowUS) - 70;  // Take out some time for IRQ codepath
+  // Transitions are scheduled from the previous one, not from when the IRQ got to it, so these are exact.
+  // Shorter than the fluff window, the IRQ would do both edges of a pulse in the same GPIO write.
+  wave->nextTimeHighCycles = max_u32(MicrosecondsToCycles(timeHighUS), CYCLES_FLUFF);
+  wave->nextTimeLowCycles = max_u32(MicrosecondsToCycles(timeLowUS), CYCLES_FLUFF);
   wave->timeLeftCycles = MicrosecondsToCycles(runTimeUS);
+  // Leaving the shared period, the pin carries on from its next transition
+  wave->aligned = 0;
   if (!wave->enabled) {
+    uint32_t now = GetCycleCount();
     wave->state = 0;
     // Actually set the pin high or low in the IRQ service to guarantee times
-    wave->nextServiceCycle = GetCycleCount() + MicrosecondsToCycles(1);
+    wave->nextServiceCycle = now + MicrosecondsToCycles(1);
+    wave->nextEventCycle = wave->nextServiceCycle;
+    wave->lastEventCycle = now;
     wave->enabled = 1;
+    QueueInsert(idx, now);
     if (!timerRunning) {
       initTimer();
     }
     ReloadTimer(MicrosecondsToCycles(1)); // Cause an interrupt post-haste
+  } else {
+    // A new run time counts from now
+    wave->lastEventCycle = GetCycleCount();
   }
 
   // Re-enable interrupts here since we're done with the update
@@ -195,6 +269,78 @@ int startWaveform(uint8_t pin, uint32_t timeHighUS, uint32_t timeLowUS, uint32_t
   return true;
 }
 
+// Start up a waveform locked to the period shared by all aligned pins, or change the
+// current one.  The new high time is picked up at the next period boundary.
+int startWaveformAligned(uint8_t pin, uint32_t timeHighUS, uint32_t periodUS, uint32_t phaseUS) {
+  uint8_t idx = WaveformIndex(pin);
+  if ((idx == countof(waveform)) || !periodUS) {
+    return false;
+  }
+  Waveform *wave = &waveform[idx];
+  uint32_t period = MicrosecondsToCycles(periodUS);
+  uint32_t phase = MicrosecondsToCycles(phaseUS % periodUS);
+  bool grouped = false;
+  for (uint8_t i = 0; i < countof(waveform); i++) {
+    grouped |= (i != idx) && waveform[i].enabled && waveform[i].aligned;
+  }
+
+  ets_intr_lock();
+
+  uint32_t now = GetCycleCount();
+  if (!grouped) {
+    // First one in, it lays down the grid
+    alignedAnchorCycle = now + MicrosecondsToCycles(1);
+    alignedPeriodCycles = period;
+    alignedOldPeriodCycles = period;
+  } else if (period != alignedPeriodCycles) {
+    // Every pin switches over at the first boundary after now, unless a switch is pending already
+    if ((int32_t)(alignedAnchorCycle - now) < 0) {
+      alignedAnchorCycle += ((now - alignedAnchorCycle) / alignedPeriodCycles + 1) * alignedPeriodCycles;
+      alignedOldPeriodCycles = alignedPeriodCycles;
+    }
+    alignedPeriodCycles = period;
+  }
+
+  wave->nextTimeHighCycles = (timeHighUS < periodUS) ? MicrosecondsToCycles(timeHighUS) : period;
+  if (timeHighUS && (wave->nextTimeHighCycles < CYCLES_FLUFF)) {
+    wave->nextTimeHighCycles = min_u32(CYCLES_FLUFF, period);
+  }
+  if (!wave->enabled || !wave->aligned || (wave->phaseCycles != phase)) {
+    // (Re)join at the pin's own first boundary on the grid.  The pin keeps its level until then,
+    // an aligned pulse already under way still ends on time.
+    bool falling = wave->enabled && wave->aligned && (wave->nextServiceCycle != wave->nextBoundaryCycle);
+    uint32_t start = falling ? wave->nextServiceCycle : now + MicrosecondsToCycles(1);
+    uint32_t boundary = alignedAnchorCycle + phase;
+    if ((int32_t)(boundary - start) < 0) {
+      boundary += ((start - boundary) / alignedPeriodCycles + 1) * alignedPeriodCycles;
+    }
+    if (wave->enabled) {
+      QueueRemove(idx);
+    } else {
+      wave->state = 0;
+    }
+    wave->aligned = 1;
+    wave->phaseCycles = phase;
+    wave->timeLeftCycles = 0;
+    wave->nextBoundaryCycle = boundary;
+    if (!falling) {
+      wave->nextServiceCycle = boundary;
+    }
+    wave->nextEventCycle = wave->nextServiceCycle;
+    wave->lastEventCycle = now;
+    wave->enabled = 1;
+    QueueInsert(idx, now);
+    if (!timerRunning) {
+      initTimer();
+    }
+    ReloadTimer(MicrosecondsToCycles(1)); // Cause an interrupt post-haste
+  }
+
+  ets_intr_unlock();
+
+  return true;
+}
+
 // Stops a waveform on a pin
 int stopWaveform(uint8_t pin) {
   // Can't possibly need to stop anything if there is no timer active
@@ -202,19 +348,16 @@ int stopWaveform(uint8_t pin) {
     return false;
   }
 
-  for (size_t i = 0; i < countof(waveform); i++) {
+  for (uint8_t i = 0; i < countof(waveform); i++) {
     if (!waveform[i].enabled) {
       continue; // Skip fast to next one, can't need to stop this one since it's not running
     }
     if (((pin == 16) && waveform[i].gpio16Mask) || ((pin != 16) && (waveform[i].gpioMask == 1<<pin))) {
-      // Note that there is no interrupt unsafety here.  The IRQ can only ever change .enabled from 1->0
-      // We're also doing that, so even if an IRQ occurred it would still stay as 0.
+      ets_intr_lock();
       waveform[i].enabled = 0;
-      int cnt = timer1CB ? 1 : 0;
-      for (size_t i = 0; (cnt == 0) && (i < countof(waveform)); i++) {
-        cnt += waveform[i].enabled ? 1 : 0;
-      }
-      if (!cnt) {
+      QueueRemove(i);
+      ets_intr_unlock();
+      if (!timer1CB && !waveQueueLen) {
         deinitTimer();
       }
       return true;
@@ -223,6 +366,93 @@ int stopWaveform(uint8_t pin) {
   return false;
 }
 
+// Transition of an aligned waveform.  Its high time is latched at the period boundary, so
+// a change never gives a short or a long pulse, and 0% or 100% stay in step with the others.
+static inline ICACHE_RAM_ATTR void ServiceAligned(Waveform *wave, uint32_t pinMask, uint32_t now, uint32_t *setMask, uint32_t *clearMask) {
+  uint32_t boundary = wave->nextServiceCycle;
+  if (boundary != wave->nextBoundaryCycle) {
+    // Falling edge inside the period
+    wave->state = 0;
+    *clearMask |= pinMask;
+    *setMask &= ~pinMask;
+    wave->nextServiceCycle = wave->nextBoundaryCycle;
+    return;
+  }
+
+  uint32_t gridCycle = boundary - wave->phaseCycles;
+  uint32_t period = alignedOldPeriodCycles;
+  if ((int32_t)(gridCycle - alignedAnchorCycle) >= 0) {
+    period = alignedPeriodCycles;
+    alignedAnchorCycle = gridCycle;
+  }
+  wave->nextBoundaryCycle = boundary + period;
+  // Fell more than a whole period behind, skip the ones missed
+  while ((int32_t)(wave->nextBoundaryCycle - now) < 0) {
+    wave->nextBoundaryCycle += period;
+  }
+
+  uint32_t high = min_u32(wave->nextTimeHighCycles, period);
+  wave->state = high ? 1 : 0;
+  if (high) {
+    *setMask |= pinMask;
+    *clearMask &= ~pinMask;
+  } else {
+    *clearMask |= pinMask;
+    *setMask &= ~pinMask;
+  }
+  wave->nextServiceCycle = (high && (high < period)) ? boundary + high : wave->nextBoundaryCycle;
+}
+
+// Handle one event of the waveform at the head of the queue: its timeout or transition, or both.
+// Pins to change are collected in the masks, GPIO16 as bit 16.
+static inline ICACHE_RAM_ATTR void ServiceWaveform(uint8_t idx, uint32_t now, uint32_t *setMask, uint32_t *clearMask) {
+  Waveform *wave = &waveform[idx];
+  uint32_t pinMask = wave->gpioMask | (wave->gpio16Mask << 16);
+
+  if (wave->timeLeftCycles) {
+    uint32_t elapsed = wave->nextEventCycle - wave->lastEventCycle;
+    wave->lastEventCycle = wave->nextEventCycle;
+    // Check for unsigned underflow with new > old
+    if (elapsed >= wave->timeLeftCycles) {
+      // Done, remove!
+      wave->enabled = 0;
+      *clearMask |= pinMask;
+      *setMask &= ~pinMask;
+      return;
+    }
+    wave->timeLeftCycles -= elapsed;
+  }
+
+  if (wave->aligned) {
+    if ((int32_t)(wave->nextServiceCycle - now) < CYCLES_FLUFF) {
+      ServiceAligned(wave, pinMask, now, setMask, clearMask);
+    }
+  } else if ((int32_t)(wave->nextServiceCycle - now) < CYCLES_FLUFF) {
+    uint32_t period;
+    wave->state = !wave->state;
+    if (wave->state) {
+      *setMask |= pinMask;
+      *clearMask &= ~pinMask;
+      period = wave->nextTimeHighCycles;
+    } else {
+      *clearMask |= pinMask;
+      *setMask &= ~pinMask;
+      period = wave->nextTimeLowCycles;
+    }
+    wave->nextServiceCycle += period;
+    // Fell more than a whole period behind, don't try to catch up
+    if ((int32_t)(wave->nextServiceCycle - now) < 0) {
+      wave->nextServiceCycle = now + period;
+    }
+  }
+
+  wave->nextEventCycle = wave->nextServiceCycle;
+  if (wave->timeLeftCycles && (wave->timeLeftCycles < wave->nextServiceCycle - wave->lastEventCycle)) {
+    wave->nextEventCycle = wave->lastEventCycle + wave->timeLeftCycles;
+  }
+  QueueInsert(idx, now);
+}
+
 static ICACHE_RAM_ATTR void timer1Interrupt() {
   uint32_t nextEventCycles;
   #if F_CPU == 160000000
@@ -232,63 +462,43 @@ static ICACHE_RAM_ATTR void timer1Interrupt() {
   #endif
 
   do {
-    nextEventCycles = MicrosecondsToCycles(MAXIRQUS);
-    for (size_t i = 0; i < countof(waveform); i++) {
-      Waveform *wave = &waveform[i];
-      uint32_t now;
-
-      // If it's not on, ignore!
-      if (!wave->enabled) {
-        continue;
-      }
+    uint32_t now = GetCycleCount();
+    uint32_t setMask = 0;
+    uint32_t clearMask = 0;
+
+    // Everything due, or due within the fluff window, goes out in one GPIO write.  Each waveform
+    // is serviced once per pass, an edge it gets requeued for within the window waits for the next
+    // pass, or else both edges of a short pulse would cancel out in the masks.
+    uint8_t due[countof(waveform)];
+    uint8_t dueLen = 0;
+    while (waveQueueLen && ((int32_t)(waveform[waveQueue[0]].nextEventCycle - now) < CYCLES_FLUFF)) {
+      due[dueLen] = waveQueue[0];
+      QueueRemove(due[dueLen++]);
+    }
+    for (uint8_t i = 0; i < dueLen; i++) {
+      ServiceWaveform(due[i], now, &setMask, &clearMask);
+    }
 
-      // Check for toggles
-      now = GetCycleCount();
-      int32_t cyclesToGo = wave->nextServiceCycle - now;
-      if (cyclesToGo < 0) {
-        wave->state = !wave->state;
-        if (wave->state) {
-          SetGPIO(wave->gpioMask);
-          if (wave->gpio16Mask) {
-            GP16O |= wave->gpio16Mask; // GPIO16 write slow as it's RMW
-          }
-          wave->nextServiceCycle = now + wave->nextTimeHighCycles;
-          nextEventCycles = min_u32(nextEventCycles, wave->nextTimeHighCycles);
-        } else {
-          ClearGPIO(wave->gpioMask);
-          if (wave->gpio16Mask) {
-            GP16O &= ~wave->gpio16Mask;
-          }
-          wave->nextServiceCycle = now + wave->nextTimeLowCycles;
-          nextEventCycles = min_u32(nextEventCycles, wave->nextTimeLowCycles);
-        }
+    if (setMask & 0xffff) {
+      SetGPIO(setMask & 0xffff);
+    }
+    if (clearMask & 0xffff) {
+      ClearGPIO(clearMask & 0xffff);
+    }
+    if ((setMask | clearMask) >> 16) {
+      if (setMask >> 16) {
+        GP16O |= 1; // GPIO16 write slow as it's RMW
       } else {
-        uint32_t deltaCycles = wave->nextServiceCycle - now;
-        nextEventCycles = min_u32(nextEventCycles, deltaCycles);
+        GP16O &= ~1;
       }
     }
-  } while (--cnt && (nextEventCycles < MicrosecondsToCycles(4)));
 
-  uint32_t curCycleCount = GetCycleCount();
-  uint32_t deltaCycles = curCycleCount - lastCycleCount;
-  lastCycleCount = curCycleCount;
-
-  // Check for timed-out waveforms out of the high-frequency toggle loop
-  for (size_t i = 0; i < countof(waveform); i++) {
-    Waveform *wave = &waveform[i];
-    if (wave->timeLeftCycles) {
-      // Check for unsigned underflow with new > old
-      if (deltaCycles >= wave->timeLeftCycles) {
-        // Done, remove!
-        wave->enabled = false;
-        ClearGPIO(wave->gpioMask);
-        GP16O &= ~wave->gpio16Mask;
-      } else {
-        uint32_t newTimeLeftCycles = wave->timeLeftCycles - deltaCycles;
-        wave->timeLeftCycles = newTimeLeftCycles;
-      }
+    nextEventCycles = MicrosecondsToCycles(MAXIRQUS);
+    if (waveQueueLen) {
+      int32_t due = waveform[waveQueue[0]].nextEventCycle - GetCycleCount();
+      nextEventCycles = min_u32(nextEventCycles, (due > 0) ? due : 0);
     }
-  }
+  } while (--cnt && (nextEventCycles < MicrosecondsToCycles(4)));
 
   if (timer1CB) {
     nextEventCycles = min_u32(nextEventCycles, timer1CB());
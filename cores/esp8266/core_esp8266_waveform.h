@@ -50,6 +50,14 @@ extern "C" {
 // If runtimeUS > 0 then automatically stop it after that many usecs.
 // Returns true or false on success or failure.
 int startWaveform(uint8_t pin, uint32_t timeHighUS, uint32_t timeLowUS, uint32_t runTimeUS);
+// Start or change a waveform locked to the period shared by all aligned pins.
+// The pin goes high phaseUS after each period boundary and stays high for
+// timeHighUS, pins with the same phase go high in the same register write.
+// A new high time is latched at the next boundary, a new period at the same
+// boundary for every pin, so changes never give a runt pulse.  timeHighUS of 0
+// or of periodUS or more keep the pin low or high, still in step with the rest.
+// Returns true or false on success or failure.
+int startWaveformAligned(uint8_t pin, uint32_t timeHighUS, uint32_t periodUS, uint32_t phaseUS);
 // Stop a waveform, if any, on the specified pin.
 // Returns true or false on success or failure.
 int stopWaveform(uint8_t pin);
@@ -63,6 +71,8 @@ int stopWaveform(uint8_t pin);
 // generated, stop the timer as well.
 // Make sure the CB function has the ICACHE_RAM_ATTR decorator.
 void setTimer1Callback(uint32_t (*fn)());
+// The callback set above, NULL if there is none.
+uint32_t (*getTimer1Callback(void))();
 
 #ifdef __cplusplus
 }
@@ -28,6 +28,8 @@
 static uint32_t analogMap = 0;
 static int32_t analogScale = PWMRANGE;
 static uint16_t analogFreq = 1000;
+static bool analogSync = false;
+static uint32_t analogPhase[17] = {0};
 
 extern void __analogWriteRange(uint32_t range) {
   if (range > 0) {
@@ -45,6 +47,17 @@ extern void __analogWriteFreq(uint32_t freq) {
   }
 }
 
+extern void __analogWriteSync(bool sync) {
+  analogSync = sync;
+}
+
+extern void __analogWritePhase(uint8_t pin, int phase) {
+  if (pin > 16) {
+    return;
+  }
+  analogPhase[pin] = (phase < 0) ? 0 : phase;
+}
+
 extern void __analogWrite(uint8_t pin, int val) {
   if (pin > 16) {
     return;
@@ -56,10 +69,21 @@ extern void __analogWrite(uint8_t pin, int val) {
     val = analogScale;
   }
 
-  analogMap &= ~(1 << pin);
   uint32_t high = (analogPeriod * val) / analogScale;
   uint32_t low = analogPeriod - high;
   pinMode(pin, OUTPUT);
+  if (analogSync && ((analogMap & (1 << pin)) || (high && low))) {
+    // Stays in step with the other pins, even at 0% or 100%
+    uint32_t phase = (analogPeriod * (analogPhase[pin] % analogScale)) / analogScale;
+    if (startWaveformAligned(pin, high, analogPeriod, phase)) {
+      analogMap |= (1 << pin);
+    } else {
+      analogMap &= ~(1 << pin);
+    }
+    return;
+  }
+
+  analogMap &= ~(1 << pin);
   if (low == 0) {
     stopWaveform(pin);
     digitalWrite(pin, HIGH);
@@ -76,3 +100,5 @@ extern void __analogWrite(uint8_t pin, int val) {
 extern void analogWrite(uint8_t pin, int val) __attribute__((weak, alias("__analogWrite")));
 extern void analogWriteFreq(uint32_t freq) __attribute__((weak, alias("__analogWriteFreq")));
 extern void analogWriteRange(uint32_t range) __attribute__((weak, alias("__analogWriteRange")));
+extern void analogWriteSync(bool sync) __attribute__((weak, alias("__analogWriteSync")));
+extern void analogWritePhase(uint8_t pin, int phase) __attribute__((weak, alias("__analogWritePhase")));
@@ -34,6 +34,13 @@ the left and right channel) concatenated as (Rout<<16)+Lout
 i2s_write_sample will block when you're sending data too quickly, so you can just
 generate and push data as fast as you can and i2s_write_sample will regulate the
 speed.
+
+For whole blocks of samples i2s_write_buffer() copies straight into the DMA
+buffers.  To skip even that copy, i2s_acquire_buffer() hands out the free part
+of the DMA buffer being filled, generate the samples right there and pass how
+many to i2s_commit_buffer().  A refill callback set with
+i2s_set_refill_callback() instead fills each buffer from the interrupt as soon
+as the DMA is done with it; buffers it leaves empty go back to the writers.
 */
 
 #ifdef __cplusplus
@@ -49,6 +56,10 @@ float i2s_get_real_rate();//The actual Sample Rate on output
 bool i2s_write_sample(uint32_t sample);//32bit sample with channels being upper and lower 16 bits (blocking when DMA is full)
 bool i2s_write_sample_nb(uint32_t sample);//same as above but does not block when DMA is full and returns false instead
 bool i2s_write_lr(int16_t left, int16_t right);//combines both channels and calls i2s_write_sample with the result
+uint16_t i2s_write_buffer(const uint32_t *frames, uint16_t frame_count);//writes frame_count 32bit samples, blocking when DMA is full, returns how many were written
+uint16_t i2s_write_buffer_nb(const uint32_t *frames, uint16_t frame_count);//same as above but returns early instead of blocking when DMA is full
+uint32_t *i2s_acquire_buffer(uint16_t *space, bool blocking);//zero-copy: free part of the current DMA buffer, its size in samples in *space, NULL when DMA is full and not blocking
+void i2s_commit_buffer(uint16_t count);//the first count samples of the acquired space are ready to go out
 bool i2s_read_sample(int16_t *left, int16_t *right, bool blocking); // RX data returned in both 16-bit outputs.
 bool i2s_is_full();//returns true if DMA is full and can not take more bytes (overflow)
 bool i2s_is_empty();//returns true if DMA is empty (underflow)
@@ -58,6 +69,7 @@ int16_t i2s_available();// returns the number of samples than can be written bef
 int16_t i2s_rx_available();// returns the number of samples than can be written before blocking
 void i2s_set_callback(void (*callback) (void));
 void i2s_rx_set_callback(void (*callback) (void));
+void i2s_set_refill_callback(uint16_t (*refill) (uint32_t *buf, uint16_t count));//fills each finished TX DMA buffer from the ISR, returns the samples written (0 = leave it to the writers), rest is muted
 
 #ifdef __cplusplus
 }
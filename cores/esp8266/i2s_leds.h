@@ -0,0 +1,66 @@
+/*
+  i2s_leds.h - WS2812/SK6812 LED output through the I2S DMA
+
+  This file is part of the esp8266 core for Arduino environment.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+#ifndef I2S_LEDS_h
+#define I2S_LEDS_h
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+How does this work? The LEDs want 800kbit/s, a 0 bit being a short high pulse
+and a 1 bit a long one.  The I2S data line runs at 3.2MHz, four times that, and
+every LED bit goes out as four I2S bits: 1000 for a 0, 1110 for a 1.  So each
+byte of pixel data becomes one 32-bit I2S sample, which a 16 entry table turns
+out one nibble at a time.
+
+Frames are encoded into one of two buffers, each with its own chain of DMA
+descriptors.  While one is going out the next one is encoded into the other,
+and once the first is done the DMA is pointed at the second.  The DMA sends
+the whole frame by itself and then keeps the line low, which is also the
+latch signal, so the CPU only sees an interrupt at the start and the end of
+each frame.
+
+- Connect the LED data input to GPIO3 (RX), through a level shifter if needed.
+- Call i2s_leds_begin() with the number of LEDs and bytes per LED, 3 for
+  WS2812 (GRB order), 4 for SK6812 RGBW.
+- Call i2s_leds_show() with the pixel bytes in the order the LEDs take them.
+
+The I2S output can't be used for anything else meanwhile.  Each buffer takes
+four bytes per pixel byte, 12 bytes per RGB LED.
+*/
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+bool i2s_leds_begin(uint16_t led_count, uint8_t bytes_per_led); // Allocate and start the output, returns false on OOM error
+void i2s_leds_end();
+bool i2s_leds_show(const uint8_t *pixels); // Encode led_count*bytes_per_led bytes and send them once the previous frame is out (blocking till then)
+bool i2s_leds_busy(); // returns true while a frame is still going out, i2s_leds_show() would block
+
+// The encoder by itself: turns len bytes into len 32-bit I2S samples
+void i2s_leds_encode(uint32_t *dst, const uint8_t *src, size_t len);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -275,6 +275,7 @@ public:
         : _fs(fs)
         , _fd(fd)
     , _written(false)
+    , _unsaved(false)
     {
         memset(&_stat, 0, sizeof(_stat));
         _getStat();
@@ -295,6 +296,7 @@ public:
             return 0;
         }
         _written = true;
+        _unsaved = true;
         return result;
     }
 
@@ -319,6 +321,7 @@ public:
             DEBUGV("SPIFFS_fflush rc=%d\r\n", rc);
         }
         _written = true;
+        _saved();
     }
 
     bool seek(uint32_t pos, SeekMode mode) override
@@ -366,6 +369,7 @@ public:
 
         SPIFFS_close(_fs->getFs(), _fd);
         DEBUGV("SPIFFS_close: fd=%d\r\n", _fd);
+        _saved();
     }
 
     const char* name() const override
@@ -387,10 +391,20 @@ protected:
         _written = false;
     }
 
+    // Tells the FS that what was written is in place, see FS::contentGeneration()
+    void _saved()
+    {
+        if (_unsaved) {
+            _unsaved = false;
+            _fs->contentChanged();
+        }
+    }
+
     SPIFFSImpl* _fs;
     spiffs_file _fd;
     mutable spiffs_stat _stat;
     mutable bool        _written;
+    bool                _unsaved;
 };
 
 class SPIFFSDirImpl : public DirImpl
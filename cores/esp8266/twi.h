@@ -32,13 +32,28 @@ extern "C" {
 #define I2C_SDA_HELD_LOW            3
 #define I2C_SDA_HELD_LOW_AFTER_INIT 4
 
+#define TWI_ASYNC_QUEUE 4    // transactions that can wait for the bus
+#define TWI_ASYNC_TX_MAX 32  // bytes a transaction can write, they are copied when it is queued
+#define TWI_ASYNC_TIMEOUT 5  // status when a slave stretches the clock past the limit
+
+// Called from the timer1 interrupt once a twi_transferAsync() is done, so it needs ICACHE_RAM_ATTR.
+// The status is what twi_writeTo() would return: 0 done, 2 address NACK, 3 data NACK, 4 bus busy,
+// or TWI_ASYNC_TIMEOUT.
+typedef void (*twi_callback_t)(void * arg, uint8_t status);
+
 void twi_init(unsigned char sda, unsigned char scl);
 void twi_stop(void);
+// Background transfers run at 50KHz at most, a higher freq only applies to the blocking ones
 void twi_setClock(unsigned int freq);
 void twi_setClockStretchLimit(uint32_t limit);
 uint8_t twi_writeTo(unsigned char address, unsigned char * buf, unsigned int len, unsigned char sendStop);
 uint8_t twi_readFrom(unsigned char address, unsigned char * buf, unsigned int len, unsigned char sendStop);
 uint8_t twi_status();
+// Background transfers take the timer1 callback (setTimer1Callback()) while any are queued,
+// and are refused while something else has set it
+bool twi_transferAsync(unsigned char address, const unsigned char * tx, unsigned int txLen, unsigned char * rx, unsigned int rxLen, unsigned char sendStop, twi_callback_t callback, void * arg);
+bool twi_asyncBusy(void);
+void twi_asyncWait(void);
 
 #ifdef __cplusplus
 }
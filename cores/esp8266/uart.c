@@ -47,10 +47,14 @@
 #include "user_interface.h"
 #include "uart_register.h"
 
+// The tx fifo level at which the isr refills it from the tx buffer
+#define UART_TX_FIFO_REFILL 32
+
 const char overrun_str [] PROGMEM STORE_ATTR = "uart input full!\r\n";
 static int s_uart_debug_nr = UART0;
 
 
+// size is a power of two, positions wrap with a mask
 struct uart_rx_buffer_ 
 {
     size_t size;
@@ -59,6 +63,15 @@ struct uart_rx_buffer_
     uint8_t * buffer;
 };
 
+// Same layout, only present when set up with uart_resize_tx_buffer()
+struct uart_tx_buffer_ 
+{
+    size_t size;
+    size_t rpos;
+    size_t wpos;
+    uint8_t * buffer;
+};
+
 struct uart_ 
 {
     int uart_nr;
@@ -69,8 +82,12 @@ struct uart_
     uint8_t rx_pin;
     uint8_t tx_pin;
     struct uart_rx_buffer_ * rx_buffer;
+    struct uart_tx_buffer_ * tx_buffer;
 };
 
+// Both uarts share one interrupt, these are the ones uart_isr() serves
+static uart_t* s_uart_isr_uart[2] = { NULL, NULL };
+
 
 /*
    In the context of the naming conventions in this file, "_unsafe" means two things:
@@ -98,10 +115,7 @@ uart_rx_fifo_available(const int uart_nr)
 inline size_t 
 uart_rx_buffer_available_unsafe(const struct uart_rx_buffer_ * rx_buffer) 
 {
-    if(rx_buffer->wpos < rx_buffer->rpos) 
-      return (rx_buffer->wpos + rx_buffer->size) - rx_buffer->rpos;
-    
-    return rx_buffer->wpos - rx_buffer->rpos;
+    return (rx_buffer->wpos - rx_buffer->rpos) & (rx_buffer->size - 1);
 }
 
 inline size_t
@@ -118,10 +132,13 @@ inline void
 uart_rx_copy_fifo_to_buffer_unsafe(uart_t* uart) 
 {
     struct uart_rx_buffer_ *rx_buffer = uart->rx_buffer;
+    const size_t mask = rx_buffer->size - 1;
 
-    while(uart_rx_fifo_available(uart->uart_nr))
+    // the status register is only read again once this many are copied
+    size_t count = uart_rx_fifo_available(uart->uart_nr);
+    while(count--)
     {
-        size_t nextPos = (rx_buffer->wpos + 1) % rx_buffer->size;
+        size_t nextPos = (rx_buffer->wpos + 1) & mask;
         if(nextPos == rx_buffer->rpos) 
         {
 
@@ -140,13 +157,14 @@ uart_rx_copy_fifo_to_buffer_unsafe(uart_t* uart)
             break;
 #else
             // discard oldest data
-            if (++rx_buffer->rpos == rx_buffer->size)
-                rx_buffer->rpos = 0;
+            rx_buffer->rpos = (rx_buffer->rpos + 1) & mask;
 #endif
         }
         uint8_t data = USF(uart->uart_nr);
         rx_buffer->buffer[rx_buffer->wpos] = data;
         rx_buffer->wpos = nextPos;
+        if(count == 0)
+            count = uart_rx_fifo_available(uart->uart_nr);
     }
 }
 
@@ -168,10 +186,125 @@ uart_read_char_unsafe(uart_t* uart)
 {
     int data = uart_peek_char_unsafe(uart);
     if(data != -1)
-        uart->rx_buffer->rpos = (uart->rx_buffer->rpos + 1) % uart->rx_buffer->size;
+        uart->rx_buffer->rpos = (uart->rx_buffer->rpos + 1) & (uart->rx_buffer->size - 1);
     return data;
 }
 
+// Copy up to size bytes out of the rx buffer, in at most two contiguous
+// spans, then straight out of the rx fifo when the buffer ran dry
+inline size_t
+uart_read_unsafe(uart_t* uart, char* dst, size_t size)
+{
+    struct uart_rx_buffer_ *rx_buffer = uart->rx_buffer;
+    size_t ret = 0;
+
+    while(ret < size)
+    {
+        size_t span = uart_rx_buffer_available_unsafe(rx_buffer);
+        if(span == 0)
+            break;
+        if(span > rx_buffer->size - rx_buffer->rpos)
+            span = rx_buffer->size - rx_buffer->rpos;
+        if(span > size - ret)
+            span = size - ret;
+        memcpy(dst + ret, rx_buffer->buffer + rx_buffer->rpos, span);
+        rx_buffer->rpos = (rx_buffer->rpos + span) & (rx_buffer->size - 1);
+        ret += span;
+    }
+
+    size_t fifo;
+    while(ret < size && (fifo = uart_rx_fifo_available(uart->uart_nr)))
+    {
+        if(fifo > size - ret)
+            fifo = size - ret;
+        while(fifo--)
+            dst[ret++] = USF(uart->uart_nr);
+    }
+    return ret;
+}
+
+inline size_t
+uart_tx_fifo_room(const int uart_nr)
+{
+    size_t used = (USS(uart_nr) >> USTXC) & 0xff;
+    return (used >= 0x7f) ? 0 : 0x7f - used;
+}
+
+inline size_t 
+uart_tx_buffer_used_unsafe(const struct uart_tx_buffer_ * tx_buffer) 
+{
+    return (tx_buffer->wpos - tx_buffer->rpos) & (tx_buffer->size - 1);
+}
+
+// Move what fits from the tx buffer into the tx fifo. The fifo empty
+// interrupt stays enabled only while there is more to move.
+inline void 
+uart_tx_copy_buffer_to_fifo_unsafe(uart_t* uart) 
+{
+    struct uart_tx_buffer_ *tx_buffer = uart->tx_buffer;
+    const size_t mask = tx_buffer->size - 1;
+
+    size_t room = uart_tx_fifo_room(uart->uart_nr);
+    while(room-- && tx_buffer->rpos != tx_buffer->wpos)
+    {
+        USF(uart->uart_nr) = tx_buffer->buffer[tx_buffer->rpos];
+        tx_buffer->rpos = (tx_buffer->rpos + 1) & mask;
+    }
+
+    if(tx_buffer->rpos == tx_buffer->wpos)
+        USIE(uart->uart_nr) &= ~(1 << UIFE);
+    else
+        USIE(uart->uart_nr) |= (1 << UIFE);
+}
+
+// Queue as much of buf as there is room for. Bytes go straight to the tx
+// fifo while the tx buffer is empty, so short writes never wait for the isr.
+inline size_t
+uart_tx_write_unsafe(uart_t* uart, const char* buf, size_t size)
+{
+    struct uart_tx_buffer_ *tx_buffer = uart->tx_buffer;
+    const size_t mask = tx_buffer->size - 1;
+    size_t ret = 0;
+
+    if(tx_buffer->rpos != tx_buffer->wpos)
+        uart_tx_copy_buffer_to_fifo_unsafe(uart);
+
+    if(tx_buffer->rpos == tx_buffer->wpos)
+    {
+        size_t room = uart_tx_fifo_room(uart->uart_nr);
+        while(ret < size && room--)
+            USF(uart->uart_nr) = buf[ret++];
+    }
+
+    while(ret < size)
+    {
+        size_t span = mask - uart_tx_buffer_used_unsafe(tx_buffer);
+        if(span == 0)
+            break;
+        if(span > tx_buffer->size - tx_buffer->wpos)
+            span = tx_buffer->size - tx_buffer->wpos;
+        if(span > size - ret)
+            span = size - ret;
+        memcpy(tx_buffer->buffer + tx_buffer->wpos, buf + ret, span);
+        tx_buffer->wpos = (tx_buffer->wpos + span) & mask;
+        ret += span;
+    }
+
+    if(tx_buffer->rpos != tx_buffer->wpos)
+        USIE(uart->uart_nr) |= (1 << UIFE);
+    return ret;
+}
+
+// Smallest power of two holding size bytes, the rings keep one slot free
+static size_t
+uart_buffer_round_size(size_t size)
+{
+    size_t rounded = 16;
+    while(rounded < size)
+        rounded <<= 1;
+    return rounded;
+}
+
 
 /**********************************************************/
 
@@ -214,12 +347,25 @@ uart_read_char(uart_t* uart)
     return data;
 }
 
+size_t 
+uart_read(uart_t* uart, char* userbuffer, size_t usersize)
+{
+    if(uart == NULL || !uart->rx_enabled || usersize == 0)
+        return 0;
+
+    ETS_UART_INTR_DISABLE();
+    size_t ret = uart_read_unsafe(uart, userbuffer, usersize);
+    ETS_UART_INTR_ENABLE();
+    return ret;
+}
+
 size_t 
 uart_resize_rx_buffer(uart_t* uart, size_t new_size)
 {
     if(uart == NULL || !uart->rx_enabled) 
         return 0;
 
+    new_size = uart_buffer_round_size(new_size);
     if(uart->rx_buffer->size == new_size) 
         return uart->rx_buffer->size;
 
@@ -227,10 +373,8 @@ uart_resize_rx_buffer(uart_t* uart, size_t new_size)
     if(!new_buf)
         return uart->rx_buffer->size;
     
-    size_t new_wpos = 0;
     ETS_UART_INTR_DISABLE();
-    while(uart_rx_available_unsafe(uart) && new_wpos < new_size)
-        new_buf[new_wpos++] = uart_read_char_unsafe(uart); //if uart_rx_available_unsafe() returns non-0, uart_read_char_unsafe() can't return -1
+    size_t new_wpos = uart_read_unsafe(uart, (char*)new_buf, new_size - 1);
     
     uint8_t * old_buf = uart->rx_buffer->buffer;
     uart->rx_buffer->rpos = 0;
@@ -247,47 +391,83 @@ uart_resize_rx_buffer(uart_t* uart, size_t new_size)
 void ICACHE_RAM_ATTR 
 uart_isr(void * arg)
 {
-    uart_t* uart = (uart_t*)arg;
-    if(uart == NULL || !uart->rx_enabled) 
+    (void) arg;
+    for(int uart_nr = UART0; uart_nr <= UART1; uart_nr++)
     {
-        USIC(uart->uart_nr) = USIS(uart->uart_nr);
-        ETS_UART_INTR_DISABLE();
+        uint32_t status = USIS(uart_nr);
+        if(status == 0)
+            continue;
+
+        uart_t* uart = s_uart_isr_uart[uart_nr];
+        if(uart != NULL && uart->rx_enabled && (status & ((1 << UIFF) | (1 << UITO))))
+            uart_rx_copy_fifo_to_buffer_unsafe(uart);
+        if(uart != NULL && uart->tx_buffer != NULL && (status & (1 << UIFE)))
+            uart_tx_copy_buffer_to_fifo_unsafe(uart);
+
+        USIC(uart_nr) = USIS(uart_nr);
+    }
+}
+
+// Keep the handler attached while any uart needs it
+static void 
+uart_isr_update(void)
+{
+    if(s_uart_isr_uart[UART0] == NULL && s_uart_isr_uart[UART1] == NULL)
+    {
+        ETS_UART_INTR_ATTACH(NULL, NULL);
         return;
     }
-    if(USIS(uart->uart_nr) & ((1 << UIFF) | (1 << UITO)))
-        uart_rx_copy_fifo_to_buffer_unsafe(uart);
-    
-    USIC(uart->uart_nr) = USIS(uart->uart_nr);
+    ETS_UART_INTR_ATTACH(uart_isr, NULL);
+    ETS_UART_INTR_ENABLE();
 }
 
+// Also called again when the tx buffer comes or goes
 static void 
 uart_start_isr(uart_t* uart)
 {
-    if(uart == NULL || !uart->rx_enabled)
+    if(uart == NULL)
         return;
 
-    // UCFFT value is when the RX fifo full interrupt triggers.  A value of 1
-    // triggers the IRS very often.  A value of 127 would not leave much time
-    // for ISR to clear fifo before the next byte is dropped.  So pick a value
-    // in the middle.
-    USC1(uart->uart_nr) = (100   << UCFFT) | (0x02 << UCTOT) | (1 <<UCTOE );
-    USIC(uart->uart_nr) = 0xffff;
-    USIE(uart->uart_nr) = (1 << UIFF) | (1 << UIFR) | (1 << UITO);
-    ETS_UART_INTR_ATTACH(uart_isr,  (void *)uart);
-    ETS_UART_INTR_ENABLE();
+    uint32_t conf1 = 0;
+    uint32_t enable = 0;
+    if(uart->rx_enabled)
+    {
+        // UCFFT value is when the RX fifo full interrupt triggers.  A value of 1
+        // triggers the IRS very often.  A value of 127 would not leave much time
+        // for ISR to clear fifo before the next byte is dropped.  So pick a value
+        // in the middle.
+        conf1 |= (100   << UCFFT) | (0x02 << UCTOT) | (1 <<UCTOE );
+        enable |= (1 << UIFF) | (1 << UIFR) | (1 << UITO);
+    }
+    if(uart->tx_buffer != NULL)
+    {
+        // UIFE itself is only enabled while the tx buffer holds data
+        conf1 |= (UART_TX_FIFO_REFILL << UCFET);
+        if(uart->tx_buffer->rpos != uart->tx_buffer->wpos)
+            enable |= (1 << UIFE);
+    }
+
+    ETS_UART_INTR_DISABLE();
+    USC1(uart->uart_nr) = conf1;
+    if(s_uart_isr_uart[uart->uart_nr] != uart)
+        USIC(uart->uart_nr) = 0xffff;
+    USIE(uart->uart_nr) = enable;
+    s_uart_isr_uart[uart->uart_nr] = uart;
+    uart_isr_update();
 }
 
 static void 
 uart_stop_isr(uart_t* uart)
 {
-    if(uart == NULL || !uart->rx_enabled)
+    if(uart == NULL || s_uart_isr_uart[uart->uart_nr] != uart)
         return;
 
     ETS_UART_INTR_DISABLE();
     USC1(uart->uart_nr) = 0;
     USIC(uart->uart_nr) = 0xffff;
     USIE(uart->uart_nr) = 0;
-    ETS_UART_INTR_ATTACH(NULL, NULL);
+    s_uart_isr_uart[uart->uart_nr] = NULL;
+    uart_isr_update();
 }
 
 
@@ -319,13 +499,49 @@ uart_do_write_char(const int uart_nr, char c)
     USF(uart_nr) = c;
 }
 
+// Only waits while the tx buffer is full. Feeding the fifo here as well
+// keeps this going when called with interrupts off.
+static void 
+uart_buffered_write(uart_t* uart, const char* buf, size_t size)
+{
+    while(size)
+    {
+        ETS_UART_INTR_DISABLE();
+        size_t queued = uart_tx_write_unsafe(uart, buf, size);
+        ETS_UART_INTR_ENABLE();
+        buf += queued;
+        size -= queued;
+    }
+}
+
+// Wait until the tx buffer holds no more than used bytes. The fifo is fed
+// from here too, so this ends even with interrupts off or inside another isr,
+// and it only yields where yielding is allowed.
+static void
+uart_tx_drain(uart_t* uart, size_t used)
+{
+    while(true)
+    {
+        ETS_UART_INTR_DISABLE();
+        uart_tx_copy_buffer_to_fifo_unsafe(uart);
+        size_t left = uart_tx_buffer_used_unsafe(uart->tx_buffer);
+        ETS_UART_INTR_ENABLE();
+        if(left <= used)
+            return;
+        optimistic_yield(10000);
+    }
+}
+
 size_t 
 uart_write_char(uart_t* uart, char c)
 {
     if(uart == NULL || !uart->tx_enabled)
         return 0;
 
-    uart_do_write_char(uart->uart_nr, c);
+    if(uart->tx_buffer != NULL)
+        uart_buffered_write(uart, &c, 1);
+    else
+        uart_do_write_char(uart->uart_nr, c);
     return 1;
 }
 
@@ -336,6 +552,12 @@ uart_write(uart_t* uart, const char* buf, size_t size)
         return 0;
 
     size_t ret = size;
+    if(uart->tx_buffer != NULL)
+    {
+        uart_buffered_write(uart, buf, size);
+        return ret;
+    }
+
     const int uart_nr = uart->uart_nr;
     while (size--)
         uart_do_write_char(uart_nr, *buf++);
@@ -351,7 +573,17 @@ uart_tx_free(uart_t* uart)
     if(uart == NULL || !uart->tx_enabled)
         return 0;
 
-    return UART_TX_FIFO_SIZE - uart_tx_fifo_available(uart->uart_nr);
+    if(uart->tx_buffer == NULL)
+        return UART_TX_FIFO_SIZE - uart_tx_fifo_available(uart->uart_nr);
+
+    // what uart_write() takes without waiting
+    ETS_UART_INTR_DISABLE();
+    size_t used = uart_tx_buffer_used_unsafe(uart->tx_buffer);
+    size_t ret = uart->tx_buffer->size - 1 - used;
+    if(used == 0)
+        ret += uart_tx_fifo_room(uart->uart_nr);
+    ETS_UART_INTR_ENABLE();
+    return ret;
 }
 
 void 
@@ -360,9 +592,85 @@ uart_wait_tx_empty(uart_t* uart)
     if(uart == NULL || !uart->tx_enabled)
         return;
 
+    if(uart->tx_buffer != NULL)
+        uart_tx_drain(uart, 0);
+
     while(uart_tx_fifo_available(uart->uart_nr) > 0)
-        delay(0);
+        optimistic_yield(10000);
+
+}
+
+size_t 
+uart_resize_tx_buffer(uart_t* uart, size_t new_size)
+{
+    if(uart == NULL || !uart->tx_enabled) 
+        return 0;
+
+    struct uart_tx_buffer_ * tx_buffer = uart->tx_buffer;
+    if(new_size == 0)
+    {
+        if(tx_buffer == NULL)
+            return 0;
+
+        uart_tx_drain(uart, 0);
+
+        ETS_UART_INTR_DISABLE();
+        uart->tx_buffer = NULL;
+        ETS_UART_INTR_ENABLE();
+        if(uart->uart_nr == UART0 && uart->rx_enabled)
+            uart_start_isr(uart);
+        else
+            uart_stop_isr(uart);
+        free(tx_buffer->buffer);
+        free(tx_buffer);
+        return 0;
+    }
+
+    new_size = uart_buffer_round_size(new_size);
+    if(tx_buffer != NULL && tx_buffer->size == new_size) 
+        return tx_buffer->size;
+
+    uint8_t * new_buf = (uint8_t*)malloc(new_size);
+    if(!new_buf)
+        return (tx_buffer != NULL) ? tx_buffer->size : 0;
+
+    if(tx_buffer == NULL)
+    {
+        tx_buffer = (struct uart_tx_buffer_ *)malloc(sizeof(struct uart_tx_buffer_));
+        if(tx_buffer == NULL)
+        {
+            free(new_buf);
+            return 0;
+        }
+        tx_buffer->size = new_size;
+        tx_buffer->rpos = 0;
+        tx_buffer->wpos = 0;
+        tx_buffer->buffer = new_buf;
+        ETS_UART_INTR_DISABLE();
+        uart->tx_buffer = tx_buffer;
+        ETS_UART_INTR_ENABLE();
+        uart_start_isr(uart);
+        return new_size;
+    }
+
+    // let out what the new buffer couldn't hold
+    uart_tx_drain(uart, new_size - 1);
 
+    ETS_UART_INTR_DISABLE();
+    size_t new_wpos = 0;
+    while(tx_buffer->rpos != tx_buffer->wpos)
+    {
+        new_buf[new_wpos++] = tx_buffer->buffer[tx_buffer->rpos];
+        tx_buffer->rpos = (tx_buffer->rpos + 1) & (tx_buffer->size - 1);
+    }
+    uint8_t * old_buf = tx_buffer->buffer;
+    tx_buffer->rpos = 0;
+    tx_buffer->wpos = new_wpos;
+    tx_buffer->size = new_size;
+    tx_buffer->buffer = new_buf;
+    ETS_UART_INTR_ENABLE();
+    free(old_buf);
+    return tx_buffer->size;
 }
 
 void 
@@ -382,7 +690,17 @@ uart_flush(uart_t* uart)
     }
 
     if(uart->tx_enabled)
+    {
         tmp |= (1 << UCTXRST);
+        if(uart->tx_buffer != NULL)
+        {
+            ETS_UART_INTR_DISABLE();
+            uart->tx_buffer->rpos = 0;
+            uart->tx_buffer->wpos = 0;
+            USIE(uart->uart_nr) &= ~(1 << UIFE);
+            ETS_UART_INTR_ENABLE();
+        }
+    }
 
     USC0(uart->uart_nr) |= (tmp);
     USC0(uart->uart_nr) &= ~(tmp);
@@ -416,12 +734,15 @@ uart_init(int uart_nr, int baudrate, int config, int mode, int tx_pin, size_t rx
 
     uart->uart_nr = uart_nr;
     uart->overrun = false;
+    uart->tx_buffer = NULL;
 
     switch(uart->uart_nr) 
     {
     case UART0:
+        // UART1 may still need the interrupt
         ETS_UART_INTR_DISABLE();
-        ETS_UART_INTR_ATTACH(NULL, NULL);
+        s_uart_isr_uart[UART0] = NULL;
+        uart_isr_update();
         uart->rx_enabled = (mode != UART_TX_ONLY);
         uart->tx_enabled = (mode != UART_RX_ONLY);
         uart->rx_pin = (uart->rx_enabled)?3:255;
@@ -433,7 +754,7 @@ uart_init(int uart_nr, int baudrate, int config, int mode, int tx_pin, size_t rx
               free(uart);
               return NULL;
             }
-            rx_buffer->size = rx_size;//var this
+            rx_buffer->size = uart_buffer_round_size(rx_size);
             rx_buffer->rpos = 0;
             rx_buffer->wpos = 0;
             rx_buffer->buffer = (uint8_t *)malloc(rx_buffer->size);
@@ -529,10 +850,14 @@ uart_uninit(uart_t* uart)
 
     if(uart->rx_enabled)
     {
-        uart_stop_isr(uart);
         free(uart->rx_buffer->buffer);
         free(uart->rx_buffer);
     }
+    if(uart->tx_buffer != NULL)
+    {
+        free(uart->tx_buffer->buffer);
+        free(uart->tx_buffer);
+    }
     free(uart);
 }
 
@@ -695,6 +1020,14 @@ uart_ignore_char(char c)
 inline void
 uart_write_char_delay(const int uart_nr, char c)
 {
+    // behind what the tx buffer still holds, not ahead of it
+    uart_t* uart = s_uart_isr_uart[uart_nr];
+    if(uart != NULL && uart->tx_buffer != NULL)
+    {
+        uart_buffered_write(uart, &c, 1);
+        return;
+    }
+
     while(uart_tx_fifo_full(uart_nr))
         delay(0);
 
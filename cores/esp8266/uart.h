@@ -126,10 +126,15 @@ void uart_set_baudrate(uart_t* uart, int baud_rate);
 int uart_get_baudrate(uart_t* uart);
 
 size_t uart_resize_rx_buffer(uart_t* uart, size_t new_size);
+// Also carries the debug output (os_printf) of this uart while it is installed.
+// Shrinking or removing it waits for the queued bytes, as uart_wait_tx_empty()
+// does; both feed the fifo themselves, so they also work with interrupts off
+size_t uart_resize_tx_buffer(uart_t* uart, size_t new_size);
 
 size_t uart_write_char(uart_t* uart, char c);
 size_t uart_write(uart_t* uart, const char* buf, size_t size);
 int uart_read_char(uart_t* uart);
+size_t uart_read(uart_t* uart, char* buffer, size_t size);
 int uart_peek_char(uart_t* uart);
 size_t uart_rx_available(uart_t* uart);
 size_t uart_tx_free(uart_t* uart);
@@ -41,6 +41,7 @@ ArduinoOTAClass::ArduinoOTAClass()
 , _end_callback(NULL)
 , _error_callback(NULL)
 , _progress_callback(NULL)
+, _progress_stats_callback(NULL)
 {
 }
 
@@ -63,6 +64,10 @@ void ArduinoOTAClass::onProgress(THandlerFunction_Progress fn) {
     _progress_callback = fn;
 }
 
+void ArduinoOTAClass::onProgressStats(THandlerFunction_ProgressStats fn) {
+    _progress_stats_callback = fn;
+}
+
 void ArduinoOTAClass::onError(THandlerFunction_Error fn) {
     _error_callback = fn;
 }
@@ -284,19 +289,27 @@ void ArduinoOTAClass::_runUpdate() {
 #ifdef OTA_DEBUG
     OTA_DEBUG.printf("Connect Failed\n");
 #endif
+    // nothing written yet, this only releases the Updater for the next try
+    Update.end();
     _udp_ota->listen(*IP_ADDR_ANY, _port);
     if (_error_callback) {
       _error_callback(OTA_CONNECT_ERROR);
     }
     _state = OTA_IDLE;
+    return;
   }
 
   uint32_t written, total = 0;
+  uint32_t started = millis();
+  ota_progress_t stats = { 0, (unsigned int)_size, 0, 0, 0, 0, 0 };
   while (!Update.isFinished() && client.connected()) {
-    int waited = 1000;
-    while (!client.available() && waited--)
-      delay(1);
-    if (!waited){
+    uint32_t waitStart = millis();
+    while (!client.available() && millis() - waitStart < 1000) {
+      // put the wait to use, erasing ahead or writing a held back buffer
+      if (!Update.idle())
+        delay(1);
+    }
+    if (!client.available()){
 #ifdef OTA_DEBUG
       OTA_DEBUG.printf("Receive Failed\n");
 #endif
@@ -305,7 +318,10 @@ void ArduinoOTAClass::_runUpdate() {
         _error_callback(OTA_RECEIVE_ERROR);
       }
       _state = OTA_IDLE;
+      break;
     }
+    // write() keeps reading for as long as data comes in, so one
+    // acknowledgement covers everything the peer sent meanwhile
     written = Update.write(client);
     if (written > 0) {
       client.print(written, DEC);
@@ -313,6 +329,15 @@ void ArduinoOTAClass::_runUpdate() {
       if(_progress_callback) {
         _progress_callback(total, _size);
       }
+      if(_progress_stats_callback) {
+        stats.received = total;
+        stats.elapsedMs = millis() - started;
+        stats.bytesPerSec = stats.elapsedMs ? (uint64_t)total * 1000 / stats.elapsedMs : 0;
+        stats.eraseMs = Update.eraseTime() / 1000;
+        stats.writeMs = Update.writeTime() / 1000;
+        stats.batches++;
+        _progress_stats_callback(stats);
+      }
     }
   }
 
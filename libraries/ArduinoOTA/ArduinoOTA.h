@@ -21,12 +21,23 @@ typedef enum {
   OTA_END_ERROR
 } ota_error_t;
 
+typedef struct {
+  unsigned int received;    // bytes so far
+  unsigned int total;       // bytes in the update
+  unsigned int elapsedMs;   // since the transfer started
+  unsigned int bytesPerSec; // average so far
+  unsigned int eraseMs;     // spent erasing flash
+  unsigned int writeMs;     // spent writing flash
+  unsigned int batches;     // acknowledgements sent back
+} ota_progress_t;
+
 class ArduinoOTAClass
 {
   public:
 	typedef std::function<void(void)> THandlerFunction;
 	typedef std::function<void(ota_error_t)> THandlerFunction_Error;
 	typedef std::function<void(unsigned int, unsigned int)> THandlerFunction_Progress;
+	typedef std::function<void(const ota_progress_t&)> THandlerFunction_ProgressStats;
 
     ArduinoOTAClass();
     ~ArduinoOTAClass();
@@ -59,6 +70,9 @@ class ArduinoOTAClass
     //This callback will be called when OTA is receiving data
     void onProgress(THandlerFunction_Progress fn);
 
+    //As onProgress, with the transfer rate and where the time went
+    void onProgressStats(THandlerFunction_ProgressStats fn);
+
     //Starts the ArduinoOTA service
     void begin();
 
@@ -88,6 +102,7 @@ class ArduinoOTAClass
     THandlerFunction _end_callback;
     THandlerFunction_Error _error_callback;
     THandlerFunction_Progress _progress_callback;
+    THandlerFunction_ProgressStats _progress_stats_callback;
 
     void _runUpdate(void);
     void _onRx(void);
@@ -7,19 +7,26 @@ DNSServer::DNSServer()
 {
   _ttl = htonl(60);
   _errorReplyCode = DNSReplyCode::NonExistentDomain;
+  _buffer = NULL;
+  memset(_domains, 0, sizeof(_domains));
+  _domainCount = 0;
+  _catchAll = false;
+}
+
+DNSServer::~DNSServer()
+{
+  clearDomains();
+  free(_buffer);
 }
 
 bool DNSServer::start(const uint16_t &port, const String &domainName,
                      const IPAddress &resolvedIP)
 {
   _port = port;
-  _buffer = NULL;
-  _domainName = domainName;
-  _resolvedIP[0] = resolvedIP[0];
-  _resolvedIP[1] = resolvedIP[1];
-  _resolvedIP[2] = resolvedIP[2];
-  _resolvedIP[3] = resolvedIP[3];
-  downcaseAndRemoveWwwPrefix(_domainName);
+  // one buffer for the lifetime of the server, queries are answered in it
+  if (_buffer == NULL) _buffer = (unsigned char*)malloc(DNS_MAX_PACKET_SIZE);
+  clearDomains();
+  addDomain(domainName, resolvedIP);
   return _udp.begin(_port) == 1;
 }
 
@@ -40,10 +47,167 @@ void DNSServer::stop()
   _buffer = NULL;
 }
 
-void DNSServer::downcaseAndRemoveWwwPrefix(String &domainName)
+// FNV-1a over the labels as they are in a packet, ignoring case
+uint32_t DNSServer::hashName(const uint8_t *name)
+{
+  uint32_t hash = 2166136261u;
+  while (*name)
+  {
+    uint8_t len = *name;
+    hash = (hash ^ len) * 16777619u;
+    for (uint8_t i = 1; i <= len; i++)
+    {
+      hash = (hash ^ tolower(name[i])) * 16777619u;
+    }
+    name += len + 1;
+  }
+  return hash;
+}
+
+// a is from a packet, b from the table and already lowercase
+bool DNSServer::sameName(const uint8_t *a, const uint8_t *b)
 {
-  domainName.toLowerCase();
-  domainName.replace("www.", "");
+  while (*a == *b)
+  {
+    uint8_t len = *a;
+    if (len == 0) return true;
+    for (uint8_t i = 1; i <= len; i++)
+    {
+      if (tolower(a[i]) != b[i]) return false;
+    }
+    a += len + 1;
+    b += len + 1;
+  }
+  return false;
+}
+
+// "www.Example.com" becomes "\x07example\x03com\0", returns the length or -1
+int DNSServer::encodeName(const String &domainName, uint8_t *name, bool &wildcard)
+{
+  const char *src = domainName.c_str();
+  wildcard = false;
+  if (strncasecmp(src, "www.", 4) == 0)
+  {
+    src += 4;
+  }
+  else if (strncmp(src, "*.", 2) == 0)
+  {
+    src += 2;
+    wildcard = true;
+  }
+
+  int pos = 0;
+  while (*src)
+  {
+    const char *dot = strchr(src, '.');
+    int len = dot ? dot - src : strlen(src);
+    if (len == 0 || len > 63 || pos + len + 2 > 255) return -1;
+    name[pos++] = len;
+    for (int i = 0; i < len; i++)
+    {
+      name[pos++] = tolower(src[i]);
+    }
+    src += dot ? len + 1 : len;
+  }
+  if (pos == 0) return -1;
+  name[pos++] = 0;
+  return pos;
+}
+
+DNSServer::Domain* DNSServer::findDomain(const uint8_t *name, uint32_t hash, bool wildcard)
+{
+  for (int i = 0; i < DNS_TABLE_SIZE; i++)
+  {
+    Domain *domain = &_domains[(hash + i) & (DNS_TABLE_SIZE - 1)];
+    if (domain->name == NULL) return NULL;
+    if (domain->hash == hash && domain->wildcard == wildcard && sameName(name, domain->name))
+    {
+      return domain;
+    }
+  }
+  return NULL;
+}
+
+void DNSServer::insertDomain(const Domain &domain)
+{
+  int slot = domain.hash & (DNS_TABLE_SIZE - 1);
+  while (_domains[slot].name != NULL)
+  {
+    slot = (slot + 1) & (DNS_TABLE_SIZE - 1);
+  }
+  _domains[slot] = domain;
+}
+
+bool DNSServer::addDomain(const String &domainName, const IPAddress &resolvedIP)
+{
+  if (domainName == "*")
+  {
+    _catchAll = true;
+    for (int i = 0; i < 4; i++) _catchAllIP[i] = resolvedIP[i];
+    return true;
+  }
+
+  uint8_t name[256];
+  bool wildcard;
+  int len = encodeName(domainName, name, wildcard);
+  if (len < 0) return false;
+  uint32_t hash = hashName(name);
+  Domain *domain = findDomain(name, hash, wildcard);
+  if (domain == NULL)
+  {
+    if (_domainCount >= DNS_MAX_DOMAINS) return false;
+    Domain added;
+    added.hash = hash;
+    added.wildcard = wildcard;
+    added.name = (uint8_t*)malloc(len);
+    if (added.name == NULL) return false;
+    memcpy(added.name, name, len);
+    insertDomain(added);
+    _domainCount++;
+    domain = findDomain(name, hash, wildcard);
+  }
+  for (int i = 0; i < 4; i++) domain->ip[i] = resolvedIP[i];
+  return true;
+}
+
+bool DNSServer::removeDomain(const String &domainName)
+{
+  if (domainName == "*")
+  {
+    bool was = _catchAll;
+    _catchAll = false;
+    return was;
+  }
+
+  uint8_t name[256];
+  bool wildcard;
+  if (encodeName(domainName, name, wildcard) < 0) return false;
+  Domain *domain = findDomain(name, hashName(name), wildcard);
+  if (domain == NULL) return false;
+  free(domain->name);
+  domain->name = NULL;
+  _domainCount--;
+
+  // put back the rest of the probe run, so lookups don't stop at the hole
+  int slot = domain - _domains;
+  for (slot = (slot + 1) & (DNS_TABLE_SIZE - 1); _domains[slot].name != NULL; slot = (slot + 1) & (DNS_TABLE_SIZE - 1))
+  {
+    Domain moved = _domains[slot];
+    _domains[slot].name = NULL;
+    insertDomain(moved);
+  }
+  return true;
+}
+
+void DNSServer::clearDomains()
+{
+  for (int i = 0; i < DNS_TABLE_SIZE; i++)
+  {
+    free(_domains[i].name);
+    _domains[i].name = NULL;
+  }
+  _domainCount = 0;
+  _catchAll = false;
 }
 
 void DNSServer::processNextRequest()
@@ -51,27 +215,30 @@ void DNSServer::processNextRequest()
   _currentPacketSize = _udp.parsePacket();
   if (_currentPacketSize)
   {
-    if (_buffer != NULL) free(_buffer);
-    _buffer = (unsigned char*)malloc(_currentPacketSize * sizeof(char));
-    if (_buffer == NULL) return;
+    // the answer goes after the query in the same buffer
+    if (_buffer == NULL ||
+        _currentPacketSize < (int)sizeof(DNSHeader) ||
+        _currentPacketSize > DNS_MAX_PACKET_SIZE - DNS_ANSWER_SIZE)
+    {
+      _udp.flush();
+      return;
+    }
     _udp.read(_buffer, _currentPacketSize);
     _dnsHeader = (DNSHeader*) _buffer;
 
+    const unsigned char *ip = NULL;
     if (_dnsHeader->QR == DNS_QR_QUERY &&
         _dnsHeader->OPCode == DNS_OPCODE_QUERY &&
         requestIncludesOnlyOneQuestion() &&
-        (_domainName == "*" || getDomainNameWithoutWwwPrefix() == _domainName)
+        (ip = resolve()) != NULL
        )
     {
-      replyWithIP();
+      replyWithIP(ip);
     }
     else if (_dnsHeader->QR == DNS_QR_QUERY)
     {
       replyWithCustomCode();
     }
-
-    free(_buffer);
-    _buffer = NULL;
   }
 }
 
@@ -83,76 +250,70 @@ bool DNSServer::requestIncludesOnlyOneQuestion()
          _dnsHeader->ARCount == 0;
 }
 
-String DNSServer::getDomainNameWithoutWwwPrefix()
+// Looks the question up where it is in the buffer: the exact name first
+// (without "www."), then wildcards from the closest parent domain up,
+// then "*". Returns NULL if nothing matches or the name is broken.
+const unsigned char* DNSServer::resolve()
 {
-  String parsedDomainName = "";
-  if (_buffer == NULL) return parsedDomainName;
-  unsigned char *start = _buffer + 12;
-  if (*start == 0)
+  uint8_t *name = _buffer + sizeof(DNSHeader);
+  uint8_t *end = _buffer + _currentPacketSize;
+  if (name >= end) return NULL;
+  for (uint8_t *label = name; *label; label += *label + 1)
   {
-    return parsedDomainName;
+    // no compression in a question, and the name has to end inside the packet
+    if (*label > 63 || label + *label + 1 >= end) return NULL;
   }
-  int pos = 0;
-  while(true)
+
+  uint8_t *exact = name;
+  if (exact[0] == 3 && tolower(exact[1]) == 'w' && tolower(exact[2]) == 'w' &&
+      tolower(exact[3]) == 'w' && exact[4] != 0)
   {
-    unsigned char labelLength = *(start + pos);
-    for(int i = 0; i < labelLength; i++)
-    {
-      pos++;
-      parsedDomainName += (char)*(start + pos);
-    }
-    pos++;
-    if (*(start + pos) == 0)
-    {
-      downcaseAndRemoveWwwPrefix(parsedDomainName);
-      return parsedDomainName;
-    }
-    else
+    exact += 4;
+  }
+  Domain *domain = findDomain(exact, hashName(exact), false);
+  if (domain) return domain->ip;
+
+  if (*name)
+  {
+    for (uint8_t *parent = name + *name + 1; *parent; parent += *parent + 1)
     {
-      parsedDomainName += ".";
+      domain = findDomain(parent, hashName(parent), true);
+      if (domain) return domain->ip;
     }
   }
+  return _catchAll ? _catchAllIP : NULL;
 }
 
-void DNSServer::replyWithIP()
+void DNSServer::replyWithIP(const unsigned char *ip)
 {
-  if (_buffer == NULL) return;
   _dnsHeader->QR = DNS_QR_RESPONSE;
   _dnsHeader->ANCount = _dnsHeader->QDCount;
-  _dnsHeader->QDCount = _dnsHeader->QDCount; 
-  //_dnsHeader->RA = 1;  
-
-  _udp.beginPacket(_udp.remoteIP(), _udp.remotePort());
-  _udp.write(_buffer, _currentPacketSize);
-
-  _udp.write((uint8_t)192); //  answer name is a pointer
-  _udp.write((uint8_t)12);  // pointer to offset at 0x00c
-
-  _udp.write((uint8_t)0);   // 0x0001  answer is type A query (host address)
-  _udp.write((uint8_t)1);
-
-  _udp.write((uint8_t)0);   //0x0001 answer is class IN (internet address)
-  _udp.write((uint8_t)1);
- 
-  _udp.write((unsigned char*)&_ttl, 4);
+  //_dnsHeader->RA = 1;
 
+  unsigned char *answer = _buffer + _currentPacketSize;
+  answer[0] = 192;  //  answer name is a pointer
+  answer[1] = 12;   // pointer to offset at 0x00c
+  answer[2] = 0;    // 0x0001  answer is type A query (host address)
+  answer[3] = 1;
+  answer[4] = 0;    //0x0001 answer is class IN (internet address)
+  answer[5] = 1;
+  memcpy(answer + 6, &_ttl, 4);
   // Length of RData is 4 bytes (because, in this case, RData is IPv4)
-  _udp.write((uint8_t)0);
-  _udp.write((uint8_t)4);
-  _udp.write(_resolvedIP, sizeof(_resolvedIP));
-  _udp.endPacket();
-
+  answer[10] = 0;
+  answer[11] = 4;
+  memcpy(answer + 12, ip, 4);
 
+  _udp.beginPacket(_udp.remoteIP(), _udp.remotePort());
+  _udp.write(_buffer, _currentPacketSize + DNS_ANSWER_SIZE);
+  _udp.endPacket();
 
   #ifdef DEBUG_ESP_DNS
-    DEBUG_ESP_PORT.printf("DNS responds: %s for %s\n",
-            IPAddress(_resolvedIP).toString().c_str(), getDomainNameWithoutWwwPrefix().c_str() );
+    DEBUG_ESP_PORT.printf("DNS responds: %s\n", IPAddress(ip).toString().c_str());
   #endif
 }
 
 void DNSServer::replyWithCustomCode()
 {
-  if (_buffer == NULL) return;
   _dnsHeader->QR = DNS_QR_RESPONSE;
   _dnsHeader->RCode = (unsigned char)_errorReplyCode;
   _dnsHeader->QDCount = 0;
@@ -6,6 +6,11 @@
 #define DNS_QR_RESPONSE 1
 #define DNS_OPCODE_QUERY 0
 
+#define DNS_MAX_PACKET_SIZE 512 // without EDNS, bigger queries are dropped
+#define DNS_ANSWER_SIZE 16      // name pointer, type, class, ttl, length, IPv4
+#define DNS_MAX_DOMAINS 8
+#define DNS_TABLE_SIZE 16       // slots of the domain table, a power of two above DNS_MAX_DOMAINS
+
 enum class DNSReplyCode
 {
   NoError = 0,
@@ -40,6 +45,7 @@ class DNSServer
 {
   public:
     DNSServer();
+    ~DNSServer();
     void processNextRequest();
     void setErrorReplyCode(const DNSReplyCode &replyCode);
     void setTTL(const uint32_t &ttl);
@@ -51,21 +57,43 @@ class DNSServer
     // stops the DNS server
     void stop();
 
+    // Answers for more domains, on top of the one given to start().
+    // "*" matches every name, "*.example.com" every name under example.com.
+    // A leading "www." is ignored, as are upper and lower case.
+    // Returns false if the table is full or the name is not valid
+    bool addDomain(const String &domainName, const IPAddress &resolvedIP);
+    bool removeDomain(const String &domainName);
+    void clearDomains();
+
   private:
+    struct Domain
+    {
+      uint32_t hash;        // of the name below, any value, even 0
+      uint8_t* name;        // lowercase labels as in a packet, without the "*" label of a wildcard, NULL for a free slot
+      unsigned char ip[4];
+      bool wildcard;
+    };
+
     WiFiUDP _udp;
     uint16_t _port;
-    String _domainName;
-    unsigned char _resolvedIP[4];
+    Domain _domains[DNS_TABLE_SIZE];
+    uint8_t _domainCount;
+    bool _catchAll;
+    unsigned char _catchAllIP[4];
     int _currentPacketSize;
     unsigned char* _buffer;
     DNSHeader* _dnsHeader;
     uint32_t _ttl;
     DNSReplyCode _errorReplyCode;
 
-    void downcaseAndRemoveWwwPrefix(String &domainName);
-    String getDomainNameWithoutWwwPrefix();
+    static uint32_t hashName(const uint8_t *name);
+    static bool sameName(const uint8_t *a, const uint8_t *b);
+    static int encodeName(const String &domainName, uint8_t *name, bool &wildcard);
+    Domain* findDomain(const uint8_t *name, uint32_t hash, bool wildcard);
+    void insertDomain(const Domain &domain);
+    const unsigned char* resolve();
     bool requestIncludesOnlyOneQuestion();
-    void replyWithIP();
+    void replyWithIP(const unsigned char *ip);
     void replyWithCustomCode();
 };
 #endif
\ No newline at end of file
@@ -21,30 +21,102 @@
 
 #include "Arduino.h"
 #include "EEPROM.h"
+#include "Schedule.h"
 
 extern "C" {
 #include "c_types.h"
-#include "ets_sys.h"
-#include "os_type.h"
-#include "osapi.h"
 #include "spi_flash.h"
 }
 
 extern "C" uint32_t _SPIFFS_end;
 
+#define EEPROM_MAGIC 0x4c504545 // "EEPL", starts a sector of the log, followed by its sequence number
+#define EEPROM_HEADER_SIZE 8
+// A record is a word with the address and the length (address | len << 16),
+// the data padded to a word, and a checksum of all that and the sector's sequence number
+#define EEPROM_RECORD_SIZE(len) (4 + (((len) + 3) & ~3) + 4)
+#define EEPROM_FREE 0xFFFFFFFF
+#define EEPROM_CHUNK 64
+
+static uint32_t eeprom_hash(uint32_t hash, const void* data, size_t len) {
+  const uint8_t* bytes = static_cast<const uint8_t*>(data);
+  for (size_t i = 0; i < len; i++) {
+    hash = (hash ^ bytes[i]) * 16777619u;
+  }
+  return hash;
+}
+
+static uint32_t eeprom_hash_start(uint32_t seq, uint32_t head) {
+  uint32_t hash = eeprom_hash(2166136261u, &seq, sizeof(seq));
+  return eeprom_hash(hash, &head, sizeof(head));
+}
+
+static bool eeprom_flash_read(uint32_t address, uint32_t* data, size_t len) {
+  noInterrupts();
+  bool ok = spi_flash_read(address, data, len) == SPI_FLASH_RESULT_OK;
+  interrupts();
+  return ok;
+}
+
+static bool eeprom_flash_write(uint32_t address, uint32_t* data, size_t len) {
+  noInterrupts();
+  bool ok = spi_flash_write(address, data, len) == SPI_FLASH_RESULT_OK;
+  interrupts();
+  return ok;
+}
+
+static bool eeprom_flash_erase(uint32_t sector) {
+  noInterrupts();
+  bool ok = spi_flash_erase_sector(sector) == SPI_FLASH_RESULT_OK;
+  interrupts();
+  return ok;
+}
+
 EEPROMClass::EEPROMClass(uint32_t sector)
 : _sector(sector)
+, _sectors(1)
+, _data(0)
+, _size(0)
+, _dirty(false)
+, _dirtyStart(0)
+, _dirtyEnd(0)
+, _active(0)
+, _seq(0)
+, _activeSeq(0)
+, _offset(0)
+, _compactScheduled(false)
+{
+}
+
+EEPROMClass::EEPROMClass(uint32_t sector, uint8_t sectors)
+: _sector(sector)
+, _sectors(sectors ? sectors : 1)
 , _data(0)
 , _size(0)
 , _dirty(false)
+, _dirtyStart(0)
+, _dirtyEnd(0)
+, _active(0)
+, _seq(0)
+, _activeSeq(0)
+, _offset(0)
+, _compactScheduled(false)
 {
 }
 
 EEPROMClass::EEPROMClass(void)
-: _sector((((uint32_t)&_SPIFFS_end - 0x40200000) / SPI_FLASH_SEC_SIZE))
+: _sector((((uint32_t)(uintptr_t)&_SPIFFS_end - 0x40200000) / SPI_FLASH_SEC_SIZE))
+, _sectors(EEPROM_SECTORS)
 , _data(0)
 , _size(0)
 , _dirty(false)
+, _dirtyStart(0)
+, _dirtyEnd(0)
+, _active(0)
+, _seq(0)
+, _activeSeq(0)
+, _offset(0)
+, _compactScheduled(false)
 {
 }
 
@@ -65,10 +137,46 @@ void EEPROMClass::begin(size_t size) {
   }
 
   _size = size;
+  _active = _sectors;
+  _seq = 0;
+  _activeSeq = 0;
+  _offset = 0;
+  memset(_data, 0xff, _size);
 
-  noInterrupts();
-  spi_flash_read(_sector * SPI_FLASH_SEC_SIZE, reinterpret_cast<uint32_t*>(_data), _size);
-  interrupts();
+  bool logFound = false;
+  if (_logged()) {
+    // newest sector first, an older one is used if it fails to replay
+    uint32_t below = 0;
+    bool bounded = false;
+    while (_active == _sectors) {
+      int newest = -1;
+      uint32_t newestSeq = 0;
+      for (uint8_t i = 0; i < _sectors; i++) {
+        uint32_t header[2];
+        if (!eeprom_flash_read(_sectorAddress(i), header, sizeof(header)) || header[0] != EEPROM_MAGIC)
+          continue;
+        logFound = true;
+        if (!bounded && header[1] > _seq)
+          _seq = header[1];
+        if ((bounded && header[1] >= below) || (newest >= 0 && header[1] <= newestSeq))
+          continue;
+        newest = i;
+        newestSeq = header[1];
+      }
+      if (newest < 0)
+        break;
+      memset(_data, 0xff, _size);
+      _replay(newest, newestSeq);
+      below = newestSeq;
+      bounded = true;
+    }
+    if (_active == _sectors)
+      memset(_data, 0xff, _size);
+  }
+  if (!logFound) {
+    // data written in place, by earlier versions or because it is too big for the log
+    eeprom_flash_read(_sector * SPI_FLASH_SEC_SIZE, reinterpret_cast<uint32_t*>(_data), _size);
+  }
 
   _dirty = false; //make sure dirty is cleared in case begin() is called 2nd+ time
 }
@@ -107,19 +215,154 @@ void EEPROMClass::write(int const address, uint8_t const value) {
   if (*pData != value)
   {
     *pData = value;
-    _dirty = true;
+    _markDirty(address, 1);
   }
 }
 
 bool EEPROMClass::commit() {
-  bool ret = false;
   if (!_size)
     return false;
   if(!_dirty)
     return true;
   if(!_data)
     return false;
+  if (!_logged())
+    return _commitImage();
 
+  size_t len = _dirtyEnd - _dirtyStart;
+  if (_active == _sectors || _offset + EEPROM_RECORD_SIZE(len) > SPI_FLASH_SEC_SIZE)
+    return compact();
+  if (!_writeRecord(_sectorAddress(_active) + _offset, _dirtyStart, len, _activeSeq)) {
+    // whatever got written can't be written over, go on in a fresh sector
+    _offset = SPI_FLASH_SEC_SIZE;
+    return compact();
+  }
+  _offset += EEPROM_RECORD_SIZE(len);
+  _dirty = false;
+
+  // once a commit of everything wouldn't fit anymore, move on to the next sector
+  // after loop(), so the erase doesn't hold up a later commit
+  if (_sectors > 1 && !_compactScheduled && _offset + EEPROM_RECORD_SIZE(_size) > SPI_FLASH_SEC_SIZE) {
+    _compactScheduled = schedule_function([this]() {
+      _compactScheduled = false;
+      if (_data && !_dirty && _offset + EEPROM_RECORD_SIZE(_size) > SPI_FLASH_SEC_SIZE)
+        compact();
+    });
+  }
+  return true;
+}
+
+bool EEPROMClass::compact() {
+  if (!_size || !_data)
+    return false;
+  if (!_logged())
+    return _commitImage();
+
+  // the old sector stays valid until the copy in the new one is complete
+  uint8_t next = (_active + 1) % _sectors;
+  if (_active == _sectors)
+    next = 0;
+  uint32_t address = _sectorAddress(next);
+  uint32_t header[2] = { EEPROM_MAGIC, _seq + 1 };
+  if (!eeprom_flash_erase(address / SPI_FLASH_SEC_SIZE))
+    return false;
+  if (!eeprom_flash_write(address, header, sizeof(header)))
+    return false;
+  if (!_writeRecord(address + EEPROM_HEADER_SIZE, 0, _size, _seq + 1))
+    return false;
+
+  _active = next;
+  _seq++;
+  _activeSeq = _seq;
+  _offset = EEPROM_HEADER_SIZE + EEPROM_RECORD_SIZE(_size);
+  _dirty = false;
+  return true;
+}
+
+bool EEPROMClass::_logged() const {
+  return EEPROM_HEADER_SIZE + EEPROM_RECORD_SIZE(_size) <= SPI_FLASH_SEC_SIZE;
+}
+
+uint32_t EEPROMClass::_sectorAddress(uint8_t index) const {
+  return (_sector + 1 - _sectors + index) * SPI_FLASH_SEC_SIZE;
+}
+
+// Checks the record at address, and copies its data into _data if apply is set
+bool EEPROMClass::_readRecord(uint32_t address, uint32_t head, uint32_t seq, bool apply) {
+  size_t start = head & 0xffff;
+  size_t len = head >> 16;
+  uint32_t hash = eeprom_hash_start(seq, head);
+  uint32_t buffer[EEPROM_CHUNK / 4];
+  for (size_t done = 0; done < len; done += EEPROM_CHUNK) {
+    size_t n = (len - done < EEPROM_CHUNK) ? len - done : EEPROM_CHUNK;
+    if (!eeprom_flash_read(address + 4 + done, buffer, (n + 3) & ~3))
+      return false;
+    hash = eeprom_hash(hash, buffer, n);
+    if (apply && start + done < _size) {
+      size_t copy = (start + done + n > _size) ? _size - start - done : n;
+      memcpy(_data + start + done, buffer, copy);
+    }
+  }
+  uint32_t check;
+  if (!eeprom_flash_read(address + 4 + ((len + 3) & ~3), &check, sizeof(check)))
+    return false;
+  return check == hash;
+}
+
+// The head goes first, so a record cut short never looks like free space
+bool EEPROMClass::_writeRecord(uint32_t address, size_t start, size_t len, uint32_t seq) {
+  uint32_t head = start | (len << 16);
+  uint32_t hash = eeprom_hash_start(seq, head);
+  if (!eeprom_flash_write(address, &head, sizeof(head)))
+    return false;
+  uint32_t buffer[EEPROM_CHUNK / 4];
+  for (size_t done = 0; done < len; done += EEPROM_CHUNK) {
+    size_t n = (len - done < EEPROM_CHUNK) ? len - done : EEPROM_CHUNK;
+    if (n & 3)
+      buffer[n / 4] = 0xffffffff;
+    memcpy(buffer, _data + start + done, n);
+    hash = eeprom_hash(hash, buffer, n);
+    if (!eeprom_flash_write(address + 4 + done, buffer, (n + 3) & ~3))
+      return false;
+  }
+  return eeprom_flash_write(address + 4 + ((len + 3) & ~3), &hash, sizeof(hash));
+}
+
+// Replays the sector into _data, makes it the active one if it starts with a good copy
+bool EEPROMClass::_replay(uint8_t index, uint32_t seq) {
+  uint32_t base = _sectorAddress(index);
+  uint32_t offset = EEPROM_HEADER_SIZE;
+  bool first = true;
+  while (offset + EEPROM_RECORD_SIZE(0) <= SPI_FLASH_SEC_SIZE) {
+    uint32_t head;
+    if (!eeprom_flash_read(base + offset, &head, sizeof(head)))
+      return false;
+    if (head == EEPROM_FREE)
+      break;
+    size_t len = head >> 16;
+    if (len == 0 || offset + EEPROM_RECORD_SIZE(len) > SPI_FLASH_SEC_SIZE ||
+        (first && (head & 0xffff) != 0) || !_readRecord(base + offset, head, seq, false)) {
+      if (first)
+        return false;
+      // a commit cut short, nothing after it counts and nothing more can go here
+      offset = SPI_FLASH_SEC_SIZE;
+      break;
+    }
+    _readRecord(base + offset, head, seq, true);
+    first = false;
+    offset += EEPROM_RECORD_SIZE(len);
+  }
+  if (first)
+    return false;
+  _active = index;
+  _activeSeq = seq;
+  _offset = offset;
+  return true;
+}
+
+// Rewrites the sector in place, for data too big for the log
+bool EEPROMClass::_commitImage() {
+  bool ret = false;
   noInterrupts();
   if(spi_flash_erase_sector(_sector) == SPI_FLASH_RESULT_OK) {
     if(spi_flash_write(_sector * SPI_FLASH_SEC_SIZE, reinterpret_cast<uint32_t*>(_data), _size) == SPI_FLASH_RESULT_OK) {
@@ -133,7 +376,7 @@ bool EEPROMClass::commit() {
 }
 
 uint8_t * EEPROMClass::getDataPtr() {
-  _dirty = true;
+  _markDirty(0, _size);
   return &_data[0];
 }
 
@@ -26,15 +26,35 @@
 #include <stdint.h>
 #include <string.h>
 
+// Flash sectors the global EEPROM spreads its writes over. More than one are
+// taken from the end of the SPIFFS area, which has to be left unused there.
+// With only one, a full sector is erased and rewritten, and a reset during
+// that loses the data. With more, the old sector is kept until the new one
+// holds a complete copy.
+#ifndef EEPROM_SECTORS
+#define EEPROM_SECTORS 1
+#endif
+
+/*
+  The data is kept as a log in a ring of flash sectors. Each sector starts
+  with a copy of the whole data, and every commit() appends the range that
+  changed since the last one. begin() replays the newest sector. A sector is
+  only erased when the log moves on to it, which happens after loop() once
+  the current one runs low on space, or in commit() if it is full.
+  Sizes over 4080 bytes leave no room for the log and are written in
+  place, a whole sector per commit().
+*/
 class EEPROMClass {
 public:
   EEPROMClass(uint32_t sector);
+  EEPROMClass(uint32_t sector, uint8_t sectors); // the ring ends at sector
   EEPROMClass(void);
 
   void begin(size_t size);
   uint8_t read(int const address);
   void write(int const address, uint8_t const val);
   bool commit();
+  bool compact(); // starts the next sector with a copy of the committed data
   void end();
 
   uint8_t * getDataPtr();
@@ -54,7 +74,7 @@ public:
     if (address < 0 || address + sizeof(T) > _size)
       return t;
     if (memcmp(_data + address, (const uint8_t*)&t, sizeof(T)) != 0) {
-      _dirty = true;
+      _markDirty(address, sizeof(T));
       memcpy(_data + address, (const uint8_t*)&t, sizeof(T));
     }
 
@@ -67,10 +87,32 @@ public:
   uint8_t const & operator[](int const address) const {return getConstDataPtr()[address];}
 
 protected:
+  void _markDirty(size_t address, size_t len) {
+    if (!_dirty || address < _dirtyStart)
+      _dirtyStart = address;
+    if (!_dirty || address + len > _dirtyEnd)
+      _dirtyEnd = address + len;
+    _dirty = true;
+  }
+  bool _logged() const;
+  uint32_t _sectorAddress(uint8_t index) const;
+  bool _readRecord(uint32_t address, uint32_t head, uint32_t seq, bool apply);
+  bool _writeRecord(uint32_t address, size_t start, size_t len, uint32_t seq);
+  bool _replay(uint8_t index, uint32_t seq);
+  bool _commitImage();
+
   uint32_t _sector;
+  uint8_t _sectors;
   uint8_t* _data;
   size_t _size;
   bool _dirty;
+  size_t _dirtyStart;
+  size_t _dirtyEnd;
+  uint8_t _active; // ring index of the sector being appended to, _sectors if none
+  uint32_t _seq;   // highest sequence number in the ring, the next sector gets one more
+  uint32_t _activeSeq; // of the active sector, older than _seq if a newer one didn't replay
+  uint32_t _offset; // of the next record in the active sector
+  bool _compactScheduled;
 };
 
 #if !defined(NO_GLOBAL_INSTANCES) && !defined(NO_GLOBAL_EEPROM)
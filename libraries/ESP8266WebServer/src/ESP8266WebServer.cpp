@@ -1,6 +1,6 @@
 /*
 	ESP8266WebServer.cpp - Dead simple web-server.
-	Supports only one simultaneous client, knows how to handle GET and POST.
+	Supports a small pool of simultaneous clients, knows how to handle GET and POST.
 
 	Copyright (c) 2014 Ivan Grokhotkov. All rights reserved.
 
@@ -49,15 +49,15 @@ static const char Content_Length[] PROGMEM = "Content-Length";
 // INITIALIZE ALL THE THINGS
 ////////////////////////////////////////////////////////////////////////////////
 void ESP8266WebServer::_init() {
-	_currentVersion		= 0;
-	_currentStatus		= HC_NONE;
-	_handler			= nullptr;
+	_current			= &_connections[0];
+	_nextConnection		= 0;
 	_firstHandler		= nullptr;
 	_lastHandler		= nullptr;
 	_contentLength		= 0;
 	_chunked			= false;
-
-	resetRequest();
+	_keepAliveTimeout	= HTTP_MAX_KEEPALIVE_WAIT;
+	_keepAliveMax		= HTTP_MAX_KEEPALIVE_REQUESTS;
+	_statusCode			= 0;
 }
 
 
@@ -89,9 +89,6 @@ ESP8266WebServer::ESP8266WebServer(int port) : _server(port) {
 ESP8266WebServer::~ESP8266WebServer() {
 	_server.close();
 
-	_headers.reset();
-	_params.reset();
-
 	RequestHandler* handler = _firstHandler;
 
 	while (handler) {
@@ -110,6 +107,7 @@ ESP8266WebServer::~ESP8266WebServer() {
 void ESP8266WebServer::begin() {
 	close();
 	_server.begin();
+	_router.build(_firstHandler);
 }
 
 
@@ -121,6 +119,7 @@ void ESP8266WebServer::begin() {
 void ESP8266WebServer::begin(uint16_t port) {
 	close();
 	_server.begin(port);
+	_router.build(_firstHandler);
 }
 
 
@@ -210,13 +209,13 @@ bool ESP8266WebServer::authenticate(const char * username, const char * password
 				DEBUG_OUTPUT.println("Hash of user:realm:pass=" + _H1);
 #			endif
 			md5.begin();
-			if(_method == HTTP_GET){
+			if(_current->method == HTTP_GET){
 				md5.add(String(F("GET:")) + _uri);
-			}else if(_method == HTTP_POST){
+			}else if(_current->method == HTTP_POST){
 				md5.add(String(F("POST:")) + _uri);
-			}else if(_method == HTTP_PUT){
+			}else if(_current->method == HTTP_PUT){
 				md5.add(String(F("PUT:")) + _uri);
-			}else if(_method == HTTP_DELETE){
+			}else if(_current->method == HTTP_DELETE){
 				md5.add(String(F("DELETE:")) + _uri);
 			}else{
 				md5.add(String(F("GET:")) + _uri);
@@ -357,6 +356,8 @@ void ESP8266WebServer::_addRequestHandler(RequestHandler* handler) {
 		_lastHandler->next(handler);
 		_lastHandler = handler;
 	}
+
+	_router.reset();
 }
 
 
@@ -365,51 +366,103 @@ void ESP8266WebServer::_addRequestHandler(RequestHandler* handler) {
 ////////////////////////////////////////////////////////////////////////////////
 // ??
 ////////////////////////////////////////////////////////////////////////////////
-void ESP8266WebServer::serveStatic(const char* uri, FS& fs, const char* path, const char* cache_header) {
-	_addRequestHandler(new StaticRequestHandler(fs, path, uri, cache_header));
+void ESP8266WebServer::serveStatic(const char* uri, FS& fs, const char* path, const char* cache_header, const char* last_modified) {
+	_addRequestHandler(new StaticRequestHandler(fs, path, uri, cache_header, last_modified));
 }
 
 
 
 
 ////////////////////////////////////////////////////////////////////////////////
-// ??
+// FIND AN UNUSED SLOT IN THE CONNECTION POOL
+////////////////////////////////////////////////////////////////////////////////
+HTTPConnection *ESP8266WebServer::_freeConnection() {
+	for (auto i=0; i<HTTP_MAX_CLIENTS; i++) {
+		if (!_connections[i].active()) {
+			return &_connections[i];
+		}
+	}
+	return nullptr;
+}
+
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+// ACCEPT NEW CLIENTS AND GIVE EVERY OPEN CONNECTION ONE NON-BLOCKING TURN
+// THE STARTING SLOT ROTATES SO NO CONNECTION IS ALWAYS SERVICED LAST
 ////////////////////////////////////////////////////////////////////////////////
 void ESP8266WebServer::handleClient() {
-	if (_currentStatus == HC_NONE) {
+	for (auto slot=_freeConnection(); slot; slot=_freeConnection()) {
 		WiFiClient client = _server.available();
-		if (!client) return;
+		if (!client) break;
 
 #		ifdef DEBUG_ESP_HTTP_SERVER
 			DEBUG_OUTPUT.println("New client");
 #		endif
 
-		_currentClient = client;
-		_currentStatus = HC_WAIT_READ;
-		_statusChange = millis();
+		slot->open(client);
 	}
 
+	bool callYield = false;
+
+	for (auto i=0; i<HTTP_MAX_CLIENTS; i++) {
+		auto &connection = _connections[(_nextConnection + i) % HTTP_MAX_CLIENTS];
+		if (connection.active()) {
+			callYield |= _handleConnection(connection);
+		}
+	}
+
+	_nextConnection = (_nextConnection + 1) % HTTP_MAX_CLIENTS;
+
+	if (callYield) {
+		yield();
+	}
+}
+
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+// ADVANCE THE STATE MACHINE OF A SINGLE CONNECTION WITHOUT BLOCKING
+// RETURNS TRUE WHEN THE CONNECTION IS WAITING ON THE CLIENT
+////////////////////////////////////////////////////////////////////////////////
+bool ESP8266WebServer::_handleConnection(HTTPConnection &connection) {
+	_current = &connection;
+
 	bool keepCurrentClient = false;
 	bool callYield = false;
 
-	if (_currentClient.connected()) {
-		switch (_currentStatus) {
+	if (connection.client.connected()) {
+		switch (connection.status) {
 		case HC_NONE:
 			// No-op to avoid C++ compiler warning
 			break;
 
 		case HC_WAIT_READ:
-			// Wait for data from client to become available
-			if (_currentClient.available()) {
-				auto status = _parseRequest(_currentClient);
-				if (status == HTTP_OK) {
-					_currentClient.setTimeout(HTTP_MAX_SEND_WAIT);
+			// Parse whatever arrived from the client
+			// (or a pipelined request already sitting in our buffer)
+			if (connection.pipelined  ||  connection.client.available()) {
+				auto status = _parseRequest(connection.client);
+				if (status == HTTP_CONTINUE) {
+					// Request is incomplete, come back once more bytes arrive
+					keepCurrentClient = true;
+
+				} else if (status == HTTP_OK) {
+					connection.client.setTimeout(HTTP_MAX_SEND_WAIT);
 					_contentLength = CONTENT_LENGTH_NOT_SET;
 					_handleRequest();
 
-					if (_currentClient.connected()) {
-						_currentStatus = HC_WAIT_CLOSE;
-						_statusChange = millis();
+					if (connection.client.connected()) {
+						if (connection.keepAlive) {
+							//PERSISTENT CONNECTION, KEEP PIPELINED BYTES AND WAIT FOR THE NEXT REQUEST
+							resetRequest(true);
+						} else {
+							//FREE THE REQUEST WHILE WAITING FOR THE CLIENT TO CLOSE
+							resetRequest();
+							connection.status = HC_WAIT_CLOSE;
+						}
+						connection.statusChange = millis();
 						keepCurrentClient = true;
 					}
 				} else {
@@ -418,8 +471,28 @@ void ESP8266WebServer::handleClient() {
 					send(status);
 				}
 
-			} else { // !_currentClient.available()
-				if (millis() - _statusChange <= HTTP_MAX_DATA_WAIT) {
+			} else if (connection.readBytes) {
+				// Partial request, the client has a while to send the rest
+				unsigned long wait = connection.parser.headersComplete() ? HTTP_MAX_POST_WAIT : HTTP_MAX_DATA_WAIT;
+				if (millis() - connection.readTimeout <= wait) {
+					keepCurrentClient = true;
+				} else {
+					resetRequest();
+					send(HTTP_TIMEOUT);
+				}
+				callYield = true;
+
+			} else if (connection.requestCount) {
+				// Idle persistent connection, it also gives up its slot
+				// when the pool is full and another client is waiting
+				if (millis() - connection.statusChange <= _keepAliveTimeout
+				&&  (_freeConnection()  ||  !_server.hasClient())) {
+					keepCurrentClient = true;
+				}
+				callYield = true;
+
+			} else { // !connection.client.available()
+				if (millis() - connection.statusChange <= HTTP_MAX_DATA_WAIT) {
 					keepCurrentClient = true;
 				}
 				callYield = true;
@@ -428,7 +501,7 @@ void ESP8266WebServer::handleClient() {
 
 		case HC_WAIT_CLOSE:
 			// Wait for client to close the connection
-			if (millis() - _statusChange <= HTTP_MAX_CLOSE_WAIT) {
+			if (millis() - connection.statusChange <= HTTP_MAX_CLOSE_WAIT) {
 				keepCurrentClient = true;
 				callYield = true;
 			}
@@ -436,14 +509,10 @@ void ESP8266WebServer::handleClient() {
 	}
 
 	if (!keepCurrentClient) {
-		_currentClient = WiFiClient();
-		_currentStatus = HC_NONE;
-		_currentUpload.reset();
+		connection.close();
 	}
 
-	if (callYield) {
-		yield();
-	}
+	return callYield;
 }
 
 
@@ -454,8 +523,10 @@ void ESP8266WebServer::handleClient() {
 ////////////////////////////////////////////////////////////////////////////////
 void ESP8266WebServer::close() {
 	_server.close();
-	_currentStatus = HC_NONE;
-	resetRequest();
+
+	for (auto i=0; i<HTTP_MAX_CLIENTS; i++) {
+		_connections[i].close();
+	}
 }
 
 
@@ -471,21 +542,33 @@ void ESP8266WebServer::stop() {
 
 
 
+////////////////////////////////////////////////////////////////////////////////
+// CONFIGURE PERSISTENT CONNECTIONS
+// TIMEOUT IS THE IDLE TIME ALLOWED BETWEEN TWO REQUESTS, 0 DISABLES KEEP-ALIVE
+////////////////////////////////////////////////////////////////////////////////
+void ESP8266WebServer::setKeepAlive(unsigned long timeout, uint16_t maxRequests) {
+	_keepAliveTimeout	= timeout;
+	_keepAliveMax		= maxRequests;
+}
+
+
+
+
 ////////////////////////////////////////////////////////////////////////////////
 // ??
 ////////////////////////////////////////////////////////////////////////////////
 void ESP8266WebServer::sendHeader(const String& name, const String& value, bool first) {
-	//TODO: CHANGE THIS TO A SINGLE FIXED LENGTH BUFFER
-	String headerLine = name;
-	headerLine += F(": ");
-	headerLine += value;
-	headerLine += "\r\n";
-
-	if (first) {
-		_responseHeaders = headerLine + _responseHeaders;
-	} else {
-		_responseHeaders += headerLine;
-	}
+	_responseHeaders.header(name.c_str(), value.c_str(), first);
+}
+
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+// SAME AS ABOVE WITHOUT BUILDING TEMPORARY STRINGS
+////////////////////////////////////////////////////////////////////////////////
+void ESP8266WebServer::sendHeader(const char* name, const char* value, bool first) {
+	_responseHeaders.header(name, value, first);
 }
 
 
@@ -504,37 +587,85 @@ void ESP8266WebServer::setContentLength(const size_t contentLength) {
 ////////////////////////////////////////////////////////////////////////////////
 // ??
 ////////////////////////////////////////////////////////////////////////////////
-void ESP8266WebServer::_prepareHeader(String& response, HTTPStatus code, const char* content_type, size_t contentLength) {
-	response = String(F("HTTP/1.")) + String(_currentVersion) + ' ';
-	response += String(code);
-	response += ' ';
-	response += _responseCodeToString(code);
-	response += "\r\n";
-
+void ESP8266WebServer::_prepareHeader(HTTPStatus code, const char* content_type, size_t contentLength) {
 	using namespace mime;
 	if (!content_type) {
 		content_type = mimeTable[html].mimeType;
 	}
 
-	sendHeader(String(F("Content-Type")), String(FPSTR(content_type)), true);
+	_responseHeaders.header(PSTR("Content-Type"), content_type, true);
 	if (_contentLength == CONTENT_LENGTH_NOT_SET) {
-		sendHeader(String(FPSTR(Content_Length)), String(contentLength));
+		_responseHeaders.header(Content_Length, contentLength);
 
 	} else if (_contentLength != CONTENT_LENGTH_UNKNOWN) {
-		sendHeader(String(FPSTR(Content_Length)), String(_contentLength));
+		_responseHeaders.header(Content_Length, _contentLength);
 
-	} else if(_contentLength == CONTENT_LENGTH_UNKNOWN && _currentVersion) { //HTTP/1.1 or above client
+	} else if(_contentLength == CONTENT_LENGTH_UNKNOWN && _current->version) { //HTTP/1.1 or above client
 		//let's do chunked
 		_chunked = true;
-		sendHeader(String(F("Accept-Ranges")),String(F("none")));
-		sendHeader(String(F("Transfer-Encoding")),String(F("chunked")));
+		_responseHeaders.header(PSTR("Transfer-Encoding"), PSTR("chunked"));
+
+	} else {
+		//HTTP/1.0 WITHOUT A LENGTH, THE BODY ENDS WHEN THE CONNECTION CLOSES
+		_current->keepAlive = false;
+	}
+
+	if (_current->keepAlive) {
+		char keepAlive[40];
+		sprintf(keepAlive, "timeout=%lu, max=%d", _keepAliveTimeout / 1000, _keepAliveMax - _current->requestCount);
+		_responseHeaders.header(PSTR("Connection"), PSTR("keep-alive"));
+		_responseHeaders.header(PSTR("Keep-Alive"), keepAlive);
+	} else {
+		_responseHeaders.header(PSTR("Connection"), PSTR("close"));
+	}
+
+	//STATUS LINE IN FRONT, BLANK LINE AT THE END
+	_responseHeaders.status(_current->version, code, _responseCodeToString(code));
+	_responseHeaders.append(PSTR("\r\n"), 2);
+}
+
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+// WRITE THE PREPARED RESPONSE HEAD AND THE FIRST PIECE OF BODY TO THE CLIENT
+// AS ONE WRITE, content IS IN FLASH WHEN progmem IS SET
+// AN EMPTY content SENDS NO CHUNK, SO A CHUNKED RESPONSE STAYS OPEN
+////////////////////////////////////////////////////////////////////////////////
+void ESP8266WebServer::_sendHeader(PGM_P content, size_t length, bool progmem) {
+	WriteSegment segments[4];
+	char chunkSize[11];
+	size_t count = 1;
+
+	segments[0] = { (const uint8_t*) _responseHeaders.data(), _responseHeaders.length(), false };
+	if (length) {
+		count += _contentSegments(segments + 1, chunkSize, content, length, progmem);
 	}
+	_currentClientWritev(segments, count);
+	_responseHeaders.reset();
+}
+
+
 
-	sendHeader(String(F("Connection")), String(F("close")));
 
-	response += _responseHeaders;
-	response += "\r\n";
-	_responseHeaders = "";
+////////////////////////////////////////////////////////////////////////////////
+// DESCRIBE A PIECE OF BODY, FRAMED AS A CHUNK WHEN THE RESPONSE IS CHUNKED
+// chunkSize HOLDS THE SIZE LINE AND HAS TO LIVE UNTIL THE WRITE, AN EMPTY
+// PIECE ENDS A CHUNKED RESPONSE. RETURNS THE NUMBER OF SEGMENTS, AT MOST 3
+////////////////////////////////////////////////////////////////////////////////
+size_t ESP8266WebServer::_contentSegments(WriteSegment *segments, char *chunkSize, PGM_P content, size_t length, bool progmem) {
+	if (!_chunked) {
+		segments[0] = { (const uint8_t*) content, length, progmem };
+		return 1;
+	}
+
+	if (length == 0) {
+		_chunked = false;
+	}
+	segments[0] = { (const uint8_t*) chunkSize, (size_t) sprintf(chunkSize, "%x\r\n", (unsigned) length), false };
+	segments[1] = { (const uint8_t*) content, length, progmem };
+	segments[2] = { (const uint8_t*) "\r\n", 2, false };
+	return 3;
 }
 
 
@@ -544,15 +675,11 @@ void ESP8266WebServer::_prepareHeader(String& response, HTTPStatus code, const c
 // ??
 ////////////////////////////////////////////////////////////////////////////////
 void ESP8266WebServer::send(HTTPStatus code, const char* content_type, const String& content) {
-	String header;
 	// Can we asume the following?
 	//if(code == HTTP_OK && content.length() == 0 && _contentLength == CONTENT_LENGTH_NOT_SET)
 	//  _contentLength = CONTENT_LENGTH_UNKNOWN;
-	_prepareHeader(header, code, content_type, content.length());
-	_currentClientWrite(header.c_str(), header.length());
-	if(content.length()) {
-		sendContent(content);
-	}
+	_prepareHeader(code, content_type, content.length());
+	_sendHeader(content.c_str(), content.length(), false);
 }
 
 
@@ -568,12 +695,7 @@ void ESP8266WebServer::send_P(HTTPStatus code, PGM_P content_type, PGM_P content
 		contentLength = strlen_P(content);
 	}
 
-	String header;
-	char type[64];
-	memccpy_P((void*)type, (PGM_VOID_P)content_type, 0, sizeof(type));
-	_prepareHeader(header, code, (const char* )type, contentLength);
-	_currentClientWrite(header.c_str(), header.length());
-	sendContent_P(content);
+	send_P(code, content_type, content, contentLength);
 }
 
 
@@ -583,12 +705,8 @@ void ESP8266WebServer::send_P(HTTPStatus code, PGM_P content_type, PGM_P content
 // ??
 ////////////////////////////////////////////////////////////////////////////////
 void ESP8266WebServer::send_P(HTTPStatus code, PGM_P content_type, PGM_P content, size_t contentLength) {
-	String header;
-	char type[64];
-	memccpy_P((void*)type, (PGM_VOID_P)content_type, 0, sizeof(type));
-	_prepareHeader(header, code, (const char* )type, contentLength);
-	sendContent(header);
-	sendContent_P(content, contentLength);
+	_prepareHeader(code, content_type, contentLength);
+	_sendHeader(content, contentLength, true);
 }
 
 
@@ -618,23 +736,9 @@ void ESP8266WebServer::send(HTTPStatus code, const String &content_type, const S
 // ??
 ////////////////////////////////////////////////////////////////////////////////
 void ESP8266WebServer::sendContent(const String& content) {
-	const char *footer = "\r\n";
-	size_t len = content.length();
-	if (_chunked) {
-		char * chunkSize = (char *)malloc(11);
-		if (chunkSize) {
-			sprintf(chunkSize, "%x%s", len, footer);
-			_currentClientWrite(chunkSize, strlen(chunkSize));
-			free(chunkSize);
-		}
-	}
-	_currentClientWrite(content.c_str(), len);
-	if (_chunked) {
-		_currentClient.write(footer, 2);
-		if (len == 0) {
-			_chunked = false;
-		}
-	}
+	WriteSegment segments[3];
+	char chunkSize[11];
+	_currentClientWritev(segments, _contentSegments(segments, chunkSize, content.c_str(), content.length(), false));
 }
 
 
@@ -654,22 +758,9 @@ void ESP8266WebServer::sendContent_P(PGM_P content) {
 // ??
 ////////////////////////////////////////////////////////////////////////////////
 void ESP8266WebServer::sendContent_P(PGM_P content, size_t size) {
-	const char *footer = "\r\n";
-	if (_chunked) {
-		char *chunkSize = (char*) malloc(11);
-		if (chunkSize) {
-			sprintf(chunkSize, "%x%s", size, footer);
-			_currentClientWrite(chunkSize, strlen(chunkSize));
-			free(chunkSize);
-		}
-	}
-	_currentClientWrite_P(content, size);
-	if (_chunked) {
-		_currentClient.write(footer, 2);
-		if (size == 0) {
-			_chunked = false;
-		}
-	}
+	WriteSegment segments[3];
+	char chunkSize[11];
+	_currentClientWritev(segments, _contentSegments(segments, chunkSize, content, size, true));
 }
 
 
@@ -679,15 +770,18 @@ void ESP8266WebServer::sendContent_P(PGM_P content, size_t size) {
 ////////////////////////////////////////////////////////////////////////////////
 // ??
 ////////////////////////////////////////////////////////////////////////////////
-void ESP8266WebServer::_streamFileCore(const size_t fileSize, const String & fileName, const String & contentType) {
+void ESP8266WebServer::_streamFileCore(const size_t fileSize, const String & fileName, const String & contentType, HTTPStatus code) {
 	using namespace mime;
 	setContentLength(fileSize);
-	if (fileName.endsWith(String(FPSTR(mimeTable[gz].endsWith))) &&
-			contentType != String(FPSTR(mimeTable[gz].mimeType)) &&
-			contentType != String(FPSTR(mimeTable[none].mimeType))) {
-		sendHeader(F("Content-Encoding"), F("gzip"));
+	size_t gzLength = strlen_P(mimeTable[gz].endsWith);
+	if (fileName.length() >= gzLength &&
+			strcmp_P(fileName.c_str() + fileName.length() - gzLength, mimeTable[gz].endsWith) == 0 &&
+			strcmp_P(contentType.c_str(), mimeTable[gz].mimeType) != 0 &&
+			strcmp_P(contentType.c_str(), mimeTable[none].mimeType) != 0) {
+		_responseHeaders.header(PSTR("Content-Encoding"), PSTR("gzip"));
 	}
-	send(HTTP_OK, contentType, "");
+	_prepareHeader(code, contentType.c_str(), 0);
+	_sendHeader(nullptr, 0, false);
 }
 
 
@@ -718,13 +812,13 @@ void ESP8266WebServer::onNotFound(THandlerFunction fn) {
 ////////////////////////////////////////////////////////////////////////////////
 void ESP8266WebServer::_handleRequest() {
 	bool handled = false;
-	if (!_handler){
+	if (!_current->handler){
 #		ifdef DEBUG_ESP_HTTP_SERVER
 			DEBUG_OUTPUT.println("request handler not found");
 #		endif
 	}
 	else {
-		handled = _handler->handle(*this, _method, _requestPath);
+		handled = _current->handler->handle(*this, _current->method, _current->requestPath);
 #		ifdef DEBUG_ESP_HTTP_SERVER
 			if (!handled) {
 				DEBUG_OUTPUT.println("request handler failed to handle request");
@@ -737,13 +831,12 @@ void ESP8266WebServer::_handleRequest() {
 	}
 	if (!handled) {
 		using namespace mime;
-		send(HTTP_NOT_FOUND, String(FPSTR(mimeTable[html].mimeType)), String(F("Not found: ")) + _requestPath);
+		send(HTTP_NOT_FOUND, String(FPSTR(mimeTable[html].mimeType)), String(F("Not found: ")) + _current->requestPath);
 		handled = true;
 	}
 	if (handled) {
 		_finalizeResponse();
 	}
-	_requestPath = "";
 }
 
 
@@ -764,56 +857,56 @@ void ESP8266WebServer::_finalizeResponse() {
 ////////////////////////////////////////////////////////////////////////////////
 // ??
 ////////////////////////////////////////////////////////////////////////////////
-String ESP8266WebServer::_responseCodeToString(HTTPStatus code) {
+PGM_P ESP8266WebServer::_responseCodeToString(HTTPStatus code) {
 	switch (code) {
-		case HTTP_CONTINUE:				return F("Continue");
-		case HTTP_SWITCH_PROTO:			return F("Switching Protocols");
-		case HTTP_OK:					return F("OK");
-		case HTTP_CREATED:				return F("Created");
-		case HTTP_ACCEPTED:				return F("Accepted");
-		case HTTP_NON_AUTH_INFO:		return F("Non-Authoritative Information");
-		case HTTP_NO_CONTENT:			return F("No Content");
-		case HTTP_RESET_CONTENT:		return F("Reset Content");
-		case HTTP_PARTIAL_CONTENT:		return F("Partial Content");
-		case HTTP_IM_USED:				return F("IM Used");
-		case HTTP_MULTIPLE_CHOICE:		return F("Multiple Choices");
-		case HTTP_MOVED_PERM:			return F("Moved Permanently");
-		case HTTP_FOUND:				return F("Found");
-		case HTTP_SEE_OTHER:			return F("See Other");
-		case HTTP_NOT_MODIFIED:			return F("Not Modified");
-		case HTTP_USE_PROXY:			return F("Use Proxy");
-		case HTTP_SWITCH_PROXY:			return F("Switch Proxy");
-		case HTTP_TEMP_REDIRECT:		return F("Temporary Redirect");
-		case HTTP_PERM_REDIRECT:		return F("Permanent Redirect");
-		case HTTP_BAD_REQUEST:			return F("Bad Request");
-		case HTTP_UNAUTHORIZED:			return F("Unauthorized");
-		case HTTP_PAYMENT_REQ:			return F("Payment Required");
-		case HTTP_FORBIDDEN:			return F("Forbidden");
-		case HTTP_NOT_FOUND:			return F("Not Found");
-		case HTTP_NOT_ALLOWED:			return F("Method Not Allowed");
-		case HTTP_NOT_ACCEPTABLE:		return F("Not Acceptable");
-		case HTTP_PROXY_AUTH_REQ:		return F("Proxy Authentication Required");
-		case HTTP_TIMEOUT:				return F("Request Timeout");
-		case HTTP_CONFLICT:				return F("Conflict");
-		case HTTP_GONE:					return F("Gone");
-		case HTTP_LENGTH_REQ:			return F("Length Required");
-		case HTTP_PRECON_FAIL:			return F("Precondition Failed");
-		case HTTP_PAYLOAD_LARGE:		return F("Payload Too Large");
-		case HTTP_URI_LARGE:			return F("URI Too Long");
-		case HTTP_UNSUPPORT_MEDIA:		return F("Unsupported Media Type");
-		case HTTP_RANGE_ERROR:			return F("Range Not Satisfiable");
-		case HTTP_EXPECATION_FAIL:		return F("Expectation Failed");
-		case HTTP_TEAPOT:				return F("I'm a teapot");
-		case HTTP_MISDIRECT_REQUEST:	return F("Misdirected Request");
-		case HTTP_TOO_MANY_REQUEST:		return F("Too Many Requests");
-		case HTTP_REQUEST_LARGE:		return F("Request Header Fields Too Large");
-		case HTTP_SERVER_ERROR:			return F("Internal Server Error");
-		case HTTP_NOT_IMPLEMENTED:		return F("Not Implemented");
-		case HTTP_BAD_GATEWAY:			return F("Bad Gateway");
-		case HTTP_UNAVAILABLE:			return F("Service Unavailable");
-		case HTTP_GATEWAY_TIMEOUT:		return F("Gateway Time-out");
-		case HTTP_VERSION_UNSUPPORTED:	return F("HTTP Version not supported");
+		case HTTP_CONTINUE:				return PSTR("Continue");
+		case HTTP_SWITCH_PROTO:			return PSTR("Switching Protocols");
+		case HTTP_OK:					return PSTR("OK");
+		case HTTP_CREATED:				return PSTR("Created");
+		case HTTP_ACCEPTED:				return PSTR("Accepted");
+		case HTTP_NON_AUTH_INFO:		return PSTR("Non-Authoritative Information");
+		case HTTP_NO_CONTENT:			return PSTR("No Content");
+		case HTTP_RESET_CONTENT:		return PSTR("Reset Content");
+		case HTTP_PARTIAL_CONTENT:		return PSTR("Partial Content");
+		case HTTP_IM_USED:				return PSTR("IM Used");
+		case HTTP_MULTIPLE_CHOICE:		return PSTR("Multiple Choices");
+		case HTTP_MOVED_PERM:			return PSTR("Moved Permanently");
+		case HTTP_FOUND:				return PSTR("Found");
+		case HTTP_SEE_OTHER:			return PSTR("See Other");
+		case HTTP_NOT_MODIFIED:			return PSTR("Not Modified");
+		case HTTP_USE_PROXY:			return PSTR("Use Proxy");
+		case HTTP_SWITCH_PROXY:			return PSTR("Switch Proxy");
+		case HTTP_TEMP_REDIRECT:		return PSTR("Temporary Redirect");
+		case HTTP_PERM_REDIRECT:		return PSTR("Permanent Redirect");
+		case HTTP_BAD_REQUEST:			return PSTR("Bad Request");
+		case HTTP_UNAUTHORIZED:			return PSTR("Unauthorized");
+		case HTTP_PAYMENT_REQ:			return PSTR("Payment Required");
+		case HTTP_FORBIDDEN:			return PSTR("Forbidden");
+		case HTTP_NOT_FOUND:			return PSTR("Not Found");
+		case HTTP_NOT_ALLOWED:			return PSTR("Method Not Allowed");
+		case HTTP_NOT_ACCEPTABLE:		return PSTR("Not Acceptable");
+		case HTTP_PROXY_AUTH_REQ:		return PSTR("Proxy Authentication Required");
+		case HTTP_TIMEOUT:				return PSTR("Request Timeout");
+		case HTTP_CONFLICT:				return PSTR("Conflict");
+		case HTTP_GONE:					return PSTR("Gone");
+		case HTTP_LENGTH_REQ:			return PSTR("Length Required");
+		case HTTP_PRECON_FAIL:			return PSTR("Precondition Failed");
+		case HTTP_PAYLOAD_LARGE:		return PSTR("Payload Too Large");
+		case HTTP_URI_LARGE:			return PSTR("URI Too Long");
+		case HTTP_UNSUPPORT_MEDIA:		return PSTR("Unsupported Media Type");
+		case HTTP_RANGE_ERROR:			return PSTR("Range Not Satisfiable");
+		case HTTP_EXPECATION_FAIL:		return PSTR("Expectation Failed");
+		case HTTP_TEAPOT:				return PSTR("I'm a teapot");
+		case HTTP_MISDIRECT_REQUEST:	return PSTR("Misdirected Request");
+		case HTTP_TOO_MANY_REQUEST:		return PSTR("Too Many Requests");
+		case HTTP_REQUEST_LARGE:		return PSTR("Request Header Fields Too Large");
+		case HTTP_SERVER_ERROR:			return PSTR("Internal Server Error");
+		case HTTP_NOT_IMPLEMENTED:		return PSTR("Not Implemented");
+		case HTTP_BAD_GATEWAY:			return PSTR("Bad Gateway");
+		case HTTP_UNAVAILABLE:			return PSTR("Service Unavailable");
+		case HTTP_GATEWAY_TIMEOUT:		return PSTR("Gateway Time-out");
+		case HTTP_VERSION_UNSUPPORTED:	return PSTR("HTTP Version not supported");
 	}
 
-	return F("");
+	return PSTR("");
 }
@@ -1,6 +1,6 @@
 /*
 	ESP8266WebServer.h - Dead simple web-server.
-	Supports only one simultaneous client, knows how to handle GET and POST.
+	Supports a small pool of simultaneous clients, knows how to handle GET and POST.
 
 	Copyright (c) 2014 Ivan Grokhotkov. All rights reserved.
 
@@ -31,8 +31,9 @@
 #include <ESP8266WiFi.h>
 
 #include "ESP8266WebServerHelper.h"
-#include "HTTPHeader.h"
-#include "HTTPParam.h"
+#include "HTTPConnection.h"
+#include "HTTPHeaderBuilder.h"
+#include "HTTPRouter.h"
 
 
 
@@ -52,6 +53,9 @@ public:
 	virtual void close();
 	void stop();
 
+	// PERSISTENT CONNECTIONS (HTTP KEEP-ALIVE), TIMEOUT OF 0 DISABLES THEM
+	void setKeepAlive(unsigned long timeout, uint16_t maxRequests=HTTP_MAX_KEEPALIVE_REQUESTS);
+
 	bool authenticate(const char *username, const char *password);
 
 	void requestAuthentication(	HTTPAuthMethod mode=BASIC_AUTH,
@@ -63,14 +67,14 @@ public:
 	void on(const String &uri, HTTPMethod method, THandlerFunction fn);
 	void on(const String &uri, HTTPMethod method, THandlerFunction fn, THandlerFunction ufn);
 	void addHandler(RequestHandler* handler);
-	void serveStatic(const char* uri, fs::FS& fs, const char* path, const char* cache_header=NULL);
+	void serveStatic(const char* uri, fs::FS& fs, const char* path, const char* cache_header=NULL, const char* last_modified=NULL);
 	void onNotFound(THandlerFunction fn);  //called when handler is not assigned
 	void onFileUpload(THandlerFunction fn); //handle file uploads
 
-	const char *uri() const				{ return _requestPath; }
-	HTTPMethod method() const			{ return _method; }
-	virtual WiFiClient client() const	{ return _currentClient; }
-	HTTPUpload& upload() const			{ return *_currentUpload; }
+	const char *uri() const				{ return _current->requestPath; }
+	HTTPMethod method() const			{ return _current->method; }
+	virtual WiFiClient client() const	{ return _current->client; }
+	HTTPUpload& upload() const			{ return *_current->body.upload(); }
 
 
 
@@ -81,42 +85,42 @@ public:
 
 	// GET ARGUMENTS COUNT
 	inline int args() const {
-		return _params.total();
+		return _current->params.total();
 	}
 
 
 	// GET REQUEST ARGUMENT VALUE BY NAME
 	inline const char *arg(const char *name) const {
-		return _params.value(name);
+		return _current->params.value(name);
 	}
 
 	inline String arg(String name) const {
-		return _params.value(name);
+		return _current->params.value(name);
 	}
 
 
 
 	// GET REQUEST ARGUMENT VALUE BY NUMBER
 	inline const char *arg(int i) const {
-		return _params.value(i);
+		return _current->params.value(i);
 	}
 
 
 
 	// GET REQUEST ARGUMENT NAME BY NUMBER
 	inline const char *argName(int i) const {
-		return _params.key(i);
+		return _current->params.key(i);
 	}
 
 
 
 	// CHECK IF ARGUMENT EXISTS
 	inline bool hasArg(const char *name) const {
-		return _params.has(name);
+		return _current->params.has(name);
 	}
 
 	inline bool hasArg(String name) const {
-		return _params.has(name);
+		return _current->params.has(name);
 	}
 
 
@@ -128,43 +132,43 @@ public:
 
 	// GET HEADER COUNT
 	inline int headers() const {
-		return _headers.total();
+		return _current->headers.total();
 	}
 
 
 
 	// GET REQUEST HEADER VALUE BY NAME
 	inline const char *header(const char *name) const {
-		return _headers.value(name);
+		return _current->headers.value(name);
 	}
 
 	inline String header(String name) const {
-		return _headers.value(name);
+		return _current->headers.value(name);
 	}
 
 
 
 	// GET REQUEST HEADER VALUE BY NUMBER
 	inline const char *header(int id) const {
-		return _headers.value(id);
+		return _current->headers.value(id);
 	}
 
 
 
 	// GET REQUEST HEADER NAME BY NUMBER
 	inline const char *headerName(int id) const {
-		return _headers.key(id);
+		return _current->headers.key(id);
 	}
 
 
 
 	// CHECK IF HEADER EXISTS
 	inline bool hasHeader(const char *name) const {
-		return _headers.has(name);
+		return _current->headers.has(name);
 	}
 
 	inline bool hasHeader(String name) const {
-		return _headers.has(name);
+		return _current->headers.has(name);
 	}
 
 
@@ -185,15 +189,16 @@ public:
 
 	void setContentLength(const size_t contentLength);
 	void sendHeader(const String& name, const String& value, bool first = false);
+	void sendHeader(const char* name, const char* value, bool first = false);
 	void sendContent(const String& content);
 	void sendContent_P(PGM_P content);
 	void sendContent_P(PGM_P content, size_t size);
 
 
 	template<typename T>
-	size_t streamFile(T &file, const String& contentType) {
-		_streamFileCore(file.size(), file.name(), contentType);
-		return _currentClient.write(file);
+	size_t streamFile(T &file, const String& contentType, HTTPStatus code = HTTP_OK) {
+		_streamFileCore(file.size(), file.name(), contentType, code);
+		return _current->client.write(file);
 	}
 
 
@@ -204,11 +209,15 @@ public:
 
 protected:
 	virtual size_t _currentClientWrite(const char* b, size_t l) {
-		return _currentClient.write( b, l );
+		return _current->client.write( b, l );
 	}
 
 	virtual size_t _currentClientWrite_P(PGM_P b, size_t l) {
-		return _currentClient.write_P( b, l );
+		return _current->client.write_P( b, l );
+	}
+
+	virtual size_t _currentClientWritev(const WriteSegment* s, size_t n) {
+		return _current->client.writev( s, n );
 	}
 
 
@@ -216,12 +225,16 @@ protected:
 	void _handleRequest();
 	void _finalizeResponse();
 	HTTPStatus _parseRequest(WiFiClient& client);
-	static String _responseCodeToString(HTTPStatus code);
+	bool _handleConnection(HTTPConnection &connection);
+	HTTPConnection *_freeConnection();
+	static PGM_P _responseCodeToString(HTTPStatus code);
 
 	//THIS IS A RESPONSE HEADER, NOT A REQUEST HEADER
-	void _prepareHeader(String& response, HTTPStatus code, const char* content_type, size_t contentLength);
+	void _prepareHeader(HTTPStatus code, const char* content_type, size_t contentLength);
+	void _sendHeader(PGM_P content, size_t length, bool progmem);
+	size_t _contentSegments(WriteSegment *segments, char *chunkSize, PGM_P content, size_t length, bool progmem);
 
-	void _streamFileCore(const size_t fileSize, const String & fileName, const String & contentType);
+	void _streamFileCore(const size_t fileSize, const String & fileName, const String & contentType, HTTPStatus code = HTTP_OK);
 
 	String _getRandomHexString();
 	// for extracting Auth parameters
@@ -229,13 +242,14 @@ protected:
 
 
 
-	void resetRequest();
+	void resetRequest(bool pipeline=false);
 
 
 
 private:
 	HTTPStatus	_readStream(WiFiClient &client);
-	HTTPStatus	_parseVersion(char *buffer);
+	HTTPStatus	_readBody(WiFiClient &client);
+	HTTPStatus	_parseHeaders();
 	HTTPMethod	_parseMethod(const char *method);
 
 
@@ -246,58 +260,33 @@ protected:
 	////////////////////////////////////////////////////////////////////////////
 
 
-	// BUFFER IS THE SINGLE ALLOCATED BUFFER _request
-	// METHOD, PATH, AND VERSIONS ARE ALL POINTERS WITHIN THE SINGLE ALLOCATED BUFFER
-	char *_requestMethod;
-	char *_requestPath;
-	char *_requestParams;
-	char *_requestVersion;
-	char *_requestPayload;
-
-
 	int _statusCode;
 
 	WiFiServer  _server;
 
-	WiFiClient  _currentClient;
-	HTTPMethod  _method;
-	uint8_t     _currentVersion;
-	HTTPClientStatus _currentStatus;
-	unsigned long _statusChange;
+	//POOL OF CLIENT CONNECTIONS, _current IS THE ONE BEING SERVICED RIGHT NOW
+	HTTPConnection   _connections[HTTP_MAX_CLIENTS];
+	HTTPConnection  *_current;
+	uint8_t          _nextConnection;
 
-	RequestHandler*  _handler;
 	RequestHandler*  _firstHandler;
 	RequestHandler*  _lastHandler;
+	HTTPRouter       _router;  //INDEX OF THE HANDLERS ABOVE, BUILT IN begin()
 	THandlerFunction _notFoundHandler;
 	THandlerFunction _fileUploadHandler;
 
-	std::unique_ptr<HTTPUpload> _currentUpload;
-
 	size_t           _contentLength;
-	String           _responseHeaders;
+	HTTPHeaderBuilder _responseHeaders;
 
 	bool             _chunked;
 
+	//PERSISTENT CONNECTION SETTINGS
+	unsigned long    _keepAliveTimeout;
+	uint16_t         _keepAliveMax;
+
 	String           _snonce;  // Store noance and opaque for future comparison
 	String           _sopaque;
 	String           _srealm;  // Store the Auth realm between Calls
-
-
-	//HANDLE THE READ TIMEOUT
-	unsigned long	_readTimeout;
-	int				_readBytes;
-
-
-	//STORE POINTERS INTO RAW BUFFER FOR EACH HEADER KEY/VALUE
-	HTTPHeader		_headers;
-
-	//STORE POINTERS INTO RAW BUFFER FOR EACH GET/POST KEY/VALUE
-	HTTPParam		_params;
-
-private:
-
-	//RAW BINARY BUFFER FROM CLIENT
-	char			*_request;
 };
 
 
@@ -130,10 +130,54 @@ enum HTTPAuthMethod {
 
 
 
+//NUMBER OF CLIENTS SERVED IN PARALLEL, EACH ONE HOLDS ITS OWN REQUEST BUFFER
+#ifndef HTTP_MAX_CLIENTS
+#define HTTP_MAX_CLIENTS 4
+#endif
+
+
+
+//PER-SECTION LIMITS OF AN INCOMING REQUEST
+#ifndef HTTP_MAX_REQUEST_LINE
+#define HTTP_MAX_REQUEST_LINE 1024 //bytes in "METHOD /path?params HTTP/1.1", else 414
+#endif
+
+#ifndef HTTP_MAX_HEADER_SIZE
+#define HTTP_MAX_HEADER_SIZE 4096 //bytes in the request line and all headers, else 431
+#endif
+
+#ifndef HTTP_MAX_HEADERS
+#define HTTP_MAX_HEADERS 32 //header lines in one request, else 431
+#endif
+
+#define HTTP_REQUEST_BUFLEN 256 //initial request buffer, doubled while headers arrive
+
+
+
+//STATUS LINE AND HEADERS OF A RESPONSE, ALLOCATED ONCE AND REUSED
+//BODIES THAT FIT BEHIND THE HEADERS ARE SENT IN THE SAME TCP SEGMENT
+#ifndef HTTP_RESPONSE_BUFLEN
+#define HTTP_RESPONSE_BUFLEN HTTP_DOWNLOAD_UNIT_SIZE
+#endif
+
+
+
+//REQUEST PAYLOADS ARE STREAMED, NEVER BUFFERED AS A WHOLE
+#ifndef HTTP_MAX_FORM_SIZE
+#define HTTP_MAX_FORM_SIZE 4096 //decoded bytes of all form fields in a payload, else 413
+#endif
+
+#define HTTP_MAX_BOUNDARY 70 //longest multipart boundary allowed by RFC 2046
+#define HTTP_BODY_CHUNK 256 //payload bytes read from the client at a time
+
+
+
 #define HTTP_MAX_DATA_WAIT	5000 //ms to wait for the client to send the request
 #define HTTP_MAX_POST_WAIT	5000 //ms to wait for POST data to arrive
 #define HTTP_MAX_SEND_WAIT	5000 //ms to wait for data chunk to be ACKed
 #define HTTP_MAX_CLOSE_WAIT	2000 //ms to wait for the client to close the connection
+#define HTTP_MAX_KEEPALIVE_WAIT	2000 //ms to wait for the next request on a persistent connection
+#define HTTP_MAX_KEEPALIVE_REQUESTS	100 //requests served on one persistent connection before closing it
 
 
 
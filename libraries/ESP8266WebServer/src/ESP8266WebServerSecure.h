@@ -45,6 +45,7 @@ public:
 private:
   size_t _currentClientWrite (const char *bytes, size_t len) override { return _currentClientSecure.write((const uint8_t *)bytes, len); }
   size_t _currentClientWrite_P (PGM_P bytes, size_t len) override { return _currentClientSecure.write_P(bytes, len); }
+  size_t _currentClientWritev (const WriteSegment *segments, size_t count) override { return _currentClientSecure.writev(segments, count); }
 
 protected:
   WiFiServerSecure _serverSecure;
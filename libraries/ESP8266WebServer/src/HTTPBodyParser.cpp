@@ -0,0 +1,721 @@
+#include <Arduino.h>
+#include "HTTPBodyParser.h"
+
+
+
+static_assert(HTTP_MAX_BOUNDARY < 0xFF - 4, "delimiter length is stored in 8 bits");
+
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+// CHECK THE MEDIA TYPE OF A Content-Type VALUE, IGNORING ITS PARAMETERS
+// EX: "multipart/form-data; boundary=xyz" IS "multipart/form-data"
+////////////////////////////////////////////////////////////////////////////////
+static bool _isType(const char *contentType, PGM_P type) {
+	size_t length = strlen_P(type);
+	if (strncasecmp_P(contentType, type, length)) return false;
+
+	char end = contentType[length];
+	return end == '\0'  ||  end == ';'  ||  end == ' '  ||  end == '\t';
+}
+
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+// SPLIT THE NEXT "key=value" OR "key="quoted value"" OFF A HEADER VALUE
+// TERMINATES BOTH IN PLACE AND RETURNS WHERE TO CONTINUE, OR NULL AT THE END
+////////////////////////////////////////////////////////////////////////////////
+static char *_nextParam(char *p, const char **key, const char **value) {
+	while (*p == ';'  ||  *p == ' '  ||  *p == '\t') p++;
+	if (!*p) return nullptr;
+
+	*key	= p;
+	*value	= "";
+	p		+= strcspn(p, "=;");
+
+	if (*p == '=') {
+		*p++ = '\0';
+
+		if (*p == '"') {
+			*value	= ++p;
+			p		+= strcspn(p, "\"");
+		} else {
+			*value	= p;
+			p		+= strcspn(p, "; \t");
+		}
+	}
+
+	if (*p) *p++ = '\0';
+	return p;
+}
+
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+// CONSTRUCTOR
+////////////////////////////////////////////////////////////////////////////////
+HTTPBodyParser::HTTPBodyParser() {
+	_form		= nullptr;
+	_uploading	= false;
+	reset();
+}
+
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+// DESTRUCTOR - FREES MEMORY WITHOUT CALLING BACK
+////////////////////////////////////////////////////////////////////////////////
+HTTPBodyParser::~HTTPBodyParser() {
+	_callback = nullptr;
+	reset();
+}
+
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+// ABORT AN UNFINISHED UPLOAD AND FREE ALL MEMORY
+////////////////////////////////////////////////////////////////////////////////
+void HTTPBodyParser::reset() {
+	_uploadAbort();
+	_upload.reset();
+	_callback			= nullptr;
+
+	free(_form);
+	_form				= nullptr;
+	_formLength			= 0;
+	_formCapacity		= 0;
+	_fields				= 0;
+
+	_type				= TYPE_NONE;
+	_state				= STATE_PREAMBLE;
+	_error				= HTTP_OK;
+	_remaining			= 0;
+	_file				= false;
+	_delimiter[0]		= '\0';
+	_delimiterLength	= 0;
+	_match				= 0;
+	_line				= 0;
+	_formValue			= false;
+	_pairLength			= 0;
+	_hexDigits			= 0;
+	_hexValue			= 0;
+	_hexFirst			= '\0';
+}
+
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+// GET READY FOR A PAYLOAD OF contentLength BYTES OF contentType
+////////////////////////////////////////////////////////////////////////////////
+HTTPStatus HTTPBodyParser::begin(const char *contentType, int contentLength, TUploadFunction upload) {
+	reset();
+
+	_remaining	= contentLength > 0 ? contentLength : 0;
+	_callback	= upload;
+
+	if (!_remaining) {
+		return HTTP_OK;
+	}
+
+
+	//FORM FIELDS, ALSO THE DEFAULT FOR CLIENTS THAT SEND NO TYPE
+	if (!contentType  ||  !*contentType  ||  _isType(contentType, PSTR("application/x-www-form-urlencoded"))) {
+		_type = TYPE_FORM;
+		return HTTP_OK;
+	}
+
+
+	//FORM FIELDS AND FILES SEPARATED BY A BOUNDARY
+	if (_isType(contentType, PSTR("multipart/form-data"))) {
+		_type = TYPE_MULTIPART;
+
+		const char *boundary = nullptr;
+		for (const char *p=contentType; *p; p++) {
+			if (!strncasecmp_P(p, PSTR("boundary="), 9)) {
+				boundary = p + 9;
+				break;
+			}
+		}
+		if (!boundary) return _fail(HTTP_BAD_REQUEST);
+
+		size_t length;
+		if (*boundary == '"') {
+			boundary++;
+			length = strcspn(boundary, "\"");
+		} else {
+			length = strcspn(boundary, "; \t");
+		}
+		if (length < 1  ||  length > HTTP_MAX_BOUNDARY) return _fail(HTTP_BAD_REQUEST);
+
+		//THE PAYLOAD MAY START WITH "--boundary", SO PRETEND ITS CRLF WAS SEEN
+		memcpy(_delimiter, "\r\n--", 4);
+		memcpy(_delimiter + 4, boundary, length);
+		_delimiterLength			= 4 + length;
+		_delimiter[_delimiterLength]= '\0';
+		_match						= 2;
+
+		//PART HEADERS ARE COLLECTED IN THE UPLOAD BUFFER
+		if (!_uploadBegin()) return _fail(HTTP_PAYLOAD_LARGE);
+		return HTTP_OK;
+	}
+
+
+	//ANYTHING ELSE IS HANDED TO THE UPLOAD HANDLER AS IS
+	_type = TYPE_RAW;
+	if (_callback) {
+		if (!_uploadBegin()) return _fail(HTTP_PAYLOAD_LARGE);
+		_upload->type = contentType;
+		_uploadStart();
+	}
+
+	return HTTP_OK;
+}
+
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+// CONSUME THE NEXT length BYTES OF THE PAYLOAD
+////////////////////////////////////////////////////////////////////////////////
+HTTPStatus HTTPBodyParser::parse(const char *data, int length) {
+	if (_state == STATE_FAILED) return _error;
+
+	if (length > _remaining) length = _remaining;
+	_remaining -= length;
+
+	HTTPStatus code = HTTP_OK;
+
+	switch (_type) {
+		case TYPE_RAW:
+			if (_uploading) _uploadWrite(data, length);
+		break;
+
+		case TYPE_FORM:
+			code = _parseForm(data, length);
+		break;
+
+		case TYPE_MULTIPART:
+			code = _parseMultipart(data, length);
+		break;
+
+		default:
+		break;
+	}
+
+	if (code != HTTP_OK) return _fail(code);
+	if (_remaining) return HTTP_CONTINUE;
+
+
+	//THE WHOLE PAYLOAD WAS SEEN
+	switch (_type) {
+		case TYPE_RAW:
+			if (_uploading) _uploadEnd();
+		break;
+
+		case TYPE_FORM:
+			code = _endForm();
+		break;
+
+		case TYPE_MULTIPART:
+			//NO CLOSING BOUNDARY, THE PAYLOAD WAS CUT SHORT
+			if (_state != STATE_EPILOGUE) code = HTTP_BAD_REQUEST;
+		break;
+
+		default:
+		break;
+	}
+
+	if (code != HTTP_OK) return _fail(code);
+	return HTTP_OK;
+}
+
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+// APPEND THE DECODED FORM FIELDS TO list
+////////////////////////////////////////////////////////////////////////////////
+void HTTPBodyParser::params(HTTPParam &list) const {
+	if (!_fields) return;
+
+	auto id = list.total();
+	list.allocate(_fields, false);
+
+	const char *field = _form;
+	for (auto i=0; i<_fields; i++) {
+		const char *key		= field;
+		field				+= strlen(field) + 1;
+		const char *value	= field;
+		field				+= strlen(field) + 1;
+
+		list.set(id + i, key, value);
+	}
+}
+
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+// STOP PARSING, EVERY FURTHER CALL RETURNS THE SAME ERROR
+////////////////////////////////////////////////////////////////////////////////
+HTTPStatus HTTPBodyParser::_fail(HTTPStatus status) {
+	_uploadAbort();
+	_state = STATE_FAILED;
+	_error = status;
+	return status;
+}
+
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+// DECODE application/x-www-form-urlencoded AS IT ARRIVES
+// AN ESCAPE OR A PAIR MAY BE SPLIT ACROSS ANY TWO CHUNKS
+////////////////////////////////////////////////////////////////////////////////
+HTTPStatus HTTPBodyParser::_parseForm(const char *data, int length) {
+	for (auto i=0; i<length; i++) {
+		char c = data[i];
+		HTTPStatus code;
+
+		//HEX DIGITS OF A %XX ESCAPE
+		if (_hexDigits) {
+			int8_t nibble = -1;
+			if (c >= '0'  &&  c <= '9') nibble = c - '0';
+			else if (c >= 'a'  &&  c <= 'f') nibble = c - 'a' + 10;
+			else if (c >= 'A'  &&  c <= 'F') nibble = c - 'A' + 10;
+
+			if (nibble >= 0) {
+				_hexValue = (_hexValue << 4) | nibble;
+				_hexFirst = c;
+				if (--_hexDigits) continue;
+
+				//A DECODED NULL WOULD CUT THE FIELD SHORT
+				c		= _hexValue ? (char) _hexValue : ' ';
+				code	= _formAppend(&c, 1);
+				if (code != HTTP_OK) return code;
+				continue;
+			}
+
+			//NOT AN ESCAPE AFTER ALL, THIS CHARACTER IS DECODED AS USUAL
+			code = _endEscape();
+			if (code != HTTP_OK) return code;
+		}
+
+		switch (c) {
+			case '&':
+				code = _endForm();
+			break;
+
+			case '%':
+				_hexDigits	= 2;
+				_hexValue	= 0;
+				code		= HTTP_OK;
+			break;
+
+			case '+':
+				c		= ' ';
+				code	= _formAppend(&c, 1);
+			break;
+
+			case '=':
+				if (!_formValue) {
+					_formValue	= true;
+					code		= _formAppend("", 1);
+					break;
+				}
+				//FALL THROUGH
+
+			default:
+				code = _formAppend(&c, 1);
+		}
+
+		if (code != HTTP_OK) return code;
+	}
+
+	return HTTP_OK;
+}
+
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+// TERMINATE THE FORM FIELD BEING DECODED, EMPTY PAIRS ("a=1&&b=2") ARE SKIPPED
+////////////////////////////////////////////////////////////////////////////////
+HTTPStatus HTTPBodyParser::_endForm() {
+	auto code = _endEscape();
+	if (code != HTTP_OK) return code;
+
+	bool empty	= !_pairLength  &&  !_formValue;
+	bool value	= _formValue;
+
+	_formValue	= false;
+
+	if (empty) return HTTP_OK;
+
+	//A KEY WITHOUT '=' GETS AN EMPTY VALUE
+	code = _formAppend("\0", value ? 1 : 2);
+	if (code != HTTP_OK) return code;
+
+	_pairLength = 0;
+	_fields++;
+	return HTTP_OK;
+}
+
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+// AN UNFINISHED OR INVALID %XX ESCAPE IS KEPT LITERALLY ("100%" OR "%zz")
+////////////////////////////////////////////////////////////////////////////////
+HTTPStatus HTTPBodyParser::_endEscape() {
+	if (!_hexDigits) return HTTP_OK;
+
+	const char literal[] = { '%', _hexFirst };
+	int length = _hexDigits == 2 ? 1 : 2;
+
+	_hexDigits = 0;
+	return _formAppend(literal, length);
+}
+
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+// SPLIT multipart/form-data INTO PARTS AS IT ARRIVES
+// THE DELIMITER MAY BE SPLIT ACROSS ANY TWO CHUNKS, SO ONLY THE MATCH LENGTH IS
+// KEPT. IT IS THE ONLY PLACE A CR CAN START A DELIMITER, SO A FAILED PARTIAL
+// MATCH IS ALWAYS PLAIN PART DATA
+////////////////////////////////////////////////////////////////////////////////
+HTTPStatus HTTPBodyParser::_parseMultipart(const char *data, int length) {
+	HTTPStatus code = HTTP_OK;
+
+	while (length > 0) {
+		char c = *data;
+
+		switch (_state) {
+			case STATE_PREAMBLE:
+			case STATE_PART_DATA:
+				if (c == _delimiter[_match]) {
+					data++;
+					length--;
+
+					if (++_match < _delimiterLength) break;
+
+					_match = 0;
+					if (_state == STATE_PART_DATA) {
+						code = _partEnd();
+					}
+					_state = STATE_BOUNDARY_END;
+
+				//A PARTIAL MATCH WAS PART DATA AFTER ALL, c MAY START A NEW ONE
+				} else if (_match) {
+					if (_state == STATE_PART_DATA) {
+						code = _partData(_delimiter, _match);
+					}
+					_match = 0;
+
+				//EVERYTHING UP TO THE NEXT CR IS PART DATA
+				} else {
+					const char *cr	= (const char*) memchr(data, '\r', length);
+					int run			= cr ? cr - data : length;
+
+					if (_state == STATE_PART_DATA) {
+						code = _partData(data, run);
+					}
+
+					data	+= run;
+					length	-= run;
+				}
+			break;
+
+
+			//"--" ENDS THE PAYLOAD, CRLF STARTS ANOTHER PART
+			case STATE_BOUNDARY_END:
+				data++;
+				length--;
+
+				if (c == '-') {
+					_state = STATE_BOUNDARY_DASH;
+				} else if (c == '\r') {
+					_state = STATE_BOUNDARY_LF;
+				} else if (c != ' '  &&  c != '\t') {
+					code = HTTP_BAD_REQUEST;
+				}
+			break;
+
+
+			case STATE_BOUNDARY_DASH:
+				data++;
+				length--;
+
+				if (c != '-') code = HTTP_BAD_REQUEST;
+				_state = STATE_EPILOGUE;
+			break;
+
+
+			case STATE_BOUNDARY_LF:
+				data++;
+				length--;
+
+				if (c != '\n') code = HTTP_BAD_REQUEST;
+				_state				= STATE_PART_HEADER;
+				_line				= 0;
+				_file				= false;
+				_upload->name		= "";
+				_upload->filename	= "";
+				_upload->type		= "";
+			break;
+
+
+			//PART HEADERS, ONE LINE AT A TIME, UNTIL AN EMPTY LINE
+			case STATE_PART_HEADER:
+				data++;
+				length--;
+
+				if (c == '\r') break;
+
+				if (c == '\n') {
+					if (_line) {
+						_upload->buf[_line] = '\0';
+						code	= _partHeader((char*) _upload->buf);
+						_line	= 0;
+					} else {
+						code	= _partBegin();
+						_state	= STATE_PART_DATA;
+					}
+
+				} else if (_line < HTTP_UPLOAD_BUFLEN - 1) {
+					_upload->buf[_line++] = c;
+
+				} else {
+					code = HTTP_REQUEST_LARGE;
+				}
+			break;
+
+
+			//ANYTHING AFTER THE CLOSING DELIMITER IS IGNORED
+			default:
+				data	+= length;
+				length	= 0;
+			break;
+		}
+
+		if (code != HTTP_OK) return code;
+	}
+
+	return HTTP_OK;
+}
+
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+// REMEMBER WHAT A PART HEADER SAYS ABOUT THE PART
+// EX: Content-Disposition: form-data; name="firmware"; filename="app.bin"
+////////////////////////////////////////////////////////////////////////////////
+HTTPStatus HTTPBodyParser::_partHeader(char *line) {
+	char *value = strchr(line, ':');
+	if (!value) return HTTP_BAD_REQUEST;
+
+	*value++ = '\0';
+	while (*value == ' '  ||  *value == '\t') value++;
+
+	if (!strcasecmp_P(line, PSTR("Content-Disposition"))) {
+		const char *key;
+		const char *param;
+
+		while ((value = _nextParam(value, &key, &param))) {
+			if (!strcasecmp_P(key, PSTR("name"))) {
+				_upload->name = param;
+
+			} else if (!strcasecmp_P(key, PSTR("filename"))) {
+				_upload->filename	= param;
+				_file				= true;
+			}
+		}
+
+	} else if (!strcasecmp_P(line, PSTR("Content-Type"))) {
+		_upload->type = value;
+	}
+
+	return HTTP_OK;
+}
+
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+// PART HEADERS ARE DONE, THE PART DATA FOLLOWS
+////////////////////////////////////////////////////////////////////////////////
+HTTPStatus HTTPBodyParser::_partBegin() {
+	if (_file) {
+		if (_callback) _uploadStart();
+		return HTTP_OK;
+	}
+
+	//FORM FIELD, ITS NAME IS STORED NOW AND ITS VALUE AS IT ARRIVES
+	return _formAppend(_upload->name.c_str(), _upload->name.length() + 1);
+}
+
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+// DATA OF THE CURRENT PART
+////////////////////////////////////////////////////////////////////////////////
+HTTPStatus HTTPBodyParser::_partData(const char *data, int length) {
+	if (_file) {
+		if (_uploading) _uploadWrite(data, length);
+		return HTTP_OK;
+	}
+
+	int start	= _formLength;
+	auto code	= _formAppend(data, length);
+	if (code != HTTP_OK) return code;
+
+	//A NULL BYTE WOULD CUT THE FIELD SHORT
+	for (auto i=start; i<_formLength; i++) {
+		if (!_form[i]) _form[i] = ' ';
+	}
+
+	return HTTP_OK;
+}
+
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+// THE DELIMITER ENDED THE CURRENT PART
+////////////////////////////////////////////////////////////////////////////////
+HTTPStatus HTTPBodyParser::_partEnd() {
+	if (_file) {
+		if (_uploading) _uploadEnd();
+		return HTTP_OK;
+	}
+
+	auto code = _formAppend("", 1);
+	if (code == HTTP_OK) _fields++;
+	return code;
+}
+
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+// ALLOCATE THE UPLOAD AND ITS BUFFER, ONCE PER PAYLOAD
+////////////////////////////////////////////////////////////////////////////////
+bool HTTPBodyParser::_uploadBegin() {
+	if (!_upload) {
+		_upload.reset(new HTTPUpload());
+	}
+	return !!_upload;
+}
+
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+// UPLOAD_FILE_START
+////////////////////////////////////////////////////////////////////////////////
+void HTTPBodyParser::_uploadStart() {
+	_upload->status			= UPLOAD_FILE_START;
+	_upload->totalSize		= 0;
+	_upload->currentSize	= 0;
+	_uploading				= true;
+	_callback(*_upload);
+}
+
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+// FILL THE UPLOAD BUFFER, UPLOAD_FILE_WRITE EACH TIME IT IS FULL
+////////////////////////////////////////////////////////////////////////////////
+void HTTPBodyParser::_uploadWrite(const char *data, int length) {
+	while (length > 0) {
+		if (_upload->currentSize == HTTP_UPLOAD_BUFLEN) {
+			_upload->status			= UPLOAD_FILE_WRITE;
+			_callback(*_upload);
+			_upload->totalSize		+= _upload->currentSize;
+			_upload->currentSize	= 0;
+		}
+
+		size_t size = min((size_t) length, HTTP_UPLOAD_BUFLEN - _upload->currentSize);
+		memcpy(_upload->buf + _upload->currentSize, data, size);
+
+		_upload->currentSize	+= size;
+		data					+= size;
+		length					-= size;
+	}
+}
+
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+// FLUSH WHAT IS LEFT IN THE BUFFER, THEN UPLOAD_FILE_END
+////////////////////////////////////////////////////////////////////////////////
+void HTTPBodyParser::_uploadEnd() {
+	if (_upload->currentSize) {
+		_upload->status			= UPLOAD_FILE_WRITE;
+		_callback(*_upload);
+		_upload->totalSize		+= _upload->currentSize;
+		_upload->currentSize	= 0;
+	}
+
+	_upload->status	= UPLOAD_FILE_END;
+	_uploading		= false;
+	_callback(*_upload);
+}
+
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+// UPLOAD_FILE_ABORTED, IF AN UPLOAD IS UNDER WAY
+////////////////////////////////////////////////////////////////////////////////
+void HTTPBodyParser::_uploadAbort() {
+	if (!_uploading) return;
+
+	_uploading				= false;
+	_upload->status			= UPLOAD_FILE_ABORTED;
+	_upload->currentSize	= 0;
+	if (_callback) _callback(*_upload);
+}
+
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+// APPEND DECODED BYTES TO THE FORM FIELD STORE
+// IT GROWS BY DOUBLING, UP TO HTTP_MAX_FORM_SIZE
+////////////////////////////////////////////////////////////////////////////////
+HTTPStatus HTTPBodyParser::_formAppend(const char *data, int length) {
+	int needed = _formLength + length;
+
+	if (needed > _formCapacity) {
+		if (needed > HTTP_MAX_FORM_SIZE) return HTTP_PAYLOAD_LARGE;
+
+		int capacity = max(_formCapacity, 64);
+		while (capacity < needed) capacity *= 2;
+		capacity = min(capacity, HTTP_MAX_FORM_SIZE);
+
+		char *form = (char*) realloc(_form, capacity);
+		if (!form) return HTTP_PAYLOAD_LARGE;
+
+		_form			= form;
+		_formCapacity	= capacity;
+	}
+
+	memcpy(_form + _formLength, data, length);
+	_formLength	+= length;
+	_pairLength	+= length;
+
+	return HTTP_OK;
+}
@@ -0,0 +1,168 @@
+#ifndef __HTTP_BODY_PARSER_H__
+#define __HTTP_BODY_PARSER_H__
+
+
+
+
+#include <functional>
+#include <memory>
+
+#include "ESP8266WebServerHelper.h"
+#include "HTTPParam.h"
+
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+// STREAMING REQUEST PAYLOAD PARSER
+// THE PAYLOAD IS FED IN WHATEVER CHUNKS THE NETWORK DELIVERS AND NEVER BUFFERED
+// AS A WHOLE. FORM FIELDS ARE DECODED INTO A SMALL BOUNDED STORE, FILE PARTS
+// AND RAW PAYLOADS ARE HANDED TO THE UPLOAD CALLBACK HTTP_UPLOAD_BUFLEN BYTES
+// AT A TIME, SO PEAK RAM DOES NOT DEPEND ON THE SIZE OF THE PAYLOAD
+////////////////////////////////////////////////////////////////////////////////
+class HTTPBodyParser {
+	public:
+	typedef std::function<void(HTTPUpload&)> TUploadFunction;
+
+
+
+	////////////////////////////////////////////////////////////////////////////
+	// CONSTRUCTOR
+	////////////////////////////////////////////////////////////////////////////
+	HTTPBodyParser();
+
+
+
+	////////////////////////////////////////////////////////////////////////////
+	// DESTRUCTOR - FREES MEMORY WITHOUT CALLING BACK
+	////////////////////////////////////////////////////////////////////////////
+	~HTTPBodyParser();
+
+
+
+	////////////////////////////////////////////////////////////////////////////
+	// ABORT AN UNFINISHED UPLOAD AND FREE ALL MEMORY
+	////////////////////////////////////////////////////////////////////////////
+	void reset();
+
+
+
+	////////////////////////////////////////////////////////////////////////////
+	// GET READY FOR A PAYLOAD OF contentLength BYTES OF contentType
+	// application/x-www-form-urlencoded (OR NO TYPE) AND multipart/form-data
+	// ARE DECODED, ANYTHING ELSE IS A RAW UPLOAD. FILE PARTS AND RAW PAYLOADS
+	// GO TO upload, THEY ARE SKIPPED WHEN IT IS EMPTY
+	////////////////////////////////////////////////////////////////////////////
+	HTTPStatus begin(const char *contentType, int contentLength, TUploadFunction upload);
+
+
+
+	////////////////////////////////////////////////////////////////////////////
+	// CONSUME THE NEXT length BYTES OF THE PAYLOAD
+	// RETURNS HTTP_CONTINUE UNTIL THE WHOLE PAYLOAD WAS SEEN, THEN HTTP_OK,
+	// OR THE ERROR STATUS TO ANSWER THE CLIENT WITH
+	////////////////////////////////////////////////////////////////////////////
+	HTTPStatus parse(const char *data, int length);
+
+
+
+	////////////////////////////////////////////////////////////////////////////
+	// APPEND THE DECODED FORM FIELDS TO list
+	// THE POINTERS STAY VALID UNTIL reset()
+	////////////////////////////////////////////////////////////////////////////
+	void params(HTTPParam &list) const;
+
+
+
+	////////////////////////////////////////////////////////////////////////////
+	// PAYLOAD BYTES NOT SEEN YET
+	////////////////////////////////////////////////////////////////////////////
+	inline int remaining() const {
+		return _remaining;
+	}
+
+
+
+	////////////////////////////////////////////////////////////////////////////
+	// THE UPLOAD BEING STREAMED (NULL IF THERE IS NONE)
+	////////////////////////////////////////////////////////////////////////////
+	inline HTTPUpload *upload() const {
+		return _upload.get();
+	}
+
+
+
+	protected:
+	enum Type {
+		TYPE_NONE,
+		TYPE_RAW,
+		TYPE_FORM,
+		TYPE_MULTIPART,
+	};
+
+	enum State {
+		STATE_PREAMBLE,
+		STATE_BOUNDARY_END,
+		STATE_BOUNDARY_DASH,
+		STATE_BOUNDARY_LF,
+		STATE_PART_HEADER,
+		STATE_PART_DATA,
+		STATE_EPILOGUE,
+		STATE_FAILED,
+	};
+
+	HTTPStatus	_fail(HTTPStatus status);
+
+	HTTPStatus	_parseForm(const char *data, int length);
+	HTTPStatus	_endForm();
+	HTTPStatus	_endEscape();
+
+	HTTPStatus	_parseMultipart(const char *data, int length);
+	HTTPStatus	_partHeader(char *line);
+	HTTPStatus	_partBegin();
+	HTTPStatus	_partData(const char *data, int length);
+	HTTPStatus	_partEnd();
+
+	bool		_uploadBegin();
+	void		_uploadStart();
+	void		_uploadWrite(const char *data, int length);
+	void		_uploadEnd();
+	void		_uploadAbort();
+
+	HTTPStatus	_formAppend(const char *data, int length);
+
+
+	Type				_type;
+	State				_state;
+	HTTPStatus			_error;
+	int					_remaining;
+
+	TUploadFunction		_callback;
+	std::unique_ptr<HTTPUpload> _upload;
+	bool				_uploading;
+	bool				_file;
+
+	//MULTIPART DELIMITER "\r\n--boundary" AND HOW MUCH OF IT MATCHED SO FAR
+	char				_delimiter[4 + HTTP_MAX_BOUNDARY + 1];
+	uint8_t				_delimiterLength;
+	uint8_t				_match;
+	int					_line;
+
+	//DECODED FORM FIELDS STORED AS "key\0value\0key\0value\0..."
+	char				*_form;
+	int					_formLength;
+	int					_formCapacity;
+	int					_fields;
+
+	//URL DECODER STATE
+	bool				_formValue;
+	int					_pairLength;
+	int8_t				_hexDigits;
+	uint8_t				_hexValue;
+	char				_hexFirst;
+};
+
+
+
+
+#endif //__HTTP_BODY_PARSER_H__
@@ -0,0 +1,110 @@
+#include <Arduino.h>
+#include "HTTPConnection.h"
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+// CONSTRUCTOR
+////////////////////////////////////////////////////////////////////////////////
+HTTPConnection::HTTPConnection() {
+	status			= HC_NONE;
+	statusChange	= 0;
+	requestCount	= 0;
+	version			= 0;
+	request			= nullptr;
+	capacity		= 0;
+
+	reset();
+}
+
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+// DESTRUCTOR
+////////////////////////////////////////////////////////////////////////////////
+HTTPConnection::~HTTPConnection() {
+	free(request);
+}
+
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+// TAKE OWNERSHIP OF A NEWLY ACCEPTED CLIENT
+////////////////////////////////////////////////////////////////////////////////
+void HTTPConnection::open(const WiFiClient &newClient) {
+	reset();
+	client			= newClient;
+	status			= HC_WAIT_READ;
+	statusChange	= millis();
+	requestCount	= 0;
+}
+
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+// DROP THE CLIENT AND ALL REQUEST STATE, THE SLOT BECOMES FREE AGAIN
+////////////////////////////////////////////////////////////////////////////////
+void HTTPConnection::close() {
+	client			= WiFiClient();
+	status			= HC_NONE;
+	requestCount	= 0;
+	reset();
+}
+
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+// RESET ALL REQUEST VARIABLES TO DEFAULT
+////////////////////////////////////////////////////////////////////////////////
+void HTTPConnection::reset(bool pipeline) {
+	//ABORT AN UNFINISHED UPLOAD WHILE THE REQUEST IT BELONGS TO IS STILL VALID
+	body.reset();
+
+	// CLEAR ALL HEADERS
+	headers.reset();
+
+	//CLEAR ALL GET/POST PARAMETERS
+	params.reset();
+
+	//MOVE PIPELINED BYTES TO THE FRONT OF THE BUFFER
+	int pending = 0;
+	if (pipeline  &&  request  &&  requestLength > 0  &&  requestLength < readBytes) {
+		pending = readBytes - requestLength;
+		memmove(request, request + requestLength, pending);
+		request[pending] = '\0';
+	}
+
+	//AN IDLE SLOT HOLDS NO BUFFER, IT IS ALLOCATED AGAIN WHEN BYTES ARRIVE
+	//PIPELINED BYTES KEEP IT, SHRUNK BACK TO THE INITIAL SIZE WHEN THEY FIT
+	if (!pending) {
+		free(request);
+		request		= nullptr;
+		capacity	= 0;
+
+	} else if (capacity > HTTP_REQUEST_BUFLEN  &&  pending < HTTP_REQUEST_BUFLEN) {
+		char *smaller = (char*) realloc(request, HTTP_REQUEST_BUFLEN + 1);
+		if (smaller) {
+			request		= smaller;
+			capacity	= HTTP_REQUEST_BUFLEN;
+		}
+	}
+
+	//RESET ALL OTHER STATUS VARIABLES
+	readTimeout		= millis();
+	readBytes		= pending;
+	requestLength	= 0;
+	pipelined		= (pending > 0);
+	keepAlive		= false;
+	requestMethod	= nullptr;
+	requestPath		= nullptr;
+	requestParams	= nullptr;
+	requestVersion	= nullptr;
+	method			= HTTP_ANY;
+	handler			= nullptr;
+
+	parser.reset();
+}
@@ -0,0 +1,136 @@
+#ifndef __HTTP_CONNECTION_H__
+#define __HTTP_CONNECTION_H__
+
+
+
+
+#include <memory>
+#include <ESP8266WiFi.h>
+
+#include "ESP8266WebServerHelper.h"
+#include "HTTPHeader.h"
+#include "HTTPParam.h"
+#include "HTTPParser.h"
+#include "HTTPBodyParser.h"
+
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+// STATE OF A SINGLE CLIENT CONNECTION AND THE REQUEST IT IS SENDING
+// ESP8266WebServer KEEPS A FIXED POOL OF THESE AND SERVICES THEM ROUND-ROBIN
+////////////////////////////////////////////////////////////////////////////////
+class HTTPConnection {
+	public:
+
+
+
+	////////////////////////////////////////////////////////////////////////////
+	// CONSTRUCTOR
+	////////////////////////////////////////////////////////////////////////////
+	HTTPConnection();
+
+
+
+	////////////////////////////////////////////////////////////////////////////
+	// DESTRUCTOR
+	////////////////////////////////////////////////////////////////////////////
+	~HTTPConnection();
+
+
+
+	////////////////////////////////////////////////////////////////////////////
+	// TAKE OWNERSHIP OF A NEWLY ACCEPTED CLIENT
+	////////////////////////////////////////////////////////////////////////////
+	void open(const WiFiClient &newClient);
+
+
+
+	////////////////////////////////////////////////////////////////////////////
+	// DROP THE CLIENT AND ALL REQUEST STATE, THE SLOT BECOMES FREE AGAIN
+	////////////////////////////////////////////////////////////////////////////
+	void close();
+
+
+
+	////////////////////////////////////////////////////////////////////////////
+	// RESET ALL REQUEST VARIABLES TO DEFAULT
+	// WITH pipeline SET, BYTES FOLLOWING THE CURRENT REQUEST ARE KEPT IN THE
+	// BUFFER SO THE NEXT REQUEST ON A PERSISTENT CONNECTION CAN BE PARSED
+	////////////////////////////////////////////////////////////////////////////
+	void reset(bool pipeline=false);
+
+
+
+	////////////////////////////////////////////////////////////////////////////
+	// IS THIS SLOT SERVING A CLIENT
+	////////////////////////////////////////////////////////////////////////////
+	inline bool active() const {
+		return status != HC_NONE;
+	}
+
+
+
+	////////////////////////////////////////////////////////////////////////////
+	// CONNECTION STATE
+	////////////////////////////////////////////////////////////////////////////
+	WiFiClient			client;
+	HTTPClientStatus	status;
+	unsigned long		statusChange;
+	uint16_t			requestCount;
+	bool				keepAlive;
+	uint8_t				version;
+
+
+	////////////////////////////////////////////////////////////////////////////
+	// RAW BINARY BUFFER FROM CLIENT, HOLDING THE REQUEST LINE AND HEADERS
+	// METHOD, PATH, AND VERSIONS ARE ALL POINTERS WITHIN THIS SINGLE BUFFER
+	////////////////////////////////////////////////////////////////////////////
+	char				*request;
+	char				*requestMethod;
+	char				*requestPath;
+	char				*requestParams;
+	char				*requestVersion;
+
+
+	//HANDLE THE READ TIMEOUT
+	unsigned long		readTimeout;
+	int					readBytes;
+	int					capacity;
+
+
+	//INCREMENTAL PARSER STATE OF THE REQUEST IN THE BUFFER
+	HTTPParser			parser;
+
+
+	//STREAMING PARSER OF THE PAYLOAD, IT NEVER SITS IN THE BUFFER AS A WHOLE
+	HTTPBodyParser		body;
+
+
+	//BYTES OF THE CURRENT REQUEST IN THE BUFFER, ANYTHING AFTER IT IS PIPELINED
+	int					requestLength;
+	bool				pipelined;
+
+
+	HTTPMethod			method;
+	RequestHandler		*handler;
+
+
+	//STORE POINTERS INTO RAW BUFFER FOR EACH HEADER KEY/VALUE
+	HTTPHeader			headers;
+
+
+	//STORE POINTERS INTO RAW BUFFER FOR EACH GET/POST KEY/VALUE
+	HTTPParam			params;
+
+
+
+	private:
+	HTTPConnection(const HTTPConnection&);
+	HTTPConnection& operator=(const HTTPConnection&);
+};
+
+
+
+
+#endif //__HTTP_CONNECTION_H__
@@ -0,0 +1,132 @@
+#include <Arduino.h>
+#include "HTTPHeaderBuilder.h"
+
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+// CONSTRUCTOR - THE BUFFER IS ONLY ALLOCATED BY THE FIRST RESPONSE
+////////////////////////////////////////////////////////////////////////////////
+HTTPHeaderBuilder::HTTPHeaderBuilder() {
+	_buffer		= nullptr;
+	_length		= 0;
+	_capacity	= 0;
+}
+
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+// DESTRUCTOR
+////////////////////////////////////////////////////////////////////////////////
+HTTPHeaderBuilder::~HTTPHeaderBuilder() {
+	free(_buffer);
+}
+
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+// OPEN A GAP OF length BYTES AT OFFSET at AND RETURN IT
+// HEADERS LONGER THAN HTTP_RESPONSE_BUFLEN DOUBLE THE BUFFER, WHICH THEN
+// STAYS THAT SIZE FOR ALL FOLLOWING RESPONSES
+////////////////////////////////////////////////////////////////////////////////
+char *HTTPHeaderBuilder::_insert(size_t at, size_t length, bool grow) {
+	if (!_buffer) {
+		_buffer = (char*) malloc(HTTP_RESPONSE_BUFLEN);
+		if (!_buffer) return nullptr;
+		_capacity = HTTP_RESPONSE_BUFLEN;
+	}
+
+	if (_length + length > _capacity) {
+		if (!grow) return nullptr;
+
+		size_t capacity = _capacity;
+		while (capacity < _length + length) capacity *= 2;
+
+		char *buffer = (char*) realloc(_buffer, capacity);
+		if (!buffer) return nullptr;
+		_buffer		= buffer;
+		_capacity	= capacity;
+	}
+
+	memmove(_buffer + at + length, _buffer + at, _length - at);
+	_length += length;
+	return _buffer + at;
+}
+
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+// ADD A HEADER LINE
+////////////////////////////////////////////////////////////////////////////////
+bool HTTPHeaderBuilder::header(PGM_P name, PGM_P value, bool first) {
+	size_t nameLength	= strlen_P(name);
+	size_t valueLength	= strlen_P(value);
+
+	char *out = _insert(first ? 0 : _length, nameLength + valueLength + 4, true);
+	if (!out) return false;
+
+	memcpy_P(out, name, nameLength);
+	out += nameLength;
+	*out++ = ':';
+	*out++ = ' ';
+	memcpy_P(out, value, valueLength);
+	out += valueLength;
+	*out++ = '\r';
+	*out++ = '\n';
+	return true;
+}
+
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+// ADD A HEADER LINE WITH A NUMERIC VALUE
+////////////////////////////////////////////////////////////////////////////////
+bool HTTPHeaderBuilder::header(PGM_P name, unsigned long value) {
+	//ROOM FOR THE LARGEST unsigned long, 32 OR 64 BIT
+	char digits[sizeof(unsigned long) * 3 + 1];
+	sprintf(digits, "%lu", value);
+	return header(name, digits);
+}
+
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+// ADD THE STATUS LINE
+////////////////////////////////////////////////////////////////////////////////
+bool HTTPHeaderBuilder::status(int version, int code, PGM_P reason) {
+	char line[20];
+	int lineLength		= sprintf(line, "HTTP/1.%d %d ", version, code);
+	size_t reasonLength	= strlen_P(reason);
+
+	char *out = _insert(0, lineLength + reasonLength + 2, true);
+	if (!out) return false;
+
+	memcpy(out, line, lineLength);
+	out += lineLength;
+	memcpy_P(out, reason, reasonLength);
+	out += reasonLength;
+	*out++ = '\r';
+	*out++ = '\n';
+	return true;
+}
+
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+// APPEND RAW BYTES
+////////////////////////////////////////////////////////////////////////////////
+bool HTTPHeaderBuilder::append(PGM_P data, size_t length, bool grow) {
+	if (!length) return true;
+
+	char *out = _insert(_length, length, grow);
+	if (!out) return false;
+
+	memcpy_P(out, data, length);
+	return true;
+}
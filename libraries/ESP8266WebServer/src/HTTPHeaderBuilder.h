@@ -0,0 +1,115 @@
+#ifndef __HTTP_HEADER_BUILDER_H__
+#define __HTTP_HEADER_BUILDER_H__
+
+
+
+
+#include <stddef.h>
+#include <stdint.h>
+#include <pgmspace.h>
+
+#include "ESP8266WebServerHelper.h"
+
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+// RESPONSE HEAD BUILDER
+// THE STATUS LINE AND HEADERS ARE FORMATTED STRAIGHT INTO ONE BUFFER THAT IS
+// ALLOCATED ONCE AND REUSED BY EVERY RESPONSE, INSTEAD OF BEING CONCATENATED
+// FROM TEMPORARY STRINGS. A SMALL BODY CAN BE APPENDED BEHIND THE HEADERS SO
+// THE WHOLE RESPONSE LEAVES IN A SINGLE WRITE
+// NAMES AND VALUES ARE COPIED WITH THE _P FUNCTIONS, SO THEY MAY LIVE IN
+// RAM OR IN FLASH
+////////////////////////////////////////////////////////////////////////////////
+class HTTPHeaderBuilder {
+	public:
+
+
+
+	////////////////////////////////////////////////////////////////////////////
+	// CONSTRUCTOR
+	////////////////////////////////////////////////////////////////////////////
+	HTTPHeaderBuilder();
+
+
+
+	////////////////////////////////////////////////////////////////////////////
+	// DESTRUCTOR
+	////////////////////////////////////////////////////////////////////////////
+	~HTTPHeaderBuilder();
+
+
+
+	////////////////////////////////////////////////////////////////////////////
+	// DROP EVERYTHING BUILT SO FAR BUT KEEP THE BUFFER FOR THE NEXT RESPONSE
+	////////////////////////////////////////////////////////////////////////////
+	inline void reset() {
+		_length = 0;
+	}
+
+
+
+	////////////////////////////////////////////////////////////////////////////
+	// ADD "name: value\r\n", IN FRONT OF ALL OTHER HEADERS WHEN first IS SET
+	////////////////////////////////////////////////////////////////////////////
+	bool header(PGM_P name, PGM_P value, bool first=false);
+
+
+
+	////////////////////////////////////////////////////////////////////////////
+	// ADD "name: value\r\n" FOR A NUMERIC VALUE
+	////////////////////////////////////////////////////////////////////////////
+	bool header(PGM_P name, unsigned long value);
+
+
+
+	////////////////////////////////////////////////////////////////////////////
+	// PUT "HTTP/1.version code reason\r\n" IN FRONT OF THE HEADERS
+	////////////////////////////////////////////////////////////////////////////
+	bool status(int version, int code, PGM_P reason);
+
+
+
+	////////////////////////////////////////////////////////////////////////////
+	// APPEND RAW BYTES, THE BUFFER ONLY GROWS FOR THEM WHEN grow IS SET
+	////////////////////////////////////////////////////////////////////////////
+	bool append(PGM_P data, size_t length, bool grow=true);
+
+
+
+	////////////////////////////////////////////////////////////////////////////
+	// BYTES THAT STILL FIT WITHOUT GROWING THE BUFFER
+	////////////////////////////////////////////////////////////////////////////
+	inline size_t available() const {
+		return (_buffer ? _capacity : HTTP_RESPONSE_BUFLEN) - _length;
+	}
+
+
+
+	////////////////////////////////////////////////////////////////////////////
+	// WHAT WAS BUILT SO FAR
+	////////////////////////////////////////////////////////////////////////////
+	inline const char *data() const {
+		return _buffer;
+	}
+
+	inline size_t length() const {
+		return _length;
+	}
+
+
+
+	protected:
+	char		*_insert(size_t at, size_t length, bool grow);
+
+
+	char		*_buffer;
+	size_t		_length;
+	size_t		_capacity;
+};
+
+
+
+
+#endif //__HTTP_HEADER_BUILDER_H__
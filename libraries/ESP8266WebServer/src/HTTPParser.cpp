@@ -0,0 +1,255 @@
+#include <Arduino.h>
+#include "HTTPParser.h"
+
+
+
+static_assert(HTTP_MAX_HEADER_SIZE < 0xFFFF, "header offsets are stored in 16 bits");
+static_assert(HTTP_MAX_HEADERS < 0xFF, "header count is stored in 8 bits");
+
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+// START OVER WITH A NEW REQUEST
+////////////////////////////////////////////////////////////////////////////////
+void HTTPParser::reset() {
+	_state			= STATE_METHOD;
+	_error			= HTTP_OK;
+	_parsed			= 0;
+	_headerLength	= 0;
+	_contentLength	= 0;
+	_lengthSeen		= false;
+	_method			= 0;
+	_path			= 0;
+	_params			= 0;
+	_version		= 0;
+	_key			= 0;
+	_value			= 0;
+	_valueEnd		= 0;
+	_count			= 0;
+}
+
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+// STOP PARSING, EVERY FURTHER CALL RETURNS THE SAME ERROR
+////////////////////////////////////////////////////////////////////////////////
+HTTPStatus HTTPParser::_fail(HTTPStatus status) {
+	_state = STATE_FAILED;
+	_error = status;
+	return status;
+}
+
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+// A HEADER LINE HAS BEEN TOKENIZED, REMEMBER IT
+// Content-Length AND Transfer-Encoding ARE INTERPRETED RIGHT AWAY
+////////////////////////////////////////////////////////////////////////////////
+HTTPStatus HTTPParser::_header(char *buffer) {
+	if (_count >= HTTP_MAX_HEADERS) return _fail(HTTP_REQUEST_LARGE);
+
+	buffer[_valueEnd] = '\0';
+
+	const char *key		= buffer + _key;
+	const char *value	= buffer + _value;
+
+	if (!strcasecmp_P(key, PSTR("Content-Length"))) {
+		//A REPEATED LENGTH MAKES THE BODY BOUNDARY AMBIGUOUS, REFUSE IT
+		if (_lengthSeen) return _fail(HTTP_BAD_REQUEST);
+
+		char *end;
+		long length = strtol(value, &end, 10);
+		if (end == value  ||  *end  ||  length < 0  ||  length > 0x7FFFFFFF) {
+			return _fail(HTTP_BAD_REQUEST);
+		}
+		_contentLength	= (int) length;
+		_lengthSeen		= true;
+
+	} else if (!strcasecmp_P(key, PSTR("Transfer-Encoding"))) {
+		//CHUNKED REQUEST BODIES ARE NOT SUPPORTED
+		if (strcasecmp_P(value, PSTR("identity"))) {
+			return _fail(HTTP_NOT_IMPLEMENTED);
+		}
+	}
+
+	_fields[_count][0] = _key;
+	_fields[_count][1] = _value;
+	_count++;
+
+	return HTTP_CONTINUE;
+}
+
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+// CONSUME NEWLY ARRIVED BYTES
+////////////////////////////////////////////////////////////////////////////////
+HTTPStatus HTTPParser::parse(char *buffer, int length) {
+	if (_state == STATE_FAILED) return _error;
+
+	int pos = _parsed;
+
+	while (pos < length  &&  _state < STATE_BODY) {
+		char c = buffer[pos];
+
+		//NULL BYTES WOULD TRUNCATE OUR IN PLACE STRINGS
+		if (c == '\0') return _fail(HTTP_BAD_REQUEST);
+
+		switch (_state) {
+			case STATE_METHOD:
+				if (c == ' ') {
+					if (pos == _method) return _fail(HTTP_BAD_REQUEST);
+					buffer[pos]	= '\0';
+					_path		= pos + 1;
+					_state		= STATE_PATH;
+
+				//IGNORE EMPTY LINES BEFORE THE REQUEST LINE
+				} else if ((c == '\r'  ||  c == '\n')  &&  pos == _method) {
+					_method		= pos + 1;
+
+				} else if (c == '\r'  ||  c == '\n') {
+					return _fail(HTTP_BAD_REQUEST);
+				}
+			break;
+
+
+			case STATE_PATH:
+			case STATE_PARAMS:
+				if (c == ' ') {
+					buffer[pos]	= '\0';
+					_version	= pos + 1;
+					_state		= STATE_VERSION;
+
+				} else if (c == '?'  &&  _state == STATE_PATH) {
+					buffer[pos]	= '\0';
+					_params		= pos + 1;
+					_state		= STATE_PARAMS;
+
+				} else if (c == '\r'  ||  c == '\n') {
+					return _fail(HTTP_BAD_REQUEST);
+				}
+			break;
+
+
+			case STATE_VERSION:
+				if (c == '\r'  ||  c == '\n') {
+					if (pos == _version) return _fail(HTTP_BAD_REQUEST);
+					buffer[pos]	= '\0';
+					_state		= (c == '\r') ? STATE_REQUEST_LF : STATE_HEADER_START;
+
+				} else if (c == ' ') {
+					return _fail(HTTP_BAD_REQUEST);
+				}
+			break;
+
+
+			case STATE_REQUEST_LF:
+			case STATE_HEADER_LF:
+				if (c != '\n') return _fail(HTTP_BAD_REQUEST);
+				buffer[pos]	= '\0';
+				_state		= STATE_HEADER_START;
+			break;
+
+
+			case STATE_HEADER_START:
+				if (c == '\r') {
+					buffer[pos]	= '\0';
+					_state		= STATE_END_LF;
+
+				} else if (c == '\n') {
+					buffer[pos]		= '\0';
+					_headerLength	= pos + 1;
+					_state			= STATE_BODY;
+
+				} else if (c == ':'  ||  c == ' '  ||  c == '\t') {
+					return _fail(HTTP_BAD_REQUEST);
+
+				} else {
+					_key		= pos;
+					_state		= STATE_KEY;
+				}
+			break;
+
+
+			case STATE_KEY:
+				if (c == ':') {
+					buffer[pos]	= '\0';
+					_value		= pos + 1;
+					_valueEnd	= pos + 1;
+					_state		= STATE_VALUE_START;
+
+				} else if (c == '\r'  ||  c == '\n') {
+					return _fail(HTTP_BAD_REQUEST);
+				}
+			break;
+
+
+			case STATE_VALUE_START:
+				if (c == ' '  ||  c == '\t') {
+					_value		= pos + 1;
+					_valueEnd	= pos + 1;
+					break;
+				}
+				_state = STATE_VALUE;
+				//FALL THROUGH
+
+
+			case STATE_VALUE:
+				if (c == '\r'  ||  c == '\n') {
+					buffer[pos] = '\0';
+					if (_header(buffer) != HTTP_CONTINUE) return _error;
+					_state = (c == '\r') ? STATE_HEADER_LF : STATE_HEADER_START;
+
+				} else if (c != ' '  &&  c != '\t') {
+					_valueEnd = pos + 1;
+				}
+			break;
+
+
+			case STATE_END_LF:
+				if (c != '\n') return _fail(HTTP_BAD_REQUEST);
+				buffer[pos]		= '\0';
+				_headerLength	= pos + 1;
+				_state			= STATE_BODY;
+			break;
+
+
+			default:
+			break;
+		}
+
+		pos++;
+
+		//ENFORCE THE SIZE LIMIT OF THE SECTION WE ARE IN
+		if (_state < STATE_BODY) {
+			if (_state <= STATE_VERSION  &&  pos - _method >= HTTP_MAX_REQUEST_LINE) {
+				return _fail(HTTP_URI_LARGE);
+			}
+			if (pos >= HTTP_MAX_HEADER_SIZE) {
+				return _fail(HTTP_REQUEST_LARGE);
+			}
+		}
+	}
+
+	_parsed = pos;
+
+	return (_state == STATE_BODY) ? HTTP_OK : HTTP_CONTINUE;
+}
+
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+// POINT THE HEADER LIST AT THE TOKENIZED HEADERS INSIDE buffer
+////////////////////////////////////////////////////////////////////////////////
+void HTTPParser::headers(char *buffer, HTTPHeader &list) const {
+	list.allocate(_count);
+
+	for (auto i=0; i<_count; i++) {
+		list.set(i, buffer + _fields[i][0], buffer + _fields[i][1]);
+	}
+}
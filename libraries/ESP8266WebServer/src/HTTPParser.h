@@ -0,0 +1,126 @@
+#ifndef __HTTP_PARSER_H__
+#define __HTTP_PARSER_H__
+
+
+
+
+#include "ESP8266WebServerHelper.h"
+#include "HTTPHeader.h"
+
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+// INCREMENTAL HTTP REQUEST PARSER
+// BYTES ARE FED AS THEY ARRIVE AND EACH ONE IS LOOKED AT EXACTLY ONCE
+// THE REQUEST LINE AND HEADERS ARE TOKENIZED IN PLACE BY WRITING NULL
+// TERMINATORS INTO THE CALLER'S BUFFER. ONLY OFFSETS ARE REMEMBERED, SO THE
+// CALLER IS FREE TO REALLOC THE BUFFER BETWEEN TWO CALLS TO parse()
+////////////////////////////////////////////////////////////////////////////////
+class HTTPParser {
+	public:
+
+
+
+	////////////////////////////////////////////////////////////////////////////
+	// CONSTRUCTOR
+	////////////////////////////////////////////////////////////////////////////
+	inline HTTPParser() {
+		reset();
+	}
+
+
+
+	////////////////////////////////////////////////////////////////////////////
+	// START OVER WITH A NEW REQUEST
+	////////////////////////////////////////////////////////////////////////////
+	void reset();
+
+
+
+	////////////////////////////////////////////////////////////////////////////
+	// CONSUME buffer[parsed() .. length)
+	// RETURNS HTTP_CONTINUE WHILE MORE BYTES ARE NEEDED, HTTP_OK ONCE THE
+	// HEADERS ARE COMPLETE, OR THE ERROR STATUS TO ANSWER THE CLIENT WITH
+	// THE PAYLOAD STARTING AT headerLength() IS LEFT TO THE CALLER
+	////////////////////////////////////////////////////////////////////////////
+	HTTPStatus parse(char *buffer, int length);
+
+
+
+	////////////////////////////////////////////////////////////////////////////
+	// POINT THE HEADER LIST AT THE TOKENIZED HEADERS INSIDE buffer
+	////////////////////////////////////////////////////////////////////////////
+	void headers(char *buffer, HTTPHeader &list) const;
+
+
+
+	////////////////////////////////////////////////////////////////////////////
+	// REQUEST LINE TOKENS INSIDE buffer (PARAMS IS NULL WITHOUT A '?')
+	////////////////////////////////////////////////////////////////////////////
+	inline char *method(char *buffer) const		{ return buffer + _method;	}
+	inline char *path(char *buffer) const		{ return buffer + _path;	}
+	inline char *version(char *buffer) const	{ return buffer + _version;	}
+	inline char *params(char *buffer) const {
+		return _params ? buffer + _params : nullptr;
+	}
+
+
+
+	////////////////////////////////////////////////////////////////////////////
+	// SIZES
+	////////////////////////////////////////////////////////////////////////////
+	inline int parsed() const				{ return _parsed;			}
+	inline int headerLength() const			{ return _headerLength;		}
+	inline int contentLength() const		{ return _contentLength;	}
+	inline int requestLength() const		{ return _headerLength + _contentLength; }
+	inline int headerCount() const			{ return _count;			}
+	inline bool headersComplete() const		{ return _state == STATE_BODY; }
+
+
+
+	protected:
+	enum State {
+		STATE_METHOD,
+		STATE_PATH,
+		STATE_PARAMS,
+		STATE_VERSION,
+		STATE_REQUEST_LF,
+		STATE_HEADER_START,
+		STATE_KEY,
+		STATE_VALUE_START,
+		STATE_VALUE,
+		STATE_HEADER_LF,
+		STATE_END_LF,
+		STATE_BODY,
+		STATE_FAILED,
+	};
+
+	HTTPStatus	_fail(HTTPStatus status);
+	HTTPStatus	_header(char *buffer);
+
+	State		_state;
+	HTTPStatus	_error;
+	int			_parsed;
+	int			_headerLength;
+	int			_contentLength;
+	bool		_lengthSeen;
+
+	//OFFSETS OF THE REQUEST LINE TOKENS
+	uint16_t	_method;
+	uint16_t	_path;
+	uint16_t	_params;
+	uint16_t	_version;
+
+	//OFFSETS OF THE HEADER BEING PARSED, AND OF ALL COMPLETED HEADERS
+	uint16_t	_key;
+	uint16_t	_value;
+	uint16_t	_valueEnd;
+	uint8_t		_count;
+	uint16_t	_fields[HTTP_MAX_HEADERS][2];
+};
+
+
+
+
+#endif //__HTTP_PARSER_H__
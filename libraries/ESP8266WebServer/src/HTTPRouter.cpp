@@ -0,0 +1,233 @@
+#include <Arduino.h>
+#include "HTTPRouter.h"
+
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+// CONSTRUCTOR
+////////////////////////////////////////////////////////////////////////////////
+HTTPRouter::HTTPRouter() {
+	_routes		= nullptr;
+	_buckets	= nullptr;
+	_nodes		= nullptr;
+	reset();
+}
+
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+// DESTRUCTOR
+////////////////////////////////////////////////////////////////////////////////
+HTTPRouter::~HTTPRouter() {
+	_free();
+}
+
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+// FORGET THE TABLE
+////////////////////////////////////////////////////////////////////////////////
+void HTTPRouter::reset() {
+	_free();
+	_built		= false;
+	_first		= nullptr;
+}
+
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+// FREE ALL MEMORY
+////////////////////////////////////////////////////////////////////////////////
+void HTTPRouter::_free() {
+	free(_routes);
+	free(_buckets);
+	free(_nodes);
+	_routes		= nullptr;
+	_routeCount	= 0;
+	_buckets	= nullptr;
+	_bucketMask	= 0;
+	_nodes		= nullptr;
+	_nodeCount	= 0;
+	_any		= 0;
+}
+
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+// FNV-1a, CHEAP AND GOOD ENOUGH FOR A HANDFUL OF PATHS
+////////////////////////////////////////////////////////////////////////////////
+uint32_t HTTPRouter::_hash(const char *uri) {
+	uint32_t hash = 2166136261u;
+	while (*uri) {
+		hash ^= (uint8_t) *uri++;
+		hash *= 16777619u;
+	}
+	return hash;
+}
+
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+// INDEX THE HANDLER LIST
+////////////////////////////////////////////////////////////////////////////////
+bool HTTPRouter::build(RequestHandler *first) {
+	_free();
+	_built	= true;
+	_first	= first;
+
+
+	//SIZE EVERYTHING UP FRONT SO THERE ARE EXACTLY THREE ALLOCATIONS
+	size_t routes = 0, exact = 0, nodes = 1;
+	for (RequestHandler *handler=first; handler; handler=handler->next()) {
+		const char *uri = handler->routeUri();
+		if (uri  &&  handler->routeType() == RequestHandler::ROUTE_EXACT) {
+			exact++;
+		} else if (uri  &&  handler->routeType() == RequestHandler::ROUTE_PREFIX) {
+			nodes += strlen(uri);
+		}
+		routes++;
+	}
+
+	if (!routes) return true;
+	if (routes >= 0xFFFF  ||  nodes >= 0xFFFF) return false;
+
+	size_t buckets = 1;
+	while (buckets < exact * 2) buckets <<= 1;
+
+	_routes		= (Route*)		malloc(routes * sizeof(Route));
+	_buckets	= (uint16_t*)	calloc(buckets, sizeof(uint16_t));
+	_nodes		= (Node*)		malloc(nodes * sizeof(Node));
+
+	if (!_routes  ||  !_buckets  ||  !_nodes) {
+		_free();
+		return false;
+	}
+
+	_bucketMask			= buckets - 1;
+	_nodeCount			= 1;
+	_nodes[0].c			= 0;
+	_nodes[0].child		= 0;
+	_nodes[0].sibling	= 0;
+	_nodes[0].routes	= 0;
+
+
+	//ROUTES KEEP THE REGISTRATION ORDER
+	for (RequestHandler *handler=first; handler; handler=handler->next()) {
+		Route &route	= _routes[_routeCount++];
+		route.handler	= handler;
+		route.hash		= 0;
+		route.next		= 0;
+	}
+
+
+	//CHAINS ARE BUILT BACKWARDS BY PREPENDING, SO EVERY CHAIN ENDS UP IN
+	//REGISTRATION ORDER AND A LOOKUP CAN STOP AT THE FIRST HANDLER THAT MATCHES
+	for (uint16_t index=_routeCount; index; index--) {
+		Route &route	= _routes[index - 1];
+		const char *uri	= route.handler->routeUri();
+		auto type		= uri ? route.handler->routeType() : RequestHandler::ROUTE_ANY;
+
+		if (type == RequestHandler::ROUTE_EXACT) {
+			route.hash			= _hash(uri);
+			uint16_t &bucket	= _buckets[route.hash & _bucketMask];
+			route.next			= bucket;
+			bucket				= index;
+
+		} else if (type == RequestHandler::ROUTE_PREFIX) {
+			uint16_t node = 1;
+			for (; *uri; uri++) {
+				uint16_t child = _child(node, *uri);
+				if (!child) {
+					Node &added		= _nodes[_nodeCount++];
+					added.c			= *uri;
+					added.child		= 0;
+					added.sibling	= _nodes[node - 1].child;
+					added.routes	= 0;
+					child			= _nodeCount;
+					_nodes[node - 1].child = child;
+				}
+				node = child;
+			}
+			route.next				= _nodes[node - 1].routes;
+			_nodes[node - 1].routes	= index;
+
+		} else {
+			route.next	= _any;
+			_any		= index;
+		}
+	}
+
+	return true;
+}
+
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+// THE TRIE NODE BELOW node FOR CHARACTER c (0 IF THERE IS NONE)
+////////////////////////////////////////////////////////////////////////////////
+uint16_t HTTPRouter::_child(uint16_t node, char c) const {
+	for (node=_nodes[node - 1].child; node; node=_nodes[node - 1].sibling) {
+		if (_nodes[node - 1].c == c) break;
+	}
+	return node;
+}
+
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+// WALK A CHAIN OF ROUTES THAT COULD BEAT best, RETURN THE NEW BEST
+// ONLY ROUTE_EXACT ROUTES HAVE A HASH, THE OTHER CHAINS ARE PROBED WITH 0
+////////////////////////////////////////////////////////////////////////////////
+uint16_t HTTPRouter::_probe(uint16_t route, uint16_t best, uint32_t hash, HTTPMethod method, const char *uri) const {
+	for (; route  &&  (!best  ||  route < best); route=_routes[route - 1].next) {
+		const Route &r = _routes[route - 1];
+		if (r.hash == hash  &&  r.handler->canHandle(method, uri)) {
+			return route;
+		}
+	}
+	return best;
+}
+
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+// FIND THE HANDLER FOR A REQUEST
+////////////////////////////////////////////////////////////////////////////////
+RequestHandler *HTTPRouter::find(HTTPMethod method, const char *uri) const {
+	//NO TABLE, ASK EVERY HANDLER IN TURN
+	if (!_routes) {
+		RequestHandler *handler = _first;
+		while (handler  &&  !handler->canHandle(method, uri)) {
+			handler = handler->next();
+		}
+		return handler;
+	}
+
+
+	//EXACT MATCH
+	uint32_t hash	= _hash(uri);
+	uint16_t best	= _probe(_buckets[hash & _bucketMask], 0, hash, method, uri);
+
+
+	//EVERY NODE ON THE WAY DOWN THE TRIE IS A PREFIX OF uri
+	uint16_t node	= 1;
+	best = _probe(_nodes[0].routes, best, 0, method, uri);
+	for (const char *p=uri; *p  &&  (node = _child(node, *p)); p++) {
+		best = _probe(_nodes[node - 1].routes, best, 0, method, uri);
+	}
+
+
+	//EVERYTHING ELSE
+	best = _probe(_any, best, 0, method, uri);
+
+	return best ? _routes[best - 1].handler : nullptr;
+}
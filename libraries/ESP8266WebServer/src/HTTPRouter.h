@@ -0,0 +1,117 @@
+#ifndef __HTTP_ROUTER_H__
+#define __HTTP_ROUTER_H__
+
+
+
+
+#include <stdint.h>
+
+#include "ESP8266WebServerHelper.h"
+
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+// REQUEST DISPATCH TABLE
+// BUILT ONCE FROM THE HANDLER LIST, THEN EVERY REQUEST IS MATCHED WITHOUT
+// WALKING ALL HANDLERS AND WITHOUT ALLOCATING. ROUTE_EXACT HANDLERS LIVE IN A
+// HASH TABLE, ROUTE_PREFIX HANDLERS IN A CHARACTER TRIE, ANY OTHER HANDLER IS
+// STILL ASKED ONE BY ONE. WHEN SEVERAL HANDLERS ACCEPT A REQUEST THE ONE
+// REGISTERED FIRST WINS, EXACTLY LIKE THE PLAIN LIST WALK
+////////////////////////////////////////////////////////////////////////////////
+class HTTPRouter {
+	public:
+
+
+
+	////////////////////////////////////////////////////////////////////////////
+	// CONSTRUCTOR
+	////////////////////////////////////////////////////////////////////////////
+	HTTPRouter();
+
+
+
+	////////////////////////////////////////////////////////////////////////////
+	// DESTRUCTOR - THE HANDLERS ARE NOT OWNED
+	////////////////////////////////////////////////////////////////////////////
+	~HTTPRouter();
+
+
+
+	////////////////////////////////////////////////////////////////////////////
+	// FORGET THE TABLE, E.G. BECAUSE A HANDLER WAS ADDED
+	////////////////////////////////////////////////////////////////////////////
+	void reset();
+
+
+
+	////////////////////////////////////////////////////////////////////////////
+	// INDEX THE HANDLER LIST STARTING AT first
+	// RETURNS FALSE IF THERE WAS NOT ENOUGH MEMORY, find() THEN FALLS BACK TO
+	// WALKING THE LIST
+	////////////////////////////////////////////////////////////////////////////
+	bool build(RequestHandler *first);
+
+
+
+	////////////////////////////////////////////////////////////////////////////
+	// THE FIRST REGISTERED HANDLER ACCEPTING THE REQUEST (NULL IF NONE DOES)
+	////////////////////////////////////////////////////////////////////////////
+	RequestHandler *find(HTTPMethod method, const char *uri) const;
+
+
+
+	////////////////////////////////////////////////////////////////////////////
+	// HAS build() BEEN CALLED SINCE THE LAST reset()
+	////////////////////////////////////////////////////////////////////////////
+	inline bool built() const {
+		return _built;
+	}
+
+
+
+	protected:
+	//INDICES BELOW ARE 1-BASED, 0 ENDS A CHAIN
+	struct Route {
+		RequestHandler	*handler;
+		uint32_t		hash;
+		uint16_t		next;		//NEXT ROUTE IN THE SAME BUCKET, TRIE NODE OR ROUTE_ANY CHAIN
+	};
+
+	struct Node {
+		char			c;
+		uint16_t		child;		//FIRST NODE ONE CHARACTER DEEPER
+		uint16_t		sibling;	//NEXT NODE AT THE SAME DEPTH
+		uint16_t		routes;		//PREFIX ROUTES ENDING AT THIS NODE
+	};
+
+	static uint32_t	_hash(const char *uri);
+
+	uint16_t		_child(uint16_t node, char c) const;
+	uint16_t		_probe(uint16_t route, uint16_t best, uint32_t hash, HTTPMethod method, const char *uri) const;
+	void			_free();
+
+
+	bool			_built;
+	RequestHandler	*_first;
+
+	//ROUTES IN REGISTRATION ORDER, SO A LOWER INDEX MEANS HIGHER PRIORITY
+	Route			*_routes;
+	uint16_t		_routeCount;
+
+	//ROUTE_EXACT HASH BUCKETS, A POWER OF TWO OF THEM
+	uint16_t		*_buckets;
+	uint16_t		_bucketMask;
+
+	//ROUTE_PREFIX TRIE, NODE 1 IS THE ROOT (THE EMPTY PREFIX)
+	Node			*_nodes;
+	uint16_t		_nodeCount;
+
+	//ROUTE_ANY HANDLERS
+	uint16_t		_any;
+};
+
+
+
+
+#endif //__HTTP_ROUTER_H__
@@ -71,13 +71,12 @@ class HTTPValue {
 
 		total				+= count;
 		int size			 = sizeof(HTTPKeyValue) * total;
+		if (!size) return;
+
 		HTTPKeyValue *tmp	 = items;
 		items				 = (HTTPKeyValue*) realloc(items, size);
 
-		if (!size) {
-			items = nullptr;
-			
-		} else if (items) {
+		if (items) {
 			for (auto i=count; i<total; i++) {
 				items[i].key	= nullptr;
 				items[i].value	= nullptr;
@@ -148,7 +147,7 @@ class HTTPValue {
 	// GET A VALUE OBJECT BASED ON KEY (C-STRING)
 	////////////////////////////////////////////////////////////////////////////
 	HTTPKeyValue *get(const char *key) const {
-		if (key == nullptr  ||  *key == NULL) return nullptr;
+		if (key == nullptr  ||  *key == '\0') return nullptr;
 
 		for (auto i=0; i<total(); i++) {
 			if (strcasecmp(items[i].key, key) == 0) {
@@ -252,23 +251,6 @@ class HTTPValue {
 
 
 
-	////////////////////////////////////////////////////////////////////////////
-	// !!! WARNING !!! EXTREMELY DANGEROUS
-	// DON'T DO THIS UNLESS YOU ABSOLUTELY KNOW WHAT YOURE DOING!
-	////////////////////////////////////////////////////////////////////////////
-	// INCREASE OR DECREASE THE POINTER OFFSET
-	////////////////////////////////////////////////////////////////////////////
-	void __offset(int offset) {
-		if (offset == 0) return;
-		for (auto i=0; i<total(); i++) {
-			if (items[i].key)	items[i].key	+= offset;
-			if (items[i].value)	items[i].value	+= offset;
-		}
-	}
-
-
-
-
 	////////////////////////////////////////////////////////////////////////////
 	// CALCULATE THE TOTAL NUMBER OF PARAM VALUES
 	////////////////////////////////////////////////////////////////////////////
@@ -298,4 +280,4 @@ class HTTPValue {
 
 
 
-#endif __HTTP_VALUE_H__
+#endif //__HTTP_VALUE_H__
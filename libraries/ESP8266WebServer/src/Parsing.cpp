@@ -69,66 +69,94 @@ static inline T *vealloc(T *ptr, size_t size) {
 
 
 ////////////////////////////////////////////////////////////////////////////////
-// RESET ALL REQUEST VARIABLES TO DEFAULT FOR NEW INCOMING CONNECTION
+// CHECK IF A COMMA SEPARATED HEADER VALUE CONTAINS A TOKEN (CASE INSENSITIVE)
+// EX: "keep-alive, Upgrade" CONTAINS "upgrade"
 ////////////////////////////////////////////////////////////////////////////////
-void ESP8266WebServer::resetRequest() {
-	// CLEAR ALL HEADERS
-	_headers.reset();
-
-	//CLEAR ALL GET/POST PARAMETERS
-	_params.reset();
-
-	//CLEAR THE REQUEST BUFFER
-	free(_request);
-
-	//RESET ALL OTHER STATUS VARIABLES
-	_readTimeout		= millis();
-	_readBytes			= 0;
-	_request			= nullptr;
-	_requestMethod		= nullptr;
-	_requestPath		= nullptr;
-	_requestParams		= nullptr;
-	_requestVersion		= nullptr;
-	_requestPayload		= nullptr;
-	_method				= HTTP_ANY;
-	_statusCode			= 0;
+static bool _hasToken(const char *list, PGM_P token) {
+	if (!list) return false;
+
+	size_t length = strlen_P(token);
+
+	while (*list) {
+		while (*list == ' '  ||  *list == ',') list++;
+
+		if (!strncasecmp_P(list, token, length)) {
+			const char *end = list + length;
+			while (*end == ' ') end++;
+			if (*end == ','  ||  *end == '\0') return true;
+		}
+
+		while (*list  &&  *list != ',') list++;
+	}
+
+	return false;
+}
+
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+// RESET ALL REQUEST VARIABLES OF THE CURRENT CONNECTION TO DEFAULT
+// WITH pipeline SET, BYTES FOLLOWING THE CURRENT REQUEST ARE KEPT IN THE
+// BUFFER SO THE NEXT REQUEST ON A PERSISTENT CONNECTION CAN BE PARSED
+////////////////////////////////////////////////////////////////////////////////
+void ESP8266WebServer::resetRequest(bool pipeline) {
+	_current->reset(pipeline);
+	_statusCode = 0;
 }
 
 
 
 
 ////////////////////////////////////////////////////////////////////////////////
-// READ BYTES FROM THE STREAM
+// READ THE REQUEST LINE AND HEADERS FROM THE STREAM
+// THE BUFFER DOUBLES WHEN FULL, UP TO HTTP_MAX_HEADER_SIZE
 ////////////////////////////////////////////////////////////////////////////////
 HTTPStatus ESP8266WebServer::_readStream(WiFiClient &client) {
-	if (millis() - _readTimeout > HTTP_MAX_DATA_WAIT) {
+	HTTPConnection &c = *_current;
+
+	if (millis() - c.readTimeout > HTTP_MAX_DATA_WAIT) {
 		return HTTP_TIMEOUT;
 	}
 
 	//CHECK FOR AVAILABLE BYTES
-	auto available	= client.available();
+	int available	= client.available();
 	if (!available) {
-		yield();
 		return HTTP_OK;
 	}
 
-	//RESET READ TIMEOUT BECAUSE WE GOT NEW BYTES
-	_readTimeout = millis();
+	//PICK THE BUFFER SIZE WE NEED
+	int size = c.capacity;
+	if (c.readBytes >= size) {
+		size = min(max(size * 2, HTTP_REQUEST_BUFLEN), HTTP_MAX_HEADER_SIZE);
+	}
+
+	int length = min(available, size - c.readBytes);
+	if (length <= 0) {
+		return HTTP_OK;
+	}
 
 	//INCREASE BUFFER SIZE
-	_request = vealloc(_request, _readBytes + available + 1);
+	if (size != c.capacity) {
+		c.request	= vealloc(c.request, size + 1);
+		c.capacity	= c.request ? size : 0;
+
+		//NO ROOM TO EXPAND BUFFER? OUTPUT ERROR!
+		if (!c.request) return HTTP_PAYLOAD_LARGE;
+	}
 
-	//NO ROOM TO EXPAND BUFFER? OUTPUT ERROR!
-	if (!_request) return HTTP_PAYLOAD_LARGE;
+	//RESET READ TIMEOUT BECAUSE WE GOT NEW BYTES
+	c.readTimeout = millis();
 
 	//READ AVAILABLE BYTES INTO OUR BUFFER
-	client.read(((unsigned char*)_request) + _readBytes, available);
+	length = client.read(((unsigned char*)c.request) + c.readBytes, length);
+	if (length < 0) length = 0;
 
 	//INCREASE VALUE LETTING US KNOW HOW MUCH WE READ
-	_readBytes += available;
+	c.readBytes += length;
 
 	//NULL TERMINATE THE BUFFER STRING
-	_request[_readBytes] = '\0';
+	c.request[c.readBytes] = '\0';
 
 	return HTTP_OK;
 }
@@ -137,62 +165,29 @@ HTTPStatus ESP8266WebServer::_readStream(WiFiClient &client) {
 
 
 ////////////////////////////////////////////////////////////////////////////////
-// PARSE THE FIRST LINE OF THE HEADER
-// THIS POPULATES _requestPath, _requestParams, AND _requestVersion
+// FEED THE PAYLOAD TO THE BODY PARSER AS IT ARRIVES, HTTP_BODY_CHUNK AT A TIME
+// BYTES PAST THE PAYLOAD ARE LEFT IN THE SOCKET FOR THE NEXT REQUEST
 ////////////////////////////////////////////////////////////////////////////////
-HTTPStatus ESP8266WebServer::_parseVersion(char *buffer) {
-	if (!buffer  ||  !*buffer) return HTTP_TEAPOT;
-
-	//SET THE REQUEST METHOD (EG: "GET", "POST", "PUT", ETC)
-	_requestMethod = buffer;
+HTTPStatus ESP8266WebServer::_readBody(WiFiClient &client) {
+	HTTPConnection &c = *_current;
+	char chunk[HTTP_BODY_CHUNK];
 
-	do {
-		if (*buffer == ' ') {
-			*buffer++			= '\0';
+	HTTPStatus code = HTTP_CONTINUE;
 
-			//SET THE REQUEST PATH (URL)
-			if (!_requestPath) {
-				_requestPath	= buffer;
+	while (code == HTTP_CONTINUE) {
+		int length = min(client.available(), min(c.body.remaining(), (int) sizeof(chunk)));
+		if (length <= 0) break;
 
-			//SET THE REQUEST VERSION (EG: "HTTP/1.1")
-			} else if (!_requestVersion) {
-				_requestVersion	= buffer;
+		length = client.read((unsigned char*) chunk, length);
+		if (length <= 0) break;
 
-			} else {
-				return HTTP_BAD_REQUEST;
-			}
+		//RESET READ TIMEOUT BECAUSE WE GOT NEW BYTES
+		c.readTimeout = millis();
 
-		} else if (*buffer == '?') {
-			//SET THE GET REQUEST URL PARAMETERS
-			if (_requestPath  &&  !_requestParams  &&  !_requestVersion) {
-				*buffer++		= '\0';
-				_requestParams	= buffer;
-			}
-
-		} else {
-			buffer++;
-		}
-	} while (*buffer);
-
-#	ifdef DEBUG_ESP_HTTP_SERVER
-		DEBUG_OUTPUT.print(F("Method: ("));
-		DEBUG_OUTPUT.print(_headers.key(0));
-		DEBUG_OUTPUT.println(F(")"));
-
-		DEBUG_OUTPUT.print(F("Path: ("));
-		DEBUG_OUTPUT.print(_requestPath);
-		DEBUG_OUTPUT.println(F(")"));
-
-		DEBUG_OUTPUT.print(F("Parameters: ("));
-		DEBUG_OUTPUT.print(_requestParams);
-		DEBUG_OUTPUT.println(F(")"));
-
-		DEBUG_OUTPUT.print(F("Version: ("));
-		DEBUG_OUTPUT.print(_requestVersion);
-		DEBUG_OUTPUT.println(F(")"));
-#	endif
+		code = c.body.parse(chunk, length);
+	}
 
-	return _requestVersion ? HTTP_OK : HTTP_BAD_REQUEST;
+	return code;
 }
 
 
@@ -219,102 +214,158 @@ HTTPMethod ESP8266WebServer::_parseMethod(const char *method) {
 
 ////////////////////////////////////////////////////////////////////////////////
 // PARSE THE REQUEST FROM THE CLIENT BROWSER
+// THIS NEVER WAITS ON THE CLIENT: IT FEEDS WHAT HAS ARRIVED SO FAR TO THE
+// INCREMENTAL PARSERS AND RETURNS HTTP_CONTINUE UNTIL THE REQUEST IS COMPLETE
 ////////////////////////////////////////////////////////////////////////////////
 HTTPStatus ESP8266WebServer::_parseRequest(WiFiClient &client) {
+	HTTPConnection &c = *_current;
+
+	//PIPELINED BYTES ARE BEING LOOKED AT NOW
+	c.pipelined = false;
 
-	//RESET ALL REQUEST VARIABLES
-	resetRequest();
+	HTTPStatus code = HTTP_CONTINUE;
 
 
-	//READ FROM STREAM UNTIL WE HAVE ALL HEADERS
-	do {
-		auto code = _readStream(client);
+	//READ AND TOKENIZE ONLY THE BYTES WE HAVE NOT LOOKED AT YET
+	if (!c.parser.headersComplete()) {
+		code = _readStream(client);
 		if (code != HTTP_OK) return code;
-	} while (!strstr(_request, "\r\n\r\n"));
 
+		if (!c.request) return HTTP_CONTINUE;
 
+		code = c.parser.parse(c.request, c.readBytes);
+		if (code != HTTP_OK) return code;
 
-#	ifdef DEBUG_ESP_HTTP_SERVER
-		//DISPLAY RAW REQUEST TO DEBUG OUTPUT (SERIAL)
-		DEBUG_OUTPUT.println(F("REQUEST:"));
-		DEBUG_OUTPUT.println(_request);
-#	endif
+		code = _parseHeaders();
+	}
 
 
+	//STREAM THE REST OF THE PAYLOAD
+	if (code == HTTP_CONTINUE) {
+		code = _readBody(client);
+	}
 
-	//PROCESS HEADERS
-	char	*offset	= _request;
-	char	*buffer	= _headers.process(_request);
-	int		hlength	= buffer - _request;
-	int		clength	= _headers.integer("Content-Length");
+	if (code != HTTP_OK) return code;
 
 
-	//READ PAYLOAD UNTIL CONTENT LENGTH IS SATISFIED
-	while (_readBytes - hlength < clength) {
-		auto code = _readStream(client);
-		if (code != HTTP_OK) return code;
-	}
+	//FORM FIELDS FROM THE PAYLOAD FOLLOW THE URL PARAMETERS
+	c.body.params(c.params);
 
-	//ADJUST THE POINTER OFFSETS IN CASE REALLOC GAVE US A NEW POINT IN RAM
-	_headers.__offset(_request - offset);
 
+	//RETURN HTTP STATUS 200 "OK"
+	return HTTP_OK;
+}
 
-	//SET THE PAYLOAD BUFFER
-	_requestPayload = _request + hlength;
 
 
-	//PARSE THE FIRST LINE OF THE HEADER
-	{
-		char *header	= (char*) _headers.key(0);
-		auto code		= _parseVersion(header);
-		if (code != HTTP_OK) return code;
-	}
+
+////////////////////////////////////////////////////////////////////////////////
+// THE REQUEST LINE AND HEADERS ARE IN, SET UP THE REQUEST AND ITS PAYLOAD
+// RETURNS HTTP_CONTINUE WHILE MORE OF THE PAYLOAD IS EXPECTED
+////////////////////////////////////////////////////////////////////////////////
+HTTPStatus ESP8266WebServer::_parseHeaders() {
+	HTTPConnection &c = *_current;
+
+
+	//POINT THE REQUEST LINE AND HEADERS AT THE TOKENIZED BUFFER
+	c.requestMethod		= c.parser.method(c.request);
+	c.requestPath		= c.parser.path(c.request);
+	c.requestParams		= c.parser.params(c.request);
+	c.requestVersion	= c.parser.version(c.request);
+	c.parser.headers(c.request, c.headers);
+
+
+
+#	ifdef DEBUG_ESP_HTTP_SERVER
+		DEBUG_OUTPUT.print(F("Method: ("));
+		DEBUG_OUTPUT.print(c.requestMethod);
+		DEBUG_OUTPUT.println(F(")"));
+
+		DEBUG_OUTPUT.print(F("Path: ("));
+		DEBUG_OUTPUT.print(c.requestPath);
+		DEBUG_OUTPUT.println(F(")"));
+
+		DEBUG_OUTPUT.print(F("Parameters: ("));
+		DEBUG_OUTPUT.print(c.requestParams);
+		DEBUG_OUTPUT.println(F(")"));
+
+		DEBUG_OUTPUT.print(F("Version: ("));
+		DEBUG_OUTPUT.print(c.requestVersion);
+		DEBUG_OUTPUT.println(F(")"));
+#	endif
 
 
 
 	//PARSE REQUEST METHOD
-	_method = _parseMethod(_requestMethod);
+	c.method = _parseMethod(c.requestMethod);
+
+
+
+
+	//HTTP/1.1 CONNECTIONS ARE PERSISTENT UNLESS CLOSED, HTTP/1.0 MUST ASK FOR IT
+	{
+		c.version = (!strncmp_P(c.requestVersion, PSTR("HTTP/1."), 7)  &&  c.requestVersion[7] != '0');
+
+		const char *connection = c.headers.value("Connection");
+		c.keepAlive = c.version
+			? !_hasToken(connection, PSTR("close"))
+			:  _hasToken(connection, PSTR("keep-alive"));
+
+		if (++c.requestCount >= _keepAliveMax  ||  !_keepAliveTimeout) {
+			c.keepAlive = false;
+		}
+	}
 
 
 
 #	ifdef DEBUG_ESP_HTTP_SERVER
 		DEBUG_OUTPUT.print(F("Method detected: "));
-		DEBUG_OUTPUT.println(_method);
+		DEBUG_OUTPUT.println(c.method);
 #	endif
 
 
 
 	//PARSE URL PARAMETERS
-	if (_requestParams) {
-		_params.process(_requestParams, true);
+	if (c.requestParams) {
+		c.params.process(c.requestParams, true);
 	}
 
 
-	switch (_method) {
-		case HTTP_POST:
-		case HTTP_PUT:
-		case HTTP_PATCH:
-		case HTTP_DELETE:
-			if (_requestPayload) {
-				//TODO: THIS IS BASED ON ENCODING METHOD, CHECK THAT FIRST
-				_params.process(_requestPayload, false);
-			}
-		break;
+	//ATTACH HANDLER, THE ROUTE TABLE IS REBUILT IF A HANDLER WAS ADDED AFTER begin()
+	if (!_router.built()) {
+		_router.build(_firstHandler);
 	}
+	c.handler = _router.find(c.method, c.requestPath);
 
 
-	//ATTACH HANDLER
-	for (_handler=_firstHandler; _handler; _handler=_handler->next()) {
-		if (_handler->canHandle(_method, _requestPath)) {
-			break;
-		}
+	//PAYLOAD BYTES THAT ARRIVED WITH THE HEADERS, ANYTHING AFTER THEM IS PIPELINED
+	int headerLength	= c.parser.headerLength();
+	c.requestLength		= min(c.readBytes, c.parser.requestLength());
+
+
+	//FILE PARTS AND RAW PAYLOADS GO TO THE HANDLER AS THEY ARRIVE
+	HTTPBodyParser::TUploadFunction upload;
+	if (c.handler  &&  c.handler->canUpload(c.requestPath)) {
+		HTTPConnection *connection = &c;
+		upload = [this, connection](HTTPUpload &data) {
+			_current = connection;
+			connection->handler->upload(*this, connection->requestPath, data);
+		};
 	}
 
+	{
+		auto code = c.body.begin(c.headers.value("Content-Type"), c.parser.contentLength(), upload);
+		if (code != HTTP_OK) return code;
+	}
 
-	//FLUSH THE CLIENT BUFFER
-	client.flush();
 
+	//A CLIENT MAY WAIT FOR OUR GO-AHEAD BEFORE SENDING A LARGE PAYLOAD
+	if (c.version  &&  c.requestLength < c.parser.requestLength()
+	&&  _hasToken(c.headers.value("Expect"), PSTR("100-continue"))) {
+		static const char continue_P[] PROGMEM = "HTTP/1.1 100 Continue\r\n\r\n";
+		_currentClientWrite_P(continue_P, sizeof(continue_P) - 1);
+	}
 
-	//RETURN HTTP STATUS 200 "OK"
-	return HTTP_OK;
+
+	return c.body.parse(c.request + headerLength, c.requestLength - headerLength);
 }
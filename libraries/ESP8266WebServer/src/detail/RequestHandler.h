@@ -9,6 +9,17 @@ public:
     virtual bool handle(ESP8266WebServer& server, HTTPMethod requestMethod, String requestUri) { (void) server; (void) requestMethod; (void) requestUri; return false; }
     virtual void upload(ESP8266WebServer& server, String requestUri, HTTPUpload& upload) { (void) server; (void) requestUri; (void) upload; }
 
+    // Matching without building a String, handlers that can should override these
+    virtual bool canHandle(HTTPMethod method, const char* uri) { return canHandle(method, String(uri)); }
+    virtual bool canUpload(const char* uri) { return canUpload(String(uri)); }
+
+    // Route table hints. A handler that only ever matches routeUri() itself (ROUTE_EXACT)
+    // or URIs starting with it (ROUTE_PREFIX) is indexed by the server instead of being
+    // asked about every request. routeUri() must stay valid as long as the handler lives.
+    enum RouteType { ROUTE_ANY, ROUTE_EXACT, ROUTE_PREFIX };
+    virtual RouteType routeType() const { return ROUTE_ANY; }
+    virtual const char* routeUri() const { return nullptr; }
+
     RequestHandler* next() { return _next; }
     void next(RequestHandler* r) { _next = r; }
 
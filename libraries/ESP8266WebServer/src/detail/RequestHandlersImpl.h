@@ -4,6 +4,7 @@
 #include "RequestHandler.h"
 #include "mimetable.h"
 #include "WString.h"
+#include <algorithm>
 
 using namespace mime;
 
@@ -17,23 +18,34 @@ public:
     {
     }
 
-    bool canHandle(HTTPMethod requestMethod, String requestUri) override  {
+    RouteType routeType() const override { return ROUTE_EXACT; }
+    const char* routeUri() const override { return _uri.c_str(); }
+
+    bool canHandle(HTTPMethod requestMethod, const char* requestUri) override  {
         if (_method != HTTP_ANY && _method != requestMethod)
             return false;
 
-        if (requestUri != _uri)
+        if (strcmp(requestUri, _uri.c_str()) != 0)
             return false;
 
         return true;
     }
 
-    bool canUpload(String requestUri) override  {
+    bool canHandle(HTTPMethod requestMethod, String requestUri) override  {
+        return canHandle(requestMethod, requestUri.c_str());
+    }
+
+    bool canUpload(const char* requestUri) override  {
         if (!_ufn || !canHandle(HTTP_POST, requestUri))
             return false;
 
         return true;
     }
 
+    bool canUpload(String requestUri) override  {
+        return canUpload(requestUri.c_str());
+    }
+
     bool handle(ESP8266WebServer& server, HTTPMethod requestMethod, String requestUri) override {
         (void) server;
         if (!canHandle(requestMethod, requestUri))
@@ -57,29 +69,95 @@ protected:
     HTTPMethod _method;
 };
 
+// A window of a file, so only the requested bytes go to the client
+class FileRange : public Stream {
+public:
+    FileRange(File& file, size_t start, size_t length)
+    : _file(file)
+    , _length(length)
+    , _left(length)
+    {
+        _file.seek(start, SeekSet);
+    }
+
+    int available() override { return std::min((size_t) _file.available(), _left); }
+    int read() override {
+        if (!_left)
+            return -1;
+        _left--;
+        return _file.read();
+    }
+
+    int peek() override { return _left ? _file.peek() : -1; }
+    void flush() override { }
+    size_t write(uint8_t) override { return 0; }
+
+    size_t readBytes(char* buffer, size_t length) override {
+        size_t n = _file.readBytes(buffer, std::min(length, _left));
+        _left -= n;
+        return n;
+    }
+
+    size_t size() const { return _length; }
+    const char* name() const { return _file.name(); }
+
+protected:
+    File& _file;
+    size_t _length;
+    size_t _left;
+};
+
 class StaticRequestHandler : public RequestHandler {
 public:
-    StaticRequestHandler(FS& fs, const char* path, const char* uri, const char* cache_header)
+    StaticRequestHandler(FS& fs, const char* path, const char* uri, const char* cache_header, const char* last_modified = NULL)
     : _fs(fs)
     , _uri(uri)
     , _path(path)
     , _cache_header(cache_header)
+    , _last_modified(last_modified)
+    , _index(nullptr)
+    , _names(nullptr)
+    , _indexSize(0)
+    , _indexed(false)
     {
         _isFile = fs.exists(path);
         DEBUGV("StaticRequestHandler: path=%s uri=%s isFile=%d, cache_header=%s\r\n", path, uri, _isFile, cache_header);
         _baseUriLength = _uri.length();
+        buildIndex();
     }
 
-    bool canHandle(HTTPMethod requestMethod, String requestUri) override  {
+    ~StaticRequestHandler() {
+        free(_index);
+        free(_names);
+    }
+
+    RouteType routeType() const override { return _isFile ? ROUTE_EXACT : ROUTE_PREFIX; }
+    const char* routeUri() const override { return _uri.c_str(); }
+
+    bool canHandle(HTTPMethod requestMethod, const char* requestUri) override  {
         if (requestMethod != HTTP_GET)
             return false;
 
-        if ((_isFile && requestUri != _uri) || !requestUri.startsWith(_uri))
+        if (_isFile ? strcmp(requestUri, _uri.c_str()) != 0 : strncmp(requestUri, _uri.c_str(), _baseUriLength) != 0)
             return false;
 
         return true;
     }
 
+    bool canHandle(HTTPMethod requestMethod, String requestUri) override  {
+        return canHandle(requestMethod, requestUri.c_str());
+    }
+
+    bool canUpload(const char* requestUri) override  {
+        (void) requestUri;
+        return false;
+    }
+
+    bool canUpload(String requestUri) override  {
+        (void) requestUri;
+        return false;
+    }
+
     bool handle(ESP8266WebServer& server, HTTPMethod requestMethod, String requestUri) override {
         if (!canHandle(requestMethod, requestUri))
             return false;
@@ -99,40 +177,323 @@ public:
         }
         DEBUGV("StaticRequestHandler::handle: path=%s, isFile=%d\r\n", path.c_str(), _isFile);
 
-        String contentType = getContentType(path);
+        if (_fs.generation() != _generation)
+            buildIndex();
+        else if (_fs.contentGeneration() != _contentGeneration)
+            forgetContent();
+
+        String contentType;
+        IndexEntry* entry = nullptr;
 
-        // look for gz file, only if the original specified path is not a gz.  So part only works to send gzip via content encoding when a non compressed is asked for
-        // if you point the the path to gzip you will serve the gzip as content type "application/x-gzip", not text or javascript etc...
-        if (!path.endsWith(FPSTR(mimeTable[gz].endsWith)) && !_fs.exists(path))  {
-            String pathWithGz = path + FPSTR(mimeTable[gz].endsWith);
-            if(_fs.exists(pathWithGz))
-                path += FPSTR(mimeTable[gz].endsWith);
+        if (_indexed) {
+            // The index knows which variants exist, unknown paths are answered without touching the FS
+            entry = findIndex(path.c_str(), path.length());
+            if (entry) {
+                contentType = FPSTR(mimeTable[entry->mime].mimeType);
+                if (!(entry->flags & INDEX_PLAIN))
+                    path += FPSTR(mimeTable[gz].endsWith);
+            } else {
+                // An explicit request for the ".gz" file itself
+                size_t length = stripGz(path.c_str(), path.length());
+                entry = length != path.length() ? findIndex(path.c_str(), length) : nullptr;
+                if (!entry || !(entry->flags & INDEX_GZ))
+                    return false;
+                contentType = FPSTR(mimeTable[gz].mimeType);
+            }
+        } else {
+            contentType = getContentType(path);
+
+            // look for gz file, only if the original specified path is not a gz.  So part only works to send gzip via content encoding when a non compressed is asked for
+            // if you point the the path to gzip you will serve the gzip as content type "application/x-gzip", not text or javascript etc...
+            if (!path.endsWith(FPSTR(mimeTable[gz].endsWith)) && !_fs.exists(path))  {
+                String pathWithGz = path + FPSTR(mimeTable[gz].endsWith);
+                if(_fs.exists(pathWithGz))
+                    path += FPSTR(mimeTable[gz].endsWith);
+            }
         }
 
         File f = _fs.open(path, "r");
         if (!f)
             return false;
 
+        // SPIFFS keeps no timestamps, so the ETag is made from the content and size of the file served.
+        // The content hash is kept in the index until a written file is closed or flushed, which
+        // takes one extra read of the file per change. Last-Modified is only known when the sketch passed it to serveStatic().
+        uint8_t hashed = path.endsWith(FPSTR(mimeTable[gz].endsWith)) ? INDEX_GZ_HASHED : INDEX_PLAIN_HASHED;
+        uint32_t content;
+        if (entry && (entry->flags & hashed)) {
+            content = hashed == INDEX_GZ_HASHED ? entry->gzContent : entry->plainContent;
+        } else {
+            content = hashContent(f);
+            if (entry) {
+                (hashed == INDEX_GZ_HASHED ? entry->gzContent : entry->plainContent) = content;
+                entry->flags |= hashed;
+            }
+        }
+        char etag[20];
+        sprintf(etag, "\"%08x-%x\"", (unsigned) content, (unsigned) f.size());
+
         if (_cache_header.length() != 0)
-            server.sendHeader("Cache-Control", _cache_header);
+            server.sendHeader("Cache-Control", _cache_header.c_str());
+        server.sendHeader("ETag", etag);
+        if (_last_modified.length() != 0)
+            server.sendHeader("Last-Modified", _last_modified.c_str());
 
-        server.streamFile(f, contentType);
+        if (notModified(server, etag)) {
+            server.setContentLength(f.size());
+            server.send(HTTP_NOT_MODIFIED, contentType, String());
+            return true;
+        }
+
+        server.sendHeader("Accept-Ranges", "bytes");
+
+        size_t start, end;
+        switch (range(server, etag, f.size(), start, end)) {
+        case RANGE_NONE:
+            server.streamFile(f, contentType);
+            break;
+
+        case RANGE_UNSATISFIABLE: {
+            char contentRange[24];
+            sprintf(contentRange, "bytes */%u", (unsigned) f.size());
+            server.sendHeader("Content-Range", contentRange);
+            server.setContentLength(0);
+            server.send(HTTP_RANGE_ERROR, contentType, String());
+            break;
+        }
+
+        case RANGE_SATISFIABLE: {
+            char contentRange[40];
+            sprintf(contentRange, "bytes %u-%u/%u", (unsigned) start, (unsigned) end, (unsigned) f.size());
+            server.sendHeader("Content-Range", contentRange);
+            FileRange part(f, start, end - start + 1);
+            server.streamFile(part, contentType, HTTP_PARTIAL_CONTENT);
+            break;
+        }
+        }
         return true;
     }
 
+    static uint32_t hashPath(const char* path, size_t length) {
+        uint32_t hash = 2166136261u;
+        while (length--) {
+            hash ^= (uint8_t) *path++;
+            hash *= 16777619u;
+        }
+        return hash;
+    }
+
+    static uint32_t hashContent(File& f) {
+        uint32_t hash = 2166136261u;
+        uint8_t buffer[128];
+        size_t length;
+        while ((length = f.read(buffer, sizeof(buffer))) > 0) {
+            for (size_t i = 0; i < length; i++) {
+                hash ^= buffer[i];
+                hash *= 16777619u;
+            }
+        }
+        f.seek(0, SeekSet);
+        return hash;
+    }
+
+    // Length of path without a trailing ".gz"
+    static size_t stripGz(const char* path, size_t length) {
+        size_t gzLength = strlen_P(mimeTable[gz].endsWith);
+        if (length > gzLength && strcmp_P(path + length - gzLength, mimeTable[gz].endsWith) == 0)
+            return length - gzLength;
+        return length;
+    }
+
+    // If-None-Match wins over If-Modified-Since, which can only match the exact Last-Modified we sent
+    bool notModified(ESP8266WebServer& server, const char* etag) {
+        const char* match = server.header("If-None-Match");
+        if (match)
+            return strcmp(match, "*") == 0 || strstr(match, etag) != NULL;
+
+        const char* since = server.header("If-Modified-Since");
+        return since && _last_modified.length() != 0 && strcmp(since, _last_modified.c_str()) == 0;
+    }
+
+    enum RangeResult { RANGE_NONE, RANGE_UNSATISFIABLE, RANGE_SATISFIABLE };
+
+    // A single "bytes=first-last", "bytes=first-" or "bytes=-suffix" range. Anything else,
+    // including multiple ranges and a stale If-Range, is ignored and the whole file is sent.
+    static RangeResult range(ESP8266WebServer& server, const char* etag, size_t size, size_t& start, size_t& end) {
+        const char* value = server.header("Range");
+        if (!value || strncasecmp(value, "bytes=", 6) != 0 || strchr(value, ','))
+            return RANGE_NONE;
+
+        const char* ifRange = server.header("If-Range");
+        if (ifRange && strcmp(ifRange, etag) != 0)
+            return RANGE_NONE;
+
+        value += 6;
+        while (*value == ' ') value++;
+
+        char* next;
+        bool suffix = *value == '-';
+        if (!suffix && !isdigit((unsigned char) *value))
+            return RANGE_NONE;
+        unsigned long first = suffix ? 0 : strtoul(value, &next, 10);
+        if (!suffix) value = next;
+        if (*value++ != '-')
+            return RANGE_NONE;
+
+        bool open = !isdigit((unsigned char) *value);
+        unsigned long last = open ? 0 : strtoul(value, &next, 10);
+        if (!open) value = next;
+        while (*value == ' ') value++;
+        if (*value || (suffix && open) || (!open && !suffix && last < first))
+            return RANGE_NONE;
+
+        if (suffix) {
+            if (last == 0 || size == 0)
+                return RANGE_UNSATISFIABLE;
+            start = last < size ? size - last : 0;
+            end = size - 1;
+            return RANGE_SATISFIABLE;
+        }
+
+        if (first >= size)
+            return RANGE_UNSATISFIABLE;
+        start = first;
+        end = open || last >= size ? size - 1 : last;
+        return RANGE_SATISFIABLE;
+    }
+
     static String getContentType(const String& path) {
-        char buff[sizeof(mimeTable[0].mimeType)];
-        // Check all entries but last one for match, return if found
-        for (size_t i=0; i < sizeof(mimeTable)/sizeof(mimeTable[0])-1; i++) {
-            strcpy_P(buff, mimeTable[i].endsWith);
-            if (path.endsWith(buff)) {
-                strcpy_P(buff, mimeTable[i].mimeType);
-                return String(buff);
+        return String(FPSTR(mimeTable[getMimeType(path.c_str(), path.length())].mimeType));
+    }
+
+    static type getMimeType(const char* path, size_t length) {
+        // Check all entries but last one for match, fall through to the default type
+        const size_t last = sizeof(mimeTable)/sizeof(mimeTable[0])-1;
+        for (size_t i=0; i < last; i++) {
+            size_t suffix = strlen_P(mimeTable[i].endsWith);
+            if (length >= suffix && strncmp_P(path + length - suffix, mimeTable[i].endsWith, suffix) == 0)
+                return (type) i;
+        }
+        return (type) last;
+    }
+
+    // The served files are listed once into a table sorted by path hash and listed again
+    // only when FS::generation() says files were created, removed or renamed since.
+    // Each entry keeps its name after _path, so a hash collision cannot serve the wrong file.
+    // Sizes are not kept, the opened file has them and they change while a file is written.
+    // Content hashes for the ETag are filled in when a variant is first served, and dropped
+    // when FS::contentGeneration() says a written file was flushed or closed since.
+    enum { INDEX_PLAIN = 1, INDEX_GZ = 2, INDEX_PLAIN_HASHED = 4, INDEX_GZ_HASHED = 8 };
+
+    struct IndexEntry {
+        uint32_t hash;          // of the path without ".gz"
+        const char* name;       // the path without _path and ".gz", in _names
+        uint32_t plainContent;  // hash of the content of path
+        uint32_t gzContent;     // hash of the content of path.gz
+        uint8_t flags;          // which of path and path.gz exist, which contents are hashed
+        uint8_t mime;           // type of path
+    };
+
+    // Name of a file below _path, or nullptr for files this handler does not serve.
+    // openDir() matches any path prefix, so "/www" also lists "/www2/a.txt".
+    const char* indexName(const String& name) const {
+        if (!name.startsWith(_path))
+            return nullptr;
+        const char* rest = name.c_str() + _path.length();
+        if (_isFile)
+            return !*rest || strcmp_P(rest, mimeTable[gz].endsWith) == 0 ? rest : nullptr;
+        if (!_path.endsWith("/") && *rest != '/')
+            return nullptr;
+        return rest;
+    }
+
+    void forgetContent() {
+        _contentGeneration = _fs.contentGeneration();
+        for (size_t i = 0; i < _indexSize; i++)
+            _index[i].flags &= ~(INDEX_PLAIN_HASHED | INDEX_GZ_HASHED);
+    }
+
+    void buildIndex() {
+        free(_index);
+        free(_names);
+        _index = nullptr;
+        _names = nullptr;
+        _indexSize = 0;
+        _indexed = false;
+        _generation = _fs.generation();
+        _contentGeneration = _fs.contentGeneration();
+
+        size_t count = 0;
+        size_t namesSize = 0;
+        Dir dir = _fs.openDir(_path);
+        while (dir.next()) {
+            String name = dir.fileName();
+            const char* rest = indexName(name);
+            if (rest) {
+                count++;
+                namesSize += strlen(rest) + 1;
             }
         }
-        // Fall-through and just return default type
-        strcpy_P(buff, mimeTable[sizeof(mimeTable)/sizeof(mimeTable[0])-1].mimeType);
-        return String(buff);
+
+        _index = (IndexEntry*) malloc(std::max(count, (size_t) 1) * sizeof(IndexEntry));
+        _names = (char*) malloc(std::max(namesSize, (size_t) 1));
+        if (!_index || !_names)
+            return;
+
+        char* names = _names;
+        dir = _fs.openDir(_path);
+        while (_indexSize < count && dir.next()) {
+            String name = dir.fileName();
+            const char* rest = indexName(name);
+            if (!rest)
+                continue;
+            // ".gz" is only stripped from the part below _path
+            size_t prefix = rest - name.c_str();
+            size_t length = stripGz(name.c_str(), name.length());
+            if (length < prefix)
+                length = name.length();
+            size_t restLength = length - prefix;
+            if (restLength >= namesSize - (names - _names))
+                continue;
+            IndexEntry& entry = _index[_indexSize++];
+            entry.hash = hashPath(name.c_str(), length);
+            entry.name = names;
+            memcpy(names, rest, restLength);
+            names[restLength] = '\0';
+            names += restLength + 1;
+            entry.flags = length == name.length() ? INDEX_PLAIN : INDEX_GZ;
+            entry.mime = getMimeType(name.c_str(), length);
+        }
+
+        // path and path.gz share one entry
+        std::sort(_index, _index + _indexSize, [](const IndexEntry& a, const IndexEntry& b) {
+            return a.hash < b.hash || (a.hash == b.hash && strcmp(a.name, b.name) < 0);
+        });
+        size_t unique = 0;
+        for (size_t i = 0; i < _indexSize; i++) {
+            if (unique && _index[unique - 1].hash == _index[i].hash && strcmp(_index[unique - 1].name, _index[i].name) == 0)
+                _index[unique - 1].flags |= _index[i].flags;
+            else
+                _index[unique++] = _index[i];
+        }
+        _indexSize = unique;
+        _indexed = true;
+    }
+
+    // path always starts with _path, only the rest of it is compared with the stored names
+    IndexEntry* findIndex(const char* path, size_t length) const {
+        if (length < _path.length())
+            return nullptr;
+        uint32_t hash = hashPath(path, length);
+        const char* rest = path + _path.length();
+        size_t restLength = length - _path.length();
+        IndexEntry* end = _index + _indexSize;
+        IndexEntry* entry = std::lower_bound(_index, end, hash, [](const IndexEntry& e, uint32_t h) { return e.hash < h; });
+        for (; entry != end && entry->hash == hash; entry++) {
+            if (strncmp(entry->name, rest, restLength) == 0 && entry->name[restLength] == '\0')
+                return entry;
+        }
+        return nullptr;
     }
 
 protected:
@@ -140,8 +501,15 @@ protected:
     String _uri;
     String _path;
     String _cache_header;
+    String _last_modified;
     bool _isFile;
     size_t _baseUriLength;
+    IndexEntry* _index;
+    char* _names;
+    size_t _indexSize;
+    bool _indexed;
+    uint32_t _generation;
+    uint32_t _contentGeneration;
 };
 
 
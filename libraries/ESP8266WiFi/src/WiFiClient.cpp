@@ -208,6 +208,28 @@ size_t WiFiClient::write_P(PGM_P buf, size_t size)
     return _client->write_P(buf, size);
 }
 
+size_t WiFiClient::write_nocopy(const uint8_t *buf, size_t size, void (*release)(void*, const uint8_t*), void* arg)
+{
+    if (!_client || !size)
+    {
+        if (release)
+            release(arg, buf);
+        return 0;
+    }
+    _client->setTimeout(_timeout);
+    return _client->write_nocopy(buf, size, release, arg);
+}
+
+size_t WiFiClient::writev(const WriteSegment *segments, size_t count)
+{
+    if (!_client || !count)
+    {
+        return 0;
+    }
+    _client->setTimeout(_timeout);
+    return _client->writev(segments, count);
+}
+
 int WiFiClient::available()
 {
     if (!_client)
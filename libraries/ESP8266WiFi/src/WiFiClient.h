@@ -27,6 +27,7 @@
 #include "Client.h"
 #include "IPAddress.h"
 #include "include/slist.h"
+#include "include/DataSource.h"
 
 #define WIFICLIENT_MAX_PACKET_SIZE 1460
 
@@ -55,6 +56,10 @@ public:
   virtual size_t write(const uint8_t *buf, size_t size);
   virtual size_t write_P(PGM_P buf, size_t size);
   size_t write(Stream& stream);
+  // Send a RAM buffer without copying it, see ClientContext::write_nocopy for the lifetime rules
+  virtual size_t write_nocopy(const uint8_t *buf, size_t size, void (*release)(void*, const uint8_t*) = nullptr, void* arg = nullptr);
+  // Send several RAM and PROGMEM pieces as if they were one buffer
+  virtual size_t writev(const WriteSegment *segments, size_t count);
 
   // This one is deprecated, use write(Stream& instead)
   size_t write(Stream& stream, size_t unitSize) __attribute__ ((deprecated));
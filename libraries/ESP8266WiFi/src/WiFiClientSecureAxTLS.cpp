@@ -566,6 +566,31 @@ size_t WiFiClientSecure::write_P(PGM_P buf, size_t size)
     return write(copy, size);
 }
 
+// Records are encrypted into our own buffer, so the caller's one is free right away
+size_t WiFiClientSecure::write_nocopy(const uint8_t *buf, size_t size, void (*release)(void*, const uint8_t*), void* arg)
+{
+    size_t sent = write(buf, size);
+    if (release) {
+        release(arg, buf);
+    }
+    return sent;
+}
+
+// Each piece becomes its own record, there is no TCP segment to pack them into
+size_t WiFiClientSecure::writev(const WriteSegment *segments, size_t count)
+{
+    size_t sent = 0;
+    for (size_t i = 0; i < count; i++) {
+        const WriteSegment& segment = segments[i];
+        size_t wrote = segment.progmem ? write_P((PGM_P) segment.data, segment.size) : write(segment.data, segment.size);
+        sent += wrote;
+        if (wrote != segment.size) {
+            break;
+        }
+    }
+    return sent;
+}
+
 // The axTLS bare libs don't understand anything about Arduino Streams,
 // so we have to manually read and send individual chunks.
 size_t WiFiClientSecure::write(Stream& stream)
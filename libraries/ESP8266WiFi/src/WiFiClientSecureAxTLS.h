@@ -45,6 +45,8 @@ public:
   uint8_t connected() override;
   size_t write(const uint8_t *buf, size_t size) override;
   size_t write_P(PGM_P buf, size_t size) override;
+  size_t write_nocopy(const uint8_t *buf, size_t size, void (*release)(void*, const uint8_t*) = nullptr, void* arg = nullptr) override;
+  size_t writev(const WriteSegment *segments, size_t count) override;
   size_t write(Stream& stream); // Note this is not virtual
   int read(uint8_t *buf, size_t size) override;
   int available() override;
@@ -286,6 +286,28 @@ size_t WiFiClientSecure::write_P(PGM_P buf, size_t size) {
   return _write((const uint8_t *)buf, size, true);
 }
 
+// Records are encrypted into our own buffer, so the caller's one is free right away
+size_t WiFiClientSecure::write_nocopy(const uint8_t *buf, size_t size, void (*release)(void*, const uint8_t*), void* arg) {
+  size_t sent = _write(buf, size, false);
+  if (release) {
+    release(arg, buf);
+  }
+  return sent;
+}
+
+// Each piece becomes its own record, there is no TCP segment to pack them into
+size_t WiFiClientSecure::writev(const WriteSegment *segments, size_t count) {
+  size_t sent = 0;
+  for (size_t i = 0; i < count; i++) {
+    size_t wrote = _write(segments[i].data, segments[i].size, segments[i].progmem);
+    sent += wrote;
+    if (wrote != segments[i].size) {
+      break;
+    }
+  }
+  return sent;
+}
+
 // We have to manually read and send individual chunks.
 size_t WiFiClientSecure::write(Stream& stream) {
   size_t totalSent = 0;
@@ -42,6 +42,8 @@ class WiFiClientSecure : public WiFiClient {
     uint8_t connected() override;
     size_t write(const uint8_t *buf, size_t size) override;
     size_t write_P(PGM_P buf, size_t size) override;
+    size_t write_nocopy(const uint8_t *buf, size_t size, void (*release)(void*, const uint8_t*) = nullptr, void* arg = nullptr) override;
+    size_t writev(const WriteSegment *segments, size_t count) override;
     size_t write(const char *buf) {
       return write((const uint8_t*)buf, strlen(buf));
     }
@@ -25,6 +25,7 @@ class ClientContext;
 class WiFiClient;
 
 typedef void (*discard_cb_t)(void*, ClientContext*);
+typedef void (*release_cb_t)(void*, const uint8_t*);
 
 extern "C" void esp_yield();
 extern "C" void esp_schedule();
@@ -50,6 +51,10 @@ public:
 
     err_t abort()
     {
+        if(_closing_pcb) {
+            _pcb = _closing_pcb;
+            _closing_pcb = nullptr;
+        }
         if(_pcb) {
             DEBUGV(":abort\r\n");
             tcp_arg(_pcb, NULL);
@@ -60,12 +65,25 @@ public:
             tcp_abort(_pcb);
             _pcb = nullptr;
         }
+        // tcp_abort freed the segments referencing it
+        _release_nocopy();
         return ERR_ABRT;
     }
 
     err_t close()
     {
         err_t err = ERR_OK;
+        // tcp_close keeps sending queued segments after we stop hearing about acks,
+        // so a referenced buffer has to be acked first. Waiting for that here would
+        // yield from destructors and lwIP callbacks: the pcb is parked instead, and
+        // _acked() closes it, or _poll() aborts it after the timeout
+        if(_pcb && _nocopy_data) {
+            DEBUGV(":close deferred\r\n");
+            _closing_pcb = _pcb;
+            _pcb = nullptr;
+            _op_start_time = millis();
+            return ERR_OK;
+        }
         if(_pcb) {
             DEBUGV(":close\r\n");
             tcp_arg(_pcb, NULL);
@@ -114,6 +132,11 @@ public:
             if(_discard_cb) {
                 _discard_cb(_discard_cb_arg, this);
             }
+            if(_closing_pcb) {
+                // the lwIP callbacks still point here, deleted once the close finished
+                _delete_pending = true;
+                return;
+            }
             DEBUGV(":del\r\n");
             delete this;
         }
@@ -327,7 +350,8 @@ public:
         if (!_pcb) {
             return 0;
         }
-        return _write_from_source(new BufferDataSource(data, size));
+        BufferDataSource source(data, size);
+        return _write_from_source(&source);
     }
 
     size_t write(Stream& stream)
@@ -335,7 +359,8 @@ public:
         if (!_pcb) {
             return 0;
         }
-        return _write_from_source(new BufferedStreamDataSource<Stream>(stream, stream.available()));
+        BufferedStreamDataSource<Stream> source(stream, stream.available());
+        return _write_from_source(&source);
     }
 
     size_t write_P(PGM_P buf, size_t size)
@@ -344,7 +369,54 @@ public:
             return 0;
         }
         ProgmemStream stream(buf, size);
-        return _write_from_source(new BufferedStreamDataSource<ProgmemStream>(stream, size));
+        BufferedStreamDataSource<ProgmemStream> source(stream, size);
+        return _write_from_source(&source);
+    }
+
+    // All segments go out as one write: a single wait loop, and the pieces are packed
+    // into full TCP segments with one tcp_output() per window
+    size_t writev(const WriteSegment* segments, size_t count)
+    {
+        if (!_pcb) {
+            return 0;
+        }
+        SegmentDataSource source(segments, count);
+        return _write_from_source(&source);
+    }
+
+    // Queue a RAM buffer without copying it, lwIP references it until the peer acked the last byte.
+    // Without release the call returns only then. With release it returns once the data is queued
+    // and release(arg, data) is called from the ack callback, or when the connection goes away.
+    // release is called exactly once, also when nothing could be written.
+    // Only one buffer is referenced at a time, a second call first waits for the previous one.
+    // close() doesn't wait, the connection is closed in the background once the buffer is acked.
+    // PROGMEM can't be passed here: lwIP reads payload bytes for checksums, use write_P instead.
+    size_t write_nocopy(const uint8_t* data, size_t size, release_cb_t release = nullptr, void* arg = nullptr)
+    {
+        if (!_wait_nocopy()) {
+            abort();
+        }
+
+        size_t written = 0;
+        if (_pcb) {
+            BufferDataSource source(data, size);
+            _nocopy = true;
+            written = _write_from_source(&source);
+            _nocopy = false;
+        }
+
+        _nocopy_release = release;
+        _nocopy_arg = arg;
+        _nocopy_data = data;
+        if (!_pcb || !written) {
+            _release_nocopy();
+        } else {
+            _nocopy_end = _pcb->snd_lbb;
+            if (!release && !_wait_nocopy()) {
+                abort();
+            }
+        }
+        return written;
     }
 
     void keepAlive (uint16_t idle_sec = TCP_DEFAULT_KEEPALIVE_IDLE_SEC, uint16_t intv_sec = TCP_DEFAULT_KEEPALIVE_INTERVAL_SEC, uint8_t count = TCP_DEFAULT_KEEPALIVE_COUNT)
@@ -409,7 +481,6 @@ protected:
                 if (_is_timeout()) {
                     DEBUGV(":wtmo\r\n");
                 }
-                delete _datasource;
                 _datasource = nullptr;
                 break;
             }
@@ -436,14 +507,19 @@ protected:
         DEBUGV(":wr %d %d %d\r\n", will_send, left, _written);
         bool need_output = false;
         while( will_send && _datasource) {
-            size_t next_chunk =
-                will_send > _write_chunk_size ? _write_chunk_size : will_send;
+            // Whole segments rather than small pieces: one pbuf per segment, a stream
+            // source never buffers more than one, and PSH is only set on the last one
+            size_t next_chunk = _datasource->chunk_size(will_send > _pcb->mss ? _pcb->mss : will_send);
             const uint8_t* buf = _datasource->get_buffer(next_chunk);
             if (state() == CLOSED) {
                 need_output = false;
                 break;
             }
-            err_t err = tcp_write(_pcb, buf, next_chunk, TCP_WRITE_FLAG_COPY);
+            uint8_t flags = _nocopy ? 0 : TCP_WRITE_FLAG_COPY;
+            if (next_chunk < left) {
+                flags |= TCP_WRITE_FLAG_MORE;
+            }
+            err_t err = tcp_write(_pcb, buf, next_chunk, flags);
             DEBUGV(":wrc %d %d %d\r\n", next_chunk, will_send, (int) err);
             if (err == ERR_OK) {
                 _datasource->release_buffer(buf, next_chunk);
@@ -455,6 +531,7 @@ protected:
                 break;
             }
             will_send -= next_chunk;
+            left -= next_chunk;
         }
         if( need_output ) {
             tcp_output(_pcb);
@@ -473,13 +550,62 @@ protected:
 
     err_t _acked(tcp_pcb* pcb, uint16_t len)
     {
-        (void) pcb;
         (void) len;
         DEBUGV(":ack %d\r\n", len);
+        if (_nocopy_data && (int32_t) (pcb->lastack - _nocopy_end) >= 0) {
+            _release_nocopy();
+            if (_closing_pcb) {
+                return _close_deferred(true);
+            }
+        }
         _write_some_from_cb();
         return ERR_OK;
     }
 
+    void _release_nocopy()
+    {
+        const uint8_t* data = _nocopy_data;
+        if (!data) {
+            return;
+        }
+        _nocopy_data = nullptr;
+        if (_nocopy_release) {
+            _nocopy_release(_nocopy_arg, data);
+        }
+    }
+
+    // Finish a close() that was waiting for the referenced buffer, from an lwIP callback.
+    // Returns ERR_ABRT when the pcb was aborted, as lwIP expects from the callback
+    err_t _close_deferred(bool acked)
+    {
+        if (acked) {
+            _pcb = _closing_pcb;
+            _closing_pcb = nullptr;
+        }
+        err_t err = acked ? close() : abort();
+        if (_delete_pending) {
+            DEBUGV(":del\r\n");
+            delete this;
+        }
+        return err;
+    }
+
+    // Wait for the referenced buffer to be acked, false on timeout
+    bool _wait_nocopy()
+    {
+        _op_start_time = millis();
+        while (_nocopy_data && !_is_timeout()) {
+            ++_send_waiting;
+            esp_yield();
+        }
+        _send_waiting = 0;
+        if (_nocopy_data) {
+            DEBUGV(":nctmo\r\n");
+            return false;
+        }
+        return true;
+    }
+
     void _consume(size_t size)
     {
         ptrdiff_t left = _rx_buf->len - _rx_buf_offset - size;
@@ -510,6 +636,14 @@ protected:
     {
         (void) pcb;
         (void) err;
+        if(_closing_pcb) {
+            // nobody reads anymore, the peer's FIN just waits for our close
+            if(pb) {
+                tcp_recved(pcb, pb->tot_len);
+                pbuf_free(pb);
+            }
+            return ERR_OK;
+        }
         if(pb == 0) { // connection closed
             DEBUGV(":rcl\r\n");
             _notify_error();
@@ -532,11 +666,21 @@ protected:
     {
         (void) err;
         DEBUGV(":er %d 0x%08x\r\n", (int) err, (uint32_t) _datasource);
+        if (_closing_pcb) {
+            // lwIP already freed the pcb
+            _closing_pcb = nullptr;
+            _release_nocopy();
+            if (_delete_pending) {
+                delete this;
+            }
+            return;
+        }
         tcp_arg(_pcb, NULL);
         tcp_sent(_pcb, NULL);
         tcp_recv(_pcb, NULL);
         tcp_err(_pcb, NULL);
         _pcb = nullptr;
+        _release_nocopy();
         _notify_error();
     }
 
@@ -552,6 +696,9 @@ protected:
 
     err_t _poll(tcp_pcb*)
     {
+        if (_closing_pcb) {
+            return _is_timeout() ? _close_deferred(false) : ERR_OK;
+        }
         _write_some_from_cb();
         return ERR_OK;
     }
@@ -592,7 +739,13 @@ private:
 
     DataSource* _datasource = nullptr;
     size_t _written = 0;
-    size_t _write_chunk_size = 256;
+    bool _nocopy = false;
+    const uint8_t* _nocopy_data = nullptr;
+    uint32_t _nocopy_end = 0;
+    release_cb_t _nocopy_release = nullptr;
+    void* _nocopy_arg = nullptr;
+    tcp_pcb* _closing_pcb = nullptr;
+    bool _delete_pending = false;
     uint32_t _timeout_ms = 5000;
     uint32_t _op_start_time = 0;
     uint8_t _send_waiting = 0;
@@ -7,6 +7,13 @@
 
 #include <assert.h>
 
+// One piece of a WiFiClient::writev(), in RAM or, when progmem is set, in flash
+struct WriteSegment {
+    const uint8_t* data;
+    size_t size;
+    bool progmem;
+};
+
 class DataSource {
 public:
     virtual ~DataSource() {}
@@ -14,6 +21,11 @@ public:
     virtual const uint8_t* get_buffer(size_t size) = 0;
     virtual void release_buffer(const uint8_t* buffer, size_t size) = 0;
 
+    // Largest piece, up to size, the next get_buffer() should be asked for
+    virtual size_t chunk_size(size_t size)
+    {
+        return size;
+    }
 };
 
 class BufferDataSource : public DataSource {
@@ -127,6 +139,75 @@ protected:
     size_t _streamPos = 0;
 };
 
+// Hands out the RAM segments in place and flash through a small bounce buffer.
+// Pieces never span segments, lwIP packs consecutive copied writes into full TCP segments.
+class SegmentDataSource : public DataSource {
+public:
+    SegmentDataSource(const WriteSegment* segments, size_t count) :
+        _segments(segments),
+        _count(count)
+    {
+        for (size_t i = 0; i < count; ++i) {
+            _left += segments[i].size;
+        }
+        _skip_empty();
+    }
+
+    size_t available() override
+    {
+        return _left;
+    }
+
+    size_t chunk_size(size_t size) override
+    {
+        if (_index == _count) {
+            return 0;
+        }
+        const WriteSegment& segment = _segments[_index];
+        size_t left = segment.size - _pos;
+        if (segment.progmem && left > sizeof(_bounce)) {
+            left = sizeof(_bounce);
+        }
+        return size < left ? size : left;
+    }
+
+    const uint8_t* get_buffer(size_t size) override
+    {
+        assert(size <= chunk_size(size));
+        const WriteSegment& segment = _segments[_index];
+        if (!segment.progmem) {
+            return segment.data + _pos;
+        }
+        memcpy_P(_bounce, segment.data + _pos, size);
+        return _bounce;
+    }
+
+    void release_buffer(const uint8_t* buffer, size_t size) override
+    {
+        (void)buffer;
+        assert(size <= _left);
+        _pos += size;
+        _left -= size;
+        _skip_empty();
+    }
+
+protected:
+    void _skip_empty()
+    {
+        while (_index < _count && _pos == _segments[_index].size) {
+            ++_index;
+            _pos = 0;
+        }
+    }
+
+    const WriteSegment* _segments;
+    size_t _count;
+    size_t _index = 0;
+    size_t _pos = 0;
+    size_t _left = 0;
+    uint8_t _bounce[128];
+};
+
 class ProgmemStream
 {
 public:
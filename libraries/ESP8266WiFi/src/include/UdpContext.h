@@ -242,6 +242,14 @@ public:
         return size;
     }
 
+    const char* peekBuffer()
+    {
+        if (!_rx_buf)
+            return nullptr;
+
+        return reinterpret_cast<const char*>(_rx_buf->payload) + _rx_buf_offset;
+    }
+
     int peek()
     {
         if (!_rx_buf || _rx_buf_offset == _rx_buf->len)
@@ -56,6 +56,7 @@ extern "C" {
 #include "lwip/igmp.h"
 #include "lwip/mem.h"
 #include "include/UdpContext.h"
+#include "MDNSParser.h"
 
 
 
@@ -65,27 +66,12 @@ extern "C" {
 #define DEBUG_ESP_MDNS_RX
 #endif
 
-#define MDNS_NAME_REF   0xC000
-
-#define MDNS_TYPE_AAAA  0x001C
-#define MDNS_TYPE_A     0x0001
-#define MDNS_TYPE_PTR   0x000C
-#define MDNS_TYPE_SRV   0x0021
-#define MDNS_TYPE_TXT   0x0010
-
-#define MDNS_CLASS_IN             0x0001
-#define MDNS_CLASS_IN_FLUSH_CACHE 0x8001
-
 #define MDNS_ANSWERS_ALL  0x0F
 #define MDNS_ANSWER_PTR   0x08
 #define MDNS_ANSWER_TXT   0x04
 #define MDNS_ANSWER_SRV   0x02
 #define MDNS_ANSWER_A     0x01
 
-#define _conn_read32() (((uint32_t)_conn->read() << 24) | ((uint32_t)_conn->read() << 16) | ((uint32_t)_conn->read() << 8) | _conn->read())
-#define _conn_read16() (((uint16_t)_conn->read() << 8) | _conn->read())
-#define _conn_read8() _conn->read()
-#define _conn_readS(b,l) _conn->read((char*)(b),l);
 
 static const IPAddress MDNS_MULTICAST_ADDR(224, 0, 0, 251);
 static const int MDNS_MULTICAST_TTL = 1;
@@ -105,44 +91,14 @@ struct MDNSTxt{
   String _txt;
 };
 
-struct MDNSAnswer {
-  MDNSAnswer* next;
-  uint8_t ip[4];
-  uint16_t port;
-  char *hostname;
-};
-
-struct MDNSQuery {
-  char _service[32];
-  char _proto[4];
-};
-
 
 MDNSResponder::MDNSResponder() : _conn(0) { 
   _services = 0;
   _instanceName = ""; 
-  _answers = 0;
-  _query = 0;
-  _newQuery = false;
-  _waitingForAnswers = false;
+  _queryService[0] = 0;
+  _queryProto[0] = 0;
 }
 MDNSResponder::~MDNSResponder() {
-  if (_query != 0) {
-    os_free(_query);
-    _query = 0;
-  }
-
-  // Clear answer list
-  MDNSAnswer *answer;
-  int numAnswers = _getNumAnswers();
-  for (int n = numAnswers - 1; n >= 0; n--) {
-    answer = _getAnswerFromIdx(n);
-    os_free(answer->hostname);
-    os_free(answer);
-    answer = 0;
-  }
-  _answers = 0;
-
   if (_conn) {
     _conn->unref();
   }
@@ -213,7 +169,18 @@ bool MDNSResponder::_listen() {
 }
 
 void MDNSResponder::update() {
-  if (!_conn || !_conn->next()) 
+  if (!_conn)
+    return;
+
+  // forget what ran out and keep asking about the browsed services
+  uint32_t now = millis();
+  const char *service;
+  const char *proto;
+  _cache.expire(now);
+  while (_cache.due(now, service, proto))
+    _sendQuery(service, proto);
+
+  if (!_conn->next())
     return;
   _parsePacket();
 }
@@ -289,22 +256,63 @@ int MDNSResponder::queryService(char *service, char *proto) {
 #ifdef DEBUG_ESP_MDNS_TX
   DEBUG_ESP_PORT.printf("queryService %s %s\n", service, proto);
 #endif  
-  while(_answers!=0){
-    MDNSAnswer *currAnswer = _answers;
-    _answers = _answers->next;
-    os_free(currAnswer->hostname);
-    os_free(currAnswer);
-    currAnswer = 0;
+  if (!_cache.browse(service, proto, nullptr))
+    return 0;
+  os_strcpy(_queryService, service);
+  os_strcpy(_queryProto, proto);
+
+  // answers still within their TTL are good enough, otherwise ask and return
+  // right away: answers are added to the cache as they arrive
+  int count = _cache.count(service, proto);
+  if (count == 0 && _cache.query(millis(), service, proto))
+    _sendQuery(service, proto);
+
+  return count;
+}
+
+bool MDNSResponder::installServiceQuery(const char* service, const char* proto, MDNSServiceCallback callback) {
+  if (!callback)
+    return false;
+  return _cache.browse(service, proto, callback);
+}
+
+bool MDNSResponder::removeServiceQuery(const char* service, const char* proto) {
+  return _cache.forget(service, proto);
+}
+
+int MDNSResponder::answerCount(const char* service, const char* proto) {
+  return _cache.count(service, proto);
+}
+
+bool MDNSResponder::answerInfo(const char* service, const char* proto, int idx, MDNSServiceInfo& info) {
+  return _cache.info(service, proto, idx, info);
+}
+
+String MDNSResponder::hostname(int idx) {
+  MDNSServiceInfo info;
+  if (!_cache.info(_queryService, _queryProto, idx, info)) {
+    return String();
   }
-  if (_query != 0) {
-    os_free(_query);
-    _query = 0;
+  return info.hostname;
+}
+
+IPAddress MDNSResponder::IP(int idx) {
+  MDNSServiceInfo info;
+  if (!_cache.info(_queryService, _queryProto, idx, info)) {
+    return IPAddress();
   }
-  _query = (struct MDNSQuery*)(os_malloc(sizeof(struct MDNSQuery)));
-  os_strcpy(_query->_service, service);
-  os_strcpy(_query->_proto, proto);
-  _newQuery = true;
-  
+  return info.ip;
+}
+
+uint16_t MDNSResponder::port(int idx) {
+  MDNSServiceInfo info;
+  if (!_cache.info(_queryService, _queryProto, idx, info)) {
+    return 0;
+  }
+  return info.port;
+}
+
+void MDNSResponder::_sendQuery(const char *service, const char *proto) {
   char underscore[] = "_";
 
   // build service name with _
@@ -329,7 +337,6 @@ int MDNSResponder::queryService(char *service, char *proto) {
   // Only supports sending one PTR query
   uint8_t questionCount = 1;
 
-  _waitingForAnswers = true;
   for (int itfn = 0; itfn < 2; itfn++) {
     struct ip_info ip_info;
     ip_addr_t ifaddr;
@@ -370,60 +377,6 @@ int MDNSResponder::queryService(char *service, char *proto) {
     _conn->append(reinterpret_cast<const char*>(ptrAttrs), 4);
     _conn->send();
   }
-
-#ifdef DEBUG_ESP_MDNS_TX
-  DEBUG_ESP_PORT.println("Waiting for answers..");
-#endif
-  delay(1000);
-
-  _waitingForAnswers = false;
-
-  return _getNumAnswers();
-}
-
-String MDNSResponder::hostname(int idx) {
-  MDNSAnswer *answer = _getAnswerFromIdx(idx);
-  if (answer == 0) {
-    return String();
-  }
-  return answer->hostname;
-}
-
-IPAddress MDNSResponder::IP(int idx) {
-  MDNSAnswer *answer = _getAnswerFromIdx(idx);
-  if (answer == 0) {
-    return IPAddress();
-  }
-  return IPAddress(answer->ip);
-}
-
-uint16_t MDNSResponder::port(int idx) {
-  MDNSAnswer *answer = _getAnswerFromIdx(idx);
-  if (answer == 0) {
-    return 0;
-  }
-  return answer->port;
-}
-
-MDNSAnswer* MDNSResponder::_getAnswerFromIdx(int idx) {
-  MDNSAnswer *answer = _answers;
-  while (answer != 0 && idx-- > 0) {
-    answer = answer->next;
-  }
-  if (idx > 0) {
-    return 0;
-  }
-  return answer;
-}
-
-int MDNSResponder::_getNumAnswers() {
-  int numAnswers = 0;
-  MDNSAnswer *answer = _answers;
-  while (answer != 0) {
-    numAnswers++;
-    answer = answer->next;
-  }
-  return numAnswers;
 }
 
 MDNSTxt * MDNSResponder::_getServiceTxt(char *name, char *proto){
@@ -475,494 +428,119 @@ IPAddress MDNSResponder::_getRequestMulticastInterface(){
   return IPAddress(ip_info.ip.addr);
 }
 
-void MDNSResponder::_parsePacket(){
-  int i;
-  char tmp;
-  bool serviceParsed = false;
-  bool protoParsed = false;
-  bool localParsed = false;
-
-  char hostName[255];
-  uint8_t hostNameLen;
-
-  char serviceName[32];
-  uint8_t serviceNameLen;
-  uint16_t servicePort = 0;
-
-  char protoName[32];
-  protoName[0] = 0;
-  uint8_t protoNameLen = 0;
-
-  uint16_t packetHeader[6];
-
-  for(i=0; i<6; i++) 
-    packetHeader[i] = _conn_read16();
-
-  if ((packetHeader[1] & 0x8000) != 0) { // Read answers
-#ifdef DEBUG_ESP_MDNS_RX
-    DEBUG_ESP_PORT.printf("Reading answers RX: REQ, ID:%u, Q:%u, A:%u, NS:%u, ADD:%u\n", packetHeader[0], packetHeader[2], packetHeader[3], packetHeader[4], packetHeader[5]);
-#endif
-
-    if (!_waitingForAnswers) {
-#ifdef DEBUG_ESP_MDNS_RX
-      DEBUG_ESP_PORT.println("Not expecting any answers right now, returning");
-#endif
-      _conn->flush();
-      return;
-    }
-
-    int numAnswers = packetHeader[3] + packetHeader[5];
-    // Assume that the PTR answer always comes first and that it is always accompanied by a TXT, SRV, AAAA (optional) and A answer in the same packet.
-    if (numAnswers < 4) {
-#ifdef DEBUG_ESP_MDNS_RX
-      DEBUG_ESP_PORT.printf("Expected a packet with 4 or more answers, got %u\n", numAnswers);
-#endif
-      _conn->flush();
-      return;
-    }
-    
-    uint8_t tmp8;
-    uint16_t answerPort = 0;
-    uint8_t answerIp[4] = { 0,0,0,0 };
-    char answerHostName[255];
-    bool serviceMatch = false;
-    MDNSAnswer *answer;
-    uint8_t partsCollected = 0;
-    uint8_t stringsRead = 0;
-
-    answerHostName[0] = '\0';
-
-    // Clear answer list
-    if (_newQuery) {
-      int oldAnswers = _getNumAnswers();
-      for (int n = oldAnswers - 1; n >= 0; n--) {
-        answer = _getAnswerFromIdx(n);
-        os_free(answer->hostname);
-        os_free(answer);
-        answer = 0;
-      }
-      _answers = 0;
-      _newQuery = false;
-    }
-
-    while (numAnswers--) {
-      // Read name
-      stringsRead = 0;
-      size_t last_bufferpos = 0;
-      do {
-        tmp8 = _conn_read8();
-        if (tmp8 == 0x00) { // End of name
-          break;
-        }
-        if (tmp8 & 0xC0) { // Compressed pointer
-          uint16_t offset = ((((uint16_t)tmp8) & ~0xC0) << 8) | _conn_read8();
-          if (_conn->isValidOffset(offset)) {
-              if (0 == last_bufferpos)
-                last_bufferpos  = _conn->tell();
-#ifdef DEBUG_ESP_MDNS_RX
-              DEBUG_ESP_PORT.print("Compressed pointer, jumping from ");
-              DEBUG_ESP_PORT.print(last_bufferpos);
-              DEBUG_ESP_PORT.print(" to ");
-              DEBUG_ESP_PORT.println(offset);
-#endif
-              _conn->seek(offset);
-              tmp8 = _conn_read8();
-          }
-          else {
-#ifdef DEBUG_ESP_MDNS_RX
-              DEBUG_ESP_PORT.print("Skipping malformed compressed pointer");
-#endif
-              tmp8 = _conn_read8();
-              break;
-          }
-        }
-        if(stringsRead > 3){
-#ifdef DEBUG_ESP_MDNS_RX
-          DEBUG_ESP_PORT.println("failed to read the response name");
-#endif
-          _conn->flush();
-          return;
-        }
-        _conn_readS(serviceName, tmp8);
-        serviceName[tmp8] = '\0';
-#ifdef DEBUG_ESP_MDNS_RX
-        DEBUG_ESP_PORT.printf(" %d ", tmp8);
-        for (int n = 0; n < tmp8; n++) {
-          DEBUG_ESP_PORT.printf("%c", serviceName[n]);
-        }
-        DEBUG_ESP_PORT.println();
-#endif
-        if (serviceName[0] == '_') {
-          if (strcmp(&serviceName[1], _query->_service) == 0) {
-            serviceMatch = true;
-#ifdef DEBUG_ESP_MDNS_RX
-            DEBUG_ESP_PORT.printf("found matching service: %s\n", _query->_service);
-#endif
-          }
-        }
-        stringsRead++;
-      } while (true);
-      if (last_bufferpos > 0)
-      {
-          _conn->seek(last_bufferpos);
-#ifdef DEBUG_ESP_MDNS_RX
-          DEBUG_ESP_PORT.print("Compressed pointer, jumping back to ");
-          DEBUG_ESP_PORT.println(last_bufferpos);
-#endif
-      }
-
-      uint16_t answerType = _conn_read16(); // Read type
-      uint16_t answerClass = _conn_read16(); // Read class
-      uint32_t answerTtl = _conn_read32(); // Read ttl
-      uint16_t answerRdlength = _conn_read16(); // Read rdlength
-
-      (void) answerClass;
-      (void) answerTtl;
-
-      if(answerRdlength > 255){
-        if(answerType == MDNS_TYPE_TXT && answerRdlength < 1460){
-          while(--answerRdlength) _conn->read();
-        } else {
-#ifdef DEBUG_ESP_MDNS_RX
-        DEBUG_ESP_PORT.printf("Data len too long! %u\n", answerRdlength);
-#endif
-          _conn->flush();
-          return;
-        }
-      }
-
-#ifdef DEBUG_ESP_MDNS_RX
-      DEBUG_ESP_PORT.printf("type: %04x rdlength: %d\n", answerType, answerRdlength);
-#endif
-
-      if (answerType == MDNS_TYPE_PTR) {
-        partsCollected |= 0x01;
-        _conn_readS(hostName, answerRdlength); // Read rdata
-        if(hostName[answerRdlength-2] & 0xc0){
-          memcpy(answerHostName, hostName+1, answerRdlength-3);
-          answerHostName[answerRdlength-3] = '\0';
-        }
-#ifdef DEBUG_ESP_MDNS_RX
-        DEBUG_ESP_PORT.printf("PTR %d ", answerRdlength);
-        for (int n = 0; n < answerRdlength; n++) {
-          DEBUG_ESP_PORT.printf("%c", hostName[n]);
-        }
-        DEBUG_ESP_PORT.println();
-#endif
-      }
-
-      else if (answerType == MDNS_TYPE_TXT) {
-        partsCollected |= 0x02;
-        _conn_readS(hostName, answerRdlength); // Read rdata
-#ifdef DEBUG_ESP_MDNS_RX
-        DEBUG_ESP_PORT.printf("TXT %d ", answerRdlength);
-        for (int n = 0; n < answerRdlength; n++) {
-          DEBUG_ESP_PORT.printf("%c", hostName[n]);
-        }
-        DEBUG_ESP_PORT.println();
-#endif
-      }
-
-      else if (answerType == MDNS_TYPE_SRV) {
-        partsCollected |= 0x04;
-        uint16_t answerPrio = _conn_read16(); // Read priority
-        uint16_t answerWeight = _conn_read16(); // Read weight
-        answerPort = _conn_read16(); // Read port
-        last_bufferpos = 0;
-
-        (void) answerPrio;
-        (void) answerWeight;
-
-        // Read hostname
-        tmp8 = _conn_read8();
-        if (tmp8 & 0xC0) { // Compressed pointer
-          uint16_t offset = ((((uint16_t)tmp8) & ~0xC0) << 8) | _conn_read8();
-          if (_conn->isValidOffset(offset)) {
-              last_bufferpos = _conn->tell();
-#ifdef DEBUG_ESP_MDNS_RX
-              DEBUG_ESP_PORT.print("Compressed pointer, jumping from ");
-              DEBUG_ESP_PORT.print(last_bufferpos);
-              DEBUG_ESP_PORT.print(" to ");
-              DEBUG_ESP_PORT.println(offset);
-#endif
-              _conn->seek(offset);
-              tmp8 = _conn_read8();
-          }
-          else {
-#ifdef DEBUG_ESP_MDNS_RX
-              DEBUG_ESP_PORT.print("Skipping malformed compressed pointer");
-#endif
-              tmp8 = _conn_read8();
-              break;
-          }
-        }
-        _conn_readS(answerHostName, tmp8);
-        answerHostName[tmp8] = '\0';
-#ifdef DEBUG_ESP_MDNS_RX
-        DEBUG_ESP_PORT.printf("SRV %d ", tmp8);
-        for (int n = 0; n < tmp8; n++) {
-          DEBUG_ESP_PORT.printf("%02x ", answerHostName[n]);
-        }
-        DEBUG_ESP_PORT.printf("\n%s\n", answerHostName);
-#endif
-        if (last_bufferpos > 0)
-        {
-          _conn->seek(last_bufferpos);
-          tmp8 = 2; // Size of compression octets
-#ifdef DEBUG_ESP_MDNS_RX
-          DEBUG_ESP_PORT.print("Compressed pointer, jumping back to ");
-          DEBUG_ESP_PORT.println(last_bufferpos);
-#endif
-        }
-        if (answerRdlength - (6 + 1 + tmp8) > 0) { // Skip any remaining rdata
-          _conn_readS(hostName, answerRdlength - (6 + 1 + tmp8));
-        }
-      }
-
-      else if (answerType == MDNS_TYPE_A) {
-        partsCollected |= 0x08;
-        for (int i = 0; i < 4; i++) {
-          answerIp[i] = _conn_read8();
-        }
-      }
-      else {
-#ifdef DEBUG_ESP_MDNS_RX
-          DEBUG_ESP_PORT.printf("Ignoring unsupported type %02x\n", tmp8);
-#endif
-          for (int n = 0; n < answerRdlength; n++)
-		(void)_conn_read8();
-      }
-
-      if ((partsCollected == 0x0F) && serviceMatch) {
-#ifdef DEBUG_ESP_MDNS_RX
-        DEBUG_ESP_PORT.println("All answers parsed, adding to _answers list..");
-#endif
-        // Add new answer to answer list
-        if (_answers == 0) {
-          _answers = (struct MDNSAnswer*)(os_malloc(sizeof(struct MDNSAnswer)));
-          answer = _answers;
-        }
-        else {
-          answer = _answers;
-          while (answer->next != 0) {
-            answer = answer->next;
-          }
-          answer->next = (struct MDNSAnswer*)(os_malloc(sizeof(struct MDNSAnswer)));
-          answer = answer->next;
-        }
-        answer->next = 0;
-        answer->hostname = 0;
+bool MDNSResponder::_isOwnName(const uint8_t *label) {
+  return MDNSPacket::labelIs(label, _hostName.c_str()) || MDNSPacket::labelIs(label, _instanceName.c_str());
+}
 
-        // Populate new answer
-        answer->port = answerPort;
-        for (int i = 0; i < 4; i++) {
-          answer->ip[i] = answerIp[i];
-        }
-        answer->hostname = (char *)os_malloc(strlen(answerHostName) + 1);
-        os_strcpy(answer->hostname, answerHostName);
-        _conn->flush();
-        return;
-      }
-    }
-    
+void MDNSResponder::_parsePacket(){
+  MDNSPacket packet(reinterpret_cast<const uint8_t*>(_conn->peekBuffer()), _conn->getSize());
+  if (!packet.valid()) {
     _conn->flush();
     return;
   }
 
-  // PARSE REQUEST NAME
-
-  hostNameLen = _conn_read8() % 255;
-  _conn_readS(hostName, hostNameLen);
-  hostName[hostNameLen] = '\0';
-
-  if(hostName[0] == '_'){
-    serviceParsed = true;
-    memcpy(serviceName, hostName+1, hostNameLen);
-    serviceNameLen = hostNameLen-1;
-    hostNameLen = 0;
-  }
-
-  if(hostNameLen > 0 && !_hostName.equals(hostName) && !_instanceName.equals(hostName)){
-#ifdef DEBUG_ESP_MDNS_ERR
-    DEBUG_ESP_PORT.printf("ERR_NO_HOST: %s\n", hostName);
-    DEBUG_ESP_PORT.printf("hostname: %s\n", _hostName.c_str() );
-    DEBUG_ESP_PORT.printf("instance: %s\n", _instanceName.c_str() );
+  if (packet.response()) { // Read answers
+#ifdef DEBUG_ESP_MDNS_RX
+    DEBUG_ESP_PORT.printf("Reading answers RX: %u bytes\n", (unsigned) _conn->getSize());
 #endif
+    _cache.addResponse(millis(), packet);
     _conn->flush();
     return;
   }
 
-  if(!serviceParsed){
-    serviceNameLen = _conn_read8() % 255;
-    _conn_readS(serviceName, serviceNameLen);
-    serviceName[serviceNameLen] = '\0';
-
-    if(serviceName[0] == '_'){
-      memmove(serviceName, serviceName+1, serviceNameLen);
-      serviceNameLen--;
-      serviceParsed = true;
-    } else if(serviceNameLen == 5 && strcmp("local", serviceName) == 0){
-      tmp = _conn_read8();
-      if(tmp == 0){
-        serviceParsed = true;
-        serviceNameLen = 0;
-        protoParsed = true;
-        protoNameLen = 0;
-        localParsed = true;
-      } else {
-#ifdef DEBUG_ESP_MDNS_ERR
-        DEBUG_ESP_PORT.printf("ERR_FQDN: %s\n", serviceName);
-#endif
-        _conn->flush();
-        return;
-      }
-    } else {
-#ifdef DEBUG_ESP_MDNS_ERR
-      DEBUG_ESP_PORT.printf("ERR_SERVICE: %s\n", serviceName);
-#endif
-      _conn->flush();
-      return;
-    }
-  }
+  // Questions asking the same name are answered together, up to four names
+  // per packet; everything else in it is skipped where it lies
+  struct {
+    char service[33];
+    char proto[5];
+    uint16_t port;
+    uint8_t questionMask;
+    uint8_t responseMask;
+  } targets[4];
+  int targetCount = 0;
+  bool typeEnum = false;
+
+  MDNSRecord question;
+  const uint8_t *labels[4];
+  while (packet.nextQuestion(question)) {
+    if (question._class != MDNS_CLASS_IN)
+      continue;
+    int count = packet.labels(question._name, labels, 4);
+    if (count < 2 || count > 4 || !MDNSPacket::labelIs(labels[count - 1], "local"))
+      continue;
 
-  if(!protoParsed){
-    protoNameLen = _conn_read8() % 255;
-    _conn_readS(protoName, protoNameLen);
-    protoName[protoNameLen] = '\0';
-    if(protoNameLen == 4 && protoName[0] == '_'){
-      memmove(protoName, protoName+1, protoNameLen);
-      protoNameLen--;
-      protoParsed = true;
-    } else if(strcmp("services", serviceName) == 0 && strcmp("_dns-sd", protoName) == 0){
-      _conn->flush();
-      IPAddress interface = _getRequestMulticastInterface();
-      _replyToTypeEnumRequest(interface);
-      return;
-    } else {
-#ifdef DEBUG_ESP_MDNS_ERR
-      DEBUG_ESP_PORT.printf("ERR_PROTO: %s\n", protoName);
-#endif
-      _conn->flush();
-      return;
+    if (count == 4 && MDNSPacket::labelIs(labels[0], "_services") && MDNSPacket::labelIs(labels[1], "_dns-sd") && MDNSPacket::labelIs(labels[2], "_udp")) {
+      typeEnum = true;
+      continue;
     }
-  }
 
-  if(!localParsed){
-    char localName[32];
-    uint8_t localNameLen = _conn_read8() % 31;
-    _conn_readS(localName, localNameLen);
-    localName[localNameLen] = '\0';
-    tmp = _conn_read8();
-    if(localNameLen == 5 && strcmp("local", localName) == 0 && tmp == 0){
-      localParsed = true;
-    } else {
-#ifdef DEBUG_ESP_MDNS_ERR
-      DEBUG_ESP_PORT.printf("ERR_FQDN: %s\n", localName);
-#endif
-      _conn->flush();
-      return;
+    // "host.local", "_service._proto.local" or "instance._service._proto.local"
+    int first = 0;
+    if (labels[0][0] == 0 || labels[0][1] != '_') {
+      if (!_isOwnName(labels[0]))
+        continue;
+      first = 1;
     }
-  }
-
-  if(serviceNameLen > 0 && protoNameLen > 0){
-    servicePort = _getServicePort(serviceName, protoName);
-    if(servicePort == 0){
+    char service[33] = "_";
+    char proto[5] = "_";
+    uint16_t port = 0;
+    if (count - first == 3) {
+      if (labels[first][1] != '_' || labels[first + 1][0] != 4 || labels[first + 1][1] != '_' ||
+          !MDNSPacket::copyLabel(labels[first], service, sizeof(service)) ||
+          !MDNSPacket::copyLabel(labels[first + 1], proto, sizeof(proto)))
+        continue;
+      port = _getServicePort(service + 1, proto + 1);
+      if (port == 0) {
 #ifdef DEBUG_ESP_MDNS_ERR
-      DEBUG_ESP_PORT.printf("ERR_NO_SERVICE: %s\n", serviceName);
+        DEBUG_ESP_PORT.printf("ERR_NO_SERVICE: %s\n", service);
 #endif
-      _conn->flush();
-      return;
+        continue;
+      }
+    } else if (count - first != 1) {
+      continue;
     }
-  } else if(serviceNameLen > 0 || protoNameLen > 0){
-#ifdef DEBUG_ESP_MDNS_ERR
-    DEBUG_ESP_PORT.printf("ERR_SERVICE_PROTO: %s\n", serviceName);
-#endif
-    _conn->flush();
-    return;
-  }
-
-  // RESPOND
-
-#ifdef DEBUG_ESP_MDNS_RX
-  DEBUG_ESP_PORT.printf("RX: REQ, ID:%u, Q:%u, A:%u, NS:%u, ADD:%u\n", packetHeader[0], packetHeader[2], packetHeader[3], packetHeader[4], packetHeader[5]);
-#endif
-
-  uint16_t currentType;
-  uint16_t currentClass;
 
-  int numQuestions = packetHeader[2];
-  if(numQuestions > 4) numQuestions = 4;
-  uint16_t questions[4];
-  int question = 0;
-
-  while(numQuestions--){
-    currentType = _conn_read16();
-    if(currentType & MDNS_NAME_REF){ //new header handle it better!
-      currentType = _conn_read16();
+    int target;
+    for (target = 0; target < targetCount; target++) {
+      if (strcmp(targets[target].service, service + 1) == 0 && strcmp(targets[target].proto, proto + 1) == 0)
+        break;
     }
-    currentClass = _conn_read16();
-    if(currentClass & MDNS_CLASS_IN) questions[question++] = currentType;
-
-    if(numQuestions > 0){
-      if(_conn_read16() != 0xC00C){//new question but for another host/service
-        _conn->flush();
-        numQuestions = 0;
-      }
+    if (target == targetCount) {
+      if (targetCount == 4)
+        continue;
+      os_strcpy(targets[target].service, service + 1);
+      os_strcpy(targets[target].proto, proto + 1);
+      targets[target].port = port;
+      targets[target].questionMask = 0;
+      targets[target].responseMask = 0;
+      targetCount++;
     }
 
 #ifdef DEBUG_ESP_MDNS_RX
-    DEBUG_ESP_PORT.printf("REQ: ");
-    if(hostNameLen > 0) 
-      DEBUG_ESP_PORT.printf("%s.", hostName);
-    if(serviceNameLen > 0) 
-      DEBUG_ESP_PORT.printf("_%s.", serviceName);
-    if(protoNameLen > 0) 
-      DEBUG_ESP_PORT.printf("_%s.", protoName);
-    DEBUG_ESP_PORT.printf("local. ");
-
-    if(currentType == MDNS_TYPE_AAAA) 
-      DEBUG_ESP_PORT.printf("  AAAA ");
-    else if(currentType == MDNS_TYPE_A) 
-      DEBUG_ESP_PORT.printf("  A ");
-    else if(currentType == MDNS_TYPE_PTR) 
-      DEBUG_ESP_PORT.printf("  PTR ");
-    else if(currentType == MDNS_TYPE_SRV) 
-      DEBUG_ESP_PORT.printf("  SRV ");
-    else if(currentType == MDNS_TYPE_TXT) 
-      DEBUG_ESP_PORT.printf("  TXT ");
-    else 
-      DEBUG_ESP_PORT.printf("  0x%04X ", currentType);
-
-    if(currentClass == MDNS_CLASS_IN) 
-      DEBUG_ESP_PORT.printf("  IN ");
-    else if(currentClass == MDNS_CLASS_IN_FLUSH_CACHE) 
-      DEBUG_ESP_PORT.printf("  IN[F] ");
-    else 
-      DEBUG_ESP_PORT.printf("  0x%04X ", currentClass);
-
-    DEBUG_ESP_PORT.printf("\n");
-#endif
-  }
-  uint8_t questionMask = 0;
-  uint8_t responseMask = 0;
-  for(i=0;i<question;i++){
-    if(questions[i] == MDNS_TYPE_A) {
-      questionMask |= 0x1;
-      responseMask |= 0x1;
-    } else if(questions[i] == MDNS_TYPE_SRV) {
-      questionMask |= 0x2;
-      responseMask |= 0x3;
-    } else if(questions[i] == MDNS_TYPE_TXT) {
-      questionMask |= 0x4;
-      responseMask |= 0x4;
-    } else if(questions[i] == MDNS_TYPE_PTR) {
-      questionMask |= 0x8;
-      responseMask |= 0xF;
+    DEBUG_ESP_PORT.printf("REQ: %s %s type 0x%04X\n", service, proto, question._type);
+#endif
+    if (question._type == MDNS_TYPE_A) {
+      targets[target].questionMask |= 0x1;
+      targets[target].responseMask |= 0x1;
+    } else if (question._type == MDNS_TYPE_SRV) {
+      targets[target].questionMask |= 0x2;
+      targets[target].responseMask |= 0x3;
+    } else if (question._type == MDNS_TYPE_TXT) {
+      targets[target].questionMask |= 0x4;
+      targets[target].responseMask |= 0x4;
+    } else if (question._type == MDNS_TYPE_PTR) {
+      targets[target].questionMask |= 0x8;
+      targets[target].responseMask |= 0xF;
     }
   }
 
+  // the replies reuse the connection, so the packet is done with first
   IPAddress interface = _getRequestMulticastInterface();
-  return _replyToInstanceRequest(questionMask, responseMask, serviceName, protoName, servicePort, interface);
+  _conn->flush();
+  if (typeEnum)
+    _replyToTypeEnumRequest(interface);
+  for (int target = 0; target < targetCount; target++)
+    _replyToInstanceRequest(targets[target].questionMask, targets[target].responseMask, targets[target].service, targets[target].proto, targets[target].port, interface);
 }
 
 void MDNSResponder::enableArduino(uint16_t port, bool auth){
@@ -45,6 +45,7 @@ License (MIT license):
 
 #include "ESP8266WiFi.h"
 #include "WiFiUdp.h"
+#include "MDNSCache.h"
 
 //this should be defined at build time
 #ifndef ARDUINO_BOARD
@@ -55,7 +56,6 @@ class UdpContext;
 
 struct MDNSService;
 struct MDNSTxt;
-struct MDNSAnswer;
 
 class MDNSResponder {
 public:
@@ -88,6 +88,8 @@ public:
     return addServiceTxt(name.c_str(), proto.c_str(), key.c_str(), value.c_str());
   }
   
+  //returns the answers known right now without waiting; when there are none a
+  //query is sent (at most once a second) and a later call sees the answers
   int queryService(char *service, char *proto);
   int queryService(const char *service, const char *proto){
     return queryService((char *)service, (char *)proto);
@@ -95,9 +97,18 @@ public:
   int queryService(String service, String proto){
     return queryService(service.c_str(), proto.c_str());
   }
+  //these index the answers of the last queryService
   String hostname(int idx);
   IPAddress IP(int idx);
   uint16_t port(int idx);
+
+  //Browse a service in the background: queries are repeated from update() and
+  //the callback runs whenever an instance appears, changes or goes away
+  bool installServiceQuery(const char* service, const char* proto, MDNSServiceCallback callback);
+  bool removeServiceQuery(const char* service, const char* proto);
+  //what is known right now about a browsed service, without asking the network
+  int answerCount(const char* service, const char* proto);
+  bool answerInfo(const char* service, const char* proto, int idx, MDNSServiceInfo& info);
   
   void enableArduino(uint16_t port, bool auth=false);
 
@@ -114,10 +125,9 @@ private:
   UdpContext* _conn;
   String _hostName;
   String _instanceName;
-  struct MDNSAnswer * _answers;
-  struct MDNSQuery * _query;
-  bool _newQuery;
-  bool _waitingForAnswers;
+  MDNSCache _cache;
+  char _queryService[32];
+  char _queryProto[4];
   WiFiEventHandler _disconnectedHandler;
   WiFiEventHandler _gotIPHandler;
   
@@ -127,10 +137,10 @@ private:
   uint16_t _getServiceTxtLen(char *name, char *proto);
   IPAddress _getRequestMulticastInterface();
   void _parsePacket();
+  bool _isOwnName(const uint8_t *label);
+  void _sendQuery(const char* service, const char* proto);
   void _replyToTypeEnumRequest(IPAddress multicastInterface);
   void _replyToInstanceRequest(uint8_t questionMask, uint8_t responseMask, char * service, char *proto, uint16_t port, IPAddress multicastInterface);
-  MDNSAnswer* _getAnswerFromIdx(int idx);
-  int _getNumAnswers();
   bool _listen();
   void _restart();
 };
@@ -0,0 +1,466 @@
+/*
+ESP8266 Multicast DNS answer cache
+
+License (MIT license):
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in
+  all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+  THE SOFTWARE.
+
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include "MDNSCache.h"
+#include "MDNSParser.h"
+
+#define MDNS_RECORD_PTR 0
+#define MDNS_RECORD_SRV 1
+#define MDNS_RECORD_TXT 2
+#define MDNS_RECORD_A   3
+#define MDNS_RECORDS    4
+
+// an instance can be used once its address and port are known
+#define MDNS_RECORDS_COMPLETE ((1 << MDNS_RECORD_PTR) | (1 << MDNS_RECORD_SRV) | (1 << MDNS_RECORD_A))
+
+// keeps TTL * 1000 clear of millis() wrapping around
+#define MDNS_TTL_MAX 2000000
+
+struct MDNSCacheEntry {
+  MDNSCacheEntry* _next;
+  char _instance[64];
+  char _hostname[64];
+  uint8_t* _txt;
+  uint16_t _txtLen;
+  uint16_t _port;
+  uint32_t _ip;
+  uint32_t _expires[MDNS_RECORDS]; // millis() when each record runs out
+  uint32_t _refresh;               // millis() at 80% of the PTR TTL, time to ask again
+  uint8_t _known;                  // bit per record received and not expired
+  bool _reported;                  // the callback last saw it available
+};
+
+struct MDNSBrowse {
+  MDNSBrowse* _next;
+  char _service[32];
+  char _proto[4];
+  MDNSCacheEntry* _entries;
+  int _entryCount;
+  MDNSServiceCallback _callback;
+  uint32_t _queried;               // millis() of the last query
+  uint32_t _interval;              // until the next periodic one
+  bool _everQueried;
+  bool _forgotten;                 // forget() from a callback, removed by expire()
+};
+
+static bool _reached(uint32_t now, uint32_t when) {
+  return (int32_t)(now - when) >= 0;
+}
+
+static void _copyName(char* dst, size_t size, const char* src) {
+  strncpy(dst, src, size - 1);
+  dst[size - 1] = 0;
+}
+
+static void _record(MDNSCacheEntry* entry, int record, uint32_t now, uint32_t ttl) {
+  if (ttl > MDNS_TTL_MAX)
+    ttl = MDNS_TTL_MAX;
+  entry->_expires[record] = now + ttl * 1000;
+  entry->_known |= 1 << record;
+}
+
+String MDNSServiceInfo::txtValue(const char* key) const {
+  size_t keyLen = strlen(key);
+  for (uint16_t pos = 0; pos < txtLen; pos += 1 + txt[pos]) {
+    uint8_t len = txt[pos];
+    const char* str = (const char*)txt + pos + 1;
+    if (pos + 1 + len > txtLen)
+      break;
+    if (len >= keyLen && strncasecmp(str, key, keyLen) == 0 && (len == keyLen || str[keyLen] == '=')) {
+      String value;
+      if (len > keyLen) {
+        value.reserve(len - keyLen - 1);
+        for (const char* c = str + keyLen + 1; c < str + len; c++)
+          value += *c;
+      }
+      return value;
+    }
+  }
+  return String();
+}
+
+MDNSCache::MDNSCache() : _browses(0) {
+}
+
+MDNSCache::~MDNSCache() {
+  while (_browses) {
+    MDNSBrowse* browse = _browses;
+    _browses = browse->_next;
+    while (browse->_entries) {
+      MDNSCacheEntry* entry = browse->_entries;
+      browse->_entries = entry->_next;
+      free(entry->_txt);
+      delete entry;
+    }
+    delete browse;
+  }
+}
+
+MDNSBrowse* MDNSCache::_find(const char* service, const char* proto) const {
+  for (MDNSBrowse* browse = _browses; browse; browse = browse->_next) {
+    if (!browse->_forgotten && strcasecmp(browse->_service, service) == 0 && strcasecmp(browse->_proto, proto) == 0)
+      return browse;
+  }
+  return 0;
+}
+
+// The browse named by "_service._proto.local" labels
+MDNSBrowse* MDNSCache::_find(const uint8_t** labels) const {
+  char service[sizeof(MDNSBrowse::_service) + 1];
+  char proto[sizeof(MDNSBrowse::_proto) + 1];
+  if (labels[0][0] < 2 || labels[0][1] != '_' || labels[1][0] != 4 || labels[1][1] != '_' ||
+      !MDNSPacket::labelIs(labels[2], "local") ||
+      !MDNSPacket::copyLabel(labels[0], service, sizeof(service)) ||
+      !MDNSPacket::copyLabel(labels[1], proto, sizeof(proto)))
+    return 0;
+  return _find(service + 1, proto + 1);
+}
+
+bool MDNSCache::browse(const char* service, const char* proto, MDNSServiceCallback callback) {
+  if (strlen(service) >= sizeof(MDNSBrowse::_service) || strlen(proto) != 3)
+    return false;
+
+  MDNSBrowse* browse = _find(service, proto);
+  if (!browse) {
+    browse = new MDNSBrowse();
+    _copyName(browse->_service, sizeof(browse->_service), service);
+    _copyName(browse->_proto, sizeof(browse->_proto), proto);
+    browse->_interval = MDNS_QUERY_INTERVAL_MIN;
+    browse->_next = _browses;
+    _browses = browse;
+  }
+  if (callback)
+    browse->_callback = callback;
+  return true;
+}
+
+bool MDNSCache::forget(const char* service, const char* proto) {
+  MDNSBrowse* browse = _find(service, proto);
+  if (!browse)
+    return false;
+  browse->_forgotten = true;
+  return true;
+}
+
+bool MDNSCache::browsing(const char* service, const char* proto) const {
+  return _find(service, proto) != 0;
+}
+
+MDNSCacheEntry* MDNSCache::_entry(MDNSBrowse* browse, const char* instance, bool create) {
+  MDNSCacheEntry** last = &browse->_entries;
+  for (MDNSCacheEntry* entry = browse->_entries; entry; entry = entry->_next) {
+    if (strcasecmp(entry->_instance, instance) == 0)
+      return entry;
+    last = &entry->_next;
+  }
+  if (!create || browse->_entryCount >= MDNS_CACHE_MAX_ENTRIES)
+    return 0;
+
+  // new instances go last, so indexes stay put while the cache fills
+  MDNSCacheEntry* entry = new MDNSCacheEntry();
+  _copyName(entry->_instance, sizeof(entry->_instance), instance);
+  *last = entry;
+  browse->_entryCount++;
+  return entry;
+}
+
+void MDNSCache::_removeEntry(MDNSBrowse* browse, MDNSCacheEntry* entry) {
+  if (entry->_reported) {
+    entry->_known = 0;
+    _changed(browse, entry);
+  }
+  for (MDNSCacheEntry** link = &browse->_entries; *link; link = &(*link)->_next) {
+    if (*link == entry) {
+      *link = entry->_next;
+      break;
+    }
+  }
+  browse->_entryCount--;
+  free(entry->_txt);
+  delete entry;
+}
+
+void MDNSCache::_fill(const MDNSBrowse* browse, const MDNSCacheEntry* entry, MDNSServiceInfo& info) const {
+  info.service = browse->_service;
+  info.proto = browse->_proto;
+  info.instance = entry->_instance;
+  info.hostname = entry->_hostname;
+  info.ip = IPAddress(entry->_ip);
+  info.port = entry->_port;
+  info.txt = entry->_txt;
+  info.txtLen = entry->_txtLen;
+  info.available = (entry->_known & MDNS_RECORDS_COMPLETE) == MDNS_RECORDS_COMPLETE;
+}
+
+// Tell the callback when an instance became usable, changed or went away
+void MDNSCache::_changed(MDNSBrowse* browse, MDNSCacheEntry* entry) {
+  MDNSServiceInfo info;
+  _fill(browse, entry, info);
+  if (!info.available && !entry->_reported)
+    return;
+  entry->_reported = info.available;
+  if (browse->_callback && !browse->_forgotten)
+    browse->_callback(info);
+}
+
+void MDNSCache::addPTR(uint32_t now, const char* service, const char* proto, const char* instance, uint32_t ttl) {
+  MDNSBrowse* browse = _find(service, proto);
+  MDNSCacheEntry* entry = browse ? _entry(browse, instance, ttl != 0) : 0;
+  if (!entry)
+    return;
+  if (ttl == 0) {
+    _removeEntry(browse, entry);
+    return;
+  }
+
+  bool changed = !(entry->_known & (1 << MDNS_RECORD_PTR));
+  _record(entry, MDNS_RECORD_PTR, now, ttl);
+  entry->_refresh = now + (ttl > MDNS_TTL_MAX ? MDNS_TTL_MAX : ttl) * 800;
+  if (changed)
+    _changed(browse, entry);
+}
+
+void MDNSCache::addSRV(uint32_t now, const char* service, const char* proto, const char* instance, const char* host, uint16_t port, uint32_t ttl) {
+  MDNSBrowse* browse = _find(service, proto);
+  MDNSCacheEntry* entry = browse ? _entry(browse, instance, ttl != 0) : 0;
+  if (!entry)
+    return;
+  if (ttl == 0) {
+    entry->_known &= ~(1 << MDNS_RECORD_SRV);
+    _changed(browse, entry);
+    return;
+  }
+
+  bool changed = !(entry->_known & (1 << MDNS_RECORD_SRV)) || entry->_port != port || strcasecmp(entry->_hostname, host) != 0;
+  if (strcasecmp(entry->_hostname, host) != 0) {
+    // the address belongs to the old host
+    entry->_known &= ~(1 << MDNS_RECORD_A);
+    _copyName(entry->_hostname, sizeof(entry->_hostname), host);
+  }
+  entry->_port = port;
+  _record(entry, MDNS_RECORD_SRV, now, ttl);
+  if (changed)
+    _changed(browse, entry);
+}
+
+void MDNSCache::addTXT(uint32_t now, const char* service, const char* proto, const char* instance, const uint8_t* txt, uint16_t len, uint32_t ttl) {
+  MDNSBrowse* browse = _find(service, proto);
+  MDNSCacheEntry* entry = browse ? _entry(browse, instance, ttl != 0) : 0;
+  if (!entry)
+    return;
+  if (ttl == 0) {
+    entry->_known &= ~(1 << MDNS_RECORD_TXT);
+    return;
+  }
+
+  bool changed = len != entry->_txtLen || (len && memcmp(entry->_txt, txt, len) != 0);
+  if (changed) {
+    uint8_t* copy = len ? (uint8_t*)malloc(len) : 0;
+    if (len && !copy)
+      return;
+    if (len)
+      memcpy(copy, txt, len);
+    free(entry->_txt);
+    entry->_txt = copy;
+    entry->_txtLen = len;
+  }
+  _record(entry, MDNS_RECORD_TXT, now, ttl);
+  if (changed && entry->_reported)
+    _changed(browse, entry);
+}
+
+void MDNSCache::addA(uint32_t now, const char* host, uint32_t ip, uint32_t ttl) {
+  for (MDNSBrowse* browse = _browses; browse; browse = browse->_next) {
+    for (MDNSCacheEntry* entry = browse->_entries; entry; entry = entry->_next) {
+      if (!entry->_hostname[0] || strcasecmp(entry->_hostname, host) != 0)
+        continue;
+      bool changed;
+      if (ttl == 0) {
+        changed = entry->_known & (1 << MDNS_RECORD_A);
+        entry->_known &= ~(1 << MDNS_RECORD_A);
+      } else {
+        changed = !(entry->_known & (1 << MDNS_RECORD_A)) || entry->_ip != ip;
+        entry->_ip = ip;
+        _record(entry, MDNS_RECORD_A, now, ttl);
+      }
+      if (changed)
+        _changed(browse, entry);
+    }
+  }
+}
+
+// Two walks over the records: PTR, SRV and TXT first, so the A records that
+// follow find the hosts the SRV records named wherever they were in the packet
+void MDNSCache::addResponse(uint32_t now, MDNSPacket& packet) {
+  if (!_browses || !packet.response())
+    return;
+
+  MDNSRecord record;
+  const uint8_t* owner[4];
+  const uint8_t* target[4];
+  char instance[64];
+  char host[64];
+  bool addresses = false;
+  while (packet.nextRecord(record)) {
+    if (record._class != MDNS_CLASS_IN)
+      continue;
+    if (record._type == MDNS_TYPE_A) {
+      addresses = true;
+      continue;
+    }
+    if (record._type != MDNS_TYPE_PTR && record._type != MDNS_TYPE_SRV && record._type != MDNS_TYPE_TXT)
+      continue;
+
+    // "_service._proto.local" for PTR, "instance._service._proto.local" otherwise
+    int first = record._type == MDNS_TYPE_PTR ? 0 : 1;
+    MDNSBrowse* browse = packet.labels(record._name, owner, 4) == first + 3 ? _find(owner + first) : 0;
+    if (!browse)
+      continue;
+
+    if (record._type == MDNS_TYPE_PTR) {
+      if (packet.labels(record._rdata, target, 4) == 4 && _find(target + 1) == browse &&
+          MDNSPacket::copyLabel(target[0], instance, sizeof(instance)))
+        addPTR(now, browse->_service, browse->_proto, instance, record._ttl);
+    } else if (!MDNSPacket::copyLabel(owner[0], instance, sizeof(instance))) {
+      continue;
+    } else if (record._type == MDNS_TYPE_SRV) {
+      if (record._rdlength > 6 && packet.labels(record._rdata + 6, target, 2) == 2 &&
+          MDNSPacket::labelIs(target[1], "local") && MDNSPacket::copyLabel(target[0], host, sizeof(host)))
+        addSRV(now, browse->_service, browse->_proto, instance, host, packet.read16(record._rdata + 4), record._ttl);
+    } else {
+      addTXT(now, browse->_service, browse->_proto, instance, packet.data() + record._rdata, record._rdlength, record._ttl);
+    }
+  }
+
+  if (!addresses)
+    return;
+  packet.rewindRecords();
+  while (packet.nextRecord(record)) {
+    if (record._type != MDNS_TYPE_A || record._class != MDNS_CLASS_IN || record._rdlength != 4 ||
+        packet.labels(record._name, owner, 2) != 2 || !MDNSPacket::labelIs(owner[1], "local") ||
+        !MDNSPacket::copyLabel(owner[0], host, sizeof(host)))
+      continue;
+    uint32_t ip;
+    memcpy(&ip, packet.data() + record._rdata, 4);
+    addA(now, host, ip, record._ttl);
+  }
+}
+
+void MDNSCache::expire(uint32_t now) {
+  for (MDNSBrowse** link = &_browses; *link; ) {
+    MDNSBrowse* browse = *link;
+    if (browse->_forgotten) {
+      *link = browse->_next;
+      while (browse->_entries) {
+        MDNSCacheEntry* entry = browse->_entries;
+        browse->_entries = entry->_next;
+        free(entry->_txt);
+        delete entry;
+      }
+      delete browse;
+      continue;
+    }
+
+    for (MDNSCacheEntry* entry = browse->_entries; entry; ) {
+      MDNSCacheEntry* next = entry->_next;
+      uint8_t known = entry->_known;
+      for (int record = 0; record < MDNS_RECORDS; record++) {
+        if ((known & (1 << record)) && _reached(now, entry->_expires[record]))
+          known &= ~(1 << record);
+      }
+      if (known != entry->_known) {
+        bool lostPTR = (entry->_known & (1 << MDNS_RECORD_PTR)) && !(known & (1 << MDNS_RECORD_PTR));
+        entry->_known = known;
+        if (lostPTR || !known)
+          _removeEntry(browse, entry);
+        else
+          _changed(browse, entry);
+      }
+      entry = next;
+    }
+    link = &browse->_next;
+  }
+}
+
+bool MDNSCache::due(uint32_t now, const char*& service, const char*& proto) {
+  for (MDNSBrowse* browse = _browses; browse; browse = browse->_next) {
+    if (!browse->_callback || browse->_forgotten)
+      continue;
+
+    bool periodic = !browse->_everQueried || _reached(now, browse->_queried + browse->_interval);
+    bool refresh = false;
+    for (MDNSCacheEntry* entry = browse->_entries; entry && !periodic && !refresh; entry = entry->_next) {
+      // asked once the PTR is 80% through its TTL, unless a query already went out since
+      refresh = (entry->_known & (1 << MDNS_RECORD_PTR)) && _reached(now, entry->_refresh) &&
+                (int32_t)(entry->_refresh - browse->_queried) > 0;
+    }
+    if (!periodic && !refresh)
+      continue;
+
+    if (periodic && browse->_everQueried) {
+      browse->_interval *= 2;
+      if (browse->_interval > MDNS_QUERY_INTERVAL_MAX)
+        browse->_interval = MDNS_QUERY_INTERVAL_MAX;
+    }
+    browse->_queried = now;
+    browse->_everQueried = true;
+    service = browse->_service;
+    proto = browse->_proto;
+    return true;
+  }
+  return false;
+}
+
+bool MDNSCache::query(uint32_t now, const char* service, const char* proto) {
+  MDNSBrowse* browse = _find(service, proto);
+  if (!browse || (browse->_everQueried && !_reached(now, browse->_queried + MDNS_QUERY_INTERVAL_MIN)))
+    return false;
+  browse->_queried = now;
+  browse->_everQueried = true;
+  return true;
+}
+
+int MDNSCache::count(const char* service, const char* proto) const {
+  MDNSBrowse* browse = _find(service, proto);
+  int count = 0;
+  for (MDNSCacheEntry* entry = browse ? browse->_entries : 0; entry; entry = entry->_next) {
+    if ((entry->_known & MDNS_RECORDS_COMPLETE) == MDNS_RECORDS_COMPLETE)
+      count++;
+  }
+  return count;
+}
+
+bool MDNSCache::info(const char* service, const char* proto, int idx, MDNSServiceInfo& info) const {
+  MDNSBrowse* browse = _find(service, proto);
+  for (MDNSCacheEntry* entry = browse ? browse->_entries : 0; entry; entry = entry->_next) {
+    if ((entry->_known & MDNS_RECORDS_COMPLETE) == MDNS_RECORDS_COMPLETE && idx-- == 0) {
+      _fill(browse, entry, info);
+      return true;
+    }
+  }
+  return false;
+}
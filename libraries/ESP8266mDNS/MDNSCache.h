@@ -0,0 +1,112 @@
+/*
+ESP8266 Multicast DNS answer cache
+Keeps what responders announced about the services being browsed, each
+record until its TTL runs out, so lookups don't have to wait for the network.
+
+License (MIT license):
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in
+  all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+  THE SOFTWARE.
+
+*/
+#ifndef MDNSCACHE_H
+#define MDNSCACHE_H
+
+#include <functional>
+#include <stddef.h>
+#include <stdint.h>
+#include "IPAddress.h"
+#include "WString.h"
+
+// instances kept per browsed service, answers beyond that are ignored
+#ifndef MDNS_CACHE_MAX_ENTRIES
+#define MDNS_CACHE_MAX_ENTRIES 16
+#endif
+
+// continuous querying starts at one second and doubles up to an hour (RFC 6762 5.2)
+#define MDNS_QUERY_INTERVAL_MIN 1000
+#define MDNS_QUERY_INTERVAL_MAX 3600000
+
+// What is known about one instance of a browsed service
+struct MDNSServiceInfo {
+  const char* service;      // "http", without the underscore
+  const char* proto;        // "tcp"
+  const char* instance;     // "Living room" of "Living room._http._tcp.local"
+  const char* hostname;     // "esp8266" of "esp8266.local"
+  IPAddress ip;
+  uint16_t port;
+  const uint8_t* txt;       // TXT rdata as received, length prefixed "key=value" strings
+  uint16_t txtLen;
+  bool available;           // false once the instance said goodbye or its records ran out
+
+  String txtValue(const char* key) const;
+};
+
+typedef std::function<void(const MDNSServiceInfo&)> MDNSServiceCallback;
+
+struct MDNSCacheEntry;
+struct MDNSBrowse;
+class MDNSPacket;
+
+class MDNSCache {
+public:
+  MDNSCache();
+  ~MDNSCache();
+
+  // Start browsing a service, or replace the callback of one already browsed.
+  // Only browses with a callback are queried continuously.
+  bool browse(const char* service, const char* proto, MDNSServiceCallback callback);
+  bool forget(const char* service, const char* proto);
+  bool browsing(const char* service, const char* proto) const;
+
+  // Records out of a response, now is millis() and ttl is in seconds, 0 says goodbye.
+  // Names come split: the instance label, service and proto without their
+  // underscore and the host label without ".local". Records for services that
+  // aren't browsed are dropped.
+  void addPTR(uint32_t now, const char* service, const char* proto, const char* instance, uint32_t ttl);
+  void addSRV(uint32_t now, const char* service, const char* proto, const char* instance, const char* host, uint16_t port, uint32_t ttl);
+  void addTXT(uint32_t now, const char* service, const char* proto, const char* instance, const uint8_t* txt, uint16_t len, uint32_t ttl);
+  void addA(uint32_t now, const char* host, uint32_t ip, uint32_t ttl);
+  // All the records of a response, in whatever order they came. Only names of
+  // browsed services are copied out of the packet.
+  void addResponse(uint32_t now, MDNSPacket& packet);
+
+  // Drop the records whose TTL ran out
+  void expire(uint32_t now);
+
+  // One browse that should be queried now, it counts as queried afterwards
+  bool due(uint32_t now, const char*& service, const char*& proto);
+  // For a one-off query: true and counted as queried, unless the last query
+  // went out less than MDNS_QUERY_INTERVAL_MIN ago
+  bool query(uint32_t now, const char* service, const char* proto);
+
+  // Instances with a known address and port
+  int count(const char* service, const char* proto) const;
+  bool info(const char* service, const char* proto, int idx, MDNSServiceInfo& info) const;
+
+private:
+  MDNSBrowse* _find(const char* service, const char* proto) const;
+  MDNSBrowse* _find(const uint8_t** labels) const;
+  MDNSCacheEntry* _entry(MDNSBrowse* browse, const char* instance, bool create);
+  void _removeEntry(MDNSBrowse* browse, MDNSCacheEntry* entry);
+  void _changed(MDNSBrowse* browse, MDNSCacheEntry* entry);
+  void _fill(const MDNSBrowse* browse, const MDNSCacheEntry* entry, MDNSServiceInfo& info) const;
+
+  MDNSBrowse* _browses;
+};
+
+#endif //MDNSCACHE_H
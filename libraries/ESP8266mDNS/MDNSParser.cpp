@@ -0,0 +1,168 @@
+/*
+ESP8266 Multicast DNS message parser
+
+License (MIT license):
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in
+  all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+  THE SOFTWARE.
+
+*/
+
+#include <string.h>
+#include <strings.h>
+#include "MDNSParser.h"
+
+#define MDNS_HEADER_SIZE 12
+#define MDNS_QUESTION_FIXED 4    // type, class
+#define MDNS_RECORD_FIXED 10     // type, class, ttl, rdlength
+#define MDNS_NAME_MAX_LABELS 128 // a name is at most 255 bytes
+
+MDNSPacket::MDNSPacket(const uint8_t* data, size_t size)
+  : _data(data), _size(size), _pos(MDNS_HEADER_SIZE), _firstRecord(0),
+    _questionsLeft(0), _recordsLeft(0), _recordCount(0), _valid(data && size >= MDNS_HEADER_SIZE) {
+  if (!_valid)
+    return;
+  _questionsLeft = read16(4);
+  _recordCount = (uint32_t)read16(6) + read16(8) + read16(10);
+  _recordsLeft = _recordCount;
+}
+
+uint16_t MDNSPacket::read16(size_t offset) const {
+  if (offset + 2 > _size)
+    return 0;
+  return (_data[offset] << 8) | _data[offset + 1];
+}
+
+uint32_t MDNSPacket::read32(size_t offset) const {
+  if (offset + 4 > _size)
+    return 0;
+  return ((uint32_t)_data[offset] << 24) | ((uint32_t)_data[offset + 1] << 16) | ((uint32_t)_data[offset + 2] << 8) | _data[offset + 3];
+}
+
+// Past a name without following its pointer
+bool MDNSPacket::_skipName(size_t& pos) const {
+  while (pos < _size) {
+    uint8_t len = _data[pos];
+    if (len == 0) {
+      pos++;
+      return true;
+    }
+    if ((len & 0xC0) == 0xC0) {
+      pos += 2;
+      return pos <= _size;
+    }
+    if (len & 0xC0)
+      return false;
+    pos += 1 + len;
+  }
+  return false;
+}
+
+bool MDNSPacket::nextQuestion(MDNSRecord& question) {
+  if (!_questionsLeft)
+    return false;
+
+  size_t pos = _pos;
+  if (!_skipName(pos) || pos + MDNS_QUESTION_FIXED > _size) {
+    _questionsLeft = _recordsLeft = 0;
+    return false;
+  }
+  question._name = _pos;
+  question._type = read16(pos);
+  question._class = read16(pos + 2) & 0x7FFF;
+  question._ttl = 0;
+  question._rdata = 0;
+  question._rdlength = 0;
+  _pos = pos + MDNS_QUESTION_FIXED;
+  _questionsLeft--;
+  return true;
+}
+
+bool MDNSPacket::nextRecord(MDNSRecord& record) {
+  MDNSRecord question;
+  while (_questionsLeft) {
+    if (!nextQuestion(question))
+      return false;
+  }
+  if (!_firstRecord)
+    _firstRecord = _pos;
+  if (!_recordsLeft)
+    return false;
+
+  size_t pos = _pos;
+  if (!_skipName(pos) || pos + MDNS_RECORD_FIXED > _size || pos + MDNS_RECORD_FIXED + read16(pos + 8) > _size) {
+    _recordsLeft = 0;
+    return false;
+  }
+  record._name = _pos;
+  record._type = read16(pos);
+  record._class = read16(pos + 2) & 0x7FFF;
+  record._ttl = read32(pos + 4);
+  record._rdlength = read16(pos + 8);
+  record._rdata = pos + MDNS_RECORD_FIXED;
+  _pos = record._rdata + record._rdlength;
+  _recordsLeft--;
+  return true;
+}
+
+void MDNSPacket::rewindRecords() {
+  if (_firstRecord) {
+    _pos = _firstRecord;
+    _recordsLeft = _recordCount;
+  }
+}
+
+// A compression pointer has to go back before the stretch of labels it was
+// reached from, so following them always ends
+int MDNSPacket::labels(uint16_t offset, const uint8_t** labels, int max) const {
+  size_t pos = offset;
+  size_t limit = offset;
+  int count = 0;
+  while (pos < _size) {
+    uint8_t len = _data[pos];
+    if (len == 0)
+      return count;
+    if ((len & 0xC0) == 0xC0) {
+      if (pos + 1 >= _size)
+        return -1;
+      size_t target = ((len & 0x3F) << 8) | _data[pos + 1];
+      if (target >= limit)
+        return -1;
+      pos = limit = target;
+      continue;
+    }
+    if ((len & 0xC0) || pos + 1 + len > _size || count == MDNS_NAME_MAX_LABELS)
+      return -1;
+    if (count < max)
+      labels[count] = _data + pos;
+    count++;
+    pos += 1 + len;
+  }
+  return -1;
+}
+
+bool MDNSPacket::labelIs(const uint8_t* label, const char* str) {
+  return strlen(str) == label[0] && strncasecmp((const char*)label + 1, str, label[0]) == 0;
+}
+
+bool MDNSPacket::copyLabel(const uint8_t* label, char* dst, size_t size) {
+  if (label[0] >= size)
+    return false;
+  memcpy(dst, label + 1, label[0]);
+  dst[label[0]] = 0;
+  return true;
+}
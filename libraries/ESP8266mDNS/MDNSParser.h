@@ -0,0 +1,95 @@
+/*
+ESP8266 Multicast DNS message parser
+Walks a received DNS message where it lies, without copying it. Every read is
+checked against the end of the packet, so truncated or hostile packets just
+end the walk.
+
+License (MIT license):
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in
+  all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+  THE SOFTWARE.
+
+*/
+#ifndef MDNSPARSER_H
+#define MDNSPARSER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define MDNS_TYPE_AAAA  0x001C
+#define MDNS_TYPE_A     0x0001
+#define MDNS_TYPE_PTR   0x000C
+#define MDNS_TYPE_SRV   0x0021
+#define MDNS_TYPE_TXT   0x0010
+
+#define MDNS_CLASS_IN             0x0001
+#define MDNS_CLASS_IN_FLUSH_CACHE 0x8001
+
+// A question or resource record, names and rdata are offsets into the packet
+struct MDNSRecord {
+  uint16_t _name;
+  uint16_t _type;
+  uint16_t _class;      // without the cache flush / unicast response bit
+  uint32_t _ttl;        // records only
+  uint16_t _rdata;
+  uint16_t _rdlength;
+};
+
+class MDNSPacket {
+public:
+  MDNSPacket(const uint8_t* data, size_t size);
+
+  // false when even the header doesn't fit
+  bool valid() const { return _valid; }
+  bool response() const { return _valid && (_data[2] & 0x80); }
+
+  // The questions first, then the answer, authority and additional records
+  // in packet order. Both stop at the first malformed entry.
+  bool nextQuestion(MDNSRecord& question);
+  bool nextRecord(MDNSRecord& record);
+  // Back to the first record, to walk them once more
+  void rewindRecords();
+
+  // Labels of the name at offset, each pointing at its length byte inside the
+  // packet. Fills at most max of them and returns how many the name has, -1
+  // when it is malformed.
+  int labels(uint16_t offset, const uint8_t** labels, int max) const;
+
+  // rdata helpers, 0 when the field lies outside the packet
+  uint16_t read16(size_t offset) const;
+  uint32_t read32(size_t offset) const;
+  const uint8_t* data() const { return _data; }
+
+  // Length prefixed label against a C string, ignoring case as DNS does
+  static bool labelIs(const uint8_t* label, const char* str);
+  // Label as a C string, false when it doesn't fit
+  static bool copyLabel(const uint8_t* label, char* dst, size_t size);
+
+private:
+  bool _skipName(size_t& pos) const;
+
+  const uint8_t* _data;
+  size_t _size;
+  size_t _pos;
+  size_t _firstRecord;
+  uint32_t _questionsLeft;
+  uint32_t _recordsLeft;
+  uint32_t _recordCount;
+  bool _valid;
+};
+
+#endif //MDNSPARSER_H
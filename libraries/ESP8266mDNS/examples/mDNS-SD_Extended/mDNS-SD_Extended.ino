@@ -45,7 +45,12 @@ void setup() {
   MDNS.addService("esp", "tcp", 8080); // Announce esp tcp service on port 8080
 
   Serial.println("Sending mDNS query");
-  int n = MDNS.queryService("esp", "tcp"); // Send out query for esp tcp services
+  // queryService() doesn't wait for answers, ask again until some arrived
+  int n = 0;
+  uint32_t start = millis();
+  while ((n = MDNS.queryService("esp", "tcp")) == 0 && millis() - start < 3000) { // Send out query for esp tcp services
+    delay(100);
+  }
   Serial.println("mDNS query done");
   if (n == 0) {
     Serial.println("no services found");
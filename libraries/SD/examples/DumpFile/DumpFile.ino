@@ -49,10 +49,23 @@ void setup() {
 
   // if the file is available, write to it:
   if (dataFile) {
-    while (dataFile.available()) {
-      Serial.write(dataFile.read());
+    // read in chunks and time the transfer
+    uint8_t buf[512];
+    uint32_t total = 0;
+    uint32_t start = millis();
+    int n;
+    while ((n = dataFile.read(buf, sizeof(buf))) > 0) {
+      Serial.write(buf, n);
+      total += n;
     }
+    uint32_t elapsed = millis() - start;
     dataFile.close();
+
+    Serial.println();
+    Serial.print(total);
+    Serial.print(" bytes in ");
+    Serial.print(elapsed);
+    Serial.println(" ms");
   }
   // if the file isn't open, pop up an error:
   else {
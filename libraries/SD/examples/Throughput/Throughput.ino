@@ -0,0 +1,114 @@
+/*
+  SD card throughput
+
+  This example measures how fast a file can be written to and read
+  from the SD card with different buffer sizes.
+
+  Buffers of 512 bytes or more move whole blocks and bypass the
+  library's block cache.  Larger buffers let the library transfer
+  several blocks with one card command, which is where most of the
+  speed comes from.
+
+  The circuit:
+   SD card attached to SPI bus as follows:
+ ** MOSI - pin 11
+ ** MISO - pin 12
+ ** CLK - pin 13
+ ** CS - pin 4
+
+  This example code is in the public domain.
+
+*/
+
+#include <SPI.h>
+#include <SD.h>
+
+const int chipSelect = 4;
+
+// size of the test file in bytes
+const uint32_t fileSize = 1024UL * 1024UL;
+
+uint8_t buf[4096];
+
+void printRate(const char* what, size_t bufSize, uint32_t bytes, uint32_t ms) {
+  Serial.print(what);
+  Serial.print(" with ");
+  Serial.print(bufSize);
+  Serial.print(" byte buffer: ");
+  Serial.print(bytes);
+  Serial.print(" bytes in ");
+  Serial.print(ms);
+  Serial.print(" ms, ");
+  Serial.print(ms ? bytes / ms : 0);
+  Serial.println(" KB/s");
+}
+
+void testWrite(size_t bufSize) {
+  SD.remove("bench.dat");
+  File file = SD.open("bench.dat", FILE_WRITE);
+  if (!file) {
+    Serial.println("error opening bench.dat");
+    return;
+  }
+  uint32_t written = 0;
+  uint32_t start = millis();
+  while (written < fileSize) {
+    size_t n = file.write(buf, bufSize);
+    if (n != bufSize) {
+      Serial.println("write failed");
+      break;
+    }
+    written += n;
+  }
+  file.close();
+  printRate("write", bufSize, written, millis() - start);
+}
+
+void testRead(size_t bufSize) {
+  File file = SD.open("bench.dat");
+  if (!file) {
+    Serial.println("error opening bench.dat");
+    return;
+  }
+  uint32_t total = 0;
+  uint32_t start = millis();
+  int n;
+  while ((n = file.read(buf, bufSize)) > 0) {
+    total += n;
+  }
+  file.close();
+  printRate("read", bufSize, total, millis() - start);
+}
+
+void setup() {
+  // Open serial communications and wait for port to open:
+  Serial.begin(115200);
+  while (!Serial) {
+    ; // wait for serial port to connect. Needed for Leonardo only
+  }
+
+  Serial.print("Initializing SD card...");
+
+  // see if the card is present and can be initialized:
+  if (!SD.begin(chipSelect)) {
+    Serial.println("Card failed, or not present");
+    // don't do anything more:
+    return;
+  }
+  Serial.println("card initialized.");
+
+  for (size_t i = 0; i < sizeof(buf); i++) {
+    buf[i] = i;
+  }
+
+  const size_t sizes[] = {64, 512, 4096};
+  for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+    testWrite(sizes[i]);
+    testRead(sizes[i]);
+  }
+  SD.remove("bench.dat");
+  Serial.println("done.");
+}
+
+void loop() {
+}
@@ -135,6 +135,9 @@ uint8_t Sd2Card::cardCommand(uint8_t cmd, uint32_t arg) {
   if (cmd == CMD8) crc = 0x87;  // correct crc for CMD8 with arg 0X1AA
   spiSend(crc);
 
+  // skip stuff byte sent by the card after a stop transmission command
+  if (cmd == CMD12) spiRec();
+
   // wait for response
   for (uint8_t i = 0; ((status_ = spiRec()) & 0x80) && i != 0xFF; i++)
     ;
@@ -381,6 +384,34 @@ uint8_t Sd2Card::readBlock(uint32_t block, uint8_t* dst) {
   return readData(block, 0, 512, dst);
 }
 //------------------------------------------------------------------------------
+/**
+ * Read a run of contiguous 512 byte blocks from an SD card device.
+ *
+ * A run of more than one block is read with a single READ_MULTIPLE_BLOCK
+ * command instead of one READ_BLOCK command per block.
+ *
+ * \param[in] block Logical block number of the first block in the run.
+ * \param[out] dst Pointer to the location that will receive the data.
+ * \param[in] count Number of blocks to read.
+ *
+ * \return The value one, true, is returned for success and
+ * the value zero, false, is returned for failure.
+ */
+uint8_t Sd2Card::readBlocks(uint32_t block, uint8_t* dst, uint16_t count) {
+  if (count == 1) return readBlock(block, dst);
+  if (!readStart(block)) return false;
+  for (uint16_t i = 0; i < count; i++, dst += 512) {
+    if (!readData(dst)) {
+      // end the transfer but report the error that stopped it
+      uint8_t code = errorCode_;
+      readStop();
+      error(code);
+      return false;
+    }
+  }
+  return readStop();
+}
+//------------------------------------------------------------------------------
 /**
  * Read part of a 512 byte block from an SD card.
  *
@@ -469,6 +500,47 @@ uint8_t Sd2Card::readData(uint32_t block,
   return false;
 }
 //------------------------------------------------------------------------------
+/** Read one data block in a multiple block read sequence
+ *
+ * \param[out] dst Pointer to the location for the 512 byte data block.
+ *
+ * \return The value one, true, is returned for success and
+ * the value zero, false, is returned for failure.
+ */
+uint8_t Sd2Card::readData(uint8_t* dst) {
+  if (!waitStartBlock()) return false;
+
+#ifdef OPTIMIZE_HARDWARE_SPI
+  // start first spi transfer
+  SPDR = 0XFF;
+
+  // transfer data
+  for (uint16_t i = 0; i < 511; i++) {
+    while (!(SPSR & (1 << SPIF)))
+      ;
+    dst[i] = SPDR;
+    SPDR = 0XFF;
+  }
+  // wait for last byte
+  while (!(SPSR & (1 << SPIF)))
+    ;
+  dst[511] = SPDR;
+
+#else  // OPTIMIZE_HARDWARE_SPI
+#ifdef ESP8266
+  SPI.transferBytes(NULL, dst, 512);
+#else
+  for (uint16_t i = 0; i < 512; i++) {
+    dst[i] = spiRec();
+  }
+#endif
+#endif  // OPTIMIZE_HARDWARE_SPI
+
+  spiRec();  // get first crc byte
+  spiRec();  // get second crc byte
+  return true;
+}
+//------------------------------------------------------------------------------
 /** Skip remaining data in a block when in partial block read mode. */
 void Sd2Card::readEnd(void) {
   if (inBlock_) {
@@ -520,6 +592,48 @@ uint8_t Sd2Card::readRegister(uint8_t cmd, void* buf) {
   return false;
 }
 //------------------------------------------------------------------------------
+/** Start a read multiple blocks sequence.
+ *
+ * \param[in] blockNumber Address of first block in sequence.
+ *
+ * \note This function is used with readData() and readStop()
+ * for optimized multiple block reads.
+ *
+ * \return The value one, true, is returned for success and
+ * the value zero, false, is returned for failure.
+ */
+uint8_t Sd2Card::readStart(uint32_t blockNumber) {
+  // use address if not SDHC card
+  if (type() != SD_CARD_TYPE_SDHC) blockNumber <<= 9;
+  if (cardCommand(CMD18, blockNumber)) {
+    error(SD_CARD_ERROR_CMD18);
+    goto fail;
+  }
+  return true;
+
+ fail:
+  chipSelectHigh();
+  return false;
+}
+//------------------------------------------------------------------------------
+/** End a read multiple blocks sequence.
+ *
+ * \return The value one, true, is returned for success and
+ * the value zero, false, is returned for failure.
+ */
+uint8_t Sd2Card::readStop(void) {
+  if (cardCommand(CMD12, 0)) {
+    error(SD_CARD_ERROR_CMD12);
+    goto fail;
+  }
+  chipSelectHigh();
+  return true;
+
+ fail:
+  chipSelectHigh();
+  return false;
+}
+//------------------------------------------------------------------------------
 /**
  * Set the SPI clock rate.
  *
@@ -648,6 +762,29 @@ uint8_t Sd2Card::writeBlock(uint32_t blockNumber, const uint8_t* src) {
   return false;
 }
 //------------------------------------------------------------------------------
+/**
+ * Writes a run of contiguous 512 byte blocks to an SD card.
+ *
+ * A run of more than one block is pre-erased and written with a single
+ * WRITE_MULTIPLE_BLOCK command instead of one WRITE_BLOCK command per block.
+ *
+ * \param[in] blockNumber Logical block number of the first block in the run.
+ * \param[in] src Pointer to the location of the data to be written.
+ * \param[in] count Number of blocks to write.
+ *
+ * \return The value one, true, is returned for success and
+ * the value zero, false, is returned for failure.
+ */
+uint8_t Sd2Card::writeBlocks(uint32_t blockNumber,
+        const uint8_t* src, uint16_t count) {
+  if (count == 1) return writeBlock(blockNumber, src);
+  if (!writeStart(blockNumber, count)) return false;
+  for (uint16_t i = 0; i < count; i++, src += 512) {
+    if (!writeData(src)) return false;
+  }
+  return writeStop();
+}
+//------------------------------------------------------------------------------
 /** Write one data block in a multiple block write sequence */
 uint8_t Sd2Card::writeData(const uint8_t* src) {
   // wait for previous write to finish
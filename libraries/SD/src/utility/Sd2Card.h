@@ -151,6 +151,10 @@ uint8_t const SD_CARD_ERROR_WRITE_PROGRAMMING = 0X14;
 uint8_t const SD_CARD_ERROR_WRITE_TIMEOUT = 0X15;
 /** incorrect rate selected */
 uint8_t const SD_CARD_ERROR_SCK_RATE = 0X16;
+/** card returned an error response for CMD12 (stop transmission) */
+uint8_t const SD_CARD_ERROR_CMD12 = 0X17;
+/** card returned an error response for CMD18 (read multiple blocks) */
+uint8_t const SD_CARD_ERROR_CMD18 = 0X18;
 //------------------------------------------------------------------------------
 // card types
 /** Standard capacity V1 SD card */
@@ -204,8 +208,10 @@ class Sd2Card {
   /** Returns the current value, true or false, for partial block read. */
   uint8_t partialBlockRead(void) const {return partialBlockRead_;}
   uint8_t readBlock(uint32_t block, uint8_t* dst);
+  uint8_t readBlocks(uint32_t block, uint8_t* dst, uint16_t count);
   uint8_t readData(uint32_t block,
           uint16_t offset, uint16_t count, uint8_t* dst);
+  uint8_t readData(uint8_t* dst);
   /**
    * Read a cards CID register. The CID contains card identification
    * information such as Manufacturer ID, Product name, Product serial
@@ -220,6 +226,8 @@ class Sd2Card {
     return readRegister(CMD9, csd);
   }
   void readEnd(void);
+  uint8_t readStart(uint32_t blockNumber);
+  uint8_t readStop(void);
   #ifdef ESP8266
   uint8_t setSckRate(uint32_t sckRateID);
   #else
@@ -228,6 +236,7 @@ class Sd2Card {
   /** Return the card type: SD V1, SD V2 or SDHC */
   uint8_t type(void) const {return type_;}
   uint8_t writeBlock(uint32_t blockNumber, const uint8_t* src);
+  uint8_t writeBlocks(uint32_t blockNumber, const uint8_t* src, uint16_t count);
   uint8_t writeData(const uint8_t* src);
   uint8_t writeStart(uint32_t blockNumber, uint32_t eraseCount);
   uint8_t writeStop(void);
@@ -35,6 +35,27 @@
  */
 #define ALLOW_DEPRECATED_FUNCTIONS 1
 //------------------------------------------------------------------------------
+/**
+ * Number of 512 byte blocks in the SdVolume cache.  Blocks are replaced
+ * least recently used first.
+ */
+#ifndef SD_CACHE_BLOCKS
+#define SD_CACHE_BLOCKS 4
+#endif
+/**
+ * Number of cache blocks reserved for FAT blocks so directory and file
+ * data do not evict the allocation table.  Ignored if SD_CACHE_BLOCKS is one.
+ */
+#ifndef SD_CACHE_FAT_BLOCKS
+#define SD_CACHE_FAT_BLOCKS 1
+#endif
+#if SD_CACHE_BLOCKS < 1
+#error SD_CACHE_BLOCKS must be at least one
+#endif
+#if SD_CACHE_BLOCKS > 1 && SD_CACHE_FAT_BLOCKS >= SD_CACHE_BLOCKS
+#error SD_CACHE_FAT_BLOCKS must leave cache blocks for data
+#endif
+//------------------------------------------------------------------------------
 // forward declaration since SdVolume is used in SdFile
 class SdVolume;
 //==============================================================================
@@ -437,8 +458,8 @@ class SdVolume {
    */
   static uint8_t* cacheClear(void) {
     cacheFlush();
-    cacheBlockNumber_ = 0XFFFFFFFF;
-    return cacheBuffer_.data;
+    cache_[cacheCurrent_].block = 0XFFFFFFFF;
+    return cache_[cacheCurrent_].buffer.data;
   }
   /**
    * Initialize a FAT volume.  Try partition one first then try super
@@ -499,11 +520,24 @@ class SdVolume {
   // value for action argument in cacheRawBlock to indicate cache dirty
   static uint8_t const CACHE_FOR_WRITE = 1;
 
-  static cache_t cacheBuffer_;        // 512 byte cache for device blocks
-  static uint32_t cacheBlockNumber_;  // Logical number of block in the cache
+  // cache blocks reserved for the FAT, zero if all blocks are shared
+  static uint8_t const CACHE_FAT_BLOCKS =
+    SD_CACHE_BLOCKS > 1 ? SD_CACHE_FAT_BLOCKS : 0;
+
+  // one 512 byte block of the cache
+  struct cache_entry_t {
+    cache_t buffer;    // block data
+    uint32_t block;    // logical block number, 0XFFFFFFFF if unused
+    uint32_t mirror;   // block number for mirror FAT
+    uint16_t used;     // cacheTick_ at last use
+    uint8_t dirty;     // cacheFlush() will write block if true
+  };
+  static cache_entry_t cache_[SD_CACHE_BLOCKS];  // cache for device blocks
+  static uint8_t cacheCurrent_;       // entry of the last block cached
+  static uint16_t cacheTick_;         // clock for least recently used
+  static uint32_t cacheFatStart_;     // first block of the FATs
+  static uint32_t cacheFatEnd_;       // block after the last FAT
   static Sd2Card* sdCard_;            // Sd2Card object for cache
-  static uint8_t cacheDirty_;         // cacheFlush() will write block if true
-  static uint32_t cacheMirrorBlock_;  // block number for mirror FAT
 //
   uint32_t allocSearchStart_;   // start cluster for alloc search
   uint8_t blocksPerCluster_;    // cluster size in blocks
@@ -524,9 +558,23 @@ class SdVolume {
            return dataStartBlock_ + ((cluster - 2) << clusterSizeShift_);}
   uint32_t blockNumber(uint32_t cluster, uint32_t position) const {
            return clusterStartBlock(cluster) + blockOfCluster(position);}
+  static uint8_t cacheAlloc(uint32_t blockNumber);
+  // return the block number of the last block cached
+  static uint32_t cacheBlockNumber(void) {return cache_[cacheCurrent_].block;}
+  // return the data of the last block cached
+  static cache_t* cacheBuffer(void) {return &cache_[cacheCurrent_].buffer;}
+  static uint8_t cacheFind(uint32_t blockNumber);
   static uint8_t cacheFlush(void);
+  static uint8_t cacheFlush(uint8_t index);
+  static void cacheInvalidate(uint32_t blockNumber, uint16_t count);
   static uint8_t cacheRawBlock(uint32_t blockNumber, uint8_t action);
-  static void cacheSetDirty(void) {cacheDirty_ |= CACHE_FOR_WRITE;}
+  static void cacheSetDirty(void) {
+    cache_[cacheCurrent_].dirty |= CACHE_FOR_WRITE;
+  }
+  static void cacheUse(uint8_t index) {
+    cacheCurrent_ = index;
+    cache_[index].used = ++cacheTick_;
+  }
   static uint8_t cacheZeroBlock(uint32_t blockNumber);
   uint8_t chainSize(uint32_t beginCluster, uint32_t* size) const;
   uint8_t fatGet(uint32_t cluster, uint32_t* value) const;
@@ -535,11 +583,17 @@ class SdVolume {
     return fatPut(cluster, 0x0FFFFFFF);
   }
   uint8_t freeChain(uint32_t cluster);
+  static uint8_t isCached(uint32_t blockNumber) {
+    return cacheFind(blockNumber) < SD_CACHE_BLOCKS;
+  }
   uint8_t isEOC(uint32_t cluster) const {
     return  cluster >= (fatType_ == 16 ? FAT16EOC_MIN : FAT32EOC_MIN);
   }
   uint8_t readBlock(uint32_t block, uint8_t* dst) {
     return sdCard_->readBlock(block, dst);}
+  uint8_t readBlocks(uint32_t block, uint8_t* dst, uint16_t count) {
+    return sdCard_->readBlocks(block, dst, count);
+  }
   uint8_t readData(uint32_t block, uint16_t offset,
     uint16_t count, uint8_t* dst) {
       return sdCard_->readData(block, offset, count, dst);
@@ -547,5 +601,8 @@ class SdVolume {
   uint8_t writeBlock(uint32_t block, const uint8_t* dst) {
     return sdCard_->writeBlock(block, dst);
   }
+  uint8_t writeBlocks(uint32_t block, const uint8_t* src, uint16_t count) {
+    return sdCard_->writeBlocks(block, src, count);
+  }
 };
 #endif  // SdFat_h
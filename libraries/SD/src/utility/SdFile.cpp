@@ -63,7 +63,7 @@ uint8_t SdFile::addDirCluster(void) {
 // return pointer to cached entry or null for failure
 dir_t* SdFile::cacheDirEntry(uint8_t action) {
   if (!SdVolume::cacheRawBlock(dirBlock_, action)) return NULL;
-  return SdVolume::cacheBuffer_.dir + dirIndex_;
+  return SdVolume::cacheBuffer()->dir + dirIndex_;
 }
 //------------------------------------------------------------------------------
 /**
@@ -324,7 +324,7 @@ uint8_t SdFile::makeDir(SdFile* dir, const char* dirName) {
   if (!SdVolume::cacheRawBlock(block, SdVolume::CACHE_FOR_WRITE)) return false;
 
   // copy '.' to block
-  memcpy(&SdVolume::cacheBuffer_.dir[0], &d, sizeof(d));
+  memcpy(&SdVolume::cacheBuffer()->dir[0], &d, sizeof(d));
 
   // make entry for '..'
   d.name[1] = '.';
@@ -336,7 +336,7 @@ uint8_t SdFile::makeDir(SdFile* dir, const char* dirName) {
     d.firstClusterHigh = dir->firstCluster_ >> 16;
   }
   // copy '..' to block
-  memcpy(&SdVolume::cacheBuffer_.dir[1], &d, sizeof(d));
+  memcpy(&SdVolume::cacheBuffer()->dir[1], &d, sizeof(d));
 
   // set position after '..'
   curPosition_ = 2 * sizeof(d);
@@ -416,7 +416,7 @@ uint8_t SdFile::open(SdFile* dirFile, const char* fileName, uint8_t oflag) {
       if (!emptyFound) {
         emptyFound = true;
         dirIndex_ = index;
-        dirBlock_ = SdVolume::cacheBlockNumber_;
+        dirBlock_ = SdVolume::cacheBlockNumber();
       }
       // done if no entries follow
       if (p->name[0] == DIR_NAME_FREE) break;
@@ -443,7 +443,7 @@ uint8_t SdFile::open(SdFile* dirFile, const char* fileName, uint8_t oflag) {
 
     // use first entry in cluster
     dirIndex_ = 0;
-    p = SdVolume::cacheBuffer_.dir;
+    p = SdVolume::cacheBuffer()->dir;
   }
   // initialize as empty file
   memset(p, 0, sizeof(dir_t));
@@ -511,7 +511,7 @@ uint8_t SdFile::open(SdFile* dirFile, uint16_t index, uint8_t oflag) {
 // open a cached directory entry. Assumes vol_ is initializes
 uint8_t SdFile::openCachedEntry(uint8_t dirIndex, uint8_t oflag) {
   // location of entry in cache
-  dir_t* p = SdVolume::cacheBuffer_.dir + dirIndex;
+  dir_t* p = SdVolume::cacheBuffer()->dir + dirIndex;
 
   // write or truncate is an error for a directory or read-only file
   if (p->attributes & (DIR_ATT_READ_ONLY | DIR_ATT_DIRECTORY)) {
@@ -519,7 +519,7 @@ uint8_t SdFile::openCachedEntry(uint8_t dirIndex, uint8_t oflag) {
   }
   // remember location of directory entry on SD
   dirIndex_ = dirIndex;
-  dirBlock_ = SdVolume::cacheBlockNumber_;
+  dirBlock_ = SdVolume::cacheBlockNumber();
 
   // copy first cluster number for directory fields
   firstCluster_ = (uint32_t)p->firstClusterHigh << 16;
@@ -703,14 +703,34 @@ int16_t SdFile::read(void* buf, uint16_t nbyte) {
     if (n > (512 - offset)) n = 512 - offset;
 
     // no buffering needed if n == 512 or user requests no buffering
-    if ((unbufferedRead() || n == 512) &&
-      block != SdVolume::cacheBlockNumber_) {
-      if (!vol_->readData(block, offset, n, dst)) return -1;
+    if ((unbufferedRead() || n == 512) && !SdVolume::isCached(block)) {
+      if (n == 512) {
+        // read following whole blocks in the same command while they are
+        // contiguous on the card and not in the cache
+        uint16_t count = 1;
+        uint32_t cluster = curCluster_;
+        while (count < (toRead >> 9) && !SdVolume::isCached(block + count)) {
+          uint32_t position = curPosition_ + ((uint32_t)count << 9);
+          if (type_ != FAT_FILE_TYPE_ROOT16 &&
+            vol_->blockOfCluster(position) == 0) {
+            // continue if the next cluster follows this one
+            uint32_t next;
+            if (!vol_->fatGet(cluster, &next) || next != cluster + 1) break;
+            cluster = next;
+          }
+          count++;
+        }
+        if (!vol_->readBlocks(block, dst, count)) return -1;
+        curCluster_ = cluster;
+        n = count << 9;
+      } else if (!vol_->readData(block, offset, n, dst)) {
+        return -1;
+      }
       dst += n;
     } else {
       // read block to cache and copy data to caller
       if (!SdVolume::cacheRawBlock(block, SdVolume::CACHE_FOR_READ)) return -1;
-      uint8_t* src = SdVolume::cacheBuffer_.data + offset;
+      uint8_t* src = SdVolume::cacheBuffer()->data + offset;
       uint8_t* end = src + n;
       while (src != end) *dst++ = *src++;
     }
@@ -764,7 +784,7 @@ dir_t* SdFile::readDirCache(void) {
   curPosition_ += 31;
 
   // return pointer to entry
-  return (SdVolume::cacheBuffer_.dir + i);
+  return (SdVolume::cacheBuffer()->dir + i);
 }
 //------------------------------------------------------------------------------
 /**
@@ -1178,18 +1198,21 @@ size_t SdFile::write(const void* buf, uint16_t nbyte) {
     // block for data write
     uint32_t block = vol_->clusterStartBlock(curCluster_) + blockOfCluster;
     if (n == 512) {
-      // full block - don't need to use cache
-      // invalidate cache if block is in cache
-      if (SdVolume::cacheBlockNumber_ == block) {
-        SdVolume::cacheBlockNumber_ = 0XFFFFFFFF;
+      // full blocks - don't need to use cache
+      // write the whole blocks left in this cluster in one command
+      uint16_t count = nToWrite >> 9;
+      if (count > vol_->blocksPerCluster_ - blockOfCluster) {
+        count = vol_->blocksPerCluster_ - blockOfCluster;
       }
-      if (!vol_->writeBlock(block, src)) goto writeErrorReturn;
-      src += 512;
+      // invalidate cache if blocks are in cache
+      SdVolume::cacheInvalidate(block, count);
+      if (!vol_->writeBlocks(block, src, count)) goto writeErrorReturn;
+      n = count << 9;
+      src += n;
     } else {
       if (blockOffset == 0 && curPosition_ >= fileSize_) {
         // start of new block don't need to read into cache
-        if (!SdVolume::cacheFlush()) goto writeErrorReturn;
-        SdVolume::cacheBlockNumber_ = block;
+        if (!SdVolume::cacheAlloc(block)) goto writeErrorReturn;
         SdVolume::cacheSetDirty();
       } else {
         // rewrite part of block
@@ -1197,7 +1220,7 @@ size_t SdFile::write(const void* buf, uint16_t nbyte) {
           goto writeErrorReturn;
         }
       }
-      uint8_t* dst = SdVolume::cacheBuffer_.data + blockOffset;
+      uint8_t* dst = SdVolume::cacheBuffer()->data + blockOffset;
       uint8_t* end = dst + n;
       while (dst != end) *dst++ = *src++;
     }
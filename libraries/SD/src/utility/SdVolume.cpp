@@ -20,12 +20,13 @@
 #include "SdFat.h"
 //------------------------------------------------------------------------------
 // raw block cache
-// init cacheBlockNumber_to invalid SD block number
-uint32_t SdVolume::cacheBlockNumber_ = 0XFFFFFFFF;
-cache_t  SdVolume::cacheBuffer_;     // 512 byte cache for Sd2Card
-Sd2Card* SdVolume::sdCard_;          // pointer to SD card object
-uint8_t  SdVolume::cacheDirty_ = 0;  // cacheFlush() will write block if true
-uint32_t SdVolume::cacheMirrorBlock_ = 0;  // mirror  block for second FAT
+// entries are set to invalid SD block numbers by init()
+SdVolume::cache_entry_t SdVolume::cache_[SD_CACHE_BLOCKS];
+uint8_t  SdVolume::cacheCurrent_ = 0;   // entry of the last block cached
+uint16_t SdVolume::cacheTick_ = 0;      // clock for least recently used
+uint32_t SdVolume::cacheFatStart_ = 0;  // first block of the FATs
+uint32_t SdVolume::cacheFatEnd_ = 0;    // block after the last FAT
+Sd2Card* SdVolume::sdCard_;             // pointer to SD card object
 //------------------------------------------------------------------------------
 // find a contiguous group of clusters
 uint8_t SdVolume::allocContiguous(uint32_t count, uint32_t* curCluster) {
@@ -96,42 +97,108 @@ uint8_t SdVolume::allocContiguous(uint32_t count, uint32_t* curCluster) {
   return true;
 }
 //------------------------------------------------------------------------------
+// make blockNumber the current cache entry without reading it
+// the entry keeps its old data if blockNumber was not already cached
+uint8_t SdVolume::cacheAlloc(uint32_t blockNumber) {
+  uint8_t i = cacheFind(blockNumber);
+  if (i == SD_CACHE_BLOCKS) {
+    // FAT blocks and other blocks are replaced in separate parts of the cache
+    uint8_t first = CACHE_FAT_BLOCKS;
+    uint8_t last = SD_CACHE_BLOCKS;
+    if (first && blockNumber >= cacheFatStart_ && blockNumber < cacheFatEnd_) {
+      last = first;
+      first = 0;
+    }
+    // use an unused entry or the least recently used one
+    i = first;
+    for (uint8_t j = first; j < last; j++) {
+      if (cache_[j].block == 0XFFFFFFFF) {
+        i = j;
+        break;
+      }
+      if ((uint16_t)(cacheTick_ - cache_[j].used) >
+          (uint16_t)(cacheTick_ - cache_[i].used)) {
+        i = j;
+      }
+    }
+    if (!cacheFlush(i)) return false;
+    cache_[i].block = blockNumber;
+  }
+  cacheUse(i);
+  return true;
+}
+//------------------------------------------------------------------------------
+// return the cache entry for blockNumber or SD_CACHE_BLOCKS if not cached
+uint8_t SdVolume::cacheFind(uint32_t blockNumber) {
+  uint8_t i = 0;
+  while (i < SD_CACHE_BLOCKS && cache_[i].block != blockNumber) i++;
+  return i;
+}
+//------------------------------------------------------------------------------
+// write all dirty blocks, file and directory data before FAT blocks
 uint8_t SdVolume::cacheFlush(void) {
-  if (cacheDirty_) {
-    if (!sdCard_->writeBlock(cacheBlockNumber_, cacheBuffer_.data)) {
+  for (uint8_t i = SD_CACHE_BLOCKS; i != 0; i--) {
+    if (!cacheFlush(i - 1)) return false;
+  }
+  return true;
+}
+//------------------------------------------------------------------------------
+// write one cache entry if it is dirty
+uint8_t SdVolume::cacheFlush(uint8_t index) {
+  cache_entry_t* p = &cache_[index];
+  if (p->dirty) {
+    if (!sdCard_->writeBlock(p->block, p->buffer.data)) {
       return false;
     }
     // mirror FAT tables
-    if (cacheMirrorBlock_) {
-      if (!sdCard_->writeBlock(cacheMirrorBlock_, cacheBuffer_.data)) {
+    if (p->mirror) {
+      if (!sdCard_->writeBlock(p->mirror, p->buffer.data)) {
         return false;
       }
-      cacheMirrorBlock_ = 0;
+      p->mirror = 0;
     }
-    cacheDirty_ = 0;
+    p->dirty = 0;
   }
   return true;
 }
 //------------------------------------------------------------------------------
+// drop count blocks starting at blockNumber from the cache without writing
+// them, used when the blocks are about to be overwritten on the card
+void SdVolume::cacheInvalidate(uint32_t blockNumber, uint16_t count) {
+  for (uint8_t i = 0; i < SD_CACHE_BLOCKS; i++) {
+    if ((cache_[i].block - blockNumber) < count) {
+      cache_[i].block = 0XFFFFFFFF;
+      cache_[i].mirror = 0;
+      cache_[i].dirty = 0;
+    }
+  }
+}
+//------------------------------------------------------------------------------
 uint8_t SdVolume::cacheRawBlock(uint32_t blockNumber, uint8_t action) {
-  if (cacheBlockNumber_ != blockNumber) {
-    if (!cacheFlush()) return false;
-    if (!sdCard_->readBlock(blockNumber, cacheBuffer_.data)) return false;
-    cacheBlockNumber_ = blockNumber;
+  uint8_t i = cacheFind(blockNumber);
+  if (i < SD_CACHE_BLOCKS) {
+    cacheUse(i);
+  } else {
+    if (!cacheAlloc(blockNumber)) return false;
+    if (!sdCard_->readBlock(blockNumber, cacheBuffer()->data)) {
+      // don't keep a partly read block
+      cache_[cacheCurrent_].block = 0XFFFFFFFF;
+      return false;
+    }
   }
-  cacheDirty_ |= action;
+  cache_[cacheCurrent_].dirty |= action;
   return true;
 }
 //------------------------------------------------------------------------------
 // cache a zero block for blockNumber
 uint8_t SdVolume::cacheZeroBlock(uint32_t blockNumber) {
-  if (!cacheFlush()) return false;
+  if (!cacheAlloc(blockNumber)) return false;
 
-  // loop take less flash than memset(cacheBuffer_.data, 0, 512);
+  // loop take less flash than memset(cacheBuffer()->data, 0, 512);
+  uint8_t* p = cacheBuffer()->data;
   for (uint16_t i = 0; i < 512; i++) {
-    cacheBuffer_.data[i] = 0;
+    p[i] = 0;
   }
-  cacheBlockNumber_ = blockNumber;
   cacheSetDirty();
   return true;
 }
@@ -152,13 +219,13 @@ uint8_t SdVolume::fatGet(uint32_t cluster, uint32_t* value) const {
   if (cluster > (clusterCount_ + 1)) return false;
   uint32_t lba = fatStartBlock_;
   lba += fatType_ == 16 ? cluster >> 8 : cluster >> 7;
-  if (lba != cacheBlockNumber_) {
+  if (lba != cacheBlockNumber()) {
     if (!cacheRawBlock(lba, CACHE_FOR_READ)) return false;
   }
   if (fatType_ == 16) {
-    *value = cacheBuffer_.fat16[cluster & 0XFF];
+    *value = cacheBuffer()->fat16[cluster & 0XFF];
   } else {
-    *value = cacheBuffer_.fat32[cluster & 0X7F] & FAT32MASK;
+    *value = cacheBuffer()->fat32[cluster & 0X7F] & FAT32MASK;
   }
   return true;
 }
@@ -175,19 +242,19 @@ uint8_t SdVolume::fatPut(uint32_t cluster, uint32_t value) {
   uint32_t lba = fatStartBlock_;
   lba += fatType_ == 16 ? cluster >> 8 : cluster >> 7;
 
-  if (lba != cacheBlockNumber_) {
+  if (lba != cacheBlockNumber()) {
     if (!cacheRawBlock(lba, CACHE_FOR_READ)) return false;
   }
   // store entry
   if (fatType_ == 16) {
-    cacheBuffer_.fat16[cluster & 0XFF] = value;
+    cacheBuffer()->fat16[cluster & 0XFF] = value;
   } else {
-    cacheBuffer_.fat32[cluster & 0X7F] = value;
+    cacheBuffer()->fat32[cluster & 0X7F] = value;
   }
   cacheSetDirty();
 
   // mirror second FAT
-  if (fatCount_ > 1) cacheMirrorBlock_ = lba + blocksPerFat_;
+  if (fatCount_ > 1) cache_[cacheCurrent_].mirror = lba + blocksPerFat_;
   return true;
 }
 //------------------------------------------------------------------------------
@@ -227,12 +294,19 @@ uint8_t SdVolume::freeChain(uint32_t cluster) {
 uint8_t SdVolume::init(Sd2Card* dev, uint8_t part) {
   uint32_t volumeStartBlock = 0;
   sdCard_ = dev;
+  // forget blocks cached from a previous card
+  cacheFatStart_ = cacheFatEnd_ = 0;
+  for (uint8_t i = 0; i < SD_CACHE_BLOCKS; i++) {
+    cache_[i].block = 0XFFFFFFFF;
+    cache_[i].mirror = 0;
+    cache_[i].dirty = 0;
+  }
   // if part == 0 assume super floppy with FAT boot sector in block zero
   // if part > 0 assume mbr volume with partition table
   if (part) {
     if (part > 4)return false;
     if (!cacheRawBlock(volumeStartBlock, CACHE_FOR_READ)) return false;
-    part_t* p = &cacheBuffer_.mbr.part[part-1];
+    part_t* p = &cacheBuffer()->mbr.part[part-1];
     if ((p->boot & 0X7F) !=0  ||
       p->totalSectors < 100 ||
       p->firstSector == 0) {
@@ -242,7 +316,7 @@ uint8_t SdVolume::init(Sd2Card* dev, uint8_t part) {
     volumeStartBlock = p->firstSector;
   }
   if (!cacheRawBlock(volumeStartBlock, CACHE_FOR_READ)) return false;
-  bpb_t* bpb = &cacheBuffer_.fbs.bpb;
+  bpb_t* bpb = &cacheBuffer()->fbs.bpb;
   if (bpb->bytesPerSector != 512 ||
     bpb->fatCount == 0 ||
     bpb->reservedSectorCount == 0 ||
@@ -264,6 +338,10 @@ uint8_t SdVolume::init(Sd2Card* dev, uint8_t part) {
 
   fatStartBlock_ = volumeStartBlock + bpb->reservedSectorCount;
 
+  // cache FAT blocks apart from directory and file data
+  cacheFatStart_ = fatStartBlock_;
+  cacheFatEnd_ = fatStartBlock_ + bpb->fatCount * blocksPerFat_;
+
   // count for FAT16 zero for FAT32
   rootDirEntryCount_ = bpb->rootDirEntryCount;
 
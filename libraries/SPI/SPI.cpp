@@ -27,17 +27,157 @@
 
 #define SPI_OVERLAP_SS 0
 
+// Background transfers, see transferAsync(). Each one is sent in chunks of
+// half the FIFO, W0-W7 and W8-W15 in turn, so the next chunk is loaded while
+// the last one is on the bus and the interrupt only has to start it.
+#define SPI_ASYNC_CHUNK 32
+
+typedef struct {
+    const uint8_t * out;
+    uint8_t * in;
+    uint32_t size;
+    SPIAsyncCallback callback;
+    void * arg;
+    uint32_t clk;   ///< the settings it was queued with
+    uint32_t ctrl;
+    uint32_t user;
+    uint32_t pin;
+} spiAsyncTransfer_t;
+
+static struct {
+    spiAsyncTransfer_t queue[SPI_ASYNC_QUEUE];
+    uint8_t head;            ///< the transfer on the bus
+    volatile uint8_t count;  ///< transfers queued, including the head
+    uint8_t half;            ///< FIFO half of the chunk on the bus
+    uint8_t chunk[2];        ///< bytes loaded into each half, 0 if none
+    uint32_t pos;            ///< offset of the chunk on the bus
+    bool attached;
+} spiAsync;
+
+static inline ICACHE_RAM_ATTR void spiAsyncLoad(uint8_t half, const uint8_t * out, uint8_t size) {
+    volatile uint32_t * fifoPtr = &SPI1W(half * 8);
+    for(uint8_t i = 0; i < size; i += 4) {
+        uint32_t word = 0xFFFFFFFF;
+        if(out) {
+            const uint8_t * b = out + i;
+            if(!(((unsigned long) b) & 3) && size - i >= 4) {
+                word = *(const uint32_t *) b;
+            } else {
+                word = 0;
+                for(uint8_t j = 0; j < 4 && i + j < size; j++) {
+                    word |= (uint32_t) b[j] << (j * 8);
+                }
+            }
+        }
+        *fifoPtr++ = word;
+    }
+}
 
-typedef union {
-        uint32_t regValue;
-        struct {
-                unsigned regL :6;
-                unsigned regH :6;
-                unsigned regN :6;
-                unsigned regPre :13;
-                unsigned regEQU :1;
-        };
-} spiClk_t;
+static inline ICACHE_RAM_ATTR void spiAsyncUnload(uint8_t half, uint8_t * in, uint8_t size) {
+    volatile uint32_t * fifoPtr = &SPI1W(half * 8);
+    for(uint8_t i = 0; i < size; i += 4) {
+        uint32_t word = *fifoPtr++;
+        uint8_t * b = in + i;
+        if(!(((unsigned long) b) & 3) && size - i >= 4) {
+            *(uint32_t *) b = word;
+        } else {
+            for(uint8_t j = 0; j < 4 && i + j < size; j++) {
+                b[j] = word >> (j * 8);
+            }
+        }
+    }
+}
+
+// Loads the chunk that follows the one on the bus into the other half
+static ICACHE_RAM_ATTR void spiAsyncPreload() {
+    const spiAsyncTransfer_t * t = &spiAsync.queue[spiAsync.head];
+    uint8_t half = spiAsync.half ^ 1;
+    uint32_t pos = spiAsync.pos + spiAsync.chunk[spiAsync.half];
+    uint32_t left = t->size - pos;
+    uint8_t size = (left > SPI_ASYNC_CHUNK) ? SPI_ASYNC_CHUNK : left;
+    if(size) {
+        spiAsyncLoad(half, t->out ? t->out + pos : NULL, size);
+    }
+    spiAsync.chunk[half] = size;
+}
+
+static ICACHE_RAM_ATTR void spiAsyncStartChunk() {
+    const uint32_t mask = ~((SPIMMOSI << SPILMOSI) | (SPIMMISO << SPILMISO));
+    uint32_t bits = spiAsync.chunk[spiAsync.half] * 8 - 1;
+    SPI1U1 = ((SPI1U1 & mask) | ((bits << SPILMOSI) | (bits << SPILMISO)));
+    if(spiAsync.half) {
+        SPI1U |= SPIUMOSIH | SPIUMISOH;
+    } else {
+        SPI1U &= ~(SPIUMOSIH | SPIUMISOH);
+    }
+    __sync_synchronize();
+    SPI1CMD |= SPIBUSY;
+}
+
+static ICACHE_RAM_ATTR void spiAsyncStartTransfer() {
+    const spiAsyncTransfer_t * t = &spiAsync.queue[spiAsync.head];
+    if(t->clk == 0x80000000) {
+        GPMUX |= (1 << 9);
+    } else {
+        GPMUX &= ~(1 << 9);
+    }
+    SPI1CLK = t->clk;
+    SPI1C = t->ctrl;
+    SPI1U = t->user;
+    SPI1P = t->pin;
+
+    spiAsync.pos = 0;
+    spiAsync.half = 1;
+    spiAsync.chunk[1] = 0;
+    spiAsyncPreload();
+    spiAsync.half = 0;
+    spiAsyncStartChunk();
+    spiAsyncPreload();
+}
+
+static ICACHE_RAM_ATTR void spiAsyncIsr(void *arg) {
+    (void) arg;
+    if(!(SPIIR & (1 << SPII1)) || !(SPI1S & SPISTRIS)) {
+        return;
+    }
+    SPI1S &= ~SPISTRIS;
+    if(!spiAsync.count) {
+        return;
+    }
+
+    spiAsyncTransfer_t * t = &spiAsync.queue[spiAsync.head];
+    uint8_t half = spiAsync.half;
+    if(spiAsync.chunk[half ^ 1]) {
+        // the next chunk is waiting in the other half, get it going first
+        spiAsync.half ^= 1;
+        spiAsyncStartChunk();
+        if(t->in) {
+            spiAsyncUnload(half, t->in + spiAsync.pos, spiAsync.chunk[half]);
+        }
+        spiAsync.pos += spiAsync.chunk[half];
+        spiAsync.chunk[half] = 0;
+        spiAsyncPreload();
+        return;
+    }
+
+    if(t->in) {
+        spiAsyncUnload(half, t->in + spiAsync.pos, spiAsync.chunk[half]);
+    }
+    SPIAsyncCallback callback = t->callback;
+    void * callbackArg = t->arg;
+    spiAsync.head = (spiAsync.head + 1) % SPI_ASYNC_QUEUE;
+    spiAsync.count--;
+    if(spiAsync.count) {
+        spiAsyncStartTransfer();
+    } else {
+        // back to how the blocking functions use the FIFO
+        SPI1U &= ~(SPIUMOSIH | SPIUMISOH);
+        SPI1S &= ~SPISTRIE;
+    }
+    if(callback) {
+        callback(callbackArg);
+    }
+}
 
 SPIClass::SPIClass() {
     useHwCs = false;
@@ -87,6 +227,15 @@ void SPIClass::begin() {
 }
 
 void SPIClass::end() {
+    if(!asyncWait()) {
+        return;
+    }
+    if(spiAsync.attached) {
+        ETS_SPI_INTR_DISABLE();
+        SPI1S &= ~(SPISTRIE | SPISTRIS);
+        ETS_SPI_INTR_ATTACH(NULL, NULL);
+        spiAsync.attached = false;
+    }
     switch (pinSet) {
     case SPI_PINS_HSPI:
         pinMode(SCK, INPUT);
@@ -140,16 +289,28 @@ void SPIClass::setHwCs(bool use) {
 }
 
 void SPIClass::beginTransaction(SPISettings settings) {
-    while(SPI1CMD & SPIBUSY) {}
-    setFrequency(settings._clock);
-    setBitOrder(settings._bitOrder);
-    setDataMode(settings._dataMode);
+    if(!asyncWait()) {
+        return;
+    }
+    // the settings come with their register values, see SPISettings
+    if(settings._clockReg == 0x80000000) {
+        GPMUX |= (1 << 9); // Set bit 9 if sysclock required
+    } else {
+        GPMUX &= ~(1 << 9);
+    }
+    SPI1CLK = settings._clockReg;
+    SPI1C = (SPI1C & ~(SPICWBO | SPICRBO)) | settings._ctrlReg;
+    SPI1U = (SPI1U & ~SPIUSME) | settings._userReg;
+    SPI1P = (SPI1P & ~(1 << 29)) | settings._pinReg;
 }
 
 void SPIClass::endTransaction() {
 }
 
 void SPIClass::setDataMode(uint8_t dataMode) {
+    if(!asyncWait()) {
+        return;
+    }
 
     /**
      SPI_MODE0 0x00 - CPOL: 0  CPHA: 0
@@ -177,6 +338,9 @@ void SPIClass::setDataMode(uint8_t dataMode) {
 }
 
 void SPIClass::setBitOrder(uint8_t bitOrder) {
+    if(!asyncWait()) {
+        return;
+    }
     if(bitOrder == MSBFIRST) {
         SPI1C &= ~(SPICWBO | SPICRBO);
     } else {
@@ -184,6 +348,31 @@ void SPIClass::setBitOrder(uint8_t bitOrder) {
     }
 }
 
+void SPIClass::setFrequency(uint32_t freq) {
+    static uint32_t lastSetFrequency = 0;
+    static uint32_t lastSetRegister = 0;
+
+    if(lastSetFrequency == freq && lastSetRegister == SPI1CLK) {
+        // do nothing (speed optimization)
+        return;
+    }
+
+    setClockDivider(SPISettings::clockRegisterAt(freq));
+    lastSetRegister = SPI1CLK;
+    lastSetFrequency = freq;
+}
+
+typedef union {
+        uint32_t regValue;
+        struct {
+                unsigned regL :6;
+                unsigned regH :6;
+                unsigned regN :6;
+                unsigned regPre :13;
+                unsigned regEQU :1;
+        };
+} spiClk_t;
+
 /**
  * calculate the Frequency based on the register value
  * @param reg
@@ -193,28 +382,24 @@ static uint32_t ClkRegToFreq(spiClk_t * reg) {
     return (ESP8266_CLOCK / ((reg->regPre + 1) * (reg->regN + 1)));
 }
 
-void SPIClass::setFrequency(uint32_t freq) {
-    static uint32_t lastSetFrequency = 0;
-    static uint32_t lastSetRegister = 0;
+uint32_t SPISettings::clockRegisterAt(uint32_t freq) {
+    static uint32_t lastFrequency = 0;
+    static uint32_t lastRegister = 0;
 
     if(freq >= ESP8266_CLOCK) {
-        setClockDivider(0x80000000);
-        return;
+        return 0x80000000;
     }
 
-    if(lastSetFrequency == freq && lastSetRegister == SPI1CLK) {
+    if(lastRegister && lastFrequency == freq) {
         // do nothing (speed optimization)
-        return;
+        return lastRegister;
     }
 
-    const spiClk_t minFreqReg = { 0x7FFFF000 };
-    uint32_t minFreq = ClkRegToFreq((spiClk_t*) &minFreqReg);
+    spiClk_t minFreqReg = { 0x7FFFF000 };
+    uint32_t minFreq = ClkRegToFreq(&minFreqReg);
     if(freq < minFreq) {
         // use minimum possible clock
-        setClockDivider(minFreqReg.regValue);
-        lastSetRegister = SPI1CLK;
-        lastSetFrequency = freq;
-        return;
+        return minFreqReg.regValue;
     }
 
     uint8_t calN = 1;
@@ -247,17 +432,16 @@ void SPIClass::setFrequency(uint32_t freq) {
 
             // test calculation
             calFreq = ClkRegToFreq(&reg);
-            //os_printf("-----[0x%08X][%d]\t EQU: %d\t Pre: %d\t N: %d\t H: %d\t L: %d = %d\n", reg.regValue, freq, reg.regEQU, reg.regPre, reg.regN, reg.regH, reg.regL, calFreq);
 
             if(calFreq == (int32_t) freq) {
                 // accurate match use it!
-                memcpy(&bestReg, &reg, sizeof(bestReg));
+                bestReg = reg;
                 break;
             } else if(calFreq < (int32_t) freq) {
                 // never go over the requested frequency
-                if(abs(freq - calFreq) < abs(freq - bestFreq)) {
+                if(freq - calFreq < freq - bestFreq) {
                     bestFreq = calFreq;
-                    memcpy(&bestReg, &reg, sizeof(bestReg));
+                    bestReg = reg;
                 }
             }
         }
@@ -268,15 +452,15 @@ void SPIClass::setFrequency(uint32_t freq) {
         calN++;
     }
 
-    // os_printf("[0x%08X][%d]\t EQU: %d\t Pre: %d\t N: %d\t H: %d\t L: %d\t - Real Frequency: %d\n", bestReg.regValue, freq, bestReg.regEQU, bestReg.regPre, bestReg.regN, bestReg.regH, bestReg.regL, ClkRegToFreq(&bestReg));
-
-    setClockDivider(bestReg.regValue);
-    lastSetRegister = SPI1CLK;
-    lastSetFrequency = freq;
-
+    lastFrequency = freq;
+    lastRegister = bestReg.regValue;
+    return lastRegister;
 }
 
 void SPIClass::setClockDivider(uint32_t clockDiv) {
+    if(!asyncWait()) {
+        return;
+    }
     if(clockDiv == 0x80000000) {
         GPMUX |= (1 << 9); // Set bit 9 if sysclock required
     } else {
@@ -292,7 +476,9 @@ inline void SPIClass::setDataBits(uint16_t bits) {
 }
 
 uint8_t SPIClass::transfer(uint8_t data) {
-    while(SPI1CMD & SPIBUSY) {}
+    if(!asyncWait()) {
+        return 0;
+    }
     // reset to 8Bit mode
     setDataBits(8);
     SPI1W0 = data;
@@ -343,7 +529,9 @@ void SPIClass::transfer(void *buf, uint16_t count) {
 }
 
 void SPIClass::write(uint8_t data) {
-    while(SPI1CMD & SPIBUSY) {}
+    if(!asyncWait()) {
+        return;
+    }
     // reset to 8Bit mode
     setDataBits(8);
     SPI1W0 = data;
@@ -356,7 +544,9 @@ void SPIClass::write16(uint16_t data) {
 }
 
 void SPIClass::write16(uint16_t data, bool msb) {
-    while(SPI1CMD & SPIBUSY) {}
+    if(!asyncWait()) {
+        return;
+    }
     // Set to 16Bits transfer
     setDataBits(16);
     if(msb) {
@@ -375,7 +565,9 @@ void SPIClass::write32(uint32_t data) {
 }
 
 void SPIClass::write32(uint32_t data, bool msb) {
-    while(SPI1CMD & SPIBUSY) {}
+    if(!asyncWait()) {
+        return;
+    }
     // Set to 32Bits transfer
     setDataBits(32);
     if(msb) {
@@ -413,7 +605,9 @@ void SPIClass::writeBytes(const uint8_t * data, uint32_t size) {
 }
 
 void SPIClass::writeBytes_(const uint8_t * data, uint8_t size) {
-    while(SPI1CMD & SPIBUSY) {}
+    if(!asyncWait()) {
+        return;
+    }
     // Set Bits to transfer
     setDataBits(size * 8);
 
@@ -440,7 +634,9 @@ void SPIClass::writeBytes_(const uint8_t * data, uint8_t size) {
 void SPIClass::writePattern(const uint8_t * data, uint8_t size, uint32_t repeat) {
     if(size > 64) return; //max Hardware FIFO
 
-    while(SPI1CMD & SPIBUSY) {}
+    if(!asyncWait()) {
+        return;
+    }
 
     uint32_t buffer[16];
     uint8_t *bufferPtr=(uint8_t *)&buffer;
@@ -539,7 +735,9 @@ void SPIClass::transferBytes(const uint8_t * out, uint8_t * in, uint32_t size) {
  * @param size uint8_t (max 64)
  */
 void SPIClass::transferBytes_(const uint8_t * out, uint8_t * in, uint8_t size) {
-    while(SPI1CMD & SPIBUSY) {}
+    if(!asyncWait()) {
+        return;
+    }
     // Set in/out Bits to transfer
 
     setDataBits(size * 8);
@@ -577,6 +775,71 @@ void SPIClass::transferBytes_(const uint8_t * out, uint8_t * in, uint8_t size) {
     }
 }
 
+/**
+ * Queues a transfer that runs in the background, driven by the SPI interrupt.
+ * It is sent with the settings in effect now, even if they change before it starts.
+ * in and out don't need to be aligned, either can be NULL.
+ * @param out uint8_t *  data to send, or NULL to send 0xFF
+ * @param in  uint8_t *  where to put what was received, or NULL
+ * @param size uint32_t
+ * @param callback SPIAsyncCallback  called from the interrupt when done, needs ICACHE_RAM_ATTR.
+ *                 It may queue more transfers, blocking calls do nothing while any are queued.
+ * @param arg void *  passed to callback
+ * @return false if SPI_ASYNC_QUEUE transfers are waiting already
+ */
+bool SPIClass::transferAsync(const uint8_t * out, uint8_t * in, uint32_t size, SPIAsyncCallback callback, void * arg) {
+    if(!size) {
+        if(callback) callback(arg);
+        return true;
+    }
+    if(spiAsync.count >= SPI_ASYNC_QUEUE) {
+        return false;
+    }
+    if(!spiAsync.attached) {
+        ETS_SPI_INTR_ATTACH(spiAsyncIsr, NULL);
+        ETS_SPI_INTR_ENABLE();
+        spiAsync.attached = true;
+    }
+
+    ETS_SPI_INTR_DISABLE();
+    spiAsyncTransfer_t * t = &spiAsync.queue[(spiAsync.head + spiAsync.count) % SPI_ASYNC_QUEUE];
+    t->out = out;
+    t->in = in;
+    t->size = size;
+    t->callback = callback;
+    t->arg = arg;
+    t->clk = SPI1CLK;
+    t->ctrl = SPI1C;
+    t->user = SPI1U & ~(SPIUMOSIH | SPIUMISOH);
+    t->pin = SPI1P;
+    if(!spiAsync.count++) {
+        while(SPI1CMD & SPIBUSY) {}
+        SPI1S = (SPI1S & ~SPISTRIS) | SPISTRIE;
+        spiAsyncStartTransfer();
+    }
+    ETS_SPI_INTR_ENABLE();
+    return true;
+}
+
+bool SPIClass::asyncBusy() {
+    return spiAsync.count != 0;
+}
+
+/**
+ * Waits until the queued transfers are done and the bus is free.
+ * The queue only moves on in the SPI interrupt, so from an interrupt
+ * (e.g. a transferAsync() callback) this can't wait for it.
+ * @return false if called from an interrupt with transfers still queued
+ */
+bool SPIClass::asyncWait() {
+    if(spiAsync.count && ETS_INTR_WITHINISR()) {
+        return false;
+    }
+    while(spiAsync.count) {}
+    while(SPI1CMD & SPIBUSY) {}
+    return true;
+}
+
 #if !defined(NO_GLOBAL_INSTANCES) && !defined(NO_GLOBAL_SPI)
 SPIClass SPI;
 #endif
@@ -41,13 +41,63 @@ const uint8_t SPI_MODE1 = 0x01; ///<  CPOL: 0  CPHA: 1
 const uint8_t SPI_MODE2 = 0x10; ///<  CPOL: 1  CPHA: 0
 const uint8_t SPI_MODE3 = 0x11; ///<  CPOL: 1  CPHA: 1
 
+// Called from the interrupt once a transferAsync() is done, so it needs ICACHE_RAM_ATTR
+typedef void (*SPIAsyncCallback)(void * arg);
+
+#define SPI_ASYNC_QUEUE 4 // transfers that can wait for the bus
+
+// Holds the register values for its settings, so beginTransaction() only has to store them.
+// They are worked out at compile time when the arguments are constants, and by
+// clockRegisterAt() when the clock is only known at run time.
 class SPISettings {
 public:
-  SPISettings() :_clock(1000000), _bitOrder(LSBFIRST), _dataMode(SPI_MODE0){}
-  SPISettings(uint32_t clock, uint8_t bitOrder, uint8_t dataMode) :_clock(clock), _bitOrder(bitOrder), _dataMode(dataMode){}
+  constexpr SPISettings() :SPISettings(1000000, LSBFIRST, SPI_MODE0){}
+  constexpr SPISettings(uint32_t clock, uint8_t bitOrder, uint8_t dataMode) :_clock(clock), _bitOrder(bitOrder), _dataMode(dataMode),
+    _clockReg(__builtin_constant_p(clock) ? clockRegister(clock) : clockRegisterAt(clock)),
+    _ctrlReg((bitOrder == MSBFIRST) ? 0 : (SPICWBO | SPICRBO)),
+    _userReg((dataMode & 0x01) ? SPIUSME : 0),
+    _pinReg((dataMode & 0x10) ? (1 << 29) : 0){}
   uint32_t _clock;
   uint8_t  _bitOrder;
   uint8_t  _dataMode;
+  uint32_t _clockReg; ///< SPI1CLK
+  uint32_t _ctrlReg;  ///< bit order bits of SPI1C
+  uint32_t _userReg;  ///< clock phase bit of SPI1U
+  uint32_t _pinReg;   ///< clock polarity bit of SPI1P
+
+  // The SPI1CLK value for the highest frequency not above freq
+  static constexpr uint32_t clockRegister(uint32_t freq) {
+    return (freq >= ESP8266_CLOCK) ? 0x80000000 :
+           (freq < clockFrequency(0x3F, 0x1FFF)) ? 0x7FFFF000 :
+           clockSearch(freq, 1, -1, 0, 0);
+  }
+  // Same result as clockRegister(), searched with a loop and remembering the last frequency
+  static uint32_t clockRegisterAt(uint32_t freq);
+
+private:
+  static constexpr uint32_t clockFrequency(uint32_t n, uint32_t pre) {
+    return ESP8266_CLOCK / ((pre + 1) * (n + 1));
+  }
+  static constexpr uint32_t clockPre(uint32_t freq, uint32_t n, int32_t variant) {
+    return ((int32_t) ((ESP8266_CLOCK / (n + 1)) / freq) - 1 + variant > 0x1FFF) ? 0x1FFF :
+           ((int32_t) ((ESP8266_CLOCK / (n + 1)) / freq) - 1 + variant <= 0) ? 0 :
+           (int32_t) ((ESP8266_CLOCK / (n + 1)) / freq) - 1 + variant;
+  }
+  static constexpr uint32_t clockValue(uint32_t n, uint32_t pre) {
+    return ((n + 1) / 2) | (n << 12) | (pre << 18); // L, N and Pre, H stays 0
+  }
+  static constexpr uint32_t clockTry(uint32_t freq, uint32_t n, int32_t variant, uint32_t bestReg, uint32_t bestFreq, uint32_t pre) {
+    return (clockFrequency(n, pre) == freq) ? clockValue(n, pre) : // accurate match use it!
+           (clockFrequency(n, pre) < freq && freq - clockFrequency(n, pre) < freq - bestFreq) ? // never go over the requested frequency
+             clockSearch(freq, n, variant + 1, clockValue(n, pre), clockFrequency(n, pre)) :
+             clockSearch(freq, n, variant + 1, bestReg, bestFreq);
+  }
+  // N from 1 to 63, and a few Pre around the one that N suggests (integer math misses the decimals)
+  static constexpr uint32_t clockSearch(uint32_t freq, uint32_t n, int32_t variant, uint32_t bestReg, uint32_t bestFreq) {
+    return (n > 0x3F) ? bestReg :
+           (variant > 2) ? clockSearch(freq, n + 1, -1, bestReg, bestFreq) :
+           clockTry(freq, n, variant, bestReg, bestFreq, clockPre(freq, n, variant));
+  }
 };
 
 class SPIClass {
@@ -73,6 +123,12 @@ public:
   void writeBytes(const uint8_t * data, uint32_t size);
   void writePattern(const uint8_t * data, uint8_t size, uint32_t repeat);
   void transferBytes(const uint8_t * out, uint8_t * in, uint32_t size);
+  // The other calls wait for queued transfers first. They can't from the
+  // callback, which runs in the interrupt: there they return without
+  // touching the bus while transfers are queued, and asyncWait() returns false.
+  bool transferAsync(const uint8_t * out, uint8_t * in, uint32_t size, SPIAsyncCallback callback = NULL, void * arg = NULL);
+  bool asyncBusy();
+  bool asyncWait();
   void endTransaction(void);
 private:
   bool useHwCs;
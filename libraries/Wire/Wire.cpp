@@ -150,6 +150,47 @@ uint8_t TwoWire::endTransmission(void){
   return endTransmission(true);
 }
 
+/**
+ * Queues what was written since beginTransmission(), the bus is driven from the timer1 interrupt
+ * meanwhile. Returns false if the queue is full or someone else has the timer1 callback, the
+ * bytes are kept for another try then.
+ */
+bool TwoWire::endTransmissionAsync(TwoWireCallback callback, void * arg, bool sendStop){
+  if(!twi_transferAsync(txAddress, txBuffer, txBufferLength, NULL, 0, sendStop, callback, arg))
+    return false;
+  txBufferIndex = 0;
+  txBufferLength = 0;
+  transmitting = 0;
+  return true;
+}
+
+/**
+ * Queues a read of size bytes into buffer, which has to stay valid until the callback.
+ * Bytes written since beginTransmission() to the same address go first, followed by a
+ * repeated start, as for reading a register.
+ */
+bool TwoWire::requestFromAsync(uint8_t address, uint8_t * buffer, size_t size, TwoWireCallback callback, void * arg, bool sendStop){
+  if(!size)
+    return false;
+  bool prefix = transmitting && txAddress == address;
+  if(!twi_transferAsync(address, txBuffer, prefix ? txBufferLength : 0, buffer, size, sendStop, callback, arg))
+    return false;
+  if(prefix){
+    txBufferIndex = 0;
+    txBufferLength = 0;
+    transmitting = 0;
+  }
+  return true;
+}
+
+bool TwoWire::asyncBusy(){
+  return twi_asyncBusy();
+}
+
+void TwoWire::asyncWait(){
+  twi_asyncWait();
+}
+
 size_t TwoWire::write(uint8_t data){
   if(transmitting){
     if(txBufferLength >= BUFFER_LENGTH){
@@ -31,6 +31,10 @@
 
 #define BUFFER_LENGTH 32
 
+// Called from the timer1 interrupt once an asynchronous transfer is done, so it needs ICACHE_RAM_ATTR.
+// status is what endTransmission() would return, or 5 if a slave held the clock too long.
+typedef void (*TwoWireCallback)(void * arg, uint8_t status);
+
 class TwoWire : public Stream
 {
   private:
@@ -55,7 +59,7 @@ class TwoWire : public Stream
     void begin();
     void begin(uint8_t);
     void begin(int);
-    void setClock(uint32_t);
+    void setClock(uint32_t); // the async transfers run at 50KHz at most
     void setClockStretchLimit(uint32_t);
     void beginTransmission(uint8_t);
     void beginTransmission(int);
@@ -64,6 +68,12 @@ class TwoWire : public Stream
     size_t requestFrom(uint8_t address, size_t size, bool sendStop);
 	uint8_t status();
 
+    // These take the timer1 callback while busy, and return false while something else has it
+    bool endTransmissionAsync(TwoWireCallback callback = NULL, void * arg = NULL, bool sendStop = true);
+    bool requestFromAsync(uint8_t address, uint8_t * buffer, size_t size, TwoWireCallback callback, void * arg = NULL, bool sendStop = true);
+    bool asyncBusy();
+    void asyncWait();
+
     uint8_t requestFrom(uint8_t, uint8_t);
     uint8_t requestFrom(uint8_t, uint8_t, uint8_t);
     uint8_t requestFrom(int, int);
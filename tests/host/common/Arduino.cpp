@@ -27,8 +27,17 @@ extern "C" unsigned long millis()
 }
 
 
+static void (*s_yield_hook)() = nullptr;
+
+void mock_yield_hook(void (*hook)())
+{
+    s_yield_hook = hook;
+}
+
 extern "C" void yield()
 {
+    if (s_yield_hook)
+        s_yield_hook();
 }
 
 
@@ -39,3 +48,15 @@ extern "C" void __panic_func(const char* file, int line, const char* func) {
 extern "C" void delay(unsigned long ms)
 {
 }
+
+extern "C" void delayMicroseconds(unsigned int us)
+{
+}
+
+extern "C" void optimistic_yield(uint32_t interval_us)
+{
+}
+
+extern "C" void pinMode(uint8_t pin, uint8_t mode)
+{
+}
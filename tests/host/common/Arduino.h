@@ -94,6 +94,8 @@ extern "C" {
 #define TIM_SINGLE	0 //on interrupt routine you need to write a new value to start the timer again
 #define TIM_LOOP	1 //on interrupt the counter will start with the same value again
     
+#define RANDOM_REG32 ((uint32_t) random(0x7fffffff))
+
 #define timer1_read()           (T1V)
 #define timer1_enabled()        ((T1C & (1 << TCTE)) != 0)
 #define timer1_interrupted()    ((T1C & (1 << TCIS)) != 0)
@@ -198,6 +200,8 @@ extern "C" {
     void analogWrite(uint8_t pin, int val);
     void analogWriteFreq(uint32_t freq);
     void analogWriteRange(uint32_t range);
+    void analogWriteSync(bool sync);
+    void analogWritePhase(uint8_t pin, int phase);
     
     unsigned long millis(void);
     unsigned long micros(void);
@@ -246,11 +250,10 @@ extern "C" {
 #include "Updater.h"
 #include "debug.h"
 
-#ifndef _GLIBCXX_VECTOR
-// arduino is not compatible with std::vector
-#define min(a,b) ((a)<(b)?(a):(b))
-#define max(a,b) ((a)>(b)?(a):(b))
-#endif
+// host builds pull in the standard library, min/max macros would break its headers
+#include <algorithm>
+using std::min;
+using std::max;
 
 #define _min(a,b) ((a)<(b)?(a):(b))
 #define _max(a,b) ((a)>(b)?(a):(b))
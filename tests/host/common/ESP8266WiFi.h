@@ -0,0 +1,24 @@
+/*
+ ESP8266WiFi.h - WiFi library mock for host side testing
+ Copyright © 2016 Ivan Grokhotkov
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+ */
+
+#ifndef ESP8266WiFi_h
+#define ESP8266WiFi_h
+
+#include <Arduino.h>
+#include <IPAddress.h>
+#include "WiFiClient.h"
+#include "WiFiServer.h"
+
+#endif /* ESP8266WiFi_h */
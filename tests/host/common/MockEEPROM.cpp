@@ -0,0 +1,113 @@
+/*
+ MockEEPROM.cpp - simulated SPI flash for the EEPROM library
+ Copyright © 2016 Ivan Grokhotkov
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+*/
+
+#include <Arduino.h>
+#include <vector>
+#include "spi_flash.h"
+
+// the sources below run with interrupts off around flash access, nothing to do here
+#undef interrupts
+#undef noInterrupts
+#define interrupts() (void)0
+#define noInterrupts() (void)0
+
+static std::vector<uint8_t> s_flash;
+static std::vector<size_t> s_erases;
+static size_t s_overwrites = 0;
+static size_t s_failAfter = 0;
+static bool s_failed = false;
+
+extern "C" {
+
+uint32_t _SPIFFS_end;
+
+void mock_flash_reset(size_t sectors)
+{
+    s_flash.assign(sectors * SPI_FLASH_SEC_SIZE, 0xff);
+    s_erases.assign(sectors, 0);
+    s_overwrites = 0;
+    s_failAfter = 0;
+    s_failed = false;
+}
+
+uint8_t* mock_flash_data()
+{
+    return s_flash.data();
+}
+
+size_t mock_flash_erases(uint32_t sector)
+{
+    return (sector < s_erases.size()) ? s_erases[sector] : 0;
+}
+
+size_t mock_flash_overwrites()
+{
+    return s_overwrites;
+}
+
+void mock_flash_fail_after(size_t bytes)
+{
+    s_failAfter = bytes;
+    s_failed = false;
+}
+
+SpiFlashOpResult spi_flash_erase_sector(uint16_t sec)
+{
+    if (sec >= s_erases.size()) {
+        return SPI_FLASH_RESULT_ERR;
+    }
+    if (s_failed) {
+        return SPI_FLASH_RESULT_TIMEOUT;
+    }
+    memset(&s_flash[sec * SPI_FLASH_SEC_SIZE], 0xff, SPI_FLASH_SEC_SIZE);
+    s_erases[sec]++;
+    return SPI_FLASH_RESULT_OK;
+}
+
+SpiFlashOpResult spi_flash_write(uint32_t des_addr, uint32_t *src_addr, uint32_t size)
+{
+    if ((des_addr & 3) || (size & 3) || des_addr + size > s_flash.size()) {
+        return SPI_FLASH_RESULT_ERR;
+    }
+    const uint8_t* src = reinterpret_cast<const uint8_t*>(src_addr);
+    for (uint32_t i = 0; i < size; i++) {
+        if (s_failed) {
+            return SPI_FLASH_RESULT_TIMEOUT;
+        }
+        uint8_t& cell = s_flash[des_addr + i];
+        if (src[i] & ~cell) {
+            s_overwrites++;
+        }
+        cell &= src[i];
+        if (s_failAfter && --s_failAfter == 0) {
+            s_failed = true;
+        }
+    }
+    return SPI_FLASH_RESULT_OK;
+}
+
+SpiFlashOpResult spi_flash_read(uint32_t src_addr, uint32_t *des_addr, uint32_t size)
+{
+    if (src_addr + size > s_flash.size()) {
+        return SPI_FLASH_RESULT_ERR;
+    }
+    memcpy(des_addr, &s_flash[src_addr], size);
+    return SPI_FLASH_RESULT_OK;
+}
+
+}
+
+#define NO_GLOBAL_EEPROM
+#include "../../../libraries/EEPROM/EEPROM.cpp"
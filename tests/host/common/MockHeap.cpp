@@ -0,0 +1,49 @@
+/*
+ MockHeap.cpp - counts heap calls made by the core and library code
+ Copyright © 2016 Ivan Grokhotkov
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+*/
+
+#include <stddef.h>
+#include "heap_mock.h"
+
+extern "C" {
+
+size_t mock_heap_allocations = 0;
+
+// the Makefile links with --wrap for these, so only calls from our own objects land
+// here; the C and C++ runtimes keep talking to the real allocator
+#ifndef __APPLE__
+void* __real_malloc(size_t size);
+void* __real_calloc(size_t count, size_t size);
+void* __real_realloc(void* ptr, size_t size);
+
+void* __wrap_malloc(size_t size)
+{
+    ++mock_heap_allocations;
+    return __real_malloc(size);
+}
+
+void* __wrap_calloc(size_t count, size_t size)
+{
+    ++mock_heap_allocations;
+    return __real_calloc(count, size);
+}
+
+void* __wrap_realloc(void* ptr, size_t size)
+{
+    ++mock_heap_allocations;
+    return __real_realloc(ptr, size);
+}
+#endif
+
+}
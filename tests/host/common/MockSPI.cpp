@@ -0,0 +1,67 @@
+/*
+ MockSPI.cpp - the SPI library on a plain memory SPI1 block
+ Copyright © 2016 Ivan Grokhotkov
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+*/
+
+#include <Arduino.h>
+#include "esp8266_peri_mock.h"
+
+// SPI.cpp takes the address of the FIFO registers, so here they are memory
+// rather than MockRegister. Nothing happens on access: the test ends each
+// transfer with mock_spi_complete(), MISO reads back what was sent.
+namespace {
+
+uint32_t s_spi_regs[0x400];
+uint32_t s_spi_dregs[0x40];
+void (*s_spi_isr)(void*) = nullptr;
+void* s_spi_isr_arg = nullptr;
+bool s_spi_isr_enabled = false;
+bool s_spi_in_isr = false;
+
+} // namespace
+
+#undef ESP8266_REG
+#undef ESP8266_DREG
+#define ESP8266_REG(addr) (*(volatile uint32_t*) &s_spi_regs[(addr) / 4])
+#define ESP8266_DREG(addr) (*(volatile uint32_t*) &s_spi_dregs[(addr) / 4])
+
+#define ETS_SPI_INTR_ATTACH(func, arg) (s_spi_isr = (func), s_spi_isr_arg = (arg))
+#define ETS_SPI_INTR_ENABLE() (s_spi_isr_enabled = true)
+#define ETS_SPI_INTR_DISABLE() (s_spi_isr_enabled = false)
+#define ETS_INTR_WITHINISR() (s_spi_in_isr)
+
+// the host pins_arduino.h is empty, these are variants/generic/common.h
+static const uint8_t SS   = 15;
+static const uint8_t MOSI = 13;
+static const uint8_t MISO = 12;
+static const uint8_t SCK  = 14;
+
+#include "../../../libraries/SPI/SPI.cpp"
+
+bool mock_spi_busy()
+{
+    return SPI1CMD & SPIBUSY;
+}
+
+void mock_spi_complete()
+{
+    SPI1CMD &= ~SPIBUSY;
+    SPI1S |= SPISTRIS;
+    SPIIR |= 1 << SPII1;
+    if (s_spi_isr && s_spi_isr_enabled && (SPI1S & SPISTRIE)) {
+        s_spi_in_isr = true;
+        s_spi_isr(s_spi_isr_arg);
+        s_spi_in_isr = false;
+    }
+    SPIIR &= ~(1 << SPII1);
+}
@@ -0,0 +1,23 @@
+/*
+ MockWaveform.cpp - the core waveform generator on the register and timer1 model
+ Copyright © 2016 Ivan Grokhotkov
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+*/
+
+#ifndef F_CPU
+#define F_CPU 80000000L
+#endif
+
+#include <Arduino.h>
+#include "esp8266_peri_mock.h"
+
+#include "../../../cores/esp8266/core_esp8266_waveform.c"
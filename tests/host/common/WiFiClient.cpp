@@ -0,0 +1,141 @@
+/*
+ WiFiClient.cpp - TCP client and server mocks for host side testing
+ Copyright © 2016 Ivan Grokhotkov
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+ */
+
+#include <map>
+#include <deque>
+#include "WiFiClient.h"
+#include "WiFiServer.h"
+
+static std::map<uint16_t, std::deque<std::shared_ptr<MockSocket>>> s_backlog;
+
+size_t WiFiClient::write(const uint8_t *buf, size_t size)
+{
+    if (!_socket || _socket->stopped || _socket->peerClosed) {
+        return 0;
+    }
+    _socket->tx.append((const char*) buf, size);
+    _socket->writes++;
+    return size;
+}
+
+size_t WiFiClient::write(Stream& stream)
+{
+    uint8_t buf[256];
+    size_t total = 0;
+    while (stream.available()) {
+        size_t n = stream.readBytes(buf, sizeof(buf));
+        if (!n) {
+            break;
+        }
+        total += write(buf, n);
+    }
+    return total;
+}
+
+// counts as a single write, the way the real client queues all pieces at once
+size_t WiFiClient::writev(const WriteSegment *segments, size_t count)
+{
+    if (!_socket || _socket->stopped || _socket->peerClosed) {
+        return 0;
+    }
+    size_t total = 0;
+    for (size_t i = 0; i < count; ++i) {
+        _socket->tx.append((const char*) segments[i].data, segments[i].size);
+        total += segments[i].size;
+    }
+    _socket->writes++;
+    return total;
+}
+
+int WiFiClient::available()
+{
+    if (!_socket || _socket->stopped) {
+        return 0;
+    }
+    return _socket->rx.size();
+}
+
+int WiFiClient::read()
+{
+    uint8_t c;
+    return read(&c, 1) == 1 ? c : -1;
+}
+
+int WiFiClient::read(uint8_t *buf, size_t size)
+{
+    size_t n = std::min(size, (size_t) available());
+    if (n) {
+        memcpy(buf, _socket->rx.data(), n);
+        _socket->rx.erase(0, n);
+    }
+    return n;
+}
+
+int WiFiClient::peek()
+{
+    return available() ? (uint8_t) _socket->rx[0] : -1;
+}
+
+void WiFiClient::stop()
+{
+    if (_socket) {
+        _socket->stopped = true;
+    }
+}
+
+uint8_t WiFiClient::connected()
+{
+    if (!_socket || _socket->stopped) {
+        return 0;
+    }
+    return !_socket->peerClosed || available();
+}
+
+WiFiClient WiFiServer::available(uint8_t* status)
+{
+    (void) status;
+    auto& backlog = s_backlog[_port];
+    if (!_listening || backlog.empty()) {
+        return WiFiClient();
+    }
+    auto socket = backlog.front();
+    backlog.pop_front();
+    return WiFiClient(socket);
+}
+
+bool WiFiServer::hasClient()
+{
+    return _listening && !s_backlog[_port].empty();
+}
+
+void WiFiServer::begin()
+{
+    _listening = true;
+}
+
+void WiFiServer::close()
+{
+    if (_listening) {
+        s_backlog.erase(_port);
+    }
+    _listening = false;
+}
+
+std::shared_ptr<MockSocket> WiFiServer::connect(uint16_t port)
+{
+    auto socket = std::make_shared<MockSocket>();
+    s_backlog[port].push_back(socket);
+    return socket;
+}
@@ -0,0 +1,85 @@
+/*
+ WiFiClient.h - TCP client mock for host side testing
+ Copyright © 2016 Ivan Grokhotkov
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+ */
+
+#ifndef wificlient_h
+#define wificlient_h
+
+#include <memory>
+#include <string>
+#include <Arduino.h>
+#include <Client.h>
+#include <IPAddress.h>
+
+// One end of a mocked TCP connection.
+// rx holds what the remote peer sent and the sketch has not read yet,
+// tx collects everything the sketch wrote.
+struct MockSocket {
+    std::string rx;
+    std::string tx;
+    bool peerClosed = false;
+    bool stopped = false;
+    size_t writes = 0;
+
+    void send(const std::string& data) { rx += data; }
+    std::string received() { std::string out; out.swap(tx); return out; }
+};
+
+// One piece of a writev(), as in ESP8266WiFi's include/DataSource.h
+struct WriteSegment {
+    const uint8_t* data;
+    size_t size;
+    bool progmem;
+};
+
+class WiFiClient : public Client {
+public:
+    WiFiClient() {}
+    WiFiClient(std::shared_ptr<MockSocket> socket) : _socket(socket) {}
+    virtual ~WiFiClient() {}
+
+    virtual int connect(IPAddress ip, uint16_t port) { (void) ip; (void) port; return 0; }
+    virtual int connect(const char *host, uint16_t port) { (void) host; (void) port; return 0; }
+    virtual size_t write(uint8_t b) { return write(&b, 1); }
+    virtual size_t write(const uint8_t *buf, size_t size);
+    virtual size_t write_P(PGM_P buf, size_t size) { return write((const uint8_t*) buf, size); }
+    virtual size_t write_nocopy(const uint8_t *buf, size_t size, void (*release)(void*, const uint8_t*) = nullptr, void* arg = nullptr)
+    {
+        size_t written = write(buf, size);
+        if (release) {
+            release(arg, buf);
+        }
+        return written;
+    }
+    size_t write(Stream& stream);
+    virtual size_t writev(const WriteSegment *segments, size_t count);
+
+    virtual int available();
+    virtual int read();
+    virtual int read(uint8_t *buf, size_t size);
+    virtual int peek();
+    virtual void flush() {}
+    virtual void stop();
+    virtual uint8_t connected();
+    virtual operator bool() { return !!_socket; }
+
+    size_t availableForWrite() { return _socket ? 2920 : 0; }
+
+    using Print::write;
+
+protected:
+    std::shared_ptr<MockSocket> _socket;
+};
+
+#endif /* wificlient_h */
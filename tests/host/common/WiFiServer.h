@@ -0,0 +1,46 @@
+/*
+ WiFiServer.h - TCP server mock for host side testing
+ Copyright © 2016 Ivan Grokhotkov
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+ */
+
+#ifndef wifiserver_h
+#define wifiserver_h
+
+#include <deque>
+#include <memory>
+#include <IPAddress.h>
+#include "WiFiClient.h"
+
+class WiFiServer {
+public:
+    WiFiServer(IPAddress addr, uint16_t port) : _port(port) { (void) addr; }
+    WiFiServer(uint16_t port) : _port(port) {}
+    virtual ~WiFiServer() { close(); }
+
+    WiFiClient available(uint8_t* status = NULL);
+    bool hasClient();
+    void begin();
+    void begin(uint16_t port) { _port = port; begin(); }
+    void setNoDelay(bool nodelay) { (void) nodelay; }
+    void close();
+    void stop() { close(); }
+
+    // Opens a connection to the listening server on port, returns the peer end
+    static std::shared_ptr<MockSocket> connect(uint16_t port);
+
+protected:
+    uint16_t _port;
+    bool _listening = false;
+};
+
+#endif /* wifiserver_h */
@@ -0,0 +1,109 @@
+/*
+ WiFiUdp.cpp - UDP socket mock for host side testing
+ Copyright © 2016 Ivan Grokhotkov
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+ */
+
+#include <map>
+#include <deque>
+#include "WiFiUdp.h"
+
+static std::map<uint16_t, std::deque<MockDatagram>> s_inbox;
+static std::map<uint16_t, std::vector<MockDatagram>> s_outbox;
+
+void mock_udp_send(uint16_t port, const std::string& data, IPAddress from, uint16_t fromPort)
+{
+    s_inbox[port].push_back(MockDatagram{from, fromPort, data});
+}
+
+std::vector<MockDatagram> mock_udp_sent(uint16_t port)
+{
+    std::vector<MockDatagram> out;
+    out.swap(s_outbox[port]);
+    return out;
+}
+
+void mock_udp_reset()
+{
+    s_inbox.clear();
+    s_outbox.clear();
+}
+
+uint8_t WiFiUDP::begin(uint16_t port)
+{
+    _port = port;
+    return 1;
+}
+
+void WiFiUDP::stop()
+{
+    _port = 0;
+    _current = MockDatagram();
+    _readPos = 0;
+}
+
+int WiFiUDP::parsePacket()
+{
+    _current = MockDatagram();
+    _readPos = 0;
+    if (!_port || s_inbox[_port].empty()) {
+        return 0;
+    }
+    _current = s_inbox[_port].front();
+    s_inbox[_port].pop_front();
+    return _current.data.size();
+}
+
+int WiFiUDP::available()
+{
+    return _current.data.size() - _readPos;
+}
+
+int WiFiUDP::read()
+{
+    unsigned char c;
+    return read(&c, 1) == 1 ? c : -1;
+}
+
+int WiFiUDP::read(unsigned char* buffer, size_t len)
+{
+    size_t n = std::min(len, (size_t) available());
+    memcpy(buffer, _current.data.data() + _readPos, n);
+    _readPos += n;
+    return n;
+}
+
+void WiFiUDP::flush()
+{
+    _readPos = _current.data.size();
+}
+
+int WiFiUDP::beginPacket(IPAddress ip, uint16_t port)
+{
+    _out = MockDatagram{ip, port, std::string()};
+    return 1;
+}
+
+size_t WiFiUDP::write(const uint8_t *buffer, size_t size)
+{
+    _out.data.append((const char*) buffer, size);
+    return size;
+}
+
+int WiFiUDP::endPacket()
+{
+    if (!_port) {
+        return 0;
+    }
+    s_outbox[_port].push_back(_out);
+    return 1;
+}
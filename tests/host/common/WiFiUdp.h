@@ -0,0 +1,66 @@
+/*
+ WiFiUdp.h - UDP socket mock for host side testing
+ Copyright © 2016 Ivan Grokhotkov
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+ */
+
+#ifndef wifiudp_h
+#define wifiudp_h
+
+#include <string>
+#include <vector>
+#include <Arduino.h>
+#include <IPAddress.h>
+
+struct MockDatagram {
+    IPAddress ip;
+    uint16_t port;
+    std::string data;
+};
+
+// Datagrams are queued per local port. mock_udp_send() is a packet from the
+// network to a socket bound to port, mock_udp_sent() takes what sockets bound
+// to port have sent.
+void mock_udp_send(uint16_t port, const std::string& data, IPAddress from, uint16_t fromPort);
+std::vector<MockDatagram> mock_udp_sent(uint16_t port);
+void mock_udp_reset();
+
+class WiFiUDP {
+public:
+    WiFiUDP() {}
+    ~WiFiUDP() { stop(); }
+
+    uint8_t begin(uint16_t port);
+    void stop();
+
+    int parsePacket();
+    int available();
+    int read();
+    int read(unsigned char* buffer, size_t len);
+    int read(char* buffer, size_t len) { return read((unsigned char*) buffer, len); }
+    void flush();
+    IPAddress remoteIP() { return _current.ip; }
+    uint16_t remotePort() { return _current.port; }
+
+    int beginPacket(IPAddress ip, uint16_t port);
+    size_t write(uint8_t b) { return write(&b, 1); }
+    size_t write(const uint8_t *buffer, size_t size);
+    int endPacket();
+
+protected:
+    uint16_t _port = 0;
+    MockDatagram _current;
+    size_t _readPos = 0;
+    MockDatagram _out;
+};
+
+#endif /* wifiudp_h */
@@ -0,0 +1,422 @@
+/*
+ esp8266_peri_mock.cpp - peripheral register model for host side testing
+ Copyright © 2016 Ivan Grokhotkov
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+*/
+
+#include "esp8266_peri_mock.h"
+#include <deque>
+#include <stdarg.h>
+#include <map>
+#include <user_interface.h>
+
+namespace {
+
+const size_t UART_FIFO_SIZE = 128;
+
+struct MockUart {
+    std::deque<uint8_t> rx;
+    std::deque<uint8_t> tx;
+    std::string line;
+    uint32_t raw = 0;
+};
+
+std::map<uint32_t, uint32_t> s_regs;
+MockUart s_uarts[2];
+void (*s_isr)(void*) = nullptr;
+void* s_isr_arg = nullptr;
+bool s_isr_enabled = false;
+bool s_in_isr = false;
+
+uint32_t s_ccount = 0;
+uint32_t s_ccount_step = 0;
+std::vector<MockGpioWrite> s_gpio_writes;
+
+uint32_t (*s_gpio_device)(uint32_t, void*) = nullptr;
+void* s_gpio_device_arg = nullptr;
+uint32_t s_gpio_device_low = 0;
+
+timercallback s_timer1_cb = nullptr;
+bool s_timer1_armed = false;
+uint32_t s_timer1_deadline = 0;
+
+void (*s_putc1)(char) = nullptr;
+bool s_os_print = false;
+
+uint32_t stored(uint32_t addr)
+{
+    auto it = s_regs.find(addr);
+    return (it == s_regs.end()) ? 0 : it->second;
+}
+
+// UART register offset and unit, -1 when addr is something else
+int uart_reg(uint32_t addr, int& nr)
+{
+    if (addr < 0x60000000 || addr >= 0x60001000) {
+        return -1;
+    }
+    uint32_t offset = addr - 0x60000000;
+    nr = (offset >= 0xF00) ? 1 : 0;
+    offset -= nr * 0xF00;
+    return (offset < 0x80) ? (int) offset : -1;
+}
+
+uint32_t uart_conf1(int nr)
+{
+    return stored(0x60000000 + 0x24 + nr * 0xF00);
+}
+
+// The FIFO threshold interrupts follow the fill levels, like the hardware
+uint32_t uart_raw(int nr)
+{
+    MockUart& uart = s_uarts[nr];
+    uint32_t raw = uart.raw;
+    size_t full = (uart_conf1(nr) >> UCFFT) & 0x7f;
+    size_t empty = (uart_conf1(nr) >> UCFET) & 0x7f;
+    if (full && uart.rx.size() >= full) {
+        raw |= (1 << UIFF);
+    }
+    if (uart.tx.size() < empty) {
+        raw |= (1 << UIFE);
+    }
+    return raw;
+}
+
+uint32_t uart_pending(int nr)
+{
+    return uart_raw(nr) & stored(0x60000000 + 0x0c + nr * 0xF00);
+}
+
+void uart_dispatch()
+{
+    // a handler that never clears its source would spin forever on the chip
+    for (int rounds = 0; rounds < 1000; ++rounds) {
+        if (!s_isr || !s_isr_enabled || s_in_isr) {
+            return;
+        }
+        if (!uart_pending(0) && !uart_pending(1)) {
+            return;
+        }
+        s_in_isr = true;
+        s_isr(s_isr_arg);
+        s_in_isr = false;
+    }
+}
+
+void gpio_written()
+{
+    uint32_t levels = stored(0x60000300) & 0xffff;
+    levels |= (stored(0x60000768) & 1) << 16;
+    s_gpio_writes.push_back({s_ccount, levels});
+}
+
+// The lines as the chip leaves them, after the device had its say
+uint32_t gpio_lines()
+{
+    uint32_t lines = ~(stored(0x6000030C) & ~stored(0x60000300)) & 0xffff;
+    if (s_gpio_device) {
+        s_gpio_device_low = s_gpio_device(lines, s_gpio_device_arg);
+    }
+    return lines & ~s_gpio_device_low;
+}
+
+} // namespace
+
+uint32_t MockRegister::read(uint32_t addr)
+{
+    if (addr == 0x60000318) { // GPI
+        return gpio_lines();
+    }
+    int nr;
+    switch (uart_reg(addr, nr)) {
+    case 0x00: {
+        MockUart& uart = s_uarts[nr];
+        if (uart.rx.empty()) {
+            return 0;
+        }
+        uint8_t data = uart.rx.front();
+        uart.rx.pop_front();
+        return data;
+    }
+    case 0x04:
+        return uart_raw(nr);
+    case 0x08:
+        return uart_pending(nr);
+    case 0x1C: {
+        // someone waiting on a full fifo sees the line move along
+        MockUart& uart = s_uarts[nr];
+        if (uart.tx.size() >= UART_FIFO_SIZE - 1) {
+            uart.line += (char) uart.tx.front();
+            uart.tx.pop_front();
+        }
+        return (uart.rx.size() << USRXC) | (uart.tx.size() << USTXC);
+    }
+    default:
+        return stored(addr);
+    }
+}
+
+void MockRegister::write(uint32_t addr, uint32_t value)
+{
+    switch (addr) {
+    case 0x60000304: // GPOS
+        s_regs[0x60000300] = stored(0x60000300) | value;
+        gpio_written();
+        return;
+    case 0x60000308: // GPOC
+        s_regs[0x60000300] = stored(0x60000300) & ~value;
+        gpio_written();
+        return;
+    case 0x60000768: // GP16O
+        s_regs[addr] = value;
+        gpio_written();
+        return;
+    case 0x60000310: // GPES
+        s_regs[0x6000030C] = stored(0x6000030C) | value;
+        gpio_lines();
+        return;
+    case 0x60000314: // GPEC
+        s_regs[0x6000030C] = stored(0x6000030C) & ~value;
+        gpio_lines();
+        return;
+    }
+
+    int nr;
+    switch (uart_reg(addr, nr)) {
+    case 0x00:
+        if (s_uarts[nr].tx.size() < UART_FIFO_SIZE) {
+            s_uarts[nr].tx.push_back((uint8_t) value);
+        }
+        break;
+    case 0x10:
+        s_uarts[nr].raw &= ~value;
+        break;
+    case 0x20:
+        if (value & (1 << UCRXRST)) {
+            s_uarts[nr].rx.clear();
+        }
+        if (value & (1 << UCTXRST)) {
+            s_uarts[nr].tx.clear();
+        }
+        s_regs[addr] = value;
+        break;
+    default:
+        s_regs[addr] = value;
+        break;
+    }
+    uart_dispatch();
+}
+
+void mock_uart_isr_attach(void (*isr)(void*), void* arg)
+{
+    s_isr = isr;
+    s_isr_arg = arg;
+}
+
+void mock_uart_isr_enable(bool enable)
+{
+    s_isr_enabled = enable;
+    uart_dispatch();
+}
+
+void mock_uart_receive(int uart_nr, const void* data, size_t size)
+{
+    MockUart& uart = s_uarts[uart_nr & 1];
+    const uint8_t* bytes = (const uint8_t*) data;
+    for (size_t i = 0; i < size; ++i) {
+        if (uart.rx.size() < UART_FIFO_SIZE) {
+            uart.rx.push_back(bytes[i]);
+        } else {
+            uart.raw |= (1 << UIOF);
+        }
+        uart_dispatch();
+    }
+    if (size && (uart_conf1(uart_nr & 1) & (1 << UCTOE))) {
+        uart.raw |= (1 << UITO);
+        uart_dispatch();
+    }
+}
+
+size_t mock_uart_transmit(int uart_nr, size_t count)
+{
+    MockUart& uart = s_uarts[uart_nr & 1];
+    size_t sent = 0;
+    while (sent < count && !uart.tx.empty()) {
+        uart.line += (char) uart.tx.front();
+        uart.tx.pop_front();
+        ++sent;
+        uart_dispatch();
+    }
+    return sent;
+}
+
+std::string mock_uart_transmitted(int uart_nr)
+{
+    MockUart& uart = s_uarts[uart_nr & 1];
+    mock_uart_transmit(uart_nr, (size_t) -1);
+    std::string line;
+    line.swap(uart.line);
+    return line;
+}
+
+extern "C" uint32_t xthal_get_ccount()
+{
+    uint32_t ccount = s_ccount;
+    s_ccount += s_ccount_step;
+    return ccount;
+}
+
+void mock_ccount_set(uint32_t cycles, uint32_t step)
+{
+    s_ccount = cycles;
+    s_ccount_step = step;
+}
+
+uint32_t mock_ccount()
+{
+    return s_ccount;
+}
+
+extern "C" void timer1_isr_init()
+{
+}
+
+extern "C" void timer1_attachInterrupt(timercallback userFunc)
+{
+    s_timer1_cb = userFunc;
+}
+
+extern "C" void timer1_detachInterrupt()
+{
+    s_timer1_cb = nullptr;
+    s_timer1_armed = false;
+}
+
+extern "C" void timer1_enable(uint8_t divider, uint8_t int_type, uint8_t reload)
+{
+    (void) divider;
+    (void) int_type;
+    (void) reload;
+    T1C = (1 << TCTE);
+}
+
+extern "C" void timer1_disable()
+{
+    T1C = 0;
+    s_timer1_armed = false;
+}
+
+extern "C" void timer1_write(uint32_t ticks)
+{
+    s_timer1_deadline = s_ccount + (ticks & 0x7FFFFF);
+    s_timer1_armed = true;
+}
+
+bool mock_timer1_armed()
+{
+    return s_timer1_armed && s_timer1_cb && (T1C & (1 << TCTE));
+}
+
+uint32_t mock_timer1_deadline()
+{
+    return s_timer1_deadline;
+}
+
+void mock_timer1_fire()
+{
+    s_timer1_armed = false;
+    if (s_timer1_cb) {
+        s_timer1_cb();
+    }
+}
+
+extern "C" void ets_intr_lock()
+{
+}
+
+extern "C" void ets_intr_unlock()
+{
+}
+
+extern "C" void digitalWrite(uint8_t pin, uint8_t val)
+{
+    if (pin < 16) {
+        MockRegister(val ? 0x60000304 : 0x60000308) = 1U << pin;
+    } else if (pin == 16) {
+        MockRegister(0x60000768) = val ? 1 : 0;
+    }
+}
+
+void mock_gpio_attach_device(uint32_t (*device)(uint32_t lines, void* arg), void* arg)
+{
+    s_gpio_device = device;
+    s_gpio_device_arg = arg;
+    s_gpio_device_low = 0;
+}
+
+const std::vector<MockGpioWrite>& mock_gpio_writes()
+{
+    return s_gpio_writes;
+}
+
+void mock_peri_reset()
+{
+    s_regs.clear();
+    for (MockUart& uart : s_uarts) {
+        uart = MockUart();
+    }
+    s_isr = nullptr;
+    s_isr_arg = nullptr;
+    s_isr_enabled = false;
+    s_in_isr = false;
+    s_ccount = 0;
+    s_ccount_step = 0;
+    s_gpio_writes.clear();
+    s_gpio_device = nullptr;
+    s_gpio_device_arg = nullptr;
+    s_gpio_device_low = 0;
+    s_timer1_cb = nullptr;
+    s_timer1_armed = false;
+    s_timer1_deadline = 0;
+    s_putc1 = nullptr;
+    s_os_print = false;
+}
+
+extern "C" int os_printf_plus(const char* format, ...)
+{
+    char buf[256];
+    va_list args;
+    va_start(args, format);
+    int len = vsnprintf(buf, sizeof(buf), format, args);
+    va_end(args);
+    for (int i = 0; s_os_print && s_putc1 && buf[i]; i++) {
+        s_putc1(buf[i]);
+    }
+    return len;
+}
+
+extern "C" void system_set_os_print(uint8_t onoff)
+{
+    s_os_print = onoff;
+}
+
+extern "C" void ets_install_putc1(void* routine)
+{
+    s_putc1 = (void (*)(char)) routine;
+}
+
+extern "C" int uart_baudrate_detect(int uart_no, int async)
+{
+    (void) uart_no;
+    (void) async;
+    return 0;
+}
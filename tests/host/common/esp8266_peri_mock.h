@@ -0,0 +1,111 @@
+/*
+ esp8266_peri_mock.h - peripheral register model for host side testing
+ Copyright © 2016 Ivan Grokhotkov
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+*/
+
+#ifndef esp8266_peri_mock_hpp
+#define esp8266_peri_mock_hpp
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string>
+#include <vector>
+#include <Arduino.h>
+#undef RANDOM_REG32
+#include <esp8266_peri.h>
+
+// Every register access in esp8266_peri.h goes through one of these. Plain
+// registers just keep what was written, the UART FIFO, status and interrupt
+// registers behave like the hardware so drivers can run unchanged.
+// Reading happens on conversion, so a bare USF(n); statement reads nothing.
+class MockRegister {
+public:
+    explicit MockRegister(uint32_t addr) : m_addr(addr) {}
+    operator uint32_t() const { return read(m_addr); }
+    MockRegister& operator=(uint32_t value) { write(m_addr, value); return *this; }
+    MockRegister& operator=(const MockRegister& other) { return *this = (uint32_t) other; }
+    MockRegister& operator|=(uint32_t value) { return *this = (uint32_t) *this | value; }
+    MockRegister& operator&=(uint32_t value) { return *this = (uint32_t) *this & value; }
+
+    static uint32_t read(uint32_t addr);
+    static void write(uint32_t addr, uint32_t value);
+
+protected:
+    uint32_t m_addr;
+};
+
+#undef ESP8266_REG
+#undef ESP8266_DREG
+#define ESP8266_REG(addr) MockRegister(0x60000000 + (addr))
+#define ESP8266_DREG(addr) MockRegister(0x3FF00000 + (addr))
+// keep the host Arduino.h one
+#undef RANDOM_REG32
+#define RANDOM_REG32 ((uint32_t) random(0x7fffffff))
+
+// The UART interrupt, shared by both UARTs as on the chip. While enabled the
+// handler runs whenever an enabled interrupt is pending.
+void mock_uart_isr_attach(void (*isr)(void*), void* arg);
+void mock_uart_isr_enable(bool enable);
+
+#undef ETS_UART_INTR_ATTACH
+#undef ETS_UART_INTR_ENABLE
+#undef ETS_UART_INTR_DISABLE
+#define ETS_UART_INTR_ATTACH(func, arg) mock_uart_isr_attach(func, arg)
+#define ETS_UART_INTR_ENABLE() mock_uart_isr_enable(true)
+#define ETS_UART_INTR_DISABLE() mock_uart_isr_enable(false)
+
+// Bytes arriving on the RX pin. The FIFO full interrupt fires as its
+// threshold is crossed and the timeout one once the line goes quiet.
+void mock_uart_receive(int uart_nr, const void* data, size_t size);
+// Time passing on the TX line: up to count bytes leave the FIFO, the FIFO
+// empty interrupt fires once its threshold is reached. Returns how many left.
+size_t mock_uart_transmit(int uart_nr, size_t count);
+// Everything sent so far, after the line ran until the FIFO stayed empty
+std::string mock_uart_transmitted(int uart_nr);
+// The CPU cycle counter behind xthal_get_ccount(). Every read moves it on
+// by step cycles, so code that reads it more often takes longer.
+extern "C" uint32_t xthal_get_ccount();
+void mock_ccount_set(uint32_t cycles, uint32_t step = 0);
+uint32_t mock_ccount();
+
+// timer1 as set up by the core, one tick per cycle. fire() runs the
+// attached callback and disarms a one-shot timer as the hardware does.
+bool mock_timer1_armed();
+uint32_t mock_timer1_deadline();
+void mock_timer1_fire();
+
+// SPI1 as seen by the SPI library, see MockSPI.cpp. complete() ends the
+// transfer on the bus and runs the SPI interrupt handler if it is enabled.
+bool mock_spi_busy();
+void mock_spi_complete();
+
+// Every write to GPOS, GPOC or GP16O with the cycle it happened at and the
+// resulting levels, GPIO16 as bit 16
+struct MockGpioWrite {
+    uint32_t cycle;
+    uint32_t levels;
+};
+const std::vector<MockGpioWrite>& mock_gpio_writes();
+
+// GPIO 0-15 as an open drain bus: a pin enabled as output (GPE) pulls its line
+// low, GPO being 0, the others are pulled up. The device sees the lines as left
+// by the chip on every change and every GPI read, and returns those it holds low.
+void mock_gpio_attach_device(uint32_t (*device)(uint32_t lines, void* arg), void* arg);
+
+// Runs hook from every yield(), so things can happen while code waits. NULL removes it.
+void mock_yield_hook(void (*hook)());
+
+// Power on state: registers, FIFOs, timers, interrupt handlers and os_printf() output
+void mock_peri_reset();
+
+#endif /* esp8266_peri_mock_hpp */
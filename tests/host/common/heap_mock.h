@@ -0,0 +1,33 @@
+/*
+ heap_mock.h - heap call counter for host side testing
+ Copyright © 2016 Ivan Grokhotkov
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+*/
+
+#ifndef heap_mock_h
+#define heap_mock_h
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// malloc, calloc and realloc calls made by the core and library sources so far,
+// stays at 0 where the linker has no --wrap (OS X)
+extern size_t mock_heap_allocations;
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* heap_mock_h */
@@ -0,0 +1,50 @@
+/*
+ spi_flash.h - SDK spi_flash.h stand-in for host side testing
+ Copyright © 2016 Ivan Grokhotkov
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+*/
+
+#ifndef SPI_FLASH_H
+#define SPI_FLASH_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum {
+    SPI_FLASH_RESULT_OK,
+    SPI_FLASH_RESULT_ERR,
+    SPI_FLASH_RESULT_TIMEOUT
+} SpiFlashOpResult;
+
+#define SPI_FLASH_SEC_SIZE 4096
+
+SpiFlashOpResult spi_flash_erase_sector(uint16_t sec);
+SpiFlashOpResult spi_flash_write(uint32_t des_addr, uint32_t *src_addr, uint32_t size);
+SpiFlashOpResult spi_flash_read(uint32_t src_addr, uint32_t *des_addr, uint32_t size);
+
+// Simulated flash: erasing sets a sector to 0xFF, writing can only clear bits
+void mock_flash_reset(size_t sectors);
+uint8_t* mock_flash_data();
+size_t mock_flash_erases(uint32_t sector);
+size_t mock_flash_overwrites(); // writes that tried to set a cleared bit
+// Power loss: after this many more bytes are written, writes and erases stop, 0 to disable
+void mock_flash_fail_after(size_t bytes);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif//SPI_FLASH_H
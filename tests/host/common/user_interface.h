@@ -0,0 +1,35 @@
+/*
+ user_interface.h - the few SDK system calls the core drivers make, for host side testing
+ Copyright © 2016 Ivan Grokhotkov
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+*/
+
+#ifndef __USER_INTERFACE_H__
+#define __USER_INTERFACE_H__
+
+#include "c_types.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// os_printf() output goes to the routine set with ets_install_putc1(), as on the chip
+int os_printf_plus(const char* format, ...);
+void system_set_os_print(uint8_t onoff);
+void ets_install_putc1(void* routine);
+int uart_baudrate_detect(int uart_no, int async);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __USER_INTERFACE_H__ */
@@ -0,0 +1,109 @@
+/*
+ test_i2s_leds.cpp - I2S LED bitstream encoder tests and benchmark
+ Copyright © 2016 Ivan Grokhotkov
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+ */
+
+#include <catch.hpp>
+#include <chrono>
+#include <vector>
+#include <i2s_leds.h>
+
+// One LED bit at a time, the way a bit-banging loop sees it
+static void encodeBits(uint32_t* dst, const uint8_t* src, size_t len)
+{
+    for (size_t i = 0; i < len; i++) {
+        uint32_t sample = 0;
+        for (int bit = 7; bit >= 0; bit--)
+            sample = (sample << 4) | (((src[i] >> bit) & 1) ? 0xe : 0x8);
+        dst[i] = sample;
+    }
+}
+
+// What the LEDs read off the line: each bit starts high, stays high three
+// I2S bits for a 1 and one for a 0
+static std::vector<uint8_t> decodeLine(const std::vector<uint32_t>& samples)
+{
+    std::vector<uint8_t> bytes;
+    for (uint32_t sample : samples) {
+        uint8_t b = 0;
+        for (int bit = 7; bit >= 0; bit--) {
+            uint32_t slot = (sample >> (bit * 4)) & 0xf;
+            REQUIRE((slot == 0x8 || slot == 0xe));
+            b = (b << 1) | (slot == 0xe ? 1 : 0);
+        }
+        bytes.push_back(b);
+    }
+    return bytes;
+}
+
+static std::vector<uint8_t> pixels(size_t leds, int seed)
+{
+    std::vector<uint8_t> data;
+    for (size_t i = 0; i < leds * 3; i++)
+        data.push_back((uint8_t) (i * 37 + seed));
+    return data;
+}
+
+TEST_CASE("I2S LED encoder", "[core][i2s_leds]")
+{
+    uint8_t bytes[] = {0x00, 0xff, 0xa5, 0x01, 0x80};
+    uint32_t samples[5];
+    i2s_leds_encode(samples, bytes, sizeof(bytes));
+    REQUIRE(samples[0] == 0x88888888);
+    REQUIRE(samples[1] == 0xeeeeeeee);
+    REQUIRE(samples[2] == 0xe8e88e8e);
+    REQUIRE(samples[3] == 0x8888888e);
+    REQUIRE(samples[4] == 0xe8888888);
+
+    uint8_t all[256];
+    for (int i = 0; i < 256; i++)
+        all[i] = i;
+    std::vector<uint32_t> table(256), reference(256);
+    i2s_leds_encode(table.data(), all, 256);
+    encodeBits(reference.data(), all, 256);
+    REQUIRE(table == reference);
+
+    auto frame = pixels(1000, 3);
+    std::vector<uint32_t> encoded(frame.size() + 1, 0x12345678);
+    i2s_leds_encode(encoded.data(), frame.data(), frame.size());
+    REQUIRE(encoded.back() == 0x12345678);
+    encoded.pop_back();
+    REQUIRE(decodeLine(encoded) == frame);
+
+    i2s_leds_encode(encoded.data(), frame.data(), 0);
+    REQUIRE(decodeLine(encoded) == frame);
+}
+
+TEST_CASE("I2S LED encoder benchmark", "[.][benchmark][i2s_leds]")
+{
+    using clock = std::chrono::steady_clock;
+    auto frame = pixels(1000, 5);
+    std::vector<uint32_t> encoded(frame.size());
+    const int rounds = 2000;
+
+    auto run = [&](void (*encode)(uint32_t*, const uint8_t*, size_t)) {
+        auto start = clock::now();
+        for (int r = 0; r < rounds; r++) {
+            frame[r % frame.size()]++;
+            encode(encoded.data(), frame.data(), frame.size());
+        }
+        return std::chrono::duration<double, std::micro>(clock::now() - start).count() / rounds;
+    };
+
+    double bits = run(encodeBits);
+    double table = run(i2s_leds_encode);
+    REQUIRE(decodeLine(encoded) == frame);
+
+    printf("1000 RGB pixels, bit by bit:   %8.2f us/frame\n", bits);
+    printf("1000 RGB pixels, nibble table: %8.2f us/frame\n", table);
+}
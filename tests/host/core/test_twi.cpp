@@ -0,0 +1,444 @@
+/*
+ test_twi.cpp - software I2C against a simulated slave
+ Copyright © 2016 Ivan Grokhotkov
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+ */
+
+#include <catch.hpp>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <Arduino.h>
+#include <esp8266_peri_mock.h>
+#include <twi.h>
+#include <core_esp8266_waveform.h>
+
+static const int sdaPin = 4;
+static const int sclPin = 5;
+static const uint32_t sdaMask = 1 << sdaPin;
+static const uint32_t sclMask = 1 << sclPin;
+
+// A sensor behind an I2C slave, decoded from the bus edge by edge: a write sets
+// the register pointer and stores what follows, a read sends from the pointer on.
+struct VirtualSlave {
+    uint8_t address = 0x68;
+    uint8_t regs[256];
+    uint8_t pointer = 0;
+    int writable = 256;    // bytes it takes per write before NACKing
+    int stretch = 0;       // bus evaluations it holds SCL low after each acknowledge
+    bool stuck = false;    // holds SDA low for good
+
+    enum State { IDLE, ADDRESS, WRITE, READ } state = IDLE;
+    bool scl = true;
+    bool sda = true;
+    bool holdSda = false;
+    int holdScl = 0;
+    bool acking = false;
+    bool masterAck = false;
+    bool pointerSet = false;
+    int bit = 0;
+    int written = 0;
+    uint8_t shift = 0;
+    std::string log;       // S start, P stop, A/N acknowledge of the address
+
+    VirtualSlave()
+    {
+        for (int i = 0; i < 256; i++)
+            regs[i] = (uint8_t) (i * 3 + 1);
+    }
+
+    void present()
+    {
+        holdSda = !(shift & (0x80 >> bit));
+    }
+
+    uint32_t lines(uint32_t chip)
+    {
+        if (holdScl && (chip & sclMask))
+            holdScl--;
+        bool newScl = (chip & sclMask) && !holdScl;
+        bool newSda = chip & sdaMask;
+        if (newScl && scl && sda && !newSda) {
+            log += 'S';
+            state = ADDRESS;
+            bit = 0;
+            shift = 0;
+            acking = false;
+            holdSda = false;
+        } else if (newScl && scl && !sda && newSda) {
+            log += 'P';
+            state = IDLE;
+            holdSda = false;
+        } else if (newScl && !scl) {
+            rising(newSda);
+        } else if (!newScl && scl) {
+            falling();
+        }
+        scl = newScl;
+        sda = newSda;
+        return (holdSda || stuck ? sdaMask : 0) | (holdScl ? sclMask : 0);
+    }
+
+    void rising(bool level)
+    {
+        if ((state == ADDRESS || state == WRITE) && bit < 8) {
+            shift = (shift << 1) | level;
+            bit++;
+        } else if (state == READ && bit == 8) {
+            masterAck = !level;
+        }
+    }
+
+    void falling()
+    {
+        if (state == ADDRESS || state == WRITE) {
+            if (acking) {
+                acking = false;
+                holdSda = false;
+                bit = 0;
+                holdScl = stretch;
+                if (state == READ) {
+                    shift = regs[pointer++];
+                    present();
+                }
+            } else if (bit == 8) {
+                received();
+            }
+        } else if (state == READ) {
+            if (acking) {
+                // the address was acknowledged for reading
+                acking = false;
+                bit = 0;
+                holdScl = stretch;
+                shift = regs[pointer++];
+                present();
+            } else if (++bit < 8) {
+                present();
+            } else if (bit == 8) {
+                holdSda = false;
+            } else if (masterAck) {
+                bit = 0;
+                shift = regs[pointer++];
+                present();
+            } else {
+                holdSda = false;
+                state = IDLE;
+            }
+        }
+    }
+
+    void received()
+    {
+        if (state == ADDRESS) {
+            if ((shift >> 1) != address) {
+                log += 'N';
+                state = IDLE;
+                return;
+            }
+            log += 'A';
+            state = (shift & 1) ? READ : WRITE;
+            pointerSet = false;
+            written = 0;
+        } else if (!pointerSet) {
+            pointer = shift;
+            pointerSet = true;
+        } else if (written++ < writable) {
+            regs[pointer++] = shift;
+        } else {
+            state = IDLE;
+            return;
+        }
+        holdSda = true;
+        acking = true;
+    }
+
+    static uint32_t device(uint32_t chip, void* arg)
+    {
+        return static_cast<VirtualSlave*>(arg)->lines(chip);
+    }
+};
+
+// Cycles between timer1 firing and the ISR reading the counter, and what every
+// further read costs, as in the waveform tests
+static const uint32_t irqLatency = 480;
+static const uint32_t readCost = 20;
+
+// Runs the timer1 interrupts falling before until, returns the cycles spent in them
+static uint32_t simulate(uint32_t until, uint32_t* interrupts = nullptr)
+{
+    uint32_t spent = 0;
+    while (mock_timer1_armed() && (int32_t) (mock_timer1_deadline() - until) < 0) {
+        uint32_t enter = mock_timer1_deadline();
+        mock_ccount_set(enter + irqLatency, readCost);
+        mock_timer1_fire();
+        spent += mock_ccount() - enter;
+        if (interrupts)
+            (*interrupts)++;
+    }
+    mock_ccount_set(until, readCost);
+    return spent;
+}
+
+struct Completion {
+    int calls = 0;
+    uint8_t status = 0xff;
+    std::vector<int> order;
+};
+
+static int s_completions = 0;
+
+static void completed(void* arg, uint8_t status)
+{
+    Completion* c = static_cast<Completion*>(arg);
+    c->calls++;
+    c->status = status;
+    c->order.push_back(s_completions++);
+}
+
+static void startBus(VirtualSlave& slave, unsigned int clock = 100000)
+{
+    mock_peri_reset();
+    twi_init(sdaPin, sclPin);
+    twi_setClock(clock);
+    mock_gpio_attach_device(VirtualSlave::device, &slave);
+}
+
+// Lets the queue run dry and hands timer1 back
+static void finish()
+{
+    for (int i = 0; i < 100 && twi_asyncBusy(); i++)
+        simulate(mock_ccount() + 80 * 10000);
+    REQUIRE_FALSE(twi_asyncBusy());
+    REQUIRE_FALSE(mock_timer1_armed());
+}
+
+TEST_CASE("twi blocking transfers match the simulated slave", "[core][twi]")
+{
+    VirtualSlave slave;
+    startBus(slave);
+    unsigned char data[] = { 0x10, 0xaa, 0x55 };
+    REQUIRE(twi_writeTo(0x68, data, 3, true) == 0);
+    REQUIRE(slave.regs[0x10] == 0xaa);
+    REQUIRE(slave.regs[0x11] == 0x55);
+
+    unsigned char reg = 0x10;
+    unsigned char in[4] = { 0 };
+    REQUIRE(twi_writeTo(0x68, &reg, 1, false) == 0);
+    REQUIRE(twi_readFrom(0x68, in, 4, true) == 0);
+    REQUIRE(in[0] == 0xaa);
+    REQUIRE(in[1] == 0x55);
+    REQUIRE(in[2] == slave.regs[0x12]);
+    REQUIRE(slave.log == "SAPSASAP");
+
+    REQUIRE(twi_writeTo(0x42, data, 3, true) == 2);
+    slave.writable = 1;
+    REQUIRE(twi_writeTo(0x68, data, 3, true) == 3);
+}
+
+TEST_CASE("twi reads a register in the background", "[core][twi]")
+{
+    VirtualSlave slave;
+    startBus(slave);
+    unsigned char reg = 0x3b;
+    unsigned char in[12] = { 0 };
+    Completion done;
+    REQUIRE(twi_transferAsync(0x68, &reg, 1, in, sizeof(in), true, completed, &done));
+    // nothing happens on the bus until the interrupt
+    REQUIRE(twi_asyncBusy());
+    REQUIRE(slave.log.empty());
+    REQUIRE(done.calls == 0);
+
+    simulate(80 * 100000);
+    REQUIRE(done.calls == 1);
+    REQUIRE(done.status == 0);
+    REQUIRE(slave.log == "SASAP");
+    for (int i = 0; i < 12; i++) {
+        INFO("byte " << i);
+        REQUIRE(in[i] == slave.regs[0x3b + i]);
+    }
+    finish();
+
+    // and the blocking calls carry on from there
+    unsigned char data[] = { 0x20, 0x99 };
+    REQUIRE(twi_writeTo(0x68, data, 2, true) == 0);
+    REQUIRE(slave.regs[0x20] == 0x99);
+}
+
+TEST_CASE("twi queues transactions", "[core][twi]")
+{
+    VirtualSlave slave;
+    startBus(slave);
+    s_completions = 0;
+    Completion done[TWI_ASYNC_QUEUE + 1];
+    unsigned char writes[TWI_ASYNC_QUEUE][3];
+    for (int i = 0; i < TWI_ASYNC_QUEUE; i++) {
+        writes[i][0] = 0x80 + 2 * i;
+        writes[i][1] = 0xf0 + i;
+        writes[i][2] = 0xe0 + i;
+        REQUIRE(twi_transferAsync(0x68, writes[i], 3, NULL, 0, true, completed, &done[i]));
+        // the bytes are copied, the buffer can go
+        writes[i][1] = 0;
+    }
+    REQUIRE_FALSE(twi_transferAsync(0x68, writes[0], 3, NULL, 0, true, completed, &done[TWI_ASYNC_QUEUE]));
+    unsigned char tooLong[TWI_ASYNC_TX_MAX + 1] = { 0 };
+    REQUIRE_FALSE(twi_transferAsync(0x68, tooLong, sizeof(tooLong), NULL, 0, true, NULL, NULL));
+
+    simulate(80 * 100000);
+    for (int i = 0; i < TWI_ASYNC_QUEUE; i++) {
+        REQUIRE(done[i].calls == 1);
+        REQUIRE(done[i].status == 0);
+        REQUIRE(done[i].order[0] == i);
+        REQUIRE(slave.regs[0x80 + 2 * i] == 0xf0 + i);
+        REQUIRE(slave.regs[0x81 + 2 * i] == 0xe0 + i);
+    }
+    REQUIRE(done[TWI_ASYNC_QUEUE].calls == 0);
+    REQUIRE(slave.log == "SAPSAPSAPSAP");
+    finish();
+}
+
+TEST_CASE("twi reports errors of background transfers", "[core][twi]")
+{
+    VirtualSlave slave;
+    startBus(slave);
+    unsigned char data[] = { 0x10, 1, 2, 3 };
+    unsigned char in[2];
+    Completion address, nack, probe, noStop, after;
+    REQUIRE(twi_transferAsync(0x42, data, 4, NULL, 0, true, completed, &address));
+    simulate(80 * 10000);
+    REQUIRE(address.calls == 1);
+    REQUIRE(address.status == 2);
+
+    slave.writable = 1;
+    REQUIRE(twi_transferAsync(0x68, data, 4, NULL, 0, true, completed, &nack));
+    simulate(mock_ccount() + 80 * 10000);
+    REQUIRE(nack.status == 3);
+    REQUIRE(slave.regs[0x10] == 1);
+    REQUIRE(slave.regs[0x11] != 2);
+
+    // an address alone, and a read left open for the next one
+    REQUIRE(twi_transferAsync(0x68, NULL, 0, NULL, 0, true, completed, &probe));
+    REQUIRE(twi_transferAsync(0x68, NULL, 0, in, 2, false, completed, &noStop));
+    REQUIRE(twi_transferAsync(0x68, NULL, 0, in, 1, true, completed, &after));
+    simulate(mock_ccount() + 80 * 10000);
+    REQUIRE(probe.status == 0);
+    REQUIRE(noStop.status == 0);
+    REQUIRE(after.status == 0);
+    REQUIRE(slave.log == "SNPSAPSAPSASAP");
+    finish();
+}
+
+TEST_CASE("twi waits for clock stretching in the background", "[core][twi]")
+{
+    VirtualSlave slave;
+    startBus(slave);
+    slave.stretch = 5;
+    unsigned char reg = 0;
+    unsigned char in[6];
+    Completion done;
+    REQUIRE(twi_transferAsync(0x68, &reg, 1, in, sizeof(in), true, completed, &done));
+    simulate(80 * 100000);
+    REQUIRE(done.status == 0);
+    for (int i = 0; i < 6; i++)
+        REQUIRE(in[i] == slave.regs[i]);
+
+    // held past the limit the transfer gives up and lets go of the bus
+    slave.stretch = 1000;
+    Completion held;
+    REQUIRE(twi_transferAsync(0x68, &reg, 1, in, sizeof(in), true, completed, &held));
+    simulate(mock_ccount() + 80 * 100000);
+    REQUIRE(held.status == TWI_ASYNC_TIMEOUT);
+    REQUIRE((GPE & (sdaMask | sclMask)) == 0);
+    finish();
+
+    // a slave holding SDA makes the bus busy
+    slave.stuck = true;
+    Completion busy;
+    REQUIRE(twi_transferAsync(0x68, &reg, 1, in, sizeof(in), true, completed, &busy));
+    simulate(mock_ccount() + 80 * 10000);
+    REQUIRE(busy.status == 4);
+    finish();
+}
+
+static uint32_t otherTimer1User()
+{
+    return 1000;
+}
+
+TEST_CASE("twi leaves a timer1 callback it doesn't own alone", "[core][twi]")
+{
+    VirtualSlave slave;
+    startBus(slave);
+    unsigned char reg = 0x10;
+    unsigned char in[2] = { 0 };
+    Completion done;
+    setTimer1Callback(otherTimer1User);
+    REQUIRE_FALSE(twi_transferAsync(0x68, &reg, 1, in, sizeof(in), true, completed, &done));
+    REQUIRE_FALSE(twi_asyncBusy());
+    REQUIRE((getTimer1Callback() == otherTimer1User));
+    setTimer1Callback(NULL);
+
+    REQUIRE(twi_transferAsync(0x68, &reg, 1, in, sizeof(in), true, completed, &done));
+    REQUIRE((getTimer1Callback() != NULL));
+    finish();
+    REQUIRE(done.calls == 1);
+    REQUIRE(done.status == 0);
+    REQUIRE(in[0] == slave.regs[0x10]);
+    REQUIRE((getTimer1Callback() == NULL));
+}
+
+TEST_CASE("twi checks who has timer1 after the queue ran dry", "[core][twi]")
+{
+    VirtualSlave slave;
+    startBus(slave);
+    unsigned char reg = 0x10;
+    unsigned char in[2] = { 0 };
+    Completion first, second, third;
+    REQUIRE(twi_transferAsync(0x68, &reg, 1, in, sizeof(in), true, completed, &first));
+    // done in the interrupt, but neither twi_asyncBusy() nor twi_asyncWait() got to give timer1 back
+    simulate(mock_ccount() + 80 * 100000);
+    REQUIRE(first.calls == 1);
+    REQUIRE((getTimer1Callback() != NULL));
+
+    // someone else takes timer1 meanwhile
+    setTimer1Callback(otherTimer1User);
+    REQUIRE_FALSE(twi_transferAsync(0x68, &reg, 1, in, sizeof(in), true, completed, &second));
+    REQUIRE((getTimer1Callback() == otherTimer1User));
+
+    // and gives it back, the next transfer claims it again and gets clocked out
+    setTimer1Callback(NULL);
+    REQUIRE(twi_transferAsync(0x68, &reg, 1, in, sizeof(in), true, completed, &third));
+    finish();
+    REQUIRE(second.calls == 0);
+    REQUIRE(third.calls == 1);
+    REQUIRE(third.status == 0);
+}
+
+TEST_CASE("twi background transfer timing", "[.][benchmark][twi]")
+{
+    VirtualSlave slave;
+    for (unsigned int clock : { 20000u, 50000u, 100000u }) {
+        startBus(slave, clock);
+        unsigned char reg = 0x3b;
+        unsigned char in[12];
+        Completion done;
+        uint32_t start = mock_ccount();
+        REQUIRE(twi_transferAsync(0x68, &reg, 1, in, sizeof(in), true, completed, &done));
+        uint32_t interrupts = 0;
+        uint32_t spent = 0;
+        while (!done.calls)
+            spent += simulate(mock_ccount() + 80 * 100, &interrupts);
+        uint32_t busy = mock_ccount() - start;
+        printf("twi 12 byte register read at %u Hz: %u us on the bus, %u interrupts, %u%% of the CPU\n",
+               clock, busy / 80, interrupts, (unsigned) (100ull * spent / busy));
+        finish();
+    }
+}
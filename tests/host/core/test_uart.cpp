@@ -0,0 +1,277 @@
+/*
+ test_uart.cpp - uart driver and HardwareSerial tests and benchmark
+ Copyright © 2016 Ivan Grokhotkov
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+ */
+
+#include <catch.hpp>
+#include <chrono>
+#include <string>
+#include <Arduino.h>
+#include <esp8266_peri_mock.h>
+#include <user_interface.h>
+
+static std::string pattern(size_t size, int seed)
+{
+    std::string data;
+    for (size_t i = 0; i < size; i++)
+        data += (char) ((i * 7 + seed) & 0xff);
+    return data;
+}
+
+static std::string readAll(HardwareSerial& serial, size_t chunk)
+{
+    std::string data;
+    char buf[512];
+    size_t got;
+    while ((got = serial.read(buf, chunk)) > 0)
+        data.append(buf, got);
+    return data;
+}
+
+TEST_CASE("HardwareSerial bulk reads", "[core][uart]")
+{
+    mock_peri_reset();
+    Serial.setRxBufferSize(256);
+    Serial.begin(115200);
+
+    // the fifo interrupt and the timeout move everything into the buffer
+    std::string sent = pattern(200, 1);
+    mock_uart_receive(UART0, sent.data(), sent.size());
+    REQUIRE(Serial.available() == 200);
+    char buf[256];
+    REQUIRE(Serial.read(buf, 150) == 150);
+    REQUIRE(std::string(buf, 150) == sent.substr(0, 150));
+
+    // the second batch wraps around the end of the ring
+    std::string more = pattern(200, 2);
+    mock_uart_receive(UART0, more.data(), more.size());
+    REQUIRE(Serial.available() == 250);
+    REQUIRE(readAll(Serial, 17) == sent.substr(150) + more);
+    REQUIRE(Serial.read(buf, sizeof(buf)) == 0);
+    REQUIRE(Serial.read() == -1);
+    REQUIRE_FALSE(Serial.hasOverrun());
+
+    // without the timeout interrupt the bytes wait in the fifo
+    USC1(UART0) = 100 << UCFFT;
+    mock_uart_receive(UART0, sent.data(), 50);
+    REQUIRE(Serial.available() == 50);
+    REQUIRE(Serial.read(buf, 30) == 30);
+    REQUIRE(std::string(buf, 30) == sent.substr(0, 30));
+    REQUIRE(Serial.read() == (uint8_t) sent[30]);
+    REQUIRE(readAll(Serial, 64) == sent.substr(31, 19));
+
+    Serial.end();
+    REQUIRE(Serial.read(buf, sizeof(buf)) == 0);
+}
+
+TEST_CASE("HardwareSerial rx buffer is a power of two ring", "[core][uart]")
+{
+    mock_peri_reset();
+    REQUIRE(Serial.setRxBufferSize(256) == 256);
+    Serial.begin(115200);
+
+    std::string sent = pattern(100, 3);
+    mock_uart_receive(UART0, sent.data(), sent.size());
+
+    // resizing rounds up and keeps what was received
+    REQUIRE(Serial.setRxBufferSize(300) == 512);
+    REQUIRE(Serial.setRxBufferSize(512) == 512);
+    REQUIRE(Serial.available() == 100);
+    REQUIRE(Serial.setRxBufferSize(20) == 32);
+    REQUIRE(Serial.available() == 31);
+    REQUIRE(readAll(Serial, 8) == sent.substr(0, 31));
+
+    // one slot stays free, the oldest bytes go when it overflows
+    REQUIRE(Serial.setRxBufferSize(128) == 128);
+    std::string flood = pattern(300, 4);
+    mock_uart_receive(UART0, flood.data(), flood.size());
+    REQUIRE(Serial.hasOverrun());
+    REQUIRE(Serial.available() == 127);
+    REQUIRE(readAll(Serial, 100) == flood.substr(300 - 127));
+
+    Serial.end();
+}
+
+TEST_CASE("HardwareSerial::readBytes", "[core][uart]")
+{
+    mock_peri_reset();
+    Serial.setRxBufferSize(256);
+    Serial.begin(115200);
+    Serial.setTimeout(5);
+
+    std::string sent = pattern(120, 5);
+    mock_uart_receive(UART0, sent.data(), sent.size());
+    uint8_t buf[200];
+    REQUIRE(Serial.readBytes(buf, 100) == 100);
+    REQUIRE(std::string((char*) buf, 100) == sent.substr(0, 100));
+    // short reads end with the timeout
+    REQUIRE(Serial.readBytes((char*) buf, 100) == 20);
+    REQUIRE(std::string((char*) buf, 20) == sent.substr(100));
+    REQUIRE(Serial.readBytes(buf, 0) == 0);
+
+    Serial.end();
+}
+
+static std::string s_trickle;
+static unsigned long s_trickleLast;
+
+// 10 bytes every 3ms, until s_trickle is used up
+static void trickle()
+{
+    if (s_trickle.empty() || millis() - s_trickleLast < 3)
+        return;
+    s_trickleLast = millis();
+    mock_uart_receive(UART0, s_trickle.data(), 10);
+    s_trickle.erase(0, 10);
+}
+
+TEST_CASE("HardwareSerial::readBytes timeout counts from the last byte", "[core][uart]")
+{
+    mock_peri_reset();
+    Serial.setRxBufferSize(256);
+    Serial.begin(115200);
+    Serial.setTimeout(5);
+
+    // takes about 30ms, but no gap is as long as the timeout
+    std::string sent = pattern(100, 6);
+    s_trickle = sent;
+    s_trickleLast = millis();
+    mock_yield_hook(trickle);
+    char buf[100];
+    size_t got = Serial.readBytes(buf, 100);
+    mock_yield_hook(NULL);
+    REQUIRE(got == 100);
+    REQUIRE(std::string(buf, 100) == sent);
+
+    Serial.end();
+}
+
+TEST_CASE("HardwareSerial buffered writes", "[core][uart]")
+{
+    mock_peri_reset();
+    REQUIRE(Serial1.setTxBufferSize(1000) == 1000);
+    Serial1.begin(115200);
+    REQUIRE(Serial1.availableForWrite() == 1023 + 127);
+
+    // the fifo takes the first 127 bytes, the rest waits for the isr
+    std::string first = pattern(1000, 7);
+    REQUIRE(Serial1.write((const uint8_t*) first.data(), first.size()) == 1000);
+    REQUIRE(Serial1.availableForWrite() == 1023 - 873);
+    REQUIRE(mock_uart_transmit(UART1, 100) == 100);
+    int space = Serial1.availableForWrite();
+    REQUIRE(space > 150);
+
+    // a write bigger than the free space waits for the line
+    std::string second = pattern(1000, 8);
+    REQUIRE(Serial1.write((const uint8_t*) second.data(), second.size()) == 1000);
+    Serial1.write('!');
+    Serial1.print("done");
+    REQUIRE(mock_uart_transmitted(UART1) == first + second + "!done");
+    REQUIRE(Serial1.availableForWrite() == 1023 + 127);
+    Serial1.flush();
+
+    // growing keeps what is queued
+    Serial1.write((const uint8_t*) first.data(), 600);
+    REQUIRE(Serial1.setTxBufferSize(2000) == 2048);
+    std::string third = pattern(1500, 10);
+    Serial1.write((const uint8_t*) third.data(), third.size());
+    REQUIRE(mock_uart_transmitted(UART1) == first.substr(0, 600) + third);
+
+    // and without a buffer writes go straight to the fifo again
+    REQUIRE(Serial1.setTxBufferSize(0) == 0);
+    REQUIRE(Serial1.availableForWrite() == 128);
+    Serial1.write((const uint8_t*) first.data(), 300);
+    REQUIRE(mock_uart_transmitted(UART1) == first.substr(0, 300));
+    Serial1.end();
+
+    // on UART0 the same interrupt serves both directions
+    Serial.setTxBufferSize(256);
+    Serial.begin(115200);
+    Serial.write((const uint8_t*) first.data(), 400);
+    std::string received = pattern(150, 9);
+    mock_uart_receive(UART0, received.data(), received.size());
+    REQUIRE(readAll(Serial, 64) == received);
+    REQUIRE(mock_uart_transmitted(UART0) == first.substr(0, 400));
+    Serial.end();
+    Serial.setTxBufferSize(0);
+}
+
+TEST_CASE("HardwareSerial debug output queues behind buffered writes", "[core][uart]")
+{
+    mock_peri_reset();
+    Serial1.setTxBufferSize(1000);
+    Serial1.begin(115200);
+    Serial1.setDebugOutput(true);
+
+    std::string data = pattern(600, 11);
+    Serial1.write((const uint8_t*) data.data(), data.size());
+    os_printf_plus("debug %d\n", 42);
+    Serial1.print("after");
+    REQUIRE(mock_uart_transmitted(UART1) == data + "debug 42\nafter");
+
+    // and once the buffer is gone, straight to the fifo again
+    Serial1.setTxBufferSize(0);
+    os_printf_plus("direct");
+    REQUIRE(mock_uart_transmitted(UART1) == "direct");
+
+    Serial1.setDebugOutput(false);
+    Serial1.end();
+}
+
+TEST_CASE("HardwareSerial read benchmark", "[.][benchmark][uart]")
+{
+    using clock = std::chrono::steady_clock;
+    mock_peri_reset();
+    Serial.setRxBufferSize(256);
+    Serial.begin(115200);
+
+    std::string sent = pattern(200, 6);
+    const int rounds = 20000;
+    char buf[200];
+
+    auto run = [&](size_t (*read)(char*, size_t)) {
+        double elapsed = 0;
+        for (int r = 0; r < rounds; r++) {
+            mock_uart_receive(UART0, sent.data(), sent.size());
+            auto start = clock::now();
+            size_t got = read(buf, sizeof(buf));
+            elapsed += std::chrono::duration<double, std::nano>(clock::now() - start).count();
+            REQUIRE(got == sizeof(buf));
+        }
+        return elapsed / rounds / sent.size();
+    };
+
+    double perByte = run([](char* dst, size_t size) {
+        size_t i = 0;
+        int c;
+        while (i < size && (c = Serial.read()) >= 0)
+            dst[i++] = (char) c;
+        return i;
+    });
+    double stream = run([](char* dst, size_t size) {
+        return Serial.Stream::readBytes(dst, size);
+    });
+    double bulk = run([](char* dst, size_t size) {
+        return Serial.read(dst, size);
+    });
+    double readBytes = run([](char* dst, size_t size) {
+        return Serial.readBytes(dst, size);
+    });
+
+    printf("uart read(), per byte:         %7.2f ns/byte\n", perByte);
+    printf("Stream::readBytes, per byte:   %7.2f ns/byte\n", stream);
+    printf("uart read(buf, len), bulk:     %7.2f ns/byte\n", bulk);
+    printf("HardwareSerial::readBytes:     %7.2f ns/byte\n", readBytes);
+
+    Serial.end();
+}
@@ -0,0 +1,356 @@
+/*
+ test_waveform.cpp - timer1 waveform generator simulation
+ Copyright © 2016 Ivan Grokhotkov
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+ */
+
+#include <catch.hpp>
+#include <chrono>
+#include <vector>
+#include <Arduino.h>
+#include <esp8266_peri_mock.h>
+#include <core_esp8266_waveform.h>
+
+// Cycles between timer1 firing and the ISR reading the counter, which the
+// generator reloads the timer early for, and what every further read costs
+static const uint32_t irqLatency = 480;
+static const uint32_t readCost = 20;
+
+struct IsrStats {
+    uint32_t count = 0;
+    uint64_t cycles = 0;
+    uint32_t maxCycles = 0;
+    double hostNs = 0;
+};
+
+// Runs the timer1 interrupts falling before until
+static void simulate(uint32_t until, IsrStats* stats = nullptr)
+{
+    using clock = std::chrono::steady_clock;
+    while (mock_timer1_armed() && (int32_t) (mock_timer1_deadline() - until) < 0) {
+        uint32_t enter = mock_timer1_deadline() + irqLatency;
+        mock_ccount_set(enter, readCost);
+        auto start = clock::now();
+        mock_timer1_fire();
+        if (stats) {
+            stats->hostNs += std::chrono::duration<double, std::nano>(clock::now() - start).count();
+            uint32_t spent = mock_ccount() - enter;
+            stats->count++;
+            stats->cycles += spent;
+            stats->maxCycles = std::max(stats->maxCycles, spent);
+        }
+    }
+    mock_ccount_set(until, readCost);
+}
+
+static const int pins[] = {0, 1, 2, 3, 4, 5, 12, 13, 14, 15, 16};
+
+// Stops whatever an earlier test left running, the generator keeps its state
+static void resetWaveforms()
+{
+    for (int pin : pins)
+        stopWaveform(pin);
+    mock_peri_reset();
+}
+
+// Cycles at which pin changed level, and the level it changed to
+struct Edge {
+    uint32_t cycle;
+    bool high;
+};
+
+static std::vector<Edge> edges(int pin)
+{
+    std::vector<Edge> result;
+    bool level = false;
+    for (const MockGpioWrite& write : mock_gpio_writes()) {
+        bool now = (write.levels >> pin) & 1;
+        if (now != level)
+            result.push_back({write.cycle, now});
+        level = now;
+    }
+    return result;
+}
+
+// Largest distance of an edge from the grid the first falling one starts,
+// the first rising one only comes as soon as the IRQ gets to it
+static uint32_t jitter(int pin, uint32_t highUs, uint32_t lowUs)
+{
+    auto pinEdges = edges(pin);
+    REQUIRE(pinEdges.size() > 2);
+    const uint32_t period = (highUs + lowUs) * 80;
+    uint32_t worst = 0;
+    uint32_t first = pinEdges[1].cycle - highUs * 80;
+    uint32_t k = 0;
+    for (const Edge& e : pinEdges) {
+        if (&e == &pinEdges[0])
+            continue;
+        uint32_t ideal = first + k * period + (e.high ? 0 : highUs * 80);
+        int32_t off = e.cycle - ideal;
+        worst = std::max(worst, (uint32_t) (off < 0 ? -off : off));
+        if (!e.high)
+            k++;
+    }
+    return worst;
+}
+
+
+TEST_CASE("Waveform edges stay on their grid", "[core][waveform]")
+{
+    resetWaveforms();
+    REQUIRE(startWaveform(4, 100, 400, 0));
+    REQUIRE_FALSE(startWaveform(7, 100, 400, 0));
+    simulate(80 * 49950);
+
+    auto pinEdges = edges(4);
+    REQUIRE(pinEdges.size() == 200);
+    REQUIRE(pinEdges[0].high);
+    for (size_t i = 2; i < pinEdges.size(); i++) {
+        uint32_t length = pinEdges[i].cycle - pinEdges[i - 1].cycle;
+        uint32_t expected = pinEdges[i - 1].high ? 8000 : 32000;
+        REQUIRE(length >= expected - 200);
+        REQUIRE(length <= expected + 200);
+    }
+    // being late for one edge doesn't push back the ones after it
+    REQUIRE(jitter(4, 100, 400) < 200);
+
+    REQUIRE(stopWaveform(4));
+    REQUIRE_FALSE(mock_timer1_armed());
+    REQUIRE_FALSE(stopWaveform(4));
+}
+
+TEST_CASE("Waveform drives every pin at once", "[core][waveform]")
+{
+    resetWaveforms();
+    for (size_t i = 0; i < sizeof(pins) / sizeof(pins[0]); i++)
+        REQUIRE(startWaveform(pins[i], 50 + 37 * i, 950 - 37 * i, 0));
+    simulate(80 * 100000);
+
+    for (size_t i = 0; i < sizeof(pins) / sizeof(pins[0]); i++) {
+        INFO("GPIO" << pins[i]);
+        REQUIRE(edges(pins[i]).size() >= 198);
+        REQUIRE(jitter(pins[i], 50 + 37 * i, 950 - 37 * i) < 80 * 10);
+    }
+
+    // pins switching together share one register write
+    resetWaveforms();
+    startWaveform(4, 100, 100, 0);
+    startWaveform(5, 100, 100, 0);
+    simulate(80 * 9950);
+    REQUIRE(edges(4).size() == 100);
+    for (const MockGpioWrite& write : mock_gpio_writes())
+        REQUIRE(((write.levels >> 4) & 1) == ((write.levels >> 5) & 1));
+    REQUIRE(mock_gpio_writes().size() == 100);
+    stopWaveform(4);
+    stopWaveform(5);
+}
+
+static uint32_t s_callbacks;
+
+static uint32_t countCallbacks()
+{
+    s_callbacks++;
+    return 80 * 1000;
+}
+
+TEST_CASE("Waveform run time and timer1 callback", "[core][waveform]")
+{
+    resetWaveforms();
+    // stops by itself, low, once the run time is over
+    REQUIRE(startWaveform(12, 50, 50, 1000));
+    REQUIRE(startWaveform(16, 300, 300, 0));
+    simulate(80 * 5000);
+    auto pinEdges = edges(12);
+    REQUIRE(pinEdges.size() == 20);
+    REQUIRE_FALSE(pinEdges.back().high);
+    REQUIRE(pinEdges.back().cycle <= 80 * 1001 + 200);
+    REQUIRE(edges(16).size() >= 16);
+    REQUIRE_FALSE(stopWaveform(12));
+
+    // a new run time counts from when it is set, also during a long period
+    REQUIRE(startWaveform(16, 3000, 3000, 1000));
+    uint32_t changed = mock_ccount();
+    simulate(changed + 80 * 10000);
+    REQUIRE(((mock_gpio_writes().back().levels >> 16) & 1) == 0);
+    REQUIRE(mock_gpio_writes().back().cycle <= changed + 80 * 1000 + 200);
+
+    // the callback keeps the timer going on its own
+    s_callbacks = 0;
+    setTimer1Callback(countCallbacks);
+    simulate(mock_ccount() + 80 * 10500);
+    REQUIRE(s_callbacks >= 10);
+    REQUIRE(s_callbacks <= 12);
+    setTimer1Callback(nullptr);
+    REQUIRE_FALSE(mock_timer1_armed());
+}
+
+static std::vector<uint32_t> risingEdges(int pin, uint32_t from)
+{
+    std::vector<uint32_t> result;
+    for (const Edge& e : edges(pin))
+        if (e.high && (int32_t) (e.cycle - from) >= 0)
+            result.push_back(e.cycle);
+    return result;
+}
+
+TEST_CASE("Synchronized analogWrite", "[core][waveform]")
+{
+    resetWaveforms();
+    analogWriteSync(true);
+    analogWriteFreq(1000);
+    analogWrite(4, 256);
+    analogWrite(5, 512);
+    analogWritePhase(12, 512);
+    analogWrite(12, 768);
+    simulate(80 * 10000);
+
+    // one period and one write for all the rising edges of a phase, past
+    // the first one which comes whenever the IRQ gets to it
+    auto rises = risingEdges(4, 0);
+    REQUIRE(rises.size() >= 9);
+    REQUIRE(risingEdges(5, 0) == rises);
+    for (size_t i = 2; i < rises.size(); i++)
+        REQUIRE((rises[i] - rises[i - 1]) == 80 * 1000);
+    auto late = risingEdges(12, 0);
+    REQUIRE(late.size() >= rises.size() - 1);
+    for (size_t i = 1; i < late.size(); i++)
+        REQUIRE((late[i] - rises[i]) == 80 * 500);
+    size_t writes = 0;
+    for (const MockGpioWrite& write : mock_gpio_writes())
+        writes += (write.cycle == rises[3]) ? 1 : 0;
+    REQUIRE(writes == 1);
+
+    // a new duty is taken at the next boundary, so no pulse is cut short
+    uint32_t changed = rises.back() + 80 * 100;
+    simulate(changed);
+    analogWrite(4, 768);
+    analogWrite(5, 0);
+    simulate(changed + 80 * 5000);
+    auto pinEdges = edges(4);
+    for (size_t i = 2; i < pinEdges.size(); i++) {
+        if (!pinEdges[i - 1].high)
+            continue;
+        uint32_t length = pinEdges[i].cycle - pinEdges[i - 1].cycle;
+        bool before = (int32_t) (pinEdges[i - 1].cycle - changed) < 0;
+        REQUIRE(length == (before ? 80 * 250 : 80 * 750));
+    }
+    REQUIRE(edges(5).back().cycle < rises.back() + 80 * 1000 + 200);
+    REQUIRE(risingEdges(4, changed).front() == rises.back() + 80 * 1000);
+
+    // 0% keeps the pin in the group, it comes back on the same grid
+    analogWrite(5, 512);
+    simulate(mock_ccount() + 80 * 3000);
+    REQUIRE(((risingEdges(5, changed).front() - rises[1]) % (80 * 1000)) == 0);
+
+    // a new frequency takes over at the same boundary for every pin
+    uint32_t switched = mock_ccount();
+    analogWriteFreq(500);
+    analogWrite(4, 512);
+    analogWrite(5, 256);
+    analogWrite(12, 512);
+    simulate(switched + 80 * 10000);
+    rises = risingEdges(4, switched);
+    REQUIRE(risingEdges(5, switched) == rises);
+    for (size_t i = 1; i < rises.size(); i++)
+        REQUIRE((rises[i] - rises[i - 1]) == 80 * 2000);
+    late = risingEdges(12, rises.front());
+    for (size_t i = 0; i < late.size(); i++)
+        REQUIRE((late[i] - rises[i]) == 80 * 1000);
+    // moving the phase let the pulse under way end first
+    pinEdges = edges(12);
+    for (size_t i = 1; i < pinEdges.size(); i++)
+        if (pinEdges[i - 1].high)
+            REQUIRE((pinEdges[i].cycle - pinEdges[i - 1].cycle) <= 80 * 1000);
+
+    // and outside the group 0% releases the pin
+    analogWriteSync(false);
+    analogWriteFreq(1000);
+    analogWritePhase(12, 0);
+    analogWrite(4, 0);
+    analogWrite(5, 0);
+    analogWrite(12, 0);
+    REQUIRE_FALSE(mock_timer1_armed());
+    REQUIRE((mock_gpio_writes().back().levels & ((1 << 4) | (1 << 5) | (1 << 12))) == 0);
+}
+
+// High times of the complete pulses on pin
+static std::vector<uint32_t> pulses(int pin)
+{
+    std::vector<uint32_t> result;
+    auto pinEdges = edges(pin);
+    for (size_t i = 1; i < pinEdges.size(); i++)
+        if (pinEdges[i - 1].high)
+            result.push_back(pinEdges[i].cycle - pinEdges[i - 1].cycle);
+    return result;
+}
+
+TEST_CASE("Waveform pulses shorter than the IRQ fluff window", "[core][waveform]")
+{
+    resetWaveforms();
+    // 1us is 80 cycles, both edges used to be written at once and cancel out
+    REQUIRE(startWaveform(4, 1, 999, 0));
+    REQUIRE(startWaveformAligned(5, 1, 1000, 0));
+    // what analogWrite(pin, 2) comes to at the default 1kHz and range of 1023
+    analogWrite(12, 2);
+    simulate(80 * 10000);
+    for (int pin : {4, 5, 12}) {
+        INFO("pin " << pin);
+        auto high = pulses(pin);
+        REQUIRE(high.size() >= 9);
+        for (uint32_t length : high) {
+            REQUIRE(length > 0);
+            REQUIRE(length < 80 * 5);
+        }
+    }
+    analogWrite(12, 0);
+    resetWaveforms();
+}
+
+TEST_CASE("Waveform with a 0us phase", "[core][waveform]")
+{
+    resetWaveforms();
+    // each phase is stretched to the fluff window, the IRQ used to requeue it at now forever
+    REQUIRE(startWaveform(4, 0, 100, 0));
+    REQUIRE(startWaveform(5, 100, 0, 0));
+    simulate(80 * 10000);
+    REQUIRE(pulses(4).size() >= 90);
+    for (uint32_t length : pulses(4))
+        REQUIRE(length < 80 * 5);
+    auto low = edges(5);
+    REQUIRE(low.size() >= 180);
+    REQUIRE(mock_timer1_armed());
+    resetWaveforms();
+}
+
+TEST_CASE("Waveform ISR cost against channel count", "[.][benchmark][waveform]")
+{
+    printf("channels  ISRs  cycles/ISR  max cycles  edges/ISR  writes/ISR  ns/ISR  max jitter\n");
+    for (size_t channels = 1; channels <= sizeof(pins) / sizeof(pins[0]); channels++) {
+        resetWaveforms();
+        // 1kHz PWM at spread out duty cycles, as analogWrite() does it
+        for (size_t i = 0; i < channels; i++)
+            startWaveform(pins[i], 100 + 70 * i, 900 - 70 * i, 0);
+        IsrStats stats;
+        simulate(80 * 200000, &stats);
+        uint32_t worst = 0;
+        size_t count = 0;
+        for (size_t i = 0; i < channels; i++) {
+            worst = std::max(worst, jitter(pins[i], 100 + 70 * i, 900 - 70 * i));
+            count += edges(pins[i]).size();
+        }
+        printf("%8zu %5u %11.1f %11u %10.2f %11.2f %7.1f %11u\n", channels, stats.count,
+               (double) stats.cycles / stats.count, stats.maxCycles, (double) count / stats.count,
+               (double) mock_gpio_writes().size() / stats.count, stats.hostNs / stats.count, worst);
+        for (size_t i = 0; i < channels; i++)
+            stopWaveform(pins[i]);
+    }
+}
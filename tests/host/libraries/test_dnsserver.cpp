@@ -0,0 +1,243 @@
+/*
+ test_dnsserver.cpp - DNSServer tests and benchmark
+ Copyright © 2016 Ivan Grokhotkov
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+ */
+
+#include <catch.hpp>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <DNSServer.h>
+
+static const uint16_t port = 53;
+static const IPAddress client(192, 168, 4, 2);
+
+// A standard query for one name, type A, class IN
+static std::string query(const std::string& dotted, uint16_t id = 0x1234)
+{
+    std::string packet = { (char) (id >> 8), (char) id, 0x01, 0x00, 0, 1, 0, 0, 0, 0, 0, 0 };
+    std::string rest = dotted;
+    while (!rest.empty()) {
+        size_t dot = rest.find('.');
+        std::string label = rest.substr(0, dot);
+        packet += (char) label.size();
+        packet += label;
+        rest = dot == std::string::npos ? "" : rest.substr(dot + 1);
+    }
+    packet += std::string("\0\0\1\0\1", 5);
+    return packet;
+}
+
+struct Reply {
+    int rcode = -1;
+    int answers = 0;
+    std::string ip;
+    uint32_t ttl = 0;
+};
+
+static Reply ask(DNSServer& dns, const std::string& packet)
+{
+    mock_udp_send(port, packet, client, 5353);
+    dns.processNextRequest();
+    auto sent = mock_udp_sent(port);
+    Reply reply;
+    if (sent.size() != 1) {
+        return reply;
+    }
+    const std::string& data = sent[0].data;
+    REQUIRE(sent[0].ip == client);
+    REQUIRE(sent[0].port == 5353);
+    REQUIRE(data.size() >= 12);
+    REQUIRE(data.substr(0, 2) == packet.substr(0, 2));
+    REQUIRE((data[2] & 0x80) != 0);
+    reply.rcode = data[3] & 0x0f;
+    reply.answers = (uint8_t) data[6] << 8 | (uint8_t) data[7];
+    if (reply.answers) {
+        // the question as it was, then one A record pointing back at it
+        REQUIRE(data.size() == packet.size() + 16);
+        REQUIRE(data.substr(12, packet.size() - 12) == packet.substr(12));
+        std::string answer = data.substr(packet.size());
+        REQUIRE(answer.substr(0, 6) == std::string("\xc0\x0c\0\1\0\1", 6));
+        REQUIRE(answer.substr(10, 2) == std::string("\0\4", 2));
+        for (int i = 6; i < 10; i++) {
+            reply.ttl = reply.ttl << 8 | (uint8_t) answer[i];
+        }
+        for (int i = 12; i < 16; i++) {
+            reply.ip += std::to_string((uint8_t) answer[i]) + (i < 15 ? "." : "");
+        }
+    }
+    return reply;
+}
+
+TEST_CASE("DNSServer answers for its domain", "[libraries][DNSServer]")
+{
+    mock_udp_reset();
+    DNSServer dns;
+    dns.setTTL(300);
+    REQUIRE(dns.start(port, "www.Example.com", IPAddress(192, 168, 4, 1)));
+
+    Reply reply = ask(dns, query("example.com"));
+    CHECK(reply.rcode == 0);
+    CHECK(reply.answers == 1);
+    CHECK(reply.ip == "192.168.4.1");
+    CHECK(reply.ttl == 300);
+    CHECK(ask(dns, query("WWW.EXAMPLE.COM")).ip == "192.168.4.1");
+    CHECK(ask(dns, query("www.example.com")).ip == "192.168.4.1");
+
+    reply = ask(dns, query("example.org"));
+    CHECK(reply.rcode == (int) DNSReplyCode::NonExistentDomain);
+    CHECK(reply.answers == 0);
+    CHECK(ask(dns, query("foo.example.com")).answers == 0);
+    CHECK(ask(dns, query("com")).answers == 0);
+
+    dns.setErrorReplyCode(DNSReplyCode::ServerFailure);
+    CHECK(ask(dns, query("example.org")).rcode == (int) DNSReplyCode::ServerFailure);
+
+    dns.stop();
+    mock_udp_send(port, query("example.com"), client, 5353);
+    dns.processNextRequest();
+    CHECK(mock_udp_sent(port).empty());
+}
+
+TEST_CASE("DNSServer domain table and wildcards", "[libraries][DNSServer]")
+{
+    mock_udp_reset();
+    DNSServer dns;
+    REQUIRE(dns.start(port, "portal.local", IPAddress(10, 0, 0, 1)));
+    REQUIRE(dns.addDomain("*.example.com", IPAddress(10, 0, 0, 2)));
+    REQUIRE(dns.addDomain("api.example.com", IPAddress(10, 0, 0, 3)));
+    REQUIRE(dns.addDomain("*.deep.example.com", IPAddress(10, 0, 0, 4)));
+    REQUIRE_FALSE(dns.addDomain("", IPAddress(10, 0, 0, 9)));
+    REQUIRE_FALSE(dns.addDomain("a..b", IPAddress(10, 0, 0, 9)));
+    REQUIRE_FALSE(dns.addDomain(String(std::string(64, 'x').c_str()) + ".com", IPAddress(10, 0, 0, 9)));
+
+    CHECK(ask(dns, query("portal.local")).ip == "10.0.0.1");
+    CHECK(ask(dns, query("api.example.com")).ip == "10.0.0.3");
+    CHECK(ask(dns, query("www.example.com")).ip == "10.0.0.2");
+    CHECK(ask(dns, query("a.b.Example.com")).ip == "10.0.0.2");
+    CHECK(ask(dns, query("x.deep.example.com")).ip == "10.0.0.4");
+    CHECK(ask(dns, query("example.com")).answers == 0);
+    CHECK(ask(dns, query("other.org")).answers == 0);
+
+    // the catch-all comes last
+    REQUIRE(dns.addDomain("*", IPAddress(10, 0, 0, 5)));
+    CHECK(ask(dns, query("other.org")).ip == "10.0.0.5");
+    CHECK(ask(dns, query("api.example.com")).ip == "10.0.0.3");
+
+    // changing and removing entries
+    REQUIRE(dns.addDomain("API.example.com", IPAddress(10, 0, 0, 6)));
+    CHECK(ask(dns, query("api.example.com")).ip == "10.0.0.6");
+    REQUIRE(dns.removeDomain("api.example.com"));
+    REQUIRE_FALSE(dns.removeDomain("api.example.com"));
+    CHECK(ask(dns, query("api.example.com")).ip == "10.0.0.2");
+    REQUIRE(dns.removeDomain("*"));
+    CHECK(ask(dns, query("other.org")).answers == 0);
+
+    // the table is full at DNS_MAX_DOMAINS, and still finds everything after removals
+    for (int i = 0; i < DNS_MAX_DOMAINS - 3; i++) {
+        REQUIRE(dns.addDomain(String("host") + String(i) + ".lan", IPAddress(10, 1, 0, i)));
+    }
+    REQUIRE_FALSE(dns.addDomain("onemore.lan", IPAddress(10, 0, 0, 9)));
+    REQUIRE(dns.removeDomain("host1.lan"));
+    REQUIRE(dns.removeDomain("*.example.com"));
+    for (int i = 0; i < DNS_MAX_DOMAINS - 3; i++) {
+        Reply reply = ask(dns, query("host" + std::to_string(i) + ".lan"));
+        if (i == 1) {
+            CHECK(reply.answers == 0);
+        } else {
+            CHECK(reply.ip == "10.1.0." + std::to_string(i));
+        }
+    }
+    CHECK(ask(dns, query("portal.local")).ip == "10.0.0.1");
+    CHECK(ask(dns, query("x.deep.example.com")).ip == "10.0.0.4");
+
+    // start() begins with a fresh table
+    REQUIRE(dns.start(port, "*", IPAddress(10, 0, 0, 7)));
+    CHECK(ask(dns, query("portal.local")).ip == "10.0.0.7");
+    CHECK(ask(dns, query("")).ip == "10.0.0.7");
+}
+
+TEST_CASE("DNSServer rejects broken queries", "[libraries][DNSServer]")
+{
+    mock_udp_reset();
+    DNSServer dns;
+    REQUIRE(dns.start(port, "*", IPAddress(10, 0, 0, 1)));
+
+    std::string good = query("example.com");
+    REQUIRE(ask(dns, good).answers == 1);
+
+    // a name running past the end of the packet
+    std::string cut = good.substr(0, 16);
+    CHECK(ask(dns, cut).answers == 0);
+    std::string label = good;
+    label[12] = 40;
+    CHECK(ask(dns, label).answers == 0);
+    // compression in the question
+    std::string pointer = good.substr(0, 12) + std::string("\xc0\x0c\0\1\0\1", 6);
+    CHECK(ask(dns, pointer).answers == 0);
+    // two questions
+    std::string two = good;
+    two[5] = 2;
+    CHECK(ask(dns, two).answers == 0);
+
+    // responses are ignored, as are packets too short or too long for the buffer
+    std::string response = good;
+    response[2] |= 0x80;
+    mock_udp_send(port, response, client, 5353);
+    dns.processNextRequest();
+    CHECK(mock_udp_sent(port).empty());
+    mock_udp_send(port, good.substr(0, 8), client, 5353);
+    dns.processNextRequest();
+    CHECK(mock_udp_sent(port).empty());
+    mock_udp_send(port, good + std::string(DNS_MAX_PACKET_SIZE, 'x'), client, 5353);
+    dns.processNextRequest();
+    CHECK(mock_udp_sent(port).empty());
+
+    // nothing left over from those
+    REQUIRE(ask(dns, good).answers == 1);
+}
+
+TEST_CASE("DNSServer benchmark", "[.][benchmark][DNSServer]")
+{
+    using clock = std::chrono::steady_clock;
+    mock_udp_reset();
+    DNSServer dns;
+    REQUIRE(dns.start(port, "portal.local", IPAddress(10, 0, 0, 1)));
+    for (int i = 0; i < DNS_MAX_DOMAINS - 2; i++) {
+        REQUIRE(dns.addDomain(String("host") + String(i) + ".lan", IPAddress(10, 1, 0, i)));
+    }
+    REQUIRE(dns.addDomain("*.example.com", IPAddress(10, 0, 0, 2)));
+
+    const int rounds = 100000;
+    auto run = [&](const std::string& packet) {
+        std::vector<MockDatagram> sent;
+        double elapsed = 0;
+        for (int r = 0; r < rounds; r++) {
+            mock_udp_send(port, packet, client, 5353);
+            auto start = clock::now();
+            dns.processNextRequest();
+            elapsed += std::chrono::duration<double>(clock::now() - start).count();
+            sent = mock_udp_sent(port);
+        }
+        REQUIRE(sent.size() == 1);
+        return rounds / elapsed;
+    };
+
+    double exact = run(query("www.portal.local"));
+    double wildcard = run(query("connectivitycheck.gstatic.example.com"));
+    double miss = run(query("connectivitycheck.gstatic.com"));
+
+    printf("exact match:    %10.0f queries/s\n", exact);
+    printf("wildcard match: %10.0f queries/s\n", wildcard);
+    printf("no match:       %10.0f queries/s\n", miss);
+}
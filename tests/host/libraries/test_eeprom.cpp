@@ -0,0 +1,285 @@
+/*
+ test_eeprom.cpp - EEPROM wear levelling tests on simulated flash
+ Copyright © 2016 Ivan Grokhotkov
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+ */
+
+#include <catch.hpp>
+#include <EEPROM.h>
+#include <Schedule.h>
+#include <spi_flash.h>
+
+static const size_t flashSectors = 8;
+static const uint32_t lastSector = flashSectors - 1;
+static const size_t headerSize = 8; // magic and sequence number
+
+// Commits what's left and runs the compaction it may have scheduled while still around
+class TestEEPROM : public EEPROMClass
+{
+public:
+    using EEPROMClass::EEPROMClass;
+    ~TestEEPROM()
+    {
+        end();
+        run_scheduled_functions();
+    }
+};
+
+static size_t totalErases()
+{
+    size_t erases = 0;
+    for (uint32_t i = 0; i < flashSectors; i++) {
+        erases += mock_flash_erases(i);
+    }
+    return erases;
+}
+
+static void fill(EEPROMClass& eeprom, size_t size, uint8_t seed)
+{
+    for (size_t i = 0; i < size; i++) {
+        eeprom.write(i, (uint8_t) (seed + i * 7));
+    }
+}
+
+static bool matches(EEPROMClass& eeprom, size_t size, uint8_t seed)
+{
+    for (size_t i = 0; i < size; i++) {
+        if (eeprom.read(i) != (uint8_t) (seed + i * 7)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+TEST_CASE("EEPROM keeps committed data across begin", "[libraries][EEPROM]")
+{
+    mock_flash_reset(flashSectors);
+    {
+        TestEEPROM eeprom(lastSector, 4);
+        eeprom.begin(512);
+        for (size_t i = 0; i < 512; i++) {
+            REQUIRE(eeprom.read(i) == 0xff);
+        }
+        fill(eeprom, 512, 1);
+        REQUIRE(eeprom.commit());
+        eeprom.put(100, (uint32_t) 0xdeadbeef);
+        eeprom.write(3, 42);
+        REQUIRE(eeprom.commit());
+    }
+    TestEEPROM eeprom(lastSector, 4);
+    eeprom.begin(512);
+    uint32_t value = 0;
+    REQUIRE(eeprom.get(100, value) == 0xdeadbeef);
+    REQUIRE(eeprom.read(3) == 42);
+    REQUIRE(eeprom.read(4) == (uint8_t) (1 + 4 * 7));
+    REQUIRE(eeprom.read(511) == (uint8_t) (1 + 511 * 7));
+    REQUIRE(mock_flash_overwrites() == 0);
+}
+
+TEST_CASE("EEPROM commits append instead of erasing", "[libraries][EEPROM]")
+{
+    const size_t commits = 1000;
+    mock_flash_reset(flashSectors);
+    TestEEPROM eeprom(lastSector, 1);
+    eeprom.begin(512);
+    for (size_t i = 0; i < commits; i++) {
+        eeprom.put(16, (uint32_t) i);
+        REQUIRE(eeprom.commit());
+    }
+    // every commit erased the sector before
+    CHECK(mock_flash_erases(lastSector) < commits / 100);
+    CHECK(mock_flash_overwrites() == 0);
+
+    TestEEPROM reread(lastSector, 1);
+    reread.begin(512);
+    uint32_t value = 0;
+    REQUIRE(reread.get(16, value) == commits - 1);
+    REQUIRE(reread.read(0) == 0xff);
+}
+
+TEST_CASE("EEPROM spreads erases over the ring", "[libraries][EEPROM]")
+{
+    const size_t commits = 4000;
+    mock_flash_reset(flashSectors);
+    TestEEPROM eeprom(lastSector, 4);
+    eeprom.begin(256);
+    for (size_t i = 0; i < commits; i++) {
+        eeprom.put((i % 32) * 8, (uint32_t) i);
+        REQUIRE(eeprom.commit());
+        run_scheduled_functions();
+    }
+    size_t total = totalErases();
+    for (uint32_t sector = 4; sector <= lastSector; sector++) {
+        INFO("sector " << sector);
+        CHECK(mock_flash_erases(sector) > 0);
+        CHECK(mock_flash_erases(sector) <= total / 4 + 1);
+    }
+    for (uint32_t sector = 0; sector < 4; sector++) {
+        CHECK(mock_flash_erases(sector) == 0);
+    }
+    CHECK(mock_flash_overwrites() == 0);
+
+    TestEEPROM reread(lastSector, 4);
+    reread.begin(256);
+    for (size_t i = commits - 32; i < commits; i++) {
+        uint32_t value = 0;
+        REQUIRE(reread.get((i % 32) * 8, value) == i);
+    }
+}
+
+TEST_CASE("EEPROM compacts after loop once the sector runs low", "[libraries][EEPROM]")
+{
+    mock_flash_reset(flashSectors);
+    TestEEPROM eeprom(lastSector, 2);
+    eeprom.begin(1024);
+    fill(eeprom, 1024, 0);
+    REQUIRE(eeprom.commit());
+    REQUIRE(mock_flash_erases(lastSector - 1) == 1);
+    size_t i = 0;
+    while (mock_flash_erases(lastSector) == 0) {
+        REQUIRE(i < 1000);
+        eeprom.put(0, (uint32_t) i++);
+        REQUIRE(eeprom.commit());
+        run_scheduled_functions();
+    }
+    // the next sector was prepared by the scheduled function, not by a full commit
+    for (size_t n = 0; n < 200; n++) {
+        eeprom.put(0, (uint32_t) i++);
+        REQUIRE(eeprom.commit());
+    }
+    REQUIRE(mock_flash_erases(lastSector) == 1);
+    REQUIRE(mock_flash_erases(lastSector - 1) == 1);
+
+    // nothing is moved while there are uncommitted changes
+    eeprom.write(5, 0);
+    run_scheduled_functions();
+    REQUIRE(mock_flash_erases(lastSector - 1) == 1);
+    REQUIRE(eeprom.commit());
+
+    TestEEPROM reread(lastSector, 2);
+    reread.begin(1024);
+    uint32_t value = 0;
+    REQUIRE(reread.get(0, value) == i - 1);
+    REQUIRE(reread.read(5) == 0);
+    REQUIRE(reread.read(6) == 6 * 7);
+}
+
+TEST_CASE("EEPROM survives power loss during a commit", "[libraries][EEPROM]")
+{
+    const size_t size = 64;
+    // with a single sector, compaction erases the only copy, as commits always did
+    for (uint8_t sectors = 2; sectors <= 3; sectors++) {
+        for (size_t cut = 1; cut < 2 * SPI_FLASH_SEC_SIZE; cut += 13) {
+            mock_flash_reset(flashSectors);
+            uint8_t committed;
+            {
+                TestEEPROM eeprom(lastSector, sectors);
+                eeprom.begin(size);
+                fill(eeprom, size, 0);
+                REQUIRE(eeprom.commit());
+                committed = 0;
+                mock_flash_fail_after(cut);
+                // small commits until the cut, going through a compaction on the way
+                for (uint8_t seed = 1; seed < 100; seed++) {
+                    fill(eeprom, size, seed);
+                    if (!eeprom.commit()) {
+                        break;
+                    }
+                    committed = seed;
+                }
+            }
+            mock_flash_fail_after(0);
+            TestEEPROM eeprom(lastSector, sectors);
+            eeprom.begin(size);
+            INFO("sectors " << (int) sectors << " cut after " << cut << " bytes, committed " << (int) committed);
+            REQUIRE((matches(eeprom, size, committed) || matches(eeprom, size, committed + 1)));
+
+            // and carries on from there
+            fill(eeprom, size, 200);
+            REQUIRE(eeprom.commit());
+            TestEEPROM reread(lastSector, sectors);
+            reread.begin(size);
+            REQUIRE(matches(reread, size, 200));
+            REQUIRE(mock_flash_overwrites() == 0);
+        }
+    }
+}
+
+TEST_CASE("EEPROM commits after falling back to the older sector", "[libraries][EEPROM]")
+{
+    const size_t size = 64;
+    mock_flash_reset(flashSectors);
+    {
+        TestEEPROM eeprom(lastSector, 2);
+        eeprom.begin(size);
+        fill(eeprom, size, 3);
+        REQUIRE(eeprom.commit());
+        // the next sector gets its header and part of the copy
+        mock_flash_fail_after(headerSize + 20);
+        REQUIRE_FALSE(eeprom.compact());
+    }
+    mock_flash_fail_after(0);
+    {
+        TestEEPROM eeprom(lastSector, 2);
+        eeprom.begin(size);
+        REQUIRE(matches(eeprom, size, 3));
+        // a small commit, appended to the older sector
+        eeprom.put(8, (uint32_t) 0x12345678);
+        REQUIRE(eeprom.commit());
+        REQUIRE(mock_flash_erases(lastSector) == 1);
+    }
+    TestEEPROM eeprom(lastSector, 2);
+    eeprom.begin(size);
+    uint32_t value = 0;
+    REQUIRE(eeprom.get(8, value) == 0x12345678);
+    REQUIRE(eeprom.read(7) == (uint8_t) (3 + 7 * 7));
+    REQUIRE(mock_flash_overwrites() == 0);
+}
+
+TEST_CASE("EEPROM reads data written in place", "[libraries][EEPROM]")
+{
+    mock_flash_reset(flashSectors);
+    uint8_t* raw = mock_flash_data() + lastSector * SPI_FLASH_SEC_SIZE;
+    for (size_t i = 0; i < 128; i++) {
+        raw[i] = (uint8_t) (5 + i * 7);
+    }
+    {
+        TestEEPROM eeprom(lastSector, 1);
+        eeprom.begin(128);
+        REQUIRE(matches(eeprom, 128, 5));
+        eeprom.write(0, 1);
+        REQUIRE(eeprom.commit());
+    }
+    TestEEPROM eeprom(lastSector, 1);
+    eeprom.begin(128);
+    REQUIRE(eeprom.read(0) == 1);
+    REQUIRE(eeprom.read(1) == (uint8_t) (5 + 7));
+}
+
+TEST_CASE("EEPROM writes a full sector in place", "[libraries][EEPROM]")
+{
+    mock_flash_reset(flashSectors);
+    {
+        TestEEPROM eeprom(lastSector, 4);
+        eeprom.begin(SPI_FLASH_SEC_SIZE);
+        fill(eeprom, SPI_FLASH_SEC_SIZE, 9);
+        REQUIRE(eeprom.commit());
+        eeprom.write(10, 0);
+        REQUIRE(eeprom.commit());
+    }
+    REQUIRE(mock_flash_erases(lastSector) == 2);
+    REQUIRE(mock_flash_data()[lastSector * SPI_FLASH_SEC_SIZE + 11] == (uint8_t) (9 + 11 * 7));
+    TestEEPROM eeprom(lastSector, 4);
+    eeprom.begin(SPI_FLASH_SEC_SIZE);
+    REQUIRE(eeprom.read(10) == 0);
+    REQUIRE(eeprom.read(11) == (uint8_t) (9 + 11 * 7));
+}
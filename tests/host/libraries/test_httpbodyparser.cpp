@@ -0,0 +1,226 @@
+/*
+ test_httpbodyparser.cpp - HTTPBodyParser tests
+ Copyright © 2016 Ivan Grokhotkov
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+ */
+
+#include <catch.hpp>
+#include <string>
+#include <vector>
+#include <Arduino.h>
+#include <HTTPBodyParser.h>
+
+// records every upload callback
+struct Recorder {
+    std::vector<HTTPUploadStatus> events;
+    std::string data;
+    std::string filename;
+    std::string name;
+    std::string type;
+    size_t totalSize = 0;
+    size_t largestWrite = 0;
+
+    HTTPBodyParser::TUploadFunction callback()
+    {
+        return [this](HTTPUpload& upload) {
+            events.push_back(upload.status);
+            if (upload.status == UPLOAD_FILE_START) {
+                filename = upload.filename.c_str();
+                name = upload.name.c_str();
+                type = upload.type.c_str();
+            } else if (upload.status == UPLOAD_FILE_WRITE) {
+                data.append((const char*) upload.buf, upload.currentSize);
+                largestWrite = std::max(largestWrite, upload.currentSize);
+            } else if (upload.status == UPLOAD_FILE_END) {
+                totalSize = upload.totalSize;
+            }
+        };
+    }
+};
+
+static HTTPStatus feed(HTTPBodyParser& parser, const std::string& payload, size_t chunk)
+{
+    HTTPStatus status = HTTP_CONTINUE;
+    for (size_t pos = 0; status == HTTP_CONTINUE && pos < payload.size(); pos += chunk) {
+        status = parser.parse(payload.data() + pos, std::min(chunk, payload.size() - pos));
+    }
+    return status;
+}
+
+static std::string param(HTTPParam& params, const char* name)
+{
+    const char* value = params.value(name);
+    return value ? value : "<missing>";
+}
+
+static const char boundary[] = "----esp8266boundary";
+
+static std::string multipart(const std::string& file)
+{
+    std::string payload = "preamble is ignored\r\n";
+    payload += std::string("--") + boundary + "\r\n";
+    payload += "Content-Disposition: form-data; name=\"title\"\r\n\r\n";
+    payload += "my file\r\n";
+    payload += std::string("--") + boundary + "\r\n";
+    payload += "Content-Disposition: form-data; name=\"upload\"; filename=\"data.bin\"\r\n";
+    payload += "Content-Type: application/octet-stream\r\n\r\n";
+    payload += file + "\r\n";
+    payload += std::string("--") + boundary + "\r\n";
+    payload += "content-disposition: form-data; name=after\r\n\r\n";
+    payload += "x=y\r\n";
+    payload += std::string("--") + boundary + "--\r\n";
+    payload += "epilogue is ignored";
+    return payload;
+}
+
+TEST_CASE("HTTPBodyParser decodes urlencoded forms in any fragmentation", "[libraries][HTTPBodyParser]")
+{
+    const std::string payload = "a=1&b=hello+world&c=%41%42%00&&flag&=x&d=";
+
+    for (size_t chunk = 1; chunk <= payload.size(); ++chunk) {
+        HTTPBodyParser parser;
+        REQUIRE(parser.begin("application/x-www-form-urlencoded", payload.size(), nullptr) == HTTP_OK);
+        REQUIRE(feed(parser, payload, chunk) == HTTP_OK);
+
+        HTTPParam params;
+        parser.params(params);
+        REQUIRE(params.total() == 6);
+        REQUIRE(param(params, "a") == "1");
+        REQUIRE(param(params, "b") == "hello world");
+        REQUIRE(param(params, "c") == "AB ");
+        REQUIRE(param(params, "flag") == "");
+        REQUIRE(std::string(params.key(4)) == "");
+        REQUIRE(std::string(params.value(4)) == "x");
+        REQUIRE(param(params, "d") == "");
+    }
+}
+
+TEST_CASE("HTTPBodyParser keeps invalid escapes literally", "[libraries][HTTPBodyParser]")
+{
+    const std::string payload = "a=%zz&b=%4g&c=100%&d=%%41&e=%4";
+
+    for (size_t chunk = 1; chunk <= payload.size(); ++chunk) {
+        HTTPBodyParser parser;
+        REQUIRE(parser.begin("application/x-www-form-urlencoded", payload.size(), nullptr) == HTTP_OK);
+        REQUIRE(feed(parser, payload, chunk) == HTTP_OK);
+
+        HTTPParam params;
+        parser.params(params);
+        REQUIRE(params.total() == 5);
+        REQUIRE(param(params, "a") == "%zz");
+        REQUIRE(param(params, "b") == "%4g");
+        REQUIRE(param(params, "c") == "100%");
+        REQUIRE(param(params, "d") == "%A");
+        REQUIRE(param(params, "e") == "%4");
+    }
+}
+
+TEST_CASE("HTTPBodyParser splits multipart forms in any fragmentation", "[libraries][HTTPBodyParser]")
+{
+    // file content that starts to look like the delimiter more than once
+    const std::string file = "\r\n-\r\n--" + std::string(boundary, 8) + "\r\r\n--" + std::string(boundary, sizeof(boundary) - 2) + "x\r";
+    const std::string payload = multipart(file);
+    const std::string type = std::string("multipart/form-data; boundary=") + boundary;
+
+    for (size_t chunk = 1; chunk <= payload.size(); ++chunk) {
+        Recorder recorder;
+        HTTPBodyParser parser;
+        REQUIRE(parser.begin(type.c_str(), payload.size(), recorder.callback()) == HTTP_OK);
+        REQUIRE(feed(parser, payload, chunk) == HTTP_OK);
+
+        REQUIRE(recorder.events.front() == UPLOAD_FILE_START);
+        REQUIRE(recorder.events.back() == UPLOAD_FILE_END);
+        REQUIRE(recorder.filename == "data.bin");
+        REQUIRE(recorder.name == "upload");
+        REQUIRE(recorder.type == "application/octet-stream");
+        REQUIRE(recorder.data == file);
+        REQUIRE(recorder.totalSize == file.size());
+
+        HTTPParam params;
+        parser.params(params);
+        REQUIRE(params.total() == 2);
+        REQUIRE(param(params, "title") == "my file");
+        REQUIRE(param(params, "after") == "x=y");
+    }
+}
+
+TEST_CASE("HTTPBodyParser streams large uploads in fixed size chunks", "[libraries][HTTPBodyParser]")
+{
+    std::string file(200 * 1024, '\0');
+    for (size_t i = 0; i < file.size(); ++i) {
+        file[i] = (char) (i * 7 + i / 251);
+    }
+    const std::string payload = multipart(file);
+    const std::string type = std::string("multipart/form-data; boundary=\"") + boundary + "\"";
+
+    Recorder recorder;
+    HTTPBodyParser parser;
+    REQUIRE(parser.begin(type.c_str(), payload.size(), recorder.callback()) == HTTP_OK);
+    REQUIRE(feed(parser, payload, 1460) == HTTP_OK);
+
+    REQUIRE(recorder.data == file);
+    REQUIRE(recorder.largestWrite == HTTP_UPLOAD_BUFLEN);
+    REQUIRE(recorder.events.size() == 2 + (file.size() + HTTP_UPLOAD_BUFLEN - 1) / HTTP_UPLOAD_BUFLEN);
+}
+
+TEST_CASE("HTTPBodyParser passes other payloads through as raw uploads", "[libraries][HTTPBodyParser]")
+{
+    const std::string payload = "{\"json\": true}";
+
+    Recorder recorder;
+    HTTPBodyParser parser;
+    REQUIRE(parser.begin("application/json", payload.size(), recorder.callback()) == HTTP_OK);
+    REQUIRE(feed(parser, payload, 3) == HTTP_OK);
+    REQUIRE(recorder.type == "application/json");
+    REQUIRE(recorder.data == payload);
+    REQUIRE(recorder.events.back() == UPLOAD_FILE_END);
+
+    // without an upload handler the payload is skipped
+    HTTPBodyParser skipped;
+    REQUIRE(skipped.begin("application/json", payload.size(), nullptr) == HTTP_OK);
+    REQUIRE(feed(skipped, payload, 3) == HTTP_OK);
+    REQUIRE(skipped.upload() == nullptr);
+}
+
+TEST_CASE("HTTPBodyParser rejects bad payloads", "[libraries][HTTPBodyParser]")
+{
+    const std::string type = std::string("multipart/form-data; boundary=") + boundary;
+    Recorder recorder;
+    HTTPBodyParser parser;
+
+    SECTION("missing boundary") {
+        REQUIRE(parser.begin("multipart/form-data", 10, nullptr) == HTTP_BAD_REQUEST);
+    }
+
+    SECTION("payload cut short aborts the upload") {
+        std::string payload = multipart("FILE");
+        payload = payload.substr(0, payload.find("FILE") + 2);
+        REQUIRE(parser.begin(type.c_str(), payload.size(), recorder.callback()) == HTTP_OK);
+        REQUIRE(feed(parser, payload, 16) == HTTP_BAD_REQUEST);
+        REQUIRE(recorder.events.back() == UPLOAD_FILE_ABORTED);
+    }
+
+    SECTION("connection lost aborts the upload") {
+        std::string payload = multipart("FILE");
+        REQUIRE(parser.begin(type.c_str(), payload.size(), recorder.callback()) == HTTP_OK);
+        REQUIRE(parser.parse(payload.data(), payload.find("FILE") + 2) == HTTP_CONTINUE);
+        parser.reset();
+        REQUIRE(recorder.events.back() == UPLOAD_FILE_ABORTED);
+        REQUIRE(recorder.events.size() == 2);
+    }
+
+    SECTION("form fields are bounded") {
+        std::string payload = "big=" + std::string(HTTP_MAX_FORM_SIZE, 'x');
+        REQUIRE(parser.begin(nullptr, payload.size(), nullptr) == HTTP_OK);
+        REQUIRE(feed(parser, payload, 100) == HTTP_PAYLOAD_LARGE);
+    }
+}
@@ -0,0 +1,173 @@
+/*
+ test_httpheaderbuilder.cpp - HTTPHeaderBuilder tests and benchmark
+ Copyright © 2016 Ivan Grokhotkov
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+ */
+
+#include <catch.hpp>
+#include <chrono>
+#include <string>
+#include <ESP8266WebServer.h>
+#include <HTTPHeaderBuilder.h>
+#include "heap_mock.h"
+
+static std::string built(const HTTPHeaderBuilder& builder)
+{
+    return std::string(builder.data(), builder.length());
+}
+
+TEST_CASE("HTTPHeaderBuilder formats the response head", "[libraries][HTTPHeaderBuilder]")
+{
+    HTTPHeaderBuilder builder;
+    REQUIRE(builder.available() == HTTP_RESPONSE_BUFLEN);
+
+    REQUIRE(builder.header("Cache-Control", "no-cache"));
+    REQUIRE(builder.header(PSTR("Content-Type"), PSTR("text/plain"), true));
+    REQUIRE(builder.header("Content-Length", 1234567890UL));
+    REQUIRE(builder.status(1, 404, PSTR("Not Found")));
+    REQUIRE(builder.append("\r\n", 2));
+    REQUIRE(built(builder) ==
+        "HTTP/1.1 404 Not Found\r\n"
+        "Content-Type: text/plain\r\n"
+        "Cache-Control: no-cache\r\n"
+        "Content-Length: 1234567890\r\n"
+        "\r\n");
+
+    // the buffer is kept for the next response
+    const void* buffer = builder.data();
+    builder.reset();
+    REQUIRE(builder.length() == 0);
+    REQUIRE(builder.status(0, 200, PSTR("OK")));
+    REQUIRE(built(builder) == "HTTP/1.0 200 OK\r\n");
+    REQUIRE((const void*) builder.data() == buffer);
+}
+
+TEST_CASE("HTTPHeaderBuilder grows for headers but not for bodies", "[libraries][HTTPHeaderBuilder]")
+{
+    HTTPHeaderBuilder builder;
+    std::string cookie(HTTP_RESPONSE_BUFLEN, 'c');
+    std::string body(HTTP_RESPONSE_BUFLEN, 'b');
+
+    REQUIRE(builder.header("Set-Cookie", cookie.c_str()));
+    REQUIRE(builder.length() == cookie.size() + 14);
+    REQUIRE(builder.available() < body.size());
+    REQUIRE_FALSE(builder.append(body.data(), body.size(), false));
+    REQUIRE(builder.length() == cookie.size() + 14);
+
+    REQUIRE(builder.append(body.data(), builder.available(), false));
+    REQUIRE(builder.available() == 0);
+    REQUIRE(builder.append("", 0, false));
+}
+
+TEST_CASE("HTTPHeaderBuilder formats the largest numeric value", "[libraries][HTTPHeaderBuilder]")
+{
+    HTTPHeaderBuilder builder;
+    unsigned long largest = ~0UL;
+    REQUIRE(builder.header("Content-Length", largest));
+    REQUIRE(built(builder) == "Content-Length: " + std::to_string(largest) + "\r\n");
+}
+
+TEST_CASE("HTTPHeaderBuilder allocation benchmark", "[.][benchmark][HTTPHeaderBuilder]")
+{
+    using clock = std::chrono::steady_clock;
+    const int rounds = 2000;
+
+    // what _prepareHeader used to do for a keep-alive response with one custom header
+    auto strings = [](String& response) {
+        String headers;
+        auto sendHeader = [&headers](const String& name, const String& value, bool first) {
+            String headerLine = name;
+            headerLine += F(": ");
+            headerLine += value;
+            headerLine += "\r\n";
+            if (first) {
+                headers = headerLine + headers;
+            } else {
+                headers += headerLine;
+            }
+        };
+        sendHeader(String(F("Cache-Control")), String(F("max-age=86400")), false);
+        response = String(F("HTTP/1.")) + String(1) + ' ';
+        response += String(200);
+        response += ' ';
+        response += String(F("OK"));
+        response += "\r\n";
+        sendHeader(String(F("Content-Type")), String(F("text/plain")), true);
+        sendHeader(String(F("Content-Length")), String(42), false);
+        sendHeader(String(F("Connection")), String(F("keep-alive")), false);
+        sendHeader(String(F("Keep-Alive")), String(F("timeout=")) + String(2) + String(F(", max=")) + String(99), false);
+        response += headers;
+        response += "\r\n";
+    };
+
+    HTTPHeaderBuilder builder;
+    auto builderHead = [&builder]() {
+        builder.reset();
+        builder.header(PSTR("Cache-Control"), PSTR("max-age=86400"));
+        builder.header(PSTR("Content-Type"), PSTR("text/plain"), true);
+        builder.header(PSTR("Content-Length"), 42UL);
+        builder.header(PSTR("Connection"), PSTR("keep-alive"));
+        builder.header(PSTR("Keep-Alive"), "timeout=2, max=99");
+        builder.status(1, 200, PSTR("OK"));
+        builder.append(PSTR("\r\n"), 2);
+    };
+    builderHead();
+
+    String response;
+    strings(response);
+    REQUIRE(built(builder) == response.c_str());
+
+    size_t counted = mock_heap_allocations;
+    auto start = clock::now();
+    for (int r = 0; r < rounds; ++r) {
+        String head;
+        strings(head);
+    }
+    double stringTime = std::chrono::duration<double, std::nano>(clock::now() - start).count();
+    size_t stringAllocations = mock_heap_allocations - counted;
+
+    counted = mock_heap_allocations;
+    start = clock::now();
+    for (int r = 0; r < rounds; ++r) {
+        builderHead();
+    }
+    double builderTime = std::chrono::duration<double, std::nano>(clock::now() - start).count();
+    size_t builderAllocations = mock_heap_allocations - counted;
+
+    // a whole keep-alive request through the server: parse, dispatch, respond
+    ESP8266WebServer server(8007);
+    server.on("/", [&server]() {
+        server.sendHeader("Cache-Control", "max-age=86400");
+        server.send_P(HTTP_OK, PSTR("text/plain"), PSTR("hello"));
+    });
+    server.begin();
+    auto client = WiFiServer::connect(8007);
+    client->send("GET / HTTP/1.1\r\n\r\n");
+    server.handleClient();
+    server.handleClient();
+    client->received();
+
+    counted = mock_heap_allocations;
+    for (int r = 0; r < rounds; ++r) {
+        client->send("GET / HTTP/1.1\r\n\r\n");
+        server.handleClient();
+        server.handleClient();
+    }
+    size_t serverAllocations = mock_heap_allocations - counted;
+    REQUIRE(client->received().find("hello") != std::string::npos);
+
+    printf("String concatenation: %5.1f allocations, %7.1f ns per response head\n",
+           (double) stringAllocations / rounds, stringTime / rounds);
+    printf("HTTPHeaderBuilder:    %5.1f allocations, %7.1f ns per response head\n",
+           (double) builderAllocations / rounds, builderTime / rounds);
+    printf("whole request:        %5.1f allocations\n", (double) serverAllocations / rounds);
+}
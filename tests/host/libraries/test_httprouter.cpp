@@ -0,0 +1,204 @@
+/*
+ test_httprouter.cpp - HTTPRouter tests and benchmark
+ Copyright © 2016 Ivan Grokhotkov
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+ */
+
+#include <catch.hpp>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <vector>
+#include <ESP8266WebServer.h>
+#include <FS.h>
+#include <HTTPRouter.h>
+#include <detail/RequestHandlersImpl.h>
+
+// prefix or catch-all handler that counts how often it was asked
+class ProbeHandler : public RequestHandler {
+public:
+    ProbeHandler(RouteType type, const char* uri) : _type(type), _uri(uri) { }
+
+    RouteType routeType() const override { return _type; }
+    const char* routeUri() const override { return _type == ROUTE_ANY ? nullptr : _uri.c_str(); }
+
+    bool canHandle(HTTPMethod method, String uri) override
+    {
+        (void) method;
+        ++probes;
+        return _type == ROUTE_ANY ? uri.endsWith(_uri) : uri.startsWith(_uri);
+    }
+
+    int probes = 0;
+
+private:
+    RouteType _type;
+    String _uri;
+};
+
+// owns a handler list the way ESP8266WebServer does
+struct Handlers {
+    std::vector<std::unique_ptr<RequestHandler>> list;
+
+    template<typename T>
+    T* add(T* handler)
+    {
+        if (!list.empty()) {
+            list.back()->next(handler);
+        }
+        list.emplace_back(handler);
+        return handler;
+    }
+
+    FunctionRequestHandler* on(const char* uri, HTTPMethod method = HTTP_ANY)
+    {
+        return add(new FunctionRequestHandler([]() {}, nullptr, uri, method));
+    }
+
+    RequestHandler* first()
+    {
+        return list.empty() ? nullptr : list.front().get();
+    }
+
+    // what the server did before it had a route table
+    RequestHandler* walk(HTTPMethod method, const char* uri)
+    {
+        for (RequestHandler* handler = first(); handler; handler = handler->next()) {
+            if (handler->canHandle(method, String(uri))) {
+                return handler;
+            }
+        }
+        return nullptr;
+    }
+};
+
+TEST_CASE("HTTPRouter matches exact routes by method", "[libraries][HTTPRouter]")
+{
+    Handlers handlers;
+    auto get = handlers.on("/led", HTTP_GET);
+    auto post = handlers.on("/led", HTTP_POST);
+    auto any = handlers.on("/led");
+    auto root = handlers.on("/");
+
+    HTTPRouter router;
+    REQUIRE(router.build(handlers.first()));
+    REQUIRE(router.find(HTTP_GET, "/led") == get);
+    REQUIRE(router.find(HTTP_POST, "/led") == post);
+    REQUIRE(router.find(HTTP_PUT, "/led") == any);
+    REQUIRE(router.find(HTTP_GET, "/") == root);
+    REQUIRE(router.find(HTTP_GET, "/le") == nullptr);
+    REQUIRE(router.find(HTTP_GET, "/led/") == nullptr);
+    REQUIRE(router.find(HTTP_GET, "") == nullptr);
+}
+
+TEST_CASE("HTTPRouter matches prefix routes along the trie", "[libraries][HTTPRouter]")
+{
+    Handlers handlers;
+    auto img = handlers.add(new ProbeHandler(RequestHandler::ROUTE_PREFIX, "/static/img/"));
+    auto css = handlers.add(new ProbeHandler(RequestHandler::ROUTE_PREFIX, "/static/css/"));
+    auto assets = handlers.add(new ProbeHandler(RequestHandler::ROUTE_PREFIX, "/static/"));
+    auto everything = handlers.add(new ProbeHandler(RequestHandler::ROUTE_PREFIX, ""));
+
+    HTTPRouter router;
+    REQUIRE(router.build(handlers.first()));
+    REQUIRE(router.find(HTTP_GET, "/static/img/logo.png") == img);
+    REQUIRE(router.find(HTTP_GET, "/static/css/site.css") == css);
+    REQUIRE(router.find(HTTP_GET, "/static/js/app.js") == assets);
+    REQUIRE(router.find(HTTP_GET, "/static/") == assets);
+    REQUIRE(router.find(HTTP_GET, "/stat") == everything);
+
+    // handlers off the path are never asked
+    REQUIRE(img->probes == 1);
+    REQUIRE(css->probes == 1);
+}
+
+TEST_CASE("HTTPRouter keeps the registration order across route kinds", "[libraries][HTTPRouter]")
+{
+    Handlers handlers;
+    auto api = handlers.add(new ProbeHandler(RequestHandler::ROUTE_PREFIX, "/api/"));
+    auto json = handlers.add(new ProbeHandler(RequestHandler::ROUTE_ANY, ".json"));
+    auto status = handlers.on("/api/status");
+    auto config = handlers.on("/config.json");
+    auto late = handlers.add(new ProbeHandler(RequestHandler::ROUTE_ANY, "/late"));
+
+    HTTPRouter router;
+    REQUIRE(router.build(handlers.first()));
+
+    const char* uris[] = { "/api/status", "/config.json", "/api/x.json", "/late", "/nothing", "/api/" };
+    for (auto uri : uris) {
+        REQUIRE(router.find(HTTP_GET, uri) == handlers.walk(HTTP_GET, uri));
+    }
+    REQUIRE(router.find(HTTP_GET, "/api/status") == api);
+    REQUIRE(router.find(HTTP_GET, "/config.json") == json);
+    REQUIRE(router.find(HTTP_GET, "/late") == late);
+    (void) status;
+    (void) config;
+
+    // catch-all handlers registered after the winner are not asked
+    late->probes = 0;
+    router.find(HTTP_GET, "/api/status");
+    REQUIRE(late->probes == 0);
+}
+
+TEST_CASE("HTTPRouter falls back to the handler list", "[libraries][HTTPRouter]")
+{
+    Handlers handlers;
+    HTTPRouter router;
+    REQUIRE_FALSE(router.built());
+    REQUIRE(router.build(nullptr));
+    REQUIRE(router.built());
+    REQUIRE(router.find(HTTP_GET, "/") == nullptr);
+
+    auto first = handlers.on("/a");
+    router.reset();
+    REQUIRE_FALSE(router.built());
+    REQUIRE(router.build(handlers.first()));
+    REQUIRE(router.find(HTTP_GET, "/a") == first);
+}
+
+TEST_CASE("HTTPRouter dispatch benchmark", "[.][benchmark][HTTPRouter]")
+{
+    using clock = std::chrono::steady_clock;
+    const int rounds = 20000;
+
+    for (int routes = 8; routes <= 512; routes *= 4) {
+        Handlers handlers;
+        handlers.add(new ProbeHandler(RequestHandler::ROUTE_PREFIX, "/static/"));
+        std::vector<std::string> uris;
+        for (int i = 0; i < routes; ++i) {
+            uris.push_back("/api/v1/resource" + std::to_string(i));
+            handlers.on(uris.back().c_str(), HTTP_GET);
+        }
+        const char* last = uris.back().c_str();
+
+        HTTPRouter router;
+        REQUIRE(router.build(handlers.first()));
+        REQUIRE(router.find(HTTP_GET, last) == handlers.walk(HTTP_GET, last));
+
+        auto start = clock::now();
+        for (int r = 0; r < rounds; ++r) {
+            router.find(HTTP_GET, last);
+            router.find(HTTP_GET, "/missing");
+        }
+        double table = std::chrono::duration<double, std::nano>(clock::now() - start).count();
+
+        start = clock::now();
+        for (int r = 0; r < rounds; ++r) {
+            handlers.walk(HTTP_GET, last);
+            handlers.walk(HTTP_GET, "/missing");
+        }
+        double walk = std::chrono::duration<double, std::nano>(clock::now() - start).count();
+
+        printf("%4d routes: route table %8.1f ns/request, list walk %8.1f ns/request\n",
+               routes, table / (2 * rounds), walk / (2 * rounds));
+    }
+}
@@ -0,0 +1,186 @@
+/*
+ test_mdnscache.cpp - MDNSCache tests
+ Copyright © 2016 Ivan Grokhotkov
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+ */
+
+#include <catch.hpp>
+#include <string>
+#include <vector>
+#include <MDNSCache.h>
+
+static const uint32_t ip1 = 0x0a01a8c0;   // 192.168.1.10
+static const uint32_t ip2 = 0x0b01a8c0;   // 192.168.1.11
+
+// what the callback was told, one line per call
+static std::vector<std::string> s_events;
+
+static void record(const MDNSServiceInfo& info)
+{
+    char line[160];
+    snprintf(line, sizeof(line), "%s %s %s:%u %s", info.available ? "up" : "down",
+             info.instance, info.hostname, info.port, info.ip.toString().c_str());
+    s_events.push_back(line);
+}
+
+static void announce(MDNSCache& cache, uint32_t now, const char* instance, const char* host, uint16_t port, uint32_t ip, uint32_t ttl)
+{
+    cache.addPTR(now, "http", "tcp", instance, ttl);
+    cache.addSRV(now, "http", "tcp", instance, host, port, ttl);
+    cache.addA(now, host, ip, ttl);
+}
+
+TEST_CASE("MDNSCache collects instances and reports them once", "[libraries][MDNSCache]")
+{
+    MDNSCache cache;
+    s_events.clear();
+    REQUIRE(cache.browse("http", "tcp", record));
+    REQUIRE_FALSE(cache.browse("http", "tcpx", record));
+
+    // records of services nobody browses are dropped
+    cache.addPTR(0, "ftp", "tcp", "files", 120);
+    REQUIRE(cache.count("ftp", "tcp") == 0);
+
+    // usable once port and address are known, whatever the order
+    cache.addSRV(0, "http", "tcp", "Kitchen", "esp-a", 80, 120);
+    cache.addPTR(0, "HTTP", "tcp", "kitchen", 4500);
+    REQUIRE(cache.count("http", "tcp") == 0);
+    REQUIRE(s_events.empty());
+    cache.addA(0, "ESP-A", ip1, 120);
+    REQUIRE(cache.count("http", "tcp") == 1);
+    REQUIRE(s_events.size() == 1);
+    REQUIRE(s_events[0] == "up Kitchen esp-a:80 192.168.1.10");
+
+    // the same records again change nothing, a new address does
+    announce(cache, 1000, "Kitchen", "esp-a", 80, ip1, 120);
+    REQUIRE(s_events.size() == 1);
+    cache.addA(1000, "esp-a", ip2, 120);
+    REQUIRE(s_events.size() == 2);
+    REQUIRE(s_events[1] == "up Kitchen esp-a:80 192.168.1.11");
+
+    uint8_t txt[] = "\x07" "path=/x" "\x05" "debug";
+    cache.addTXT(1000, "http", "tcp", "Kitchen", txt, sizeof(txt) - 1, 4500);
+    REQUIRE(s_events.size() == 3);
+    MDNSServiceInfo info;
+    REQUIRE(cache.info("http", "tcp", 0, info));
+    REQUIRE(info.txtValue("PATH") == "/x");
+    REQUIRE(info.txtValue("debug") == "");
+    REQUIRE(info.txtValue("missing") == "");
+    REQUIRE(info.port == 80);
+    REQUIRE_FALSE(cache.info("http", "tcp", 1, info));
+
+    // a goodbye removes the instance at once
+    cache.addPTR(2000, "http", "tcp", "Kitchen", 0);
+    REQUIRE(cache.count("http", "tcp") == 0);
+    REQUIRE(s_events.size() == 4);
+    REQUIRE(s_events[3] == "down Kitchen esp-a:80 192.168.1.11");
+}
+
+TEST_CASE("MDNSCache expires records with their TTL", "[libraries][MDNSCache]")
+{
+    MDNSCache cache;
+    s_events.clear();
+    cache.browse("http", "tcp", record);
+    cache.browse("ipp", "tcp", nullptr);
+
+    // one address record serves every instance on that host
+    cache.addPTR(0, "ipp", "tcp", "printer", 60);
+    cache.addSRV(0, "ipp", "tcp", "printer", "host-a", 631, 60);
+    announce(cache, 0, "a", "host-a", 80, ip1, 120);
+    announce(cache, 0, "b", "host-b", 8080, ip2, 10);
+    REQUIRE(cache.count("ipp", "tcp") == 1);
+    REQUIRE(cache.count("http", "tcp") == 2);
+
+    cache.expire(9999);
+    REQUIRE(cache.count("http", "tcp") == 2);
+    cache.expire(10000);
+    REQUIRE(cache.count("http", "tcp") == 1);
+    REQUIRE(s_events.back() == "down b host-b:8080 192.168.1.11");
+
+    MDNSServiceInfo info;
+    REQUIRE(cache.info("http", "tcp", 0, info));
+    REQUIRE(std::string(info.instance) == "a");
+
+    // only the address ran out, the instance stays but can't be used
+    cache.addA(20000, "host-a", ip1, 5);
+    cache.expire(25000);
+    REQUIRE(cache.count("http", "tcp") == 0);
+    REQUIRE(cache.count("ipp", "tcp") == 0);
+    REQUIRE(s_events.back() == "down a host-a:80 192.168.1.10");
+    cache.addA(26000, "host-a", ip1, 120);
+    REQUIRE(cache.count("http", "tcp") == 1);
+    REQUIRE(s_events.back() == "up a host-a:80 192.168.1.10");
+
+    // millis() wrapping around doesn't expire anything early
+    MDNSCache wrapped;
+    wrapped.browse("http", "tcp", nullptr);
+    announce(wrapped, 0xfffff000, "w", "host-w", 80, ip1, 120);
+    wrapped.expire(0x00001000);
+    REQUIRE(wrapped.count("http", "tcp") == 1);
+    wrapped.expire(0xfffff000 + 120000);
+    REQUIRE(wrapped.count("http", "tcp") == 0);
+}
+
+TEST_CASE("MDNSCache schedules queries", "[libraries][MDNSCache]")
+{
+    MDNSCache cache;
+    const char* service;
+    const char* proto;
+
+    // without a callback nothing is asked in the background
+    cache.browse("ipp", "tcp", nullptr);
+    REQUIRE_FALSE(cache.due(0, service, proto));
+
+    // one-off queries go out at most once per minimum interval
+    REQUIRE_FALSE(cache.query(0, "printer", "tcp"));
+    REQUIRE(cache.query(0, "ipp", "tcp"));
+    REQUIRE_FALSE(cache.query(MDNS_QUERY_INTERVAL_MIN - 1, "ipp", "tcp"));
+    REQUIRE(cache.query(MDNS_QUERY_INTERVAL_MIN, "ipp", "tcp"));
+    REQUIRE_FALSE(cache.due(MDNS_QUERY_INTERVAL_MIN, service, proto));
+
+    cache.browse("http", "tcp", record);
+    REQUIRE(cache.due(0, service, proto));
+    REQUIRE(std::string(service) == "http");
+    REQUIRE_FALSE(cache.due(0, service, proto));
+
+    // the interval doubles from a second up to an hour
+    std::vector<uint32_t> times;
+    for (uint32_t now = 0; now < 20000000; now += 500) {
+        if (cache.due(now, service, proto))
+            times.push_back(now);
+    }
+    REQUIRE(times.size() > 12);
+    REQUIRE(times[0] == 1000);
+    REQUIRE(times[1] == 3000);
+    REQUIRE(times[2] == 7000);
+    uint32_t lastInterval = times.back() - times[times.size() - 2];
+    REQUIRE(lastInterval == MDNS_QUERY_INTERVAL_MAX);
+
+    // an instance is asked about again at 80% of its TTL
+    MDNSCache refresh;
+    refresh.browse("http", "tcp", record);
+    REQUIRE(refresh.due(0, service, proto));
+    announce(refresh, 100, "a", "host-a", 80, ip1, 1);
+    REQUIRE_FALSE(refresh.due(899, service, proto));
+    REQUIRE(refresh.due(900, service, proto));
+    REQUIRE_FALSE(refresh.due(950, service, proto));
+
+    // forgetting from inside the callback is safe
+    MDNSCache forgetful;
+    forgetful.browse("http", "tcp", [&forgetful](const MDNSServiceInfo&) {
+        forgetful.forget("http", "tcp");
+    });
+    announce(forgetful, 0, "a", "host-a", 80, ip1, 10);
+    REQUIRE_FALSE(forgetful.browsing("http", "tcp"));
+    forgetful.expire(1);
+    REQUIRE_FALSE(forgetful.due(1, service, proto));
+}
@@ -0,0 +1,429 @@
+/*
+ test_mdnsparser.cpp - MDNSPacket tests, fuzzing and benchmark
+ Copyright © 2016 Ivan Grokhotkov
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+ */
+
+#include <catch.hpp>
+#include <chrono>
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+#include <MDNSCache.h>
+#include <MDNSParser.h>
+
+#define MDNS_TYPE_NSEC 0x002F
+
+// Writes DNS messages the way responders do, names compressed against every
+// suffix written before
+class PacketWriter {
+public:
+    PacketWriter(uint16_t flags, uint16_t questions, uint16_t answers, uint16_t authority, uint16_t additional)
+    {
+        u16(0);
+        u16(flags);
+        u16(questions);
+        u16(answers);
+        u16(authority);
+        u16(additional);
+    }
+
+    void u8(uint8_t value) { bytes.push_back(value); }
+    void u16(uint16_t value) { u8(value >> 8); u8(value); }
+    void u32(uint32_t value) { u16(value >> 16); u16(value); }
+    void raw(const std::string& value) { bytes.insert(bytes.end(), value.begin(), value.end()); }
+
+    // labels separated by '.', instance names here have no dots of their own
+    void name(const std::string& dotted)
+    {
+        std::string rest = dotted;
+        while (!rest.empty()) {
+            auto known = _names.find(rest);
+            if (known != _names.end()) {
+                u16(0xC000 | known->second);
+                return;
+            }
+            _names[rest] = bytes.size();
+            size_t dot = rest.find('.');
+            std::string label = rest.substr(0, dot);
+            u8(label.size());
+            raw(label);
+            rest = dot == std::string::npos ? "" : rest.substr(dot + 1);
+        }
+        u8(0);
+    }
+
+    void question(const std::string& owner, uint16_t type, uint16_t cls = MDNS_CLASS_IN)
+    {
+        name(owner);
+        u16(type);
+        u16(cls);
+    }
+
+    void record(const std::string& owner, uint16_t type, uint32_t ttl, std::function<void()> rdata)
+    {
+        name(owner);
+        u16(type);
+        u16(MDNS_CLASS_IN_FLUSH_CACHE);
+        u32(ttl);
+        size_t length = bytes.size();
+        u16(0);
+        rdata();
+        size_t size = bytes.size() - length - 2;
+        bytes[length] = size >> 8;
+        bytes[length + 1] = size;
+    }
+
+    void ptr(const std::string& owner, const std::string& target, uint32_t ttl = 4500)
+    {
+        record(owner, MDNS_TYPE_PTR, ttl, [&]() { name(target); });
+    }
+
+    void srv(const std::string& owner, const std::string& host, uint16_t port, uint32_t ttl = 120)
+    {
+        record(owner, MDNS_TYPE_SRV, ttl, [&]() { u16(0); u16(0); u16(port); name(host); });
+    }
+
+    void txt(const std::string& owner, const std::vector<std::string>& strings, uint32_t ttl = 4500)
+    {
+        record(owner, MDNS_TYPE_TXT, ttl, [&]() {
+            for (auto& s : strings) {
+                u8(s.size());
+                raw(s);
+            }
+        });
+    }
+
+    void a(const std::string& owner, uint8_t a, uint8_t b, uint8_t c, uint8_t d, uint32_t ttl = 120)
+    {
+        record(owner, MDNS_TYPE_A, ttl, [&]() { u8(a); u8(b); u8(c); u8(d); });
+    }
+
+    void aaaa(const std::string& owner, uint32_t ttl = 120)
+    {
+        record(owner, MDNS_TYPE_AAAA, ttl, [&]() { u32(0xfe800000); u32(0); u32(0x12345678); u32(0x9abcdef0); });
+    }
+
+    void nsec(const std::string& owner)
+    {
+        record(owner, MDNS_TYPE_NSEC, 120, [&]() { name(owner); u8(0); u8(5); u8(0); u8(0); u8(0x80); u8(0); u8(0x40); });
+    }
+
+    std::vector<uint8_t> bytes;
+
+private:
+    std::map<std::string, uint16_t> _names;
+};
+
+// What a busy home network sends around, recreated from captures: cast
+// devices, Apple devices announcing and asking, and one of ours whose
+// response lists its records in an unusual order
+static std::vector<std::vector<uint8_t>> traffic()
+{
+    std::vector<std::vector<uint8_t>> packets;
+    {
+        PacketWriter p(0x8400, 0, 1, 0, 4);
+        p.ptr("_googlecast._tcp.local", "Chromecast-Ultra-5a1b2c3d4e5f._googlecast._tcp.local", 120);
+        p.txt("Chromecast-Ultra-5a1b2c3d4e5f._googlecast._tcp.local",
+              {"id=5a1b2c3d4e5f60718293a4b5c6d7e8f9", "cd=0D1E2F3A4B5C6D7E8F90A1B2C3D4E5F6", "rm=", "ve=05",
+               "md=Chromecast Ultra", "ic=/setup/icon.png", "fn=Living Room TV", "ca=4101", "st=0", "bs=FA8FCA7A2B4C", "nf=1", "rs="});
+        p.srv("Chromecast-Ultra-5a1b2c3d4e5f._googlecast._tcp.local", "5a1b2c3d-4e5f-6071-8293-a4b5c6d7e8f9.local", 8009);
+        p.a("5a1b2c3d-4e5f-6071-8293-a4b5c6d7e8f9.local", 192, 168, 1, 31);
+        p.aaaa("5a1b2c3d-4e5f-6071-8293-a4b5c6d7e8f9.local");
+        packets.push_back(p.bytes);
+    }
+    {
+        PacketWriter p(0x8400, 0, 6, 0, 4);
+        p.ptr("_airplay._tcp.local", "Kitchen HomePod._airplay._tcp.local");
+        p.ptr("_raop._tcp.local", "A0B1C2D3E4F5@Kitchen HomePod._raop._tcp.local");
+        p.srv("Kitchen HomePod._airplay._tcp.local", "Kitchen-HomePod.local", 7000);
+        p.srv("A0B1C2D3E4F5@Kitchen HomePod._raop._tcp.local", "Kitchen-HomePod.local", 7000);
+        p.txt("Kitchen HomePod._airplay._tcp.local",
+              {"acl=0", "deviceid=A0:B1:C2:D3:E4:F5", "features=0x4A7FDFD5,0xBC157FDE", "rsf=0x0", "fv=p20.T8.1",
+               "flags=0x1a404", "model=AudioAccessory1,1", "manufacturer=Apple Inc.", "protovers=1.1", "srcvers=530.6",
+               "pi=0b1c2d3e-4f50-6172-8394-a5b6c7d8e9f0", "gid=1a2b3c4d-5e6f-7081-92a3-b4c5d6e7f809", "gcgl=0",
+               "pk=9a8b7c6d5e4f3a2b1c0d9e8f7a6b5c4d3e2f1a0b9c8d7e6f5a4b3c2d1e0f9a8b"});
+        p.txt("A0B1C2D3E4F5@Kitchen HomePod._raop._tcp.local",
+              {"cn=0,1,2,3", "da=true", "et=0,3,5", "ft=0x4A7FDFD5,0xBC157FDE", "sf=0x1a404", "md=0,1,2", "am=AudioAccessory1,1",
+               "pk=9a8b7c6d5e4f3a2b1c0d9e8f7a6b5c4d3e2f1a0b9c8d7e6f5a4b3c2d1e0f9a8b", "tp=UDP", "vn=65537", "vs=530.6", "ov=16.3"});
+        p.a("Kitchen-HomePod.local", 192, 168, 1, 42);
+        p.aaaa("Kitchen-HomePod.local");
+        p.nsec("Kitchen HomePod._airplay._tcp.local");
+        p.nsec("Kitchen-HomePod.local");
+        packets.push_back(p.bytes);
+    }
+    {
+        PacketWriter p(0x0000, 4, 2, 0, 0);
+        p.question("_companion-link._tcp.local", MDNS_TYPE_PTR, 0x8001);
+        p.question("_sleep-proxy._udp.local", MDNS_TYPE_PTR, 0x8001);
+        p.question("_homekit._tcp.local", MDNS_TYPE_PTR);
+        p.question("_airplay._tcp.local", MDNS_TYPE_PTR);
+        p.ptr("_companion-link._tcp.local", "Living Room._companion-link._tcp.local", 4493);
+        p.ptr("_airplay._tcp.local", "Kitchen HomePod._airplay._tcp.local", 4493);
+        packets.push_back(p.bytes);
+    }
+    {
+        PacketWriter p(0x8400, 0, 4, 0, 1);
+        p.a("esp-kitchen.local", 192, 168, 1, 50);
+        p.txt("Kitchen light._http._tcp.local", {"path=/", "version=2.4"});
+        p.srv("Kitchen light._http._tcp.local", "esp-kitchen.local", 80);
+        p.ptr("_http._tcp.local", "Kitchen light._http._tcp.local");
+        p.ptr("_http._tcp.local", "Printer admin._http._tcp.local");
+        packets.push_back(p.bytes);
+    }
+    return packets;
+}
+
+static std::string label(const uint8_t* l)
+{
+    return std::string((const char*) l + 1, l[0]);
+}
+
+// Resolves every name of a packet, returns how many were well formed or -1
+// when anything handed out lies outside the packet
+static int walk(const uint8_t* data, size_t size)
+{
+    MDNSPacket packet(data, size);
+    MDNSRecord record;
+    const uint8_t* labels[8];
+    int seen = 0;
+    bool inside = true;
+    auto check = [&](uint16_t offset) {
+        int count = packet.labels(offset, labels, 8);
+        for (int i = 0; i < count && i < 8; i++)
+            inside = inside && labels[i] >= data && labels[i] + 1 + labels[i][0] <= data + size;
+        seen += count > 0;
+    };
+    while (packet.nextQuestion(record))
+        check(record._name);
+    while (packet.nextRecord(record)) {
+        inside = inside && (size_t) record._rdata + record._rdlength <= size;
+        check(record._name);
+        if (record._type == MDNS_TYPE_PTR)
+            check(record._rdata);
+        else if (record._type == MDNS_TYPE_SRV && record._rdlength > 6)
+            check(record._rdata + 6);
+    }
+    return inside ? seen : -1;
+}
+
+TEST_CASE("MDNSPacket walks questions and records in place", "[libraries][MDNSParser]")
+{
+    auto packets = traffic();
+    auto& query = packets[2];
+    MDNSPacket packet(query.data(), query.size());
+    REQUIRE(packet.valid());
+    REQUIRE_FALSE(packet.response());
+
+    MDNSRecord record;
+    const uint8_t* labels[4];
+    std::vector<std::string> names;
+    while (packet.nextQuestion(record)) {
+        REQUIRE(record._type == MDNS_TYPE_PTR);
+        REQUIRE(record._class == MDNS_CLASS_IN);
+        int count = packet.labels(record._name, labels, 4);
+        REQUIRE(count == 3);
+        names.push_back(label(labels[0]));
+        REQUIRE(MDNSPacket::labelIs(labels[2], "LOCAL"));
+    }
+    REQUIRE(names == std::vector<std::string>({"_companion-link", "_sleep-proxy", "_homekit", "_airplay"}));
+
+    // the known answers, their names compressed against the questions
+    REQUIRE(packet.nextRecord(record));
+    REQUIRE(record._ttl == 4493);
+    REQUIRE(packet.labels(record._rdata, labels, 4) == 4);
+    REQUIRE(label(labels[0]) == "Living Room");
+    REQUIRE(label(labels[1]) == "_companion-link");
+    REQUIRE(packet.nextRecord(record));
+    REQUIRE_FALSE(packet.nextRecord(record));
+
+    packet.rewindRecords();
+    REQUIRE(packet.nextRecord(record));
+    REQUIRE(packet.labels(record._name, labels, 1) == 3);
+    REQUIRE(packet.labels(record._name, labels, 4) == 3);
+
+    char copy[8];
+    REQUIRE(MDNSPacket::copyLabel(labels[0], copy, sizeof(copy)) == false);
+    REQUIRE(MDNSPacket::copyLabel(labels[2], copy, sizeof(copy)));
+    REQUIRE(std::string(copy) == "local");
+
+    REQUIRE_FALSE(MDNSPacket(query.data(), 11).valid());
+    for (auto& p : packets)
+        REQUIRE(walk(p.data(), p.size()) > 0);
+}
+
+TEST_CASE("MDNSPacket stops at malformed names", "[libraries][MDNSParser]")
+{
+    const uint8_t* labels[4];
+    MDNSRecord record;
+
+    // a pointer to itself, one pointing forward and a loop between two names
+    const uint8_t self[] = {0, 0, 0x84, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0xC0, 12, 0, 1, 0, 1, 0, 0, 0, 1, 0, 0};
+    MDNSPacket selfPacket(self, sizeof(self));
+    REQUIRE(selfPacket.nextRecord(record));
+    REQUIRE(selfPacket.labels(record._name, labels, 4) == -1);
+
+    const uint8_t forward[] = {0, 0, 0x84, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0xC0, 14, 1, 'a', 0, 0, 1, 0, 1, 0, 0, 0, 1, 0, 0};
+    MDNSPacket forwardPacket(forward, sizeof(forward));
+    REQUIRE(forwardPacket.labels(12, labels, 4) == -1);
+    REQUIRE(forwardPacket.labels(14, labels, 4) == 1);
+
+    const uint8_t loop[] = {0, 0, 0x84, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 'a', 0xC0, 16, 1, 'b', 0xC0, 12};
+    MDNSPacket loopPacket(loop, sizeof(loop));
+    REQUIRE(loopPacket.labels(12, labels, 4) == -1);
+    REQUIRE(loopPacket.labels(16, labels, 4) == -1);
+
+    // labels and rdata running past the end, reserved label types
+    const uint8_t truncated[] = {0, 0, 0x84, 0, 0, 0, 0, 1, 0, 0, 0, 0, 5, 'l', 'o', 'c'};
+    MDNSPacket truncatedPacket(truncated, sizeof(truncated));
+    REQUIRE_FALSE(truncatedPacket.nextRecord(record));
+    REQUIRE(truncatedPacket.labels(12, labels, 4) == -1);
+
+    const uint8_t rdata[] = {0, 0, 0x84, 0, 0, 0, 0, 2, 0, 0, 0, 0, 0, 0, 1, 0, 1, 0, 0, 0, 1, 0, 4, 1, 2, 3};
+    MDNSPacket rdataPacket(rdata, sizeof(rdata));
+    REQUIRE_FALSE(rdataPacket.nextRecord(record));
+
+    const uint8_t reserved[] = {0, 0, 0x84, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0x41, 'a', 0};
+    MDNSPacket reservedPacket(reserved, sizeof(reserved));
+    REQUIRE(reservedPacket.labels(12, labels, 4) == -1);
+
+    // more records announced than there are
+    auto packets = traffic();
+    auto chromecast = packets[0];
+    chromecast[11] = 200;
+    MDNSPacket overcounted(chromecast.data(), chromecast.size());
+    int records = 0;
+    while (overcounted.nextRecord(record))
+        records++;
+    REQUIRE(records == 5);
+}
+
+TEST_CASE("MDNSCache takes responses in any record order", "[libraries][MDNSParser]")
+{
+    auto packets = traffic();
+    MDNSCache cache;
+    std::vector<std::string> up;
+    cache.browse("http", "tcp", [&up](const MDNSServiceInfo& info) {
+        up.push_back(std::string(info.instance) + " " + info.hostname + " " + info.ip.toString().c_str());
+    });
+    cache.browse("airplay", "tcp", nullptr);
+
+    for (auto& p : packets) {
+        MDNSPacket packet(p.data(), p.size());
+        cache.addResponse(1000, packet);
+    }
+
+    // the address came first and still completes the instance
+    REQUIRE(cache.count("http", "tcp") == 1);
+    REQUIRE(up == std::vector<std::string>({"Kitchen light esp-kitchen 192.168.1.50"}));
+    MDNSServiceInfo info;
+    REQUIRE(cache.info("http", "tcp", 0, info));
+    REQUIRE(info.port == 80);
+    REQUIRE(info.txtValue("version") == "2.4");
+
+    REQUIRE(cache.count("airplay", "tcp") == 1);
+    REQUIRE(cache.info("airplay", "tcp", 0, info));
+    REQUIRE(std::string(info.instance) == "Kitchen HomePod");
+    REQUIRE(info.port == 7000);
+    REQUIRE(info.txtValue("model") == "AudioAccessory1,1");
+
+    // known answers in a query are no news
+    REQUIRE(cache.count("googlecast", "tcp") == 0);
+    MDNSCache other;
+    other.browse("companion-link", "tcp", nullptr);
+    MDNSPacket query(packets[2].data(), packets[2].size());
+    other.addResponse(1000, query);
+    MDNSServiceInfo none;
+    REQUIRE_FALSE(other.info("companion-link", "tcp", 0, none));
+}
+
+TEST_CASE("MDNSPacket survives mutated traffic", "[libraries][MDNSParser]")
+{
+    auto packets = traffic();
+    uint32_t seed = 0x2545F491;
+    auto random = [&seed]() {
+        seed ^= seed << 13;
+        seed ^= seed >> 17;
+        seed ^= seed << 5;
+        return seed;
+    };
+
+    MDNSCache cache;
+    cache.browse("http", "tcp", [](const MDNSServiceInfo& info) { (void) info.txtValue("path"); });
+    cache.browse("airplay", "tcp", nullptr);
+    cache.browse("googlecast", "tcp", nullptr);
+
+    for (int round = 0; round < 20000; round++) {
+        // exactly sized, so the sanitizer sees any read past the end
+        std::vector<uint8_t> p = packets[random() % packets.size()];
+        for (int mutations = 1 + random() % 4; mutations; mutations--) {
+            size_t at = random() % p.size();
+            switch (random() % 5) {
+            case 0: p[at] = random(); break;
+            case 1: p[at] ^= 1 << (random() % 8); break;
+            case 2: p.resize(1 + at); break;
+            case 3: p[at] = 0xC0 | (random() % 4); if (at + 1 < p.size()) p[at + 1] = random(); break;
+            case 4: if (at > 12) p[at] = random() % 64; break;
+            }
+        }
+        std::vector<uint8_t> exact(p);
+        REQUIRE(walk(exact.data(), exact.size()) >= 0);
+        MDNSPacket packet(exact.data(), exact.size());
+        cache.addResponse(round, packet);
+        cache.expire(round);
+    }
+}
+
+TEST_CASE("MDNSPacket benchmark", "[.][benchmark][MDNSParser]")
+{
+    using clock = std::chrono::steady_clock;
+    auto packets = traffic();
+    const int rounds = 20000;
+    size_t bytes = 0;
+    for (auto& p : packets)
+        bytes += p.size();
+
+    auto run = [&](MDNSCache& cache) {
+        auto start = clock::now();
+        for (int r = 0; r < rounds; r++) {
+            for (auto& p : packets) {
+                MDNSPacket packet(p.data(), p.size());
+                cache.addResponse(r, packet);
+            }
+        }
+        return std::chrono::duration<double, std::nano>(clock::now() - start).count() / rounds / packets.size();
+    };
+
+    MDNSCache idle;
+    MDNSCache browsing;
+    browsing.browse("http", "tcp", nullptr);
+    MDNSCache busy;
+    busy.browse("http", "tcp", nullptr);
+    busy.browse("airplay", "tcp", nullptr);
+    busy.browse("googlecast", "tcp", nullptr);
+
+    auto start = clock::now();
+    int seen = 0;
+    for (int r = 0; r < rounds; r++) {
+        for (auto& p : packets)
+            seen += walk(p.data(), p.size());
+    }
+    double walkTime = std::chrono::duration<double, std::nano>(clock::now() - start).count() / rounds / packets.size();
+    REQUIRE(seen > 0);
+
+    printf("%d packets, %.0f bytes on average\n", (int) packets.size(), (double) bytes / packets.size());
+    printf("not browsing:           %7.1f ns per packet\n", run(idle));
+    printf("browsing one service:   %7.1f ns per packet\n", run(browsing));
+    printf("browsing all services:  %7.1f ns per packet\n", run(busy));
+    printf("every name resolved:    %7.1f ns per packet\n", walkTime);
+}
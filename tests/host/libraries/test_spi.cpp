@@ -0,0 +1,103 @@
+/*
+ test_spi.cpp - SPI library background transfers
+ Copyright © 2016 Ivan Grokhotkov
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+ */
+
+#include <catch.hpp>
+#include <string.h>
+#include <Arduino.h>
+#include <esp8266_peri_mock.h>
+#include <SPI.h>
+
+namespace {
+
+struct Done {
+    int calls = 0;
+    bool busy = false;
+    bool waited = false;
+    uint8_t received = 0xAA;
+};
+
+void record(void* arg)
+{
+    Done* done = (Done*) arg;
+    done->calls++;
+    done->busy = SPI.asyncBusy();
+    done->waited = SPI.asyncWait();
+}
+
+// nothing ends a blocking transfer on the host, so only while one is queued
+void recordTransfer(void* arg)
+{
+    record(arg);
+    ((Done*) arg)->received = SPI.transfer(0x55);
+}
+
+void finish()
+{
+    for (int i = 0; i < 100 && mock_spi_busy(); i++) {
+        mock_spi_complete();
+    }
+}
+
+} // namespace
+
+TEST_CASE("SPI callbacks can't block on queued transfers", "[libraries][SPI]")
+{
+    SPI.begin();
+    const uint8_t first[] = "first";
+    const uint8_t second[] = "second";
+    uint8_t in[sizeof(first) + sizeof(second)];
+    memset(in, 0, sizeof(in));
+    Done firstDone, secondDone;
+
+    REQUIRE(SPI.transferAsync(first, in, sizeof(first), recordTransfer, &firstDone));
+    REQUIRE(SPI.transferAsync(second, in + sizeof(first), sizeof(second), record, &secondDone));
+    REQUIRE(SPI.asyncBusy());
+
+    mock_spi_complete();
+    // the second one is on the bus, waiting for it here would never end
+    CHECK(firstDone.calls == 1);
+    CHECK(firstDone.busy);
+    CHECK_FALSE(firstDone.waited);
+    CHECK(firstDone.received == 0);
+    CHECK(secondDone.calls == 0);
+
+    finish();
+    // the last callback finds the queue empty and may use the bus
+    CHECK(secondDone.calls == 1);
+    CHECK_FALSE(secondDone.busy);
+    CHECK(secondDone.waited);
+    // and the transfer(0x55) of the first one left the second alone
+    CHECK(memcmp(in, first, sizeof(first)) == 0);
+    CHECK(memcmp(in + sizeof(first), second, sizeof(second)) == 0);
+    CHECK_FALSE(SPI.asyncBusy());
+    SPI.end();
+}
+
+TEST_CASE("SPISettings picks the same divider at run time", "[libraries][SPI]")
+{
+    static_assert(SPISettings::clockRegister(80000000) == 0x80000000, "sysclock");
+    constexpr SPISettings fixed(8000000, MSBFIRST, SPI_MODE0);
+    static_assert(fixed._clockReg == SPISettings::clockRegister(8000000), "compile time");
+
+    for (uint32_t freq = 1; freq < 90000000; freq += 997) {
+        volatile uint32_t runtime = freq;
+        CHECK(SPISettings(runtime, MSBFIRST, SPI_MODE0)._clockReg == SPISettings::clockRegister(freq));
+    }
+    // the last-frequency cache hands back the right register when devices take turns
+    for (uint32_t freq : { 1000000, 1000000, 4000000, 1000000, 4000000 }) {
+        volatile uint32_t runtime = freq;
+        CHECK(SPISettings::clockRegisterAt(runtime) == SPISettings::clockRegister(freq));
+    }
+}
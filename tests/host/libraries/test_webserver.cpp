@@ -0,0 +1,535 @@
+/*
+ test_webserver.cpp - ESP8266WebServer tests
+ Copyright © 2016 Ivan Grokhotkov
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+ */
+
+#include <catch.hpp>
+#include <string>
+#include <ESP8266WebServer.h>
+#include <FS.h>
+#include "../common/spiffs_mock.h"
+
+static void pump(ESP8266WebServer& server, int rounds = 4)
+{
+    for (int i = 0; i < rounds; ++i) {
+        server.handleClient();
+    }
+}
+
+static size_t count(const std::string& haystack, const std::string& needle)
+{
+    size_t n = 0;
+    for (size_t pos = haystack.find(needle); pos != std::string::npos; pos = haystack.find(needle, pos + 1)) {
+        ++n;
+    }
+    return n;
+}
+
+static void echoName(ESP8266WebServer& server)
+{
+    server.on("/hello", [&server]() {
+        server.send(HTTP_OK, "text/plain", String("hello ") + server.arg("name"));
+    });
+}
+
+TEST_CASE("WebServer answers a simple GET", "[libraries][WebServer]")
+{
+    ESP8266WebServer server(8001);
+    echoName(server);
+    server.begin();
+
+    auto client = WiFiServer::connect(8001);
+    client->send("GET /hello?name=esp HTTP/1.1\r\nHost: esp\r\n\r\n");
+    pump(server);
+
+    auto response = client->received();
+    REQUIRE(response.find("HTTP/1.1 200 OK\r\n") == 0);
+    REQUIRE(response.find("Content-Length: 9\r\n") != std::string::npos);
+    REQUIRE(response.find("Connection: keep-alive\r\n") != std::string::npos);
+    REQUIRE(response.substr(response.size() - 9) == "hello esp");
+    REQUIRE_FALSE(client->stopped);
+
+    // a small response leaves in one write
+    REQUIRE(client->writes == 1);
+}
+
+TEST_CASE("WebServer keep-alive and pipelining", "[libraries][WebServer]")
+{
+    ESP8266WebServer server(8002);
+    echoName(server);
+    server.begin();
+
+    SECTION("pipelined requests are answered in order on one connection") {
+        auto client = WiFiServer::connect(8002);
+        client->send(
+            "GET /hello?name=one HTTP/1.1\r\n\r\n"
+            "GET /hello?name=two HTTP/1.1\r\n\r\n"
+            "GET /hello?name=three HTTP/1.1\r\nConnection: close\r\n\r\n");
+        pump(server);
+
+        auto response = client->received();
+        REQUIRE(count(response, "HTTP/1.1 200 OK") == 3);
+        REQUIRE(response.find("hello one") < response.find("hello two"));
+        REQUIRE(response.find("hello two") < response.find("hello three"));
+        REQUIRE(count(response, "Connection: close") == 1);
+    }
+
+    SECTION("pipelined POST body does not leak into the next request") {
+        server.on("/post", [&server]() {
+            server.send(HTTP_OK, "text/plain", String("got ") + server.arg("v"));
+        });
+        auto client = WiFiServer::connect(8002);
+        client->send(
+            "POST /post HTTP/1.1\r\nContent-Length: 3\r\n\r\nv=1"
+            "GET /hello?name=next HTTP/1.1\r\n\r\n");
+        pump(server);
+
+        auto response = client->received();
+        REQUIRE(response.find("got 1") != std::string::npos);
+        REQUIRE(response.find("hello next") != std::string::npos);
+    }
+
+    SECTION("HTTP/1.0 closes unless keep-alive is requested") {
+        auto client = WiFiServer::connect(8002);
+        client->send("GET /hello HTTP/1.0\r\n\r\n");
+        pump(server);
+        auto response = client->received();
+        REQUIRE(response.find("HTTP/1.0 200 OK") == 0);
+        REQUIRE(response.find("Connection: close") != std::string::npos);
+
+        auto persistent = WiFiServer::connect(8002);
+        persistent->send("GET /hello HTTP/1.0\r\nConnection: Keep-Alive\r\n\r\n");
+        pump(server);
+        REQUIRE(persistent->received().find("Connection: keep-alive") != std::string::npos);
+    }
+
+    SECTION("connection closes after the configured number of requests") {
+        server.setKeepAlive(HTTP_MAX_KEEPALIVE_WAIT, 2);
+        auto client = WiFiServer::connect(8002);
+        client->send("GET /hello HTTP/1.1\r\n\r\n");
+        pump(server);
+        REQUIRE(client->received().find("Connection: keep-alive") != std::string::npos);
+        client->send("GET /hello HTTP/1.1\r\n\r\n");
+        pump(server);
+        REQUIRE(client->received().find("Connection: close") != std::string::npos);
+    }
+}
+
+TEST_CASE("WebServer connections free their buffers between requests", "[libraries][WebServer]")
+{
+    HTTPConnection c;
+    const char request[] = "GET / HTTP/1.1\r\n\r\n";
+    const int length = sizeof(request) - 1;
+    c.capacity = HTTP_MAX_HEADER_SIZE;
+    c.request = (char*) malloc(c.capacity + 1);
+
+    SECTION("an idle persistent connection holds no buffer") {
+        memcpy(c.request, request, length);
+        c.readBytes = c.requestLength = length;
+        c.reset(true);
+        REQUIRE(c.request == nullptr);
+        REQUIRE(c.capacity == 0);
+        REQUIRE(c.readBytes == 0);
+    }
+
+    SECTION("pipelined bytes are kept in a shrunk buffer") {
+        memcpy(c.request, request, length);
+        memcpy(c.request + length, request, length);
+        c.readBytes = 2 * length;
+        c.requestLength = length;
+        c.reset(true);
+        REQUIRE(c.capacity == HTTP_REQUEST_BUFLEN);
+        REQUIRE(c.pipelined);
+        REQUIRE(std::string(c.request) == request);
+    }
+
+    SECTION("closing frees everything") {
+        c.readBytes = 0;
+        c.close();
+        REQUIRE(c.request == nullptr);
+        REQUIRE(c.capacity == 0);
+    }
+}
+
+TEST_CASE("WebServer serves interleaved clients in parallel", "[libraries][WebServer]")
+{
+    ESP8266WebServer server(8003);
+    echoName(server);
+    server.on("/post", HTTP_POST, [&server]() {
+        server.send(HTTP_OK, "text/plain", String("posted ") + server.arg("v"));
+    });
+    server.begin();
+
+    auto slow = WiFiServer::connect(8003);
+    auto fast = WiFiServer::connect(8003);
+    auto trickle = WiFiServer::connect(8003);
+
+    // a slow client sends half of its headers, a POST body trickles in
+    slow->send("GET /hello?name=slow HTTP/1.1\r\nHo");
+    trickle->send("POST /post HTTP/1.1\r\nContent-Length: 9\r\n\r\nv=");
+    fast->send("GET /hello?name=fast HTTP/1.1\r\n\r\n");
+    pump(server, 1);
+
+    // the complete request does not wait for the incomplete ones
+    REQUIRE(fast->received().find("hello fast") != std::string::npos);
+    REQUIRE(slow->received().empty());
+    REQUIRE(trickle->received().empty());
+
+    trickle->send("tri");
+    slow->send("st: esp\r\n");
+    pump(server, 1);
+    REQUIRE(slow->received().empty());
+    REQUIRE(trickle->received().empty());
+
+    slow->send("\r\n");
+    trickle->send("ckle");
+    pump(server, 1);
+    REQUIRE(slow->received().find("hello slow") != std::string::npos);
+    REQUIRE(trickle->received().find("posted trickle") != std::string::npos);
+
+    // each connection keeps its own request state across further requests
+    fast->send("GET /hello?name=again HTTP/1.1\r\n\r\n");
+    slow->send("GET /hello?name=once HTTP/1.1\r\n\r\n");
+    pump(server, 1);
+    REQUIRE(fast->received().find("hello again") != std::string::npos);
+    REQUIRE(slow->received().find("hello once") != std::string::npos);
+}
+
+TEST_CASE("WebServer connection pool is bounded", "[libraries][WebServer]")
+{
+    ESP8266WebServer server(8004);
+    echoName(server);
+    server.begin();
+
+    std::shared_ptr<MockSocket> idle[HTTP_MAX_CLIENTS];
+    for (auto& client : idle) {
+        client = WiFiServer::connect(8004);
+        client->send("GET /hello HTTP/1.1\r\n\r\n");
+    }
+    pump(server, 1);
+    for (auto& client : idle) {
+        REQUIRE(client->received().find("200 OK") != std::string::npos);
+    }
+
+    // all slots hold idle persistent connections, one of them makes room
+    auto late = WiFiServer::connect(8004);
+    late->send("GET /hello?name=late HTTP/1.1\r\n\r\n");
+    pump(server, 3);
+    REQUIRE(late->received().find("hello late") != std::string::npos);
+}
+
+TEST_CASE("WebServer streams uploads without buffering the payload", "[libraries][WebServer]")
+{
+    ESP8266WebServer server(8005);
+    size_t received = 0;
+    size_t largest = 0;
+    String name;
+    server.on("/upload", HTTP_POST, [&server, &name]() {
+        server.send(HTTP_OK, "text/plain", name + " " + server.arg("note"));
+    }, [&server, &received, &largest, &name]() {
+        HTTPUpload& upload = server.upload();
+        if (upload.status == UPLOAD_FILE_START) {
+            name = upload.filename;
+        } else if (upload.status == UPLOAD_FILE_WRITE) {
+            received += upload.currentSize;
+            largest = std::max(largest, upload.currentSize);
+        }
+    });
+    server.begin();
+
+    const std::string file(200 * 1024, 'f');
+    const std::string payload =
+        "--xyz\r\nContent-Disposition: form-data; name=\"note\"\r\n\r\nhi\r\n"
+        "--xyz\r\nContent-Disposition: form-data; name=\"f\"; filename=\"big.bin\"\r\n\r\n"
+        + file + "\r\n--xyz--\r\n";
+
+    auto client = WiFiServer::connect(8005);
+    client->send(
+        "POST /upload HTTP/1.1\r\n"
+        "Content-Type: multipart/form-data; boundary=xyz\r\n"
+        "Expect: 100-continue\r\n"
+        "Content-Length: " + std::to_string(payload.size()) + "\r\n\r\n");
+    pump(server, 1);
+    REQUIRE(client->received() == "HTTP/1.1 100 Continue\r\n\r\n");
+
+    // the payload arrives one TCP segment per turn
+    for (size_t pos = 0; pos < payload.size(); pos += 1460) {
+        client->send(payload.substr(pos, 1460));
+        pump(server, 1);
+    }
+
+    auto response = client->received();
+    REQUIRE(response.find("HTTP/1.1 200 OK") == 0);
+    REQUIRE(response.find("big.bin hi") != std::string::npos);
+    REQUIRE(received == file.size());
+    REQUIRE(largest == HTTP_UPLOAD_BUFLEN);
+}
+
+TEST_CASE("WebServer dispatches through the route table", "[libraries][WebServer]")
+{
+    ESP8266WebServer server(8006);
+    server.on("/a", HTTP_GET, [&server]() { server.send(HTTP_OK, "text/plain", "get a"); });
+    server.on("/a", HTTP_POST, [&server]() { server.send(HTTP_OK, "text/plain", "post a"); });
+    server.begin();
+
+    // added after begin(), the table is rebuilt on the next request
+    server.on("/b", [&server]() { server.send(HTTP_OK, "text/plain", "any b"); });
+
+    auto client = WiFiServer::connect(8006);
+    client->send(
+        "GET /a HTTP/1.1\r\n\r\n"
+        "POST /a HTTP/1.1\r\nContent-Length: 0\r\n\r\n"
+        "PUT /b HTTP/1.1\r\n\r\n"
+        "PUT /a HTTP/1.1\r\nConnection: close\r\n\r\n");
+    pump(server, 8);
+
+    auto response = client->received();
+    REQUIRE(response.find("get a") != std::string::npos);
+    REQUIRE(response.find("post a") != std::string::npos);
+    REQUIRE(response.find("any b") != std::string::npos);
+    REQUIRE(response.find("HTTP/1.1 404") != std::string::npos);
+}
+
+static std::string get(ESP8266WebServer& server, uint16_t port, const std::string& uri, const std::string& headers = "")
+{
+    auto client = WiFiServer::connect(port);
+    client->send("GET " + uri + " HTTP/1.1\r\n" + headers + "Connection: close\r\n\r\n");
+    pump(server);
+    auto response = client->received();
+
+    // hang up so the connection slot is free for the next request
+    client->peerClosed = true;
+    pump(server, 1);
+    return response;
+}
+
+static std::string headerValue(const std::string& response, const std::string& name)
+{
+    size_t pos = response.find("\r\n" + name + ": ");
+    if (pos == std::string::npos) {
+        return "<missing>";
+    }
+    pos += name.size() + 4;
+    return response.substr(pos, response.find("\r\n", pos) - pos);
+}
+
+static std::string body(const std::string& response)
+{
+    return response.substr(response.find("\r\n\r\n") + 4);
+}
+
+TEST_CASE("WebServer serves static files with validators and ranges", "[libraries][WebServer]")
+{
+    SPIFFS_MOCK_DECLARE(64, 8, 512);
+    REQUIRE(SPIFFS.begin());
+    {
+        auto f = SPIFFS.open("/www/data.txt", "w");
+        f.print("0123456789");
+    }
+
+    ESP8266WebServer server(8008);
+    server.serveStatic("/", SPIFFS, "/www/", "max-age=60", "Wed, 21 Oct 2015 07:28:00 GMT");
+    server.begin();
+
+    auto full = get(server, 8008, "/data.txt");
+    REQUIRE(full.find("HTTP/1.1 200 OK\r\n") == 0);
+    REQUIRE(headerValue(full, "Accept-Ranges") == "bytes");
+    REQUIRE(headerValue(full, "Cache-Control") == "max-age=60");
+    REQUIRE(headerValue(full, "Last-Modified") == "Wed, 21 Oct 2015 07:28:00 GMT");
+    REQUIRE(body(full) == "0123456789");
+    const std::string etag = headerValue(full, "ETag");
+    REQUIRE(etag.size() > 2);
+    REQUIRE(etag.front() == '"');
+
+    SECTION("a matching If-None-Match answers 304") {
+        auto response = get(server, 8008, "/data.txt", "If-None-Match: \"other\", " + etag + "\r\n");
+        REQUIRE(response.find("HTTP/1.1 304 Not Modified\r\n") == 0);
+        REQUIRE(headerValue(response, "ETag") == etag);
+        REQUIRE(body(response) == "");
+
+        response = get(server, 8008, "/data.txt", "If-None-Match: \"other\"\r\nIf-Modified-Since: Wed, 21 Oct 2015 07:28:00 GMT\r\n");
+        REQUIRE(response.find("HTTP/1.1 200 OK\r\n") == 0);
+    }
+
+    SECTION("rewriting the file changes the ETag, even at the same size") {
+        {
+            auto f = SPIFFS.open("/www/data.txt", "w");
+            f.print("9876543210");
+        }
+        auto response = get(server, 8008, "/data.txt", "If-None-Match: " + etag + "\r\n");
+        REQUIRE(response.find("HTTP/1.1 200 OK\r\n") == 0);
+        REQUIRE(body(response) == "9876543210");
+        REQUIRE(headerValue(response, "ETag") != etag);
+        REQUIRE(headerValue(get(server, 8008, "/data.txt"), "ETag") == headerValue(response, "ETag"));
+    }
+
+    SECTION("a request while the file is written doesn't keep a stale ETag") {
+        uint32_t generation = SPIFFS.generation();
+        auto f = SPIFFS.open("/www/data.txt", "a");
+        f.print("abc");
+        auto during = headerValue(get(server, 8008, "/data.txt"), "ETag");
+        f.print("def");
+        f.close();
+        // no file was added, so the index is kept, only the content hashes go
+        REQUIRE(SPIFFS.generation() == generation);
+        auto response = get(server, 8008, "/data.txt", "If-None-Match: " + during + "\r\n");
+        REQUIRE(response.find("HTTP/1.1 200 OK\r\n") == 0);
+        REQUIRE(body(response) == "0123456789abcdef");
+        REQUIRE(headerValue(response, "ETag") != during);
+    }
+
+    SECTION("a matching If-Modified-Since answers 304") {
+        auto response = get(server, 8008, "/data.txt", "If-Modified-Since: Wed, 21 Oct 2015 07:28:00 GMT\r\n");
+        REQUIRE(response.find("HTTP/1.1 304 Not Modified\r\n") == 0);
+
+        response = get(server, 8008, "/data.txt", "If-Modified-Since: Thu, 22 Oct 2015 07:28:00 GMT\r\n");
+        REQUIRE(response.find("HTTP/1.1 200 OK\r\n") == 0);
+    }
+
+    SECTION("a single range answers 206") {
+        auto response = get(server, 8008, "/data.txt", "Range: bytes=2-5\r\n");
+        REQUIRE(response.find("HTTP/1.1 206 Partial Content\r\n") == 0);
+        REQUIRE(headerValue(response, "Content-Range") == "bytes 2-5/10");
+        REQUIRE(headerValue(response, "Content-Length") == "4");
+        REQUIRE(body(response) == "2345");
+
+        REQUIRE(body(get(server, 8008, "/data.txt", "Range: bytes=7-\r\n")) == "789");
+        REQUIRE(body(get(server, 8008, "/data.txt", "Range: bytes=-3\r\n")) == "789");
+        REQUIRE(body(get(server, 8008, "/data.txt", "Range: bytes=8-100\r\n")) == "89");
+        REQUIRE(body(get(server, 8008, "/data.txt", "Range: bytes=-100\r\n")) == "0123456789");
+        REQUIRE(body(get(server, 8008, "/data.txt", "Range: bytes=0-0\r\nIf-Range: " + etag + "\r\n")) == "0");
+    }
+
+    SECTION("ranges past the end answer 416") {
+        auto response = get(server, 8008, "/data.txt", "Range: bytes=10-\r\n");
+        REQUIRE(response.find("HTTP/1.1 416 Range Not Satisfiable\r\n") == 0);
+        REQUIRE(headerValue(response, "Content-Range") == "bytes */10");
+        REQUIRE(body(response) == "");
+    }
+
+    SECTION("other ranges are ignored") {
+        const char* ranges[] = { "bytes=1-2,4-5", "bytes=5-2", "items=0-1", "bytes=-", "bytes=x-1", "bytes=1-2 junk" };
+        for (auto range : ranges) {
+            auto response = get(server, 8008, "/data.txt", std::string("Range: ") + range + "\r\n");
+            REQUIRE(response.find("HTTP/1.1 200 OK\r\n") == 0);
+            REQUIRE(body(response) == "0123456789");
+        }
+        auto response = get(server, 8008, "/data.txt", "Range: bytes=0-0\r\nIf-Range: \"stale\"\r\n");
+        REQUIRE(body(response) == "0123456789");
+    }
+}
+
+TEST_CASE("WebServer serves static files from its index", "[libraries][WebServer]")
+{
+    SPIFFS_MOCK_DECLARE(64, 8, 512);
+    REQUIRE(SPIFFS.begin());
+    {
+        auto f = SPIFFS.open("/www/index.htm", "w");
+        f.print("<p>home</p>");
+        f = SPIFFS.open("/www/app.js.gz", "w");
+        f.print("gzipped");
+    }
+
+    ESP8266WebServer server(8009);
+    server.serveStatic("/", SPIFFS, "/www/");
+    server.begin();
+
+    auto response = get(server, 8009, "/");
+    REQUIRE(response.find("HTTP/1.1 200 OK\r\n") == 0);
+    REQUIRE(headerValue(response, "Content-Type") == "text/html");
+    REQUIRE(body(response) == "<p>home</p>");
+
+    // only the compressed variant exists, it is sent for the plain name
+    response = get(server, 8009, "/app.js");
+    REQUIRE(headerValue(response, "Content-Type") == "application/javascript");
+    REQUIRE(headerValue(response, "Content-Encoding") == "gzip");
+    REQUIRE(body(response) == "gzipped");
+
+    response = get(server, 8009, "/app.js.gz");
+    REQUIRE(headerValue(response, "Content-Type") == "application/x-gzip");
+    REQUIRE(headerValue(response, "Content-Encoding") == "<missing>");
+
+    REQUIRE(get(server, 8009, "/missing.css").find("HTTP/1.1 404 Not Found\r\n") == 0);
+    REQUIRE(get(server, 8009, "/index.htm.gz").find("HTTP/1.1 404 Not Found\r\n") == 0);
+
+    // files written, renamed or removed after the index was built
+    {
+        auto f = SPIFFS.open("/www/late.txt", "w");
+        f.print("late");
+    }
+    REQUIRE(body(get(server, 8009, "/late.txt")) == "late");
+    REQUIRE(SPIFFS.rename("/www/late.txt", "/www/later.txt"));
+    REQUIRE(get(server, 8009, "/late.txt").find("HTTP/1.1 404 Not Found\r\n") == 0);
+    REQUIRE(body(get(server, 8009, "/later.txt")) == "late");
+    REQUIRE(SPIFFS.remove("/www/later.txt"));
+    REQUIRE(get(server, 8009, "/later.txt").find("HTTP/1.1 404 Not Found\r\n") == 0);
+}
+
+TEST_CASE("WebServer indexes only the files below the served directory", "[libraries][WebServer]")
+{
+    SPIFFS_MOCK_DECLARE(64, 8, 512);
+    REQUIRE(SPIFFS.begin());
+    {
+        auto f = SPIFFS.open("/www/a.txt", "w");
+        f.print("public");
+        f = SPIFFS.open("/www2/secret.txt", "w");
+        f.print("secret");
+        f = SPIFFS.open("/page.htm", "w");
+        f.print("page");
+        f = SPIFFS.open("/page.htm.bak", "w");
+        f.print("backup");
+    }
+
+    ESP8266WebServer server(8011);
+    server.serveStatic("/site", SPIFFS, "/www");
+    server.serveStatic("/page", SPIFFS, "/page.htm");
+    server.begin();
+
+    REQUIRE(body(get(server, 8011, "/site/a.txt")) == "public");
+    // "/site2/..." starts with "/site" and maps to "/www2/...", which is not below "/www"
+    REQUIRE(get(server, 8011, "/site2/secret.txt").find("HTTP/1.1 404 Not Found\r\n") == 0);
+    REQUIRE(body(get(server, 8011, "/page")) == "page");
+}
+
+TEST_CASE("WebServer writes each response piece in one go", "[libraries][WebServer]")
+{
+    static const char page[] PROGMEM = "<html>flash</html>";
+    const String big(3 * HTTP_RESPONSE_BUFLEN, 'x');
+
+    ESP8266WebServer server(8010);
+    server.on("/big", [&server, &big]() {
+        server.send(HTTP_OK, "text/plain", big);
+    });
+    server.on("/chunked", [&server]() {
+        server.setContentLength(CONTENT_LENGTH_UNKNOWN);
+        server.send_P(HTTP_OK, PSTR("text/html"), page);
+        server.sendContent(String("{\"a\":1}"));
+        server.sendContent_P(page);
+        server.sendContent("");
+    });
+    server.begin();
+
+    auto client = WiFiServer::connect(8010);
+    client->send("GET /big HTTP/1.1\r\n\r\n");
+    pump(server);
+    auto response = client->received();
+    REQUIRE(body(response) == big.c_str());
+    REQUIRE(client->writes == 1);
+
+    client->send("GET /chunked HTTP/1.1\r\n\r\n");
+    pump(server);
+    response = client->received();
+    REQUIRE(headerValue(response, "Transfer-Encoding") == "chunked");
+    REQUIRE(body(response) == "12\r\n<html>flash</html>\r\n7\r\n{\"a\":1}\r\n12\r\n<html>flash</html>\r\n0\r\n\r\n");
+    REQUIRE(client->writes == 1 + 4);
+}
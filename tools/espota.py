@@ -36,6 +36,7 @@ import optparse
 import logging
 import hashlib
 import random
+import select
 
 # Commands
 FLASH = 0
@@ -152,6 +153,7 @@ def serve(remoteAddr, localAddr, remotePort, localPort, password, filename, comm
       sys.stderr.write('Uploading')
       sys.stderr.flush()
     offset = 0
+    result = False
     while True:
       chunk = f.read(1460)
       if not chunk: break
@@ -159,8 +161,13 @@ def serve(remoteAddr, localAddr, remotePort, localPort, password, filename, comm
       update_progress(offset/float(content_size))
       connection.settimeout(10)
       try:
+        # Keep sending, TCP flow control paces us. The device acknowledges
+        # in batches, so only pick up what has come back already
         connection.sendall(chunk)
-        res = connection.recv(4)
+        while select.select([connection], [], [], 0)[0]:
+          res = connection.recv(32)
+          if not res: raise socket.error('connection closed')
+          result = result or res.decode().find('O') >= 0
       except:
         sys.stderr.write('\n')
         logging.error('Error Uploading')
@@ -176,8 +183,10 @@ def serve(remoteAddr, localAddr, remotePort, localPort, password, filename, comm
     # the connection before receiving the 'O' of 'OK'
     try:
       connection.settimeout(60)
-      while True:
-        if connection.recv(32).decode().find('O') >= 0: break
+      while not result:
+        res = connection.recv(32)
+        if not res: raise socket.error('connection closed')
+        result = res.decode().find('O') >= 0
       logging.info('Result: OK')
       connection.close()
       f.close()